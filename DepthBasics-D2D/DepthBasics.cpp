@@ -13,6 +13,10 @@
 #include "opencv2/core.hpp"
 #include "opencv2/highgui.hpp"
 #endif
+
+const char* CDepthBasics::cDepthRingName = "KinectDepthFrames";
+const char* CDepthBasics::cRegisteredRingName = "KinectRegisteredColorFrames";
+
 /// <summary>
 /// Entry point for the application
 /// </summary>
@@ -29,9 +33,9 @@ int APIENTRY wWinMain(
 )
 {
     UNREFERENCED_PARAMETER(hPrevInstance);
-    UNREFERENCED_PARAMETER(lpCmdLine);
 
     CDepthBasics application;
+    application.SetRemapFilePath(lpCmdLine);
     application.Run(hInstance, nShowCmd);
 }
 
@@ -50,8 +54,24 @@ CDepthBasics::CDepthBasics() :
     m_pDepthFrameReader(NULL),
     m_pD2DFactory(NULL),
     m_pDrawDepth(NULL),
-    m_pDepthRGBX(NULL)
+    m_pDepthRGBX(NULL),
+    m_pDepthPublisher(NULL),
+    m_pColorFrameReader(NULL),
+    m_pCoordinateMapper(NULL),
+    m_hCoordinateMappingChanged(0),
+    m_pColorRGBX(NULL),
+    m_pRegisteredRGBX(NULL),
+    m_bColorFrameValid(false),
+    m_bRegisteredFrameValid(false),
+    m_bRegistrationReady(false),
+    m_bRegistrationStale(false),
+    m_pRegisteredPublisher(NULL),
+    m_pRegistrationDepthPoints(NULL),
+    m_pRegistrationDepths(NULL),
+    m_pRegistrationColorPoints(NULL)
 {
+    m_szRemapFilePath[0] = L'\0';
+
     LARGE_INTEGER qpf = {0};
     if (QueryPerformanceFrequency(&qpf))
     {
@@ -60,6 +80,25 @@ CDepthBasics::CDepthBasics() :
 
     // create heap storage for depth pixel data in RGBX format
     m_pDepthRGBX = new RGBQUAD[cDepthWidth * cDepthHeight];
+
+    // Other processes are optional consumers, so carry on without the ring if it can't be created
+    m_pDepthPublisher = new FrameRingPublisher();
+    if (!m_pDepthPublisher->Initialize(cDepthRingName, cDepthRingSlots, cDepthWidth * cDepthHeight * sizeof(UINT16)))
+    {
+        delete m_pDepthPublisher;
+        m_pDepthPublisher = NULL;
+    }
+
+    // create heap storage for the color frame and the color registered to the depth frame
+    m_pColorRGBX = new RGBQUAD[cColorWidth * cColorHeight];
+    m_pRegisteredRGBX = new RGBQUAD[cDepthWidth * cDepthHeight];
+
+    m_pRegisteredPublisher = new FrameRingPublisher();
+    if (!m_pRegisteredPublisher->Initialize(cRegisteredRingName, cDepthRingSlots, cDepthWidth * cDepthHeight * sizeof(RGBQUAD)))
+    {
+        delete m_pRegisteredPublisher;
+        m_pRegisteredPublisher = NULL;
+    }
 }
   
 
@@ -81,12 +120,39 @@ CDepthBasics::~CDepthBasics()
         m_pDepthRGBX = NULL;
     }
 
+    if (m_pDepthPublisher)
+    {
+        delete m_pDepthPublisher;
+        m_pDepthPublisher = NULL;
+    }
+
+    if (m_pColorRGBX)
+    {
+        delete [] m_pColorRGBX;
+        m_pColorRGBX = NULL;
+    }
+
+    if (m_pRegisteredRGBX)
+    {
+        delete [] m_pRegisteredRGBX;
+        m_pRegisteredRGBX = NULL;
+    }
+
+    if (m_pRegisteredPublisher)
+    {
+        delete m_pRegisteredPublisher;
+        m_pRegisteredPublisher = NULL;
+    }
+
     // clean up Direct2D
     SafeRelease(m_pD2DFactory);
 
     // done with depth frame reader
     SafeRelease(m_pDepthFrameReader);
 
+    // done with color frame reader and coordinate mapper
+    ReleaseColorRegistration();
+
     // close the Kinect Sensor
     if (m_pKinectSensor)
     {
@@ -96,6 +162,34 @@ CDepthBasics::~CDepthBasics()
     SafeRelease(m_pKinectSensor);
 }
 
+/// <summary>
+/// Sets the remap file used to pre-distort the depth view, loaded when the window is created
+/// </summary>
+/// <param name="lpszFilePath">path to the remap file, optionally quoted; empty to draw unwarped</param>
+void CDepthBasics::SetRemapFilePath(LPCWSTR lpszFilePath)
+{
+    m_szRemapFilePath[0] = L'\0';
+
+    if (!lpszFilePath)
+    {
+        return;
+    }
+
+    // Paths with spaces arrive quoted on the command line
+    if (L'"' == lpszFilePath[0])
+    {
+        ++lpszFilePath;
+    }
+
+    StringCchCopyW(m_szRemapFilePath, _countof(m_szRemapFilePath), lpszFilePath);
+
+    WCHAR* pQuote = wcschr(m_szRemapFilePath, L'"');
+    if (pQuote)
+    {
+        *pQuote = L'\0';
+    }
+}
+
 /// <summary>
 /// Creates the main window and begins processing
 /// </summary>
@@ -233,6 +327,11 @@ void CDepthBasics::Update()
 #if defined(USE_OPENCV)
 			bufferMat.convertTo(depthMat, CV_8U, -255.0f / 8000.0f, 255.0f);
             cv::imshow("Depth", ~depthMat);
+
+            if (m_bRegisteredFrameValid)
+            {
+                cv::imshow("Registered", cv::Mat(cDepthHeight, cDepthWidth, CV_8UC4, m_pRegisteredRGBX));
+            }
 #endif
         }
 
@@ -306,6 +405,19 @@ LRESULT CALLBACK CDepthBasics::DlgProc(HWND hWnd, UINT message, WPARAM wParam, L
                 SetStatusMessage(L"Failed to initialize the Direct2D draw device.", 10000, true);
             }
 
+            // Pre-distort the depth view if a remap file was given on the command line
+            if (SUCCEEDED(hr) && m_szRemapFilePath[0])
+            {
+                if (SUCCEEDED(LoadRemapTable(m_szRemapFilePath)))
+                {
+                    m_pDrawDepth->SetRemapTable(&m_remapTable);
+                }
+                else
+                {
+                    SetStatusMessage(L"Failed to load the remap table.", 10000, true);
+                }
+            }
+
             // Get and initialize the default Kinect sensor
             InitializeDefaultSensor();
         }
@@ -365,6 +477,12 @@ HRESULT CDepthBasics::InitializeDefaultSensor()
             hr = pDepthFrameSource->OpenReader(&m_pDepthFrameReader);
         }
 
+        // Registered color is an extra; without it the depth stream still runs on its own
+        if (SUCCEEDED(hr) && FAILED(InitializeColorRegistration()))
+        {
+            ReleaseColorRegistration();
+        }
+
         SafeRelease(pDepthFrameSource);
     }
 
@@ -377,6 +495,257 @@ HRESULT CDepthBasics::InitializeDefaultSensor()
     return hr;
 }
 
+/// <summary>
+/// Opens the color reader and coordinate mapper used to register color to depth.
+/// Registration is optional; depth keeps working if this fails.
+/// </summary>
+/// <returns>S_OK on success, otherwise failure code</returns>
+HRESULT CDepthBasics::InitializeColorRegistration()
+{
+    IColorFrameSource* pColorFrameSource = NULL;
+
+    HRESULT hr = m_pKinectSensor->get_ColorFrameSource(&pColorFrameSource);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pColorFrameSource->OpenReader(&m_pColorFrameReader);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pKinectSensor->get_CoordinateMapper(&m_pCoordinateMapper);
+    }
+
+    // The table is rebuilt when the sensor reports new calibration rather than retried on every frame
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pCoordinateMapper->SubscribeCoordinateMappingChanged(&m_hCoordinateMappingChanged);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_registration.Initialize(cDepthWidth, cDepthHeight, cColorWidth, cColorHeight);
+
+        const UINT nPixelCount = cDepthWidth * cDepthHeight;
+        m_pRegistrationDepthPoints = new DepthSpacePoint[nPixelCount];
+        m_pRegistrationDepths = new UINT16[nPixelCount];
+        m_pRegistrationColorPoints = new ColorSpacePoint[nPixelCount * DepthColorRegistration::cSampleCount];
+
+        // The mapper is always asked about every depth pixel
+        for (UINT i = 0; i < nPixelCount; ++i)
+        {
+            m_pRegistrationDepthPoints[i].X = static_cast<float>(i % cDepthWidth);
+            m_pRegistrationDepthPoints[i].Y = static_cast<float>(i / cDepthWidth);
+        }
+
+        // Try once straight away in case the calibration arrived before we subscribed
+        m_bRegistrationStale = true;
+    }
+
+    SafeRelease(pColorFrameSource);
+
+    return hr;
+}
+
+/// <summary>
+/// Releases everything InitializeColorRegistration acquired
+/// </summary>
+void CDepthBasics::ReleaseColorRegistration()
+{
+    if (m_pCoordinateMapper && m_hCoordinateMappingChanged)
+    {
+        m_pCoordinateMapper->UnsubscribeCoordinateMappingChanged(m_hCoordinateMappingChanged);
+    }
+    m_hCoordinateMappingChanged = 0;
+
+    SafeRelease(m_pCoordinateMapper);
+    SafeRelease(m_pColorFrameReader);
+
+    if (m_pRegistrationDepthPoints)
+    {
+        delete [] m_pRegistrationDepthPoints;
+        m_pRegistrationDepthPoints = NULL;
+    }
+
+    if (m_pRegistrationDepths)
+    {
+        delete [] m_pRegistrationDepths;
+        m_pRegistrationDepths = NULL;
+    }
+
+    if (m_pRegistrationColorPoints)
+    {
+        delete [] m_pRegistrationColorPoints;
+        m_pRegistrationColorPoints = NULL;
+    }
+
+    m_bColorFrameValid = false;
+    m_bRegistrationReady = false;
+    m_bRegistrationStale = false;
+}
+
+/// <summary>
+/// Copies the latest color frame, if there is a new one
+/// </summary>
+void CDepthBasics::UpdateColor()
+{
+    if (!m_pColorFrameReader || !m_pColorRGBX)
+    {
+        return;
+    }
+
+    IColorFrame* pColorFrame = NULL;
+
+    HRESULT hr = m_pColorFrameReader->AcquireLatestFrame(&pColorFrame);
+
+    if (SUCCEEDED(hr))
+    {
+        IFrameDescription* pFrameDescription = NULL;
+        int nWidth = 0;
+        int nHeight = 0;
+
+        hr = pColorFrame->get_FrameDescription(&pFrameDescription);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pFrameDescription->get_Width(&nWidth);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pFrameDescription->get_Height(&nHeight);
+        }
+
+        if (SUCCEEDED(hr) && ((nWidth != cColorWidth) || (nHeight != cColorHeight)))
+        {
+            hr = E_UNEXPECTED;
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            // The sensor delivers YUY2, so always convert into our own BGRA buffer
+            hr = pColorFrame->CopyConvertedFrameDataToArray(cColorWidth * cColorHeight * sizeof(RGBQUAD), reinterpret_cast<BYTE*>(m_pColorRGBX), ColorImageFormat_Bgra);
+        }
+
+        m_bColorFrameValid = SUCCEEDED(hr);
+
+        SafeRelease(pFrameDescription);
+    }
+
+    SafeRelease(pColorFrame);
+}
+
+/// <summary>
+/// Builds the depth-to-color registration table from the sensor calibration
+/// </summary>
+/// <returns>S_OK on success, E_PENDING if the calibration is not available yet, otherwise failure code</returns>
+HRESULT CDepthBasics::BuildRegistrationTable()
+{
+    if (!m_pCoordinateMapper || !m_registration.IsInitialized() || !m_pRegistrationDepthPoints || !m_pRegistrationDepths || !m_pRegistrationColorPoints)
+    {
+        return E_FAIL;
+    }
+
+    const UINT nPixelCount = cDepthWidth * cDepthHeight;
+    const int nSampleCount = DepthColorRegistration::cSampleCount;
+
+    const DepthSpacePoint* pDepthPoints = m_pRegistrationDepthPoints;
+    UINT16* pDepths = m_pRegistrationDepths;
+    ColorSpacePoint* pColorPoints = m_pRegistrationColorPoints;
+
+    // Ask the sensor where every depth pixel lands in the color image at each sample depth
+    HRESULT hr = S_OK;
+    for (int nSample = 0; (nSample < nSampleCount) && SUCCEEDED(hr); ++nSample)
+    {
+        for (UINT i = 0; i < nPixelCount; ++i)
+        {
+            pDepths[i] = DepthColorRegistration::cSampleDepths[nSample];
+        }
+
+        hr = m_pCoordinateMapper->MapDepthPointsToColorSpace(nPixelCount, pDepthPoints, nPixelCount, pDepths, nPixelCount, pColorPoints + nSample * nPixelCount);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        UINT nValidCount = 0;
+
+        for (UINT i = 0; i < nPixelCount; ++i)
+        {
+            float fColorX[nSampleCount];
+            float fColorY[nSampleCount];
+
+            for (int nSample = 0; nSample < nSampleCount; ++nSample)
+            {
+                fColorX[nSample] = pColorPoints[nSample * nPixelCount + i].X;
+                fColorY[nSample] = pColorPoints[nSample * nPixelCount + i].Y;
+            }
+
+            if (m_registration.FitPixel(i, fColorX, fColorY))
+            {
+                ++nValidCount;
+            }
+        }
+
+        // The mapper reports every point as unmappable until the sensor has sent its calibration
+        if (0 == nValidCount)
+        {
+            hr = E_PENDING;
+        }
+    }
+
+    return hr;
+}
+
+/// <summary>
+/// Registers the latest color frame to a depth frame and publishes it
+/// </summary>
+/// <param name="nTime">timestamp of the depth frame</param>
+/// <param name="pBuffer">depth frame</param>
+void CDepthBasics::ProcessRegistration(INT64 nTime, const UINT16* pBuffer)
+{
+    if (!m_pCoordinateMapper || !m_pRegisteredRGBX)
+    {
+        return;
+    }
+
+    // The sensor signals when its calibration arrives or changes
+    if (m_hCoordinateMappingChanged && (WAIT_OBJECT_0 == WaitForSingleObject(reinterpret_cast<HANDLE>(m_hCoordinateMappingChanged), 0)))
+    {
+        ICoordinateMappingChangedEventArgs* pArgs = NULL;
+        m_pCoordinateMapper->GetCoordinateMappingChangedEventData(m_hCoordinateMappingChanged, &pArgs);
+        SafeRelease(pArgs);
+
+        m_bRegistrationStale = true;
+    }
+
+    if (m_bRegistrationStale)
+    {
+        // If the calibration is still missing (E_PENDING) the next change event triggers another attempt
+        m_bRegistrationReady = SUCCEEDED(BuildRegistrationTable());
+        m_bRegistrationStale = false;
+    }
+
+    if (!m_bRegistrationReady)
+    {
+        return;
+    }
+
+    // The 1080p color frame is only converted when it is about to be registered
+    UpdateColor();
+    if (!m_bColorFrameValid)
+    {
+        return;
+    }
+
+    m_registration.Register(pBuffer, reinterpret_cast<const UINT32*>(m_pColorRGBX), reinterpret_cast<UINT32*>(m_pRegisteredRGBX));
+    m_bRegisteredFrameValid = true;
+
+    if (m_pRegisteredPublisher)
+    {
+        m_pRegisteredPublisher->Publish(nTime, m_pRegisteredRGBX, cDepthWidth, cDepthHeight, cDepthWidth * sizeof(RGBQUAD), FrameRing::PixelFormatBGRA32);
+    }
+}
+
 /// <summary>
 /// Handle new depth data
 /// <param name="nTime">timestamp of frame</param>
@@ -423,32 +792,22 @@ void CDepthBasics::ProcessDepth(INT64 nTime, const UINT16* pBuffer, int nWidth,
     // Make sure we've received valid data
     if (m_pDepthRGBX && pBuffer && (nWidth == cDepthWidth) && (nHeight == cDepthHeight))
     {
-        RGBQUAD* pRGBX = m_pDepthRGBX;
-
-        // end pixel is start + width*height - 1
-        const UINT16* pBufferEnd = pBuffer + (nWidth * nHeight);
-
-        while (pBuffer < pBufferEnd)
+        // Hand the depth frame to local consumers before it is reduced to 8 bits
+        if (m_pDepthPublisher)
         {
-            USHORT depth = *pBuffer;
-
-            // To convert to a byte, we're discarding the most-significant
-            // rather than least-significant bits.
-            // We're preserving detail, although the intensity will "wrap."
-            // Values outside the reliable depth range are mapped to 0 (black).
-
-            // Note: Using conditionals in this loop could degrade performance.
-            // Consider using a lookup table instead when writing production code.
-//            BYTE intensity = static_cast<BYTE>((depth >= nMinDepth) && (depth <= nMaxDepth) ? (depth % 256) : 0);
-            BYTE intensity = static_cast<BYTE>((depth >= nMinDepth) && (depth <= nMaxDepth) ? (depth * 256 / 8000) : 0);
+            m_pDepthPublisher->Publish(nTime, pBuffer, nWidth, nHeight, nWidth * sizeof(UINT16), FrameRing::PixelFormatDepth16);
+        }
 
-            pRGBX->rgbRed   = intensity;
-            pRGBX->rgbGreen = intensity;
-            pRGBX->rgbBlue  = intensity;
+        // To convert to a byte, we're discarding the most-significant
+        // rather than least-significant bits.
+        // We're preserving detail, although the intensity will "wrap."
+        // Values outside the reliable depth range are mapped to 0 (black).
+        // The table is only rebuilt when the reliable depth range changes.
+        m_depthIntensity.Update(nMinDepth, nMaxDepth);
+        m_depthIntensity.Convert(pBuffer, reinterpret_cast<UINT32*>(m_pDepthRGBX), nWidth * nHeight);
 
-            ++pRGBX;
-            ++pBuffer;
-        }
+        // Align the latest color frame to this depth frame
+        ProcessRegistration(nTime, pBuffer);
 
         // Draw the data with Direct2D
         m_pDrawDepth->Draw(reinterpret_cast<BYTE*>(m_pDepthRGBX), cDepthWidth * cDepthHeight * sizeof(RGBQUAD));
@@ -599,3 +958,64 @@ HRESULT CDepthBasics::SaveBitmapToFile(BYTE* pBitmapBits, LONG lWidth, LONG lHei
     CloseHandle(hFile);
     return S_OK;
 }
+
+/// <summary>
+/// Loads a remap table the size of the depth frame. The file holds one pair of
+/// 32-bit floats per displayed pixel, row by row, giving the depth pixel it shows;
+/// NaN marks pixels with no source.
+/// </summary>
+/// <param name="lpszFilePath">full path of the remap file</param>
+/// <returns>indicates success or failure</returns>
+HRESULT CDepthBasics::LoadRemapTable(LPCWSTR lpszFilePath)
+{
+    const DWORD cCoordinates = cDepthWidth * cDepthHeight * 2;
+    const DWORD cbCoordinates = cCoordinates * sizeof(float);
+
+    HANDLE hFile = CreateFileW(lpszFilePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    // The file must hold exactly one table for the depth frame size
+    LARGE_INTEGER cbFile = {0};
+    if (!GetFileSizeEx(hFile, &cbFile) || (cbFile.QuadPart != cbCoordinates))
+    {
+        CloseHandle(hFile);
+        return E_INVALIDARG;
+    }
+
+    float* pCoordinates = new float[cCoordinates];
+
+    DWORD dwBytesRead = 0;
+    BOOL bRead = ReadFile(hFile, pCoordinates, cbCoordinates, &dwBytesRead, NULL);
+    CloseHandle(hFile);
+
+    if (!bRead || (dwBytesRead != cbCoordinates))
+    {
+        delete [] pCoordinates;
+        return E_FAIL;
+    }
+
+    m_remapTable.Resize(cDepthWidth, cDepthHeight);
+
+    const float* pCoordinate = pCoordinates;
+    for (UINT y = 0; y < cDepthHeight; ++y)
+    {
+        for (UINT x = 0; x < cDepthWidth; ++x, pCoordinate += 2)
+        {
+            // NaN compares unequal to itself
+            if ((pCoordinate[0] == pCoordinate[0]) && (pCoordinate[1] == pCoordinate[1]))
+            {
+                m_remapTable.Set(x, y, pCoordinate[0], pCoordinate[1]);
+            }
+            else
+            {
+                m_remapTable.SetInvalid(x, y);
+            }
+        }
+    }
+
+    delete [] pCoordinates;
+    return S_OK;
+}
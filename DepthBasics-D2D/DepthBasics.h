@@ -8,11 +8,23 @@
 
 #include "resource.h"
 #include "ImageRenderer.h"
+#include "FrameRingPublisher.h"
+#include "DepthIntensityTable.h"
+#include "DepthColorRegistration.h"
 
 class CDepthBasics
 {
     static const int        cDepthWidth  = 512;
     static const int        cDepthHeight = 424;
+    static const int        cColorWidth  = 1920;
+    static const int        cColorHeight = 1080;
+
+    // Shared-memory ring local consumers read depth frames from
+    static const char*      cDepthRingName;
+    static const UINT       cDepthRingSlots = 4;
+
+    // Shared-memory ring carrying colour registered to the depth frames
+    static const char*      cRegisteredRingName;
 
 public:
     /// <summary>
@@ -52,6 +64,12 @@ public:
     /// <param name="nCmdShow"></param>
     int                     Run(HINSTANCE hInstance, int nCmdShow);
 
+    /// <summary>
+    /// Sets the remap file used to pre-distort the depth view, loaded when the window is created
+    /// </summary>
+    /// <param name="lpszFilePath">path to the remap file, optionally quoted; empty to draw unwarped</param>
+    void                    SetRemapFilePath(LPCWSTR lpszFilePath);
+
 private:
     HWND                    m_hWnd;
     INT64                   m_nStartTime;
@@ -67,10 +85,40 @@ private:
     // Depth reader
     IDepthFrameReader*      m_pDepthFrameReader;
 
+    // Color reader
+    IColorFrameReader*      m_pColorFrameReader;
+
+    // Calibration between the depth and color cameras
+    ICoordinateMapper*      m_pCoordinateMapper;
+    WAITABLE_HANDLE         m_hCoordinateMappingChanged;
+
     // Direct2D
     ImageRenderer*          m_pDrawDepth;
     ID2D1Factory*           m_pD2DFactory;
     RGBQUAD*                m_pDepthRGBX;
+    DepthIntensityTable     m_depthIntensity;
+
+    // Pre-distortion applied to the depth view
+    WCHAR                   m_szRemapFilePath[MAX_PATH];
+    ProjectionMapping::RemapTable m_remapTable;
+
+    // Publishes depth frames to other local processes
+    FrameRingPublisher*     m_pDepthPublisher;
+
+    // Latest color frame and the color registered to the depth frame
+    RGBQUAD*                m_pColorRGBX;
+    RGBQUAD*                m_pRegisteredRGBX;
+    bool                    m_bColorFrameValid;
+    bool                    m_bRegisteredFrameValid;
+    DepthColorRegistration  m_registration;
+    bool                    m_bRegistrationReady;
+    bool                    m_bRegistrationStale;
+    FrameRingPublisher*     m_pRegisteredPublisher;
+
+    // Mapper input and output used to build the registration table
+    DepthSpacePoint*        m_pRegistrationDepthPoints;
+    UINT16*                 m_pRegistrationDepths;
+    ColorSpacePoint*        m_pRegistrationColorPoints;
 
     /// <summary>
     /// Main processing function
@@ -83,6 +131,36 @@ private:
     /// <returns>S_OK on success, otherwise failure code</returns>
     HRESULT                 InitializeDefaultSensor();
 
+    /// <summary>
+    /// Opens the color reader and coordinate mapper used to register color to depth.
+    /// Registration is optional; depth keeps working if this fails.
+    /// </summary>
+    /// <returns>S_OK on success, otherwise failure code</returns>
+    HRESULT                 InitializeColorRegistration();
+
+    /// <summary>
+    /// Releases everything InitializeColorRegistration acquired
+    /// </summary>
+    void                    ReleaseColorRegistration();
+
+    /// <summary>
+    /// Copies the latest color frame, if there is a new one
+    /// </summary>
+    void                    UpdateColor();
+
+    /// <summary>
+    /// Builds the depth-to-color registration table from the sensor calibration
+    /// </summary>
+    /// <returns>S_OK on success, E_PENDING if the calibration is not available yet, otherwise failure code</returns>
+    HRESULT                 BuildRegistrationTable();
+
+    /// <summary>
+    /// Registers the latest color frame to a depth frame and publishes it
+    /// </summary>
+    /// <param name="nTime">timestamp of the depth frame</param>
+    /// <param name="pBuffer">depth frame</param>
+    void                    ProcessRegistration(INT64 nTime, const UINT16* pBuffer);
+
     /// <summary>
     /// Handle new depth data
     /// <param name="nTime">timestamp of frame</param>
@@ -122,5 +200,14 @@ private:
     /// <param name="lpszFilePath">full file path to output bitmap to</param>
     /// <returns>indicates success or failure</returns>
     HRESULT                 SaveBitmapToFile(BYTE* pBitmapBits, LONG lWidth, LONG lHeight, WORD wBitsPerPixel, LPCWSTR lpszFilePath);
+
+    /// <summary>
+    /// Loads a remap table the size of the depth frame. The file holds one pair of
+    /// 32-bit floats per displayed pixel, row by row, giving the depth pixel it shows;
+    /// NaN marks pixels with no source.
+    /// </summary>
+    /// <param name="lpszFilePath">full path of the remap file</param>
+    /// <returns>indicates success or failure</returns>
+    HRESULT                 LoadRemapTable(LPCWSTR lpszFilePath);
 };
 
@@ -0,0 +1,249 @@
+//------------------------------------------------------------------------------
+// Maps depth pixels to colour-image coordinates through a per-pixel table
+//------------------------------------------------------------------------------
+
+#include "DepthColorRegistration.h"
+
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define DEPTHBASICS_REGISTRATION_SSE2
+#include <emmintrin.h>
+#endif
+
+// Near, middle and far end of the sensor range
+const uint16_t DepthColorRegistration::cSampleDepths[DepthColorRegistration::cSampleCount] = { 500, 1500, 4500 };
+
+namespace
+{
+    /// <summary>
+    /// Fits a + b * w + c * w^2 through three samples
+    /// </summary>
+    /// <returns>false if a sample is not finite</returns>
+    bool FitQuadratic(const float* pW, const float* pValue, float* pA, float* pB, float* pC)
+    {
+        for (int i = 0; i < DepthColorRegistration::cSampleCount; ++i)
+        {
+            // The Kinect coordinate mapper reports unmappable points as -infinity
+            if (!(std::fabs(pValue[i]) < 1.0e6f))
+            {
+                return false;
+            }
+        }
+
+        // Newton divided differences
+        double w0 = pW[0], w1 = pW[1], w2 = pW[2];
+        double d01 = (pValue[1] - pValue[0]) / (w1 - w0);
+        double d12 = (pValue[2] - pValue[1]) / (w2 - w1);
+        double c = (d12 - d01) / (w2 - w0);
+        double b = d01 - c * (w0 + w1);
+        double a = pValue[0] - (b + c * w0) * w0;
+
+        *pA = static_cast<float>(a);
+        *pB = static_cast<float>(b);
+        *pC = static_cast<float>(c);
+        return true;
+    }
+
+    /// <summary>
+    /// Looks up the colour pixel nearest to a colour coordinate, 0 if it is outside the image.
+    /// The SIMD path performs exactly the same float operations.
+    /// </summary>
+    inline uint32_t SampleColor(const uint32_t* pColor, uint32_t nColorWidth, uint32_t nColorHeight, float fColorX, float fColorY)
+    {
+        float x = fColorX + 0.5f;
+        float y = fColorY + 0.5f;
+
+        // Written so that NaN fails the test
+        if (!((x >= 0.0f) && (x < static_cast<float>(nColorWidth)) && (y >= 0.0f) && (y < static_cast<float>(nColorHeight))))
+        {
+            return 0;
+        }
+
+        return pColor[static_cast<size_t>(y) * nColorWidth + static_cast<uint32_t>(x)];
+    }
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+DepthColorRegistration::DepthColorRegistration() :
+    m_nPlaneSize(0),
+    m_nDepthWidth(0),
+    m_nDepthHeight(0),
+    m_nColorWidth(0),
+    m_nColorHeight(0)
+{
+}
+
+/// <summary>
+/// Allocates an empty table; every pixel is unregistered until set
+/// </summary>
+/// <param name="nDepthWidth">width (in pixels) of the depth frame</param>
+/// <param name="nDepthHeight">height (in pixels) of the depth frame</param>
+/// <param name="nColorWidth">width (in pixels) of the colour frame</param>
+/// <param name="nColorHeight">height (in pixels) of the colour frame</param>
+void DepthColorRegistration::Initialize(uint32_t nDepthWidth, uint32_t nDepthHeight, uint32_t nColorWidth, uint32_t nColorHeight)
+{
+    m_nDepthWidth = nDepthWidth;
+    m_nDepthHeight = nDepthHeight;
+    m_nColorWidth = nColorWidth;
+    m_nColorHeight = nColorHeight;
+
+    // Round the planes up to whole vectors
+    m_nPlaneSize = (static_cast<size_t>(nDepthWidth) * nDepthHeight + 3) & ~static_cast<size_t>(3);
+    m_coefficients.assign(m_nPlaneSize * CoefficientCount, 0.0f);
+
+    for (size_t i = 0; i < m_nPlaneSize; ++i)
+    {
+        ClearPixel(i);
+    }
+}
+
+/// <summary>
+/// Fits the coefficients of one depth pixel from its colour coordinates at cSampleDepths
+/// </summary>
+/// <param name="nIndex">index of the depth pixel</param>
+/// <param name="pColorX">colour x at each sample depth</param>
+/// <param name="pColorY">colour y at each sample depth</param>
+/// <returns>false if the pixel has no valid mapping; it is then left unregistered</returns>
+bool DepthColorRegistration::FitPixel(size_t nIndex, const float* pColorX, const float* pColorY)
+{
+    float w[cSampleCount];
+    for (int i = 0; i < cSampleCount; ++i)
+    {
+        w[i] = 1.0f / cSampleDepths[i];
+    }
+
+    float xa, xb, xc, ya, yb, yc;
+    if (!FitQuadratic(w, pColorX, &xa, &xb, &xc) || !FitQuadratic(w, pColorY, &ya, &yb, &yc))
+    {
+        ClearPixel(nIndex);
+        return false;
+    }
+
+    GetPlane(CoefficientXA)[nIndex] = xa;
+    GetPlane(CoefficientXB)[nIndex] = xb;
+    GetPlane(CoefficientXC)[nIndex] = xc;
+    GetPlane(CoefficientYA)[nIndex] = ya;
+    GetPlane(CoefficientYB)[nIndex] = yb;
+    GetPlane(CoefficientYC)[nIndex] = yc;
+    return true;
+}
+
+/// <summary>
+/// Marks a depth pixel as having no colour
+/// </summary>
+/// <param name="nIndex">index of the depth pixel</param>
+void DepthColorRegistration::ClearPixel(size_t nIndex)
+{
+    // A constant coordinate left of the image, whatever the depth
+    GetPlane(CoefficientXA)[nIndex] = -1.0f;
+    GetPlane(CoefficientXB)[nIndex] = 0.0f;
+    GetPlane(CoefficientXC)[nIndex] = 0.0f;
+    GetPlane(CoefficientYA)[nIndex] = -1.0f;
+    GetPlane(CoefficientYB)[nIndex] = 0.0f;
+    GetPlane(CoefficientYC)[nIndex] = 0.0f;
+}
+
+/// <summary>
+/// Colour coordinates of a single depth pixel
+/// </summary>
+/// <param name="nIndex">index of the depth pixel</param>
+/// <param name="nDepth">depth in millimetres</param>
+/// <param name="pColorX">receives colour x</param>
+/// <param name="pColorY">receives colour y</param>
+void DepthColorRegistration::MapPixel(size_t nIndex, uint16_t nDepth, float* pColorX, float* pColorY) const
+{
+    float w = 1.0f / static_cast<float>(nDepth);
+
+    *pColorX = GetPlane(CoefficientXA)[nIndex] + (GetPlane(CoefficientXB)[nIndex] + GetPlane(CoefficientXC)[nIndex] * w) * w;
+    *pColorY = GetPlane(CoefficientYA)[nIndex] + (GetPlane(CoefficientYB)[nIndex] + GetPlane(CoefficientYC)[nIndex] * w) * w;
+}
+
+/// <summary>
+/// Registers pixels [nBegin, nEnd) one at a time
+/// </summary>
+void DepthColorRegistration::RegisterScalar(const uint16_t* pDepth, const uint32_t* pColor, uint32_t* pRegistered, size_t nBegin, size_t nEnd) const
+{
+    for (size_t i = nBegin; i < nEnd; ++i)
+    {
+        if (0 == pDepth[i])
+        {
+            pRegistered[i] = 0;
+            continue;
+        }
+
+        float fColorX, fColorY;
+        MapPixel(i, pDepth[i], &fColorX, &fColorY);
+        pRegistered[i] = SampleColor(pColor, m_nColorWidth, m_nColorHeight, fColorX, fColorY);
+    }
+}
+
+/// <summary>
+/// Produces a colour image aligned to the depth frame
+/// </summary>
+/// <param name="pDepth">depth frame in millimetres</param>
+/// <param name="pColor">32-bit colour frame, tightly packed</param>
+/// <param name="pRegistered">receives one colour pixel per depth pixel, 0 where there is none</param>
+void DepthColorRegistration::Register(const uint16_t* pDepth, const uint32_t* pColor, uint32_t* pRegistered) const
+{
+    if (!IsInitialized() || !pDepth || !pColor || !pRegistered)
+    {
+        return;
+    }
+
+    const size_t nCount = static_cast<size_t>(m_nDepthWidth) * m_nDepthHeight;
+    size_t i = 0;
+
+#if defined(DEPTHBASICS_REGISTRATION_SSE2)
+    const float* pXA = GetPlane(CoefficientXA);
+    const float* pXB = GetPlane(CoefficientXB);
+    const float* pXC = GetPlane(CoefficientXC);
+    const float* pYA = GetPlane(CoefficientYA);
+    const float* pYB = GetPlane(CoefficientYB);
+    const float* pYC = GetPlane(CoefficientYC);
+
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 width = _mm_set1_ps(static_cast<float>(m_nColorWidth));
+    const __m128 height = _mm_set1_ps(static_cast<float>(m_nColorHeight));
+    const __m128i zeroInt = _mm_setzero_si128();
+
+    for (; i + 4 <= nCount; i += 4)
+    {
+        // Widen four depths to float; zero depth gives an infinite w and fails the bounds test below
+        __m128i depth = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pDepth + i)), zeroInt);
+        __m128 w = _mm_div_ps(one, _mm_cvtepi32_ps(depth));
+
+        __m128 x = _mm_add_ps(_mm_loadu_ps(pXA + i), _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(pXB + i), _mm_mul_ps(_mm_loadu_ps(pXC + i), w)), w));
+        __m128 y = _mm_add_ps(_mm_loadu_ps(pYA + i), _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(pYB + i), _mm_mul_ps(_mm_loadu_ps(pYC + i), w)), w));
+        x = _mm_add_ps(x, half);
+        y = _mm_add_ps(y, half);
+
+        // Ordered compares, so NaN lanes are rejected as in SampleColor
+        __m128 inside = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(x, zero), _mm_cmplt_ps(x, width)),
+            _mm_and_ps(_mm_cmpge_ps(y, zero), _mm_cmplt_ps(y, height)));
+        __m128i valid = _mm_andnot_si128(_mm_cmpeq_epi32(depth, zeroInt), _mm_castps_si128(inside));
+
+        // Rejected lanes are zeroed so the truncated coordinates are always in range
+        __m128i columns = _mm_and_si128(_mm_cvttps_epi32(x), valid);
+        __m128i rows = _mm_and_si128(_mm_cvttps_epi32(y), valid);
+
+        // SSE2 has no gather, so the four colour fetches are scalar
+        uint32_t nColumns[4], nRows[4], nValid[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(nColumns), columns);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(nRows), rows);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(nValid), valid);
+
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            pRegistered[i + lane] = pColor[static_cast<size_t>(nRows[lane]) * m_nColorWidth + nColumns[lane]] & nValid[lane];
+        }
+    }
+#endif
+
+    RegisterScalar(pDepth, pColor, pRegistered, i, nCount);
+}
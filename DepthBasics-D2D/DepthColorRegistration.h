@@ -0,0 +1,105 @@
+//------------------------------------------------------------------------------
+// Maps depth pixels to colour-image coordinates through a per-pixel table
+//------------------------------------------------------------------------------
+
+// For a depth pixel at depth Z the matching colour coordinate is modelled as
+//
+//   colour = a + b / Z + c / Z^2
+//
+// a is where the pixel's ray lands at infinity, b is the parallax caused by the
+// baseline between the two cameras and c absorbs the residual depth dependence
+// of lens distortion and the out-of-plane part of the baseline. The coefficients
+// are fitted per pixel from calibration, so registering a frame costs one
+// reciprocal and a few multiply-adds per pixel.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DepthColorRegistration
+{
+public:
+    // Depths the calibration is sampled at to fit the coefficients
+    static const int        cSampleCount = 3;
+    static const uint16_t   cSampleDepths[cSampleCount];
+
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    DepthColorRegistration();
+
+    /// <summary>
+    /// Allocates an empty table; every pixel is unregistered until set
+    /// </summary>
+    /// <param name="nDepthWidth">width (in pixels) of the depth frame</param>
+    /// <param name="nDepthHeight">height (in pixels) of the depth frame</param>
+    /// <param name="nColorWidth">width (in pixels) of the colour frame</param>
+    /// <param name="nColorHeight">height (in pixels) of the colour frame</param>
+    void                    Initialize(uint32_t nDepthWidth, uint32_t nDepthHeight, uint32_t nColorWidth, uint32_t nColorHeight);
+
+    /// <summary>
+    /// Fits the coefficients of one depth pixel from its colour coordinates at cSampleDepths
+    /// </summary>
+    /// <param name="nIndex">index of the depth pixel</param>
+    /// <param name="pColorX">colour x at each sample depth</param>
+    /// <param name="pColorY">colour y at each sample depth</param>
+    /// <returns>false if the pixel has no valid mapping; it is then left unregistered</returns>
+    bool                    FitPixel(size_t nIndex, const float* pColorX, const float* pColorY);
+
+    /// <summary>
+    /// Marks a depth pixel as having no colour
+    /// </summary>
+    /// <param name="nIndex">index of the depth pixel</param>
+    void                    ClearPixel(size_t nIndex);
+
+    /// <summary>
+    /// Colour coordinates of a single depth pixel
+    /// </summary>
+    /// <param name="nIndex">index of the depth pixel</param>
+    /// <param name="nDepth">depth in millimetres</param>
+    /// <param name="pColorX">receives colour x</param>
+    /// <param name="pColorY">receives colour y</param>
+    void                    MapPixel(size_t nIndex, uint16_t nDepth, float* pColorX, float* pColorY) const;
+
+    /// <summary>
+    /// Produces a colour image aligned to the depth frame
+    /// </summary>
+    /// <param name="pDepth">depth frame in millimetres</param>
+    /// <param name="pColor">32-bit colour frame, tightly packed</param>
+    /// <param name="pRegistered">receives one colour pixel per depth pixel, 0 where there is none</param>
+    void                    Register(const uint16_t* pDepth, const uint32_t* pColor, uint32_t* pRegistered) const;
+
+    bool                    IsInitialized() const   { return !m_coefficients.empty(); }
+    uint32_t                GetDepthWidth() const   { return m_nDepthWidth; }
+    uint32_t                GetDepthHeight() const  { return m_nDepthHeight; }
+
+private:
+    enum Coefficient
+    {
+        CoefficientXA,
+        CoefficientXB,
+        CoefficientXC,
+        CoefficientYA,
+        CoefficientYB,
+        CoefficientYC,
+        CoefficientCount
+    };
+
+    // One plane per coefficient so four neighbouring pixels load as one vector
+    std::vector<float>      m_coefficients;
+    size_t                  m_nPlaneSize;
+    uint32_t                m_nDepthWidth;
+    uint32_t                m_nDepthHeight;
+    uint32_t                m_nColorWidth;
+    uint32_t                m_nColorHeight;
+
+    float*                  GetPlane(Coefficient coefficient)               { return &m_coefficients[coefficient * m_nPlaneSize]; }
+    const float*            GetPlane(Coefficient coefficient) const         { return &m_coefficients[coefficient * m_nPlaneSize]; }
+
+    /// <summary>
+    /// Registers pixels [nBegin, nEnd) one at a time
+    /// </summary>
+    void                    RegisterScalar(const uint16_t* pDepth, const uint32_t* pColor, uint32_t* pRegistered, size_t nBegin, size_t nEnd) const;
+};
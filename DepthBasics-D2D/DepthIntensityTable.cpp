@@ -0,0 +1,65 @@
+//------------------------------------------------------------------------------
+// Lookup table that turns 16-bit depth into 8-bit display intensity
+//------------------------------------------------------------------------------
+
+#include "DepthIntensityTable.h"
+#include "FixedPoint.h"
+
+/// <summary>
+/// Constructor
+/// </summary>
+DepthIntensityTable::DepthIntensityTable() :
+    m_nMinDepth(0),
+    m_nMaxDepth(0),
+    m_bBuilt(false)
+{
+}
+
+/// <summary>
+/// Rebuilds the table if the reliable depth range changed
+/// </summary>
+/// <param name="nMinDepth">minimum reliable depth</param>
+/// <param name="nMaxDepth">maximum reliable depth</param>
+void DepthIntensityTable::Update(uint16_t nMinDepth, uint16_t nMaxDepth)
+{
+    if (m_bBuilt && (nMinDepth == m_nMinDepth) && (nMaxDepth == m_nMaxDepth))
+    {
+        return;
+    }
+
+    // depth * 256 is at most 24 bits
+    const FixedPoint::ReciprocalDivider divider(cDisplayRange, 24);
+
+    for (uint32_t nDepth = 0; nDepth <= 0xFFFF; ++nDepth)
+    {
+        // Same as the original static_cast<BYTE>(depth * 256 / 8000): keep the low byte so the intensity wraps.
+        // Values outside the reliable depth range are mapped to 0 (black).
+        uint32_t nIntensity = divider.Divide(nDepth << 8);
+        m_table[nDepth] = ((nDepth >= nMinDepth) && (nDepth <= nMaxDepth)) ? static_cast<uint8_t>(nIntensity) : 0;
+    }
+
+    m_nMinDepth = nMinDepth;
+    m_nMaxDepth = nMaxDepth;
+    m_bBuilt = true;
+}
+
+/// <summary>
+/// Converts a depth frame to grey RGBX pixels
+/// </summary>
+/// <param name="pDepth">depth values</param>
+/// <param name="pRGBX">receives one 32-bit pixel per depth value</param>
+/// <param name="nCount">number of pixels</param>
+void DepthIntensityTable::Convert(const uint16_t* pDepth, uint32_t* pRGBX, size_t nCount) const
+{
+    const uint16_t* pDepthEnd = pDepth + nCount;
+
+    while (pDepth < pDepthEnd)
+    {
+        // Replicate the intensity into blue, green and red
+        uint32_t nIntensity = m_table[*pDepth];
+        *pRGBX = nIntensity * 0x010101u;
+
+        ++pRGBX;
+        ++pDepth;
+    }
+}
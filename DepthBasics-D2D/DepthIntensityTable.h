@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------------
+// Lookup table that turns 16-bit depth into 8-bit display intensity
+//------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class DepthIntensityTable
+{
+public:
+    // Depth that maps to full intensity before the byte wraps
+    static const uint32_t   cDisplayRange = 8000;
+
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    DepthIntensityTable();
+
+    /// <summary>
+    /// Rebuilds the table if the reliable depth range changed
+    /// </summary>
+    /// <param name="nMinDepth">minimum reliable depth</param>
+    /// <param name="nMaxDepth">maximum reliable depth</param>
+    void                    Update(uint16_t nMinDepth, uint16_t nMaxDepth);
+
+    /// <summary>
+    /// Intensity of a single depth value
+    /// </summary>
+    uint8_t                 operator[](uint16_t nDepth) const   { return m_table[nDepth]; }
+
+    /// <summary>
+    /// Converts a depth frame to grey RGBX pixels
+    /// </summary>
+    /// <param name="pDepth">depth values</param>
+    /// <param name="pRGBX">receives one 32-bit pixel per depth value</param>
+    /// <param name="nCount">number of pixels</param>
+    void                    Convert(const uint16_t* pDepth, uint32_t* pRGBX, size_t nCount) const;
+
+private:
+    uint8_t                 m_table[65536];
+    uint16_t                m_nMinDepth;
+    uint16_t                m_nMaxDepth;
+    bool                    m_bBuilt;
+};
@@ -0,0 +1,57 @@
+//------------------------------------------------------------------------------
+// Fixed-point helpers for per-pixel depth arithmetic
+//------------------------------------------------------------------------------
+
+// Depth arrives as 16-bit millimetres. Conversion stages that scale it by a
+// constant ratio use ReciprocalDivider, so the division becomes a multiply and a
+// shift with exactly the result of the integer division.
+
+#pragma once
+
+#include <cstdint>
+
+namespace FixedPoint
+{
+    /// <summary>
+    /// Divides by a constant with a multiply and a shift.
+    /// The result equals n / divisor exactly for every n below 2^nNumeratorBits.
+    /// </summary>
+    class ReciprocalDivider
+    {
+    public:
+        /// <summary>
+        /// Constructor
+        /// </summary>
+        /// <param name="nDivisor">constant divisor, must be non-zero</param>
+        /// <param name="nNumeratorBits">number of significant bits in the numerators that will be divided, at most 31</param>
+        ReciprocalDivider(uint32_t nDivisor, unsigned int nNumeratorBits)
+        {
+            // With l = ceil(log2(d)) and m = ceil(2^(N + l) / d) the error of n * m / 2^(N + l)
+            // stays below 1 / d for every n < 2^N, so the floor is exact. m < 2^(N + 1), so
+            // n * m fits in 64 bits while N <= 31.
+            unsigned int nLog2 = 0;
+            while ((1ull << nLog2) < nDivisor)
+            {
+                ++nLog2;
+            }
+
+            m_nShift = nNumeratorBits + nLog2;
+            m_nMultiplier = ((1ull << m_nShift) + nDivisor - 1) / nDivisor;
+        }
+
+        /// <summary>
+        /// Returns n / divisor
+        /// </summary>
+        uint32_t Divide(uint32_t n) const
+        {
+            return static_cast<uint32_t>((n * m_nMultiplier) >> m_nShift);
+        }
+
+        uint64_t GetMultiplier() const  { return m_nMultiplier; }
+        unsigned int GetShift() const   { return m_nShift; }
+
+    private:
+        uint64_t        m_nMultiplier;
+        unsigned int    m_nShift;
+    };
+}
@@ -0,0 +1,218 @@
+//------------------------------------------------------------------------------
+// Named shared-memory mapping for the frame ring
+//------------------------------------------------------------------------------
+
+#include "FrameRing.h"
+
+#include <cstdio>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace FrameRing;
+
+/// <summary>
+/// Constructor
+/// </summary>
+SharedMemory::SharedMemory() :
+    m_pData(NULL),
+    m_cbSize(0),
+    m_bOwner(false),
+#if defined(_WIN32)
+    m_hMapping(NULL)
+#else
+    m_fd(-1)
+#endif
+{
+    m_szName[0] = '\0';
+}
+
+/// <summary>
+/// Destructor, unmaps the view and releases the object
+/// </summary>
+SharedMemory::~SharedMemory()
+{
+    Close();
+}
+
+/// <summary>
+/// Creates (or re-opens) a named object for writing
+/// </summary>
+/// <param name="szName">object name without platform prefix</param>
+/// <param name="cbSize">size of the object in bytes</param>
+/// <returns>true on success</returns>
+bool SharedMemory::Create(const char* szName, size_t cbSize)
+{
+    Close();
+
+    if (!szName || !cbSize)
+    {
+        return false;
+    }
+
+#if defined(_WIN32)
+    _snprintf_s(m_szName, sizeof(m_szName), _TRUNCATE, "Local\\%s", szName);
+
+    ULONGLONG cbMapping = cbSize;
+    m_hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                    static_cast<DWORD>(cbMapping >> 32), static_cast<DWORD>(cbMapping & 0xFFFFFFFF), m_szName);
+    if (NULL == m_hMapping)
+    {
+        return false;
+    }
+
+    m_pData = static_cast<uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, cbSize));
+    if (NULL == m_pData)
+    {
+        Close();
+        return false;
+    }
+#else
+    snprintf(m_szName, sizeof(m_szName), "/%s", szName);
+
+    m_fd = shm_open(m_szName, O_CREAT | O_RDWR, 0644);
+    if (m_fd < 0)
+    {
+        return false;
+    }
+
+    // Own the name from here on so Close unlinks it if sizing or mapping fails
+    m_bOwner = true;
+
+    if (ftruncate(m_fd, static_cast<off_t>(cbSize)) != 0)
+    {
+        Close();
+        return false;
+    }
+
+    void* pView = mmap(NULL, cbSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == pView)
+    {
+        Close();
+        return false;
+    }
+
+    m_pData = static_cast<uint8_t*>(pView);
+#endif
+
+    m_cbSize = cbSize;
+    m_bOwner = true;
+
+    return true;
+}
+
+/// <summary>
+/// Opens an existing named object read-only
+/// </summary>
+/// <param name="szName">object name without platform prefix</param>
+/// <returns>true on success</returns>
+bool SharedMemory::Open(const char* szName)
+{
+    Close();
+
+    if (!szName)
+    {
+        return false;
+    }
+
+#if defined(_WIN32)
+    _snprintf_s(m_szName, sizeof(m_szName), _TRUNCATE, "Local\\%s", szName);
+
+    m_hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, m_szName);
+    if (NULL == m_hMapping)
+    {
+        return false;
+    }
+
+    // Map the whole object, then ask the view how large it is
+    m_pData = static_cast<uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (NULL == m_pData)
+    {
+        Close();
+        return false;
+    }
+
+    MEMORY_BASIC_INFORMATION info = {0};
+    VirtualQuery(m_pData, &info, sizeof(info));
+    m_cbSize = info.RegionSize;
+#else
+    snprintf(m_szName, sizeof(m_szName), "/%s", szName);
+
+    m_fd = shm_open(m_szName, O_RDONLY, 0);
+    if (m_fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if ((fstat(m_fd, &st) != 0) || (st.st_size <= 0))
+    {
+        Close();
+        return false;
+    }
+
+    void* pView = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, m_fd, 0);
+    if (MAP_FAILED == pView)
+    {
+        Close();
+        return false;
+    }
+
+    m_pData = static_cast<uint8_t*>(pView);
+    m_cbSize = static_cast<size_t>(st.st_size);
+#endif
+
+    m_bOwner = false;
+
+    return true;
+}
+
+/// <summary>
+/// Unmaps the view and releases the object
+/// </summary>
+void SharedMemory::Close()
+{
+#if defined(_WIN32)
+    if (m_pData)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+#else
+    if (m_pData)
+    {
+        munmap(m_pData, m_cbSize);
+    }
+
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    // The creator removes the name; readers that still have it mapped keep their view
+    if (m_bOwner && m_szName[0])
+    {
+        shm_unlink(m_szName);
+    }
+#endif
+
+    m_pData = NULL;
+    m_cbSize = 0;
+    m_bOwner = false;
+    m_szName[0] = '\0';
+}
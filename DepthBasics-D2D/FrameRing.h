@@ -0,0 +1,144 @@
+//------------------------------------------------------------------------------
+// Shared-memory frame ring layout used by FrameRingPublisher and FrameRingReader
+//------------------------------------------------------------------------------
+
+// The ring lives in a named shared-memory object ("Local\<name>" file mapping on
+// Windows, "/<name>" POSIX shm object elsewhere) and is laid out as
+//
+//   [RingHeader][Slot 0: SlotHeader | pixels][Slot 1: SlotHeader | pixels] ...
+//
+// Every slot is guarded by its own sequence counter (seqlock). The publisher makes
+// the counter odd while it writes the slot and even again when the frame is
+// complete, so readers never take a lock: they read the counter, use the pixels in
+// place and then check that the counter has not moved.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace FrameRing
+{
+    static const uint32_t   cMagic          = 0x3152464B;   // 'KFR1'
+    static const uint32_t   cVersion        = 1;
+
+    // Slots start on page boundaries so readers get aligned pixel data
+    static const uint32_t   cSlotAlignment  = 4096;
+
+    // Pixel data starts this many bytes into a slot
+    static const uint32_t   cSlotHeaderSize = 64;
+
+    enum PixelFormat
+    {
+        PixelFormatUnknown  = 0,
+        PixelFormatDepth16  = 1,    // UINT16 millimetres
+        PixelFormatBGRA32   = 2     // RGBQUAD
+    };
+
+    struct RingHeader
+    {
+        uint32_t                magic;
+        uint32_t                version;
+        uint32_t                slotCount;
+        uint32_t                slotStride;         // bytes between slots
+        uint32_t                maxFrameBytes;      // capacity of a slot's pixel area
+        uint32_t                reserved[3];
+
+        // Frame number of the newest completed frame, 0 until the first publish
+        std::atomic<uint32_t>   latestFrame;
+    };
+
+    struct SlotHeader
+    {
+        // Odd while the publisher is writing the slot
+        std::atomic<uint32_t>   sequence;
+        uint32_t                frameNumber;
+        int64_t                 timestamp;
+        uint32_t                width;
+        uint32_t                height;
+        uint32_t                stride;             // bytes per scanline
+        uint32_t                format;             // PixelFormat
+        uint32_t                frameBytes;
+    };
+
+    /// <summary>
+    /// Rounds a byte count up to a multiple of a power-of-two alignment
+    /// </summary>
+    inline uint32_t AlignUp(uint32_t nBytes, uint32_t nAlignment)
+    {
+        return (nBytes + nAlignment - 1) & ~(nAlignment - 1);
+    }
+
+    /// <summary>
+    /// Offset of the first slot from the start of the mapping
+    /// </summary>
+    inline uint32_t FirstSlotOffset()
+    {
+        return AlignUp(sizeof(RingHeader), cSlotAlignment);
+    }
+
+    /// <summary>
+    /// Distance between two slots for the given pixel capacity
+    /// </summary>
+    inline uint32_t SlotStride(uint32_t nMaxFrameBytes)
+    {
+        return AlignUp(cSlotHeaderSize + nMaxFrameBytes, cSlotAlignment);
+    }
+
+    /// <summary>
+    /// A mapped named shared-memory object
+    /// </summary>
+    class SharedMemory
+    {
+    public:
+        /// <summary>
+        /// Constructor
+        /// </summary>
+        SharedMemory();
+
+        /// <summary>
+        /// Destructor, unmaps the view and releases the object
+        /// </summary>
+        ~SharedMemory();
+
+        /// <summary>
+        /// Creates (or re-opens) a named object for writing
+        /// </summary>
+        /// <param name="szName">object name without platform prefix</param>
+        /// <param name="cbSize">size of the object in bytes</param>
+        /// <returns>true on success</returns>
+        bool                    Create(const char* szName, size_t cbSize);
+
+        /// <summary>
+        /// Opens an existing named object read-only
+        /// </summary>
+        /// <param name="szName">object name without platform prefix</param>
+        /// <returns>true on success</returns>
+        bool                    Open(const char* szName);
+
+        /// <summary>
+        /// Unmaps the view and releases the object
+        /// </summary>
+        void                    Close();
+
+        uint8_t*                GetData() const     { return m_pData; }
+        size_t                  GetSize() const     { return m_cbSize; }
+
+    private:
+        uint8_t*                m_pData;
+        size_t                  m_cbSize;
+        bool                    m_bOwner;
+        char                    m_szName[256];
+
+#if defined(_WIN32)
+        void*                   m_hMapping;
+#else
+        int                     m_fd;
+#endif
+
+        // Not copyable
+        SharedMemory(const SharedMemory&);
+        SharedMemory& operator=(const SharedMemory&);
+    };
+}
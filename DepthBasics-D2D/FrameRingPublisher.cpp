@@ -0,0 +1,190 @@
+//------------------------------------------------------------------------------
+// Publishes frames into a shared-memory ring for local consumers
+//------------------------------------------------------------------------------
+
+#include "FrameRingPublisher.h"
+
+#include <cstring>
+#include <new>
+
+using namespace FrameRing;
+
+/// <summary>
+/// Constructor
+/// </summary>
+FrameRingPublisher::FrameRingPublisher() :
+    m_pHeader(NULL),
+    m_nSlotCount(0),
+    m_nMaxFrameBytes(0),
+    m_nFrameNumber(0),
+    m_pPendingSlot(NULL)
+{
+}
+
+/// <summary>
+/// Destructor
+/// </summary>
+FrameRingPublisher::~FrameRingPublisher()
+{
+    // Mark the ring as gone so readers holding the mapping stop waiting for frames
+    if (m_pHeader)
+    {
+        m_pHeader->magic = 0;
+    }
+}
+
+/// <summary>
+/// Creates the shared-memory ring
+/// </summary>
+/// <param name="szName">name readers open the ring by</param>
+/// <param name="nSlotCount">number of frames kept; a reader has nSlotCount - 1 frame periods to use a frame in place</param>
+/// <param name="nMaxFrameBytes">largest frame that will be published</param>
+/// <returns>true on success</returns>
+bool FrameRingPublisher::Initialize(const char* szName, uint32_t nSlotCount, uint32_t nMaxFrameBytes)
+{
+    if ((nSlotCount < 2) || !nMaxFrameBytes)
+    {
+        return false;
+    }
+
+    const uint32_t nSlotStride = SlotStride(nMaxFrameBytes);
+    const size_t cbTotal = FirstSlotOffset() + static_cast<size_t>(nSlotStride) * nSlotCount;
+
+    if (!m_memory.Create(szName, cbTotal))
+    {
+        return false;
+    }
+
+    // Lay out the header while the magic is still invalid so a reader that
+    // opens the ring mid-initialization rejects it
+    m_pHeader = new (m_memory.GetData()) RingHeader;
+    m_pHeader->magic         = 0;
+    m_pHeader->version       = cVersion;
+    m_pHeader->slotCount     = nSlotCount;
+    m_pHeader->slotStride    = nSlotStride;
+    m_pHeader->maxFrameBytes = nMaxFrameBytes;
+    memset(m_pHeader->reserved, 0, sizeof(m_pHeader->reserved));
+    m_pHeader->latestFrame.store(0, std::memory_order_relaxed);
+
+    m_nSlotCount = nSlotCount;
+    m_nMaxFrameBytes = nMaxFrameBytes;
+    m_nFrameNumber = 0;
+
+    for (uint32_t i = 0; i < nSlotCount; ++i)
+    {
+        SlotHeader* pSlot = new (GetSlot(i)) SlotHeader;
+        pSlot->sequence.store(0, std::memory_order_relaxed);
+        pSlot->frameNumber = 0;
+        pSlot->timestamp   = 0;
+        pSlot->width       = 0;
+        pSlot->height      = 0;
+        pSlot->stride      = 0;
+        pSlot->format      = PixelFormatUnknown;
+        pSlot->frameBytes  = 0;
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    m_pHeader->magic = cMagic;
+
+    return true;
+}
+
+/// <summary>
+/// Returns the header of a slot
+/// </summary>
+SlotHeader* FrameRingPublisher::GetSlot(uint32_t nSlot) const
+{
+    return reinterpret_cast<SlotHeader*>(m_memory.GetData() + FirstSlotOffset() + static_cast<size_t>(nSlot) * m_pHeader->slotStride);
+}
+
+/// <summary>
+/// Claims the next slot so a frame can be produced directly into shared memory.
+/// Must be followed by CommitFrame.
+/// </summary>
+/// <returns>pointer to nMaxFrameBytes of writable pixel memory, NULL if not initialized</returns>
+void* FrameRingPublisher::BeginFrame()
+{
+    if (!m_pHeader)
+    {
+        return NULL;
+    }
+
+    // Frame numbers start at 1 so 0 can mean "nothing published yet"
+    SlotHeader* pSlot = GetSlot((m_nFrameNumber + 1) % m_nSlotCount);
+
+    // Odd sequence tells readers the slot is being rewritten
+    uint32_t nSequence = pSlot->sequence.load(std::memory_order_relaxed);
+    pSlot->sequence.store(nSequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_pPendingSlot = pSlot;
+
+    return reinterpret_cast<uint8_t*>(pSlot) + cSlotHeaderSize;
+}
+
+/// <summary>
+/// Completes the frame started by BeginFrame and makes it the latest frame
+/// </summary>
+/// <param name="nTime">timestamp of frame</param>
+/// <param name="nWidth">width (in pixels) of the frame</param>
+/// <param name="nHeight">height (in pixels) of the frame</param>
+/// <param name="nStride">length (in bytes) of a single scanline</param>
+/// <param name="format">pixel format of the frame</param>
+void FrameRingPublisher::CommitFrame(int64_t nTime, uint32_t nWidth, uint32_t nHeight, uint32_t nStride, PixelFormat format)
+{
+    SlotHeader* pSlot = m_pPendingSlot;
+    if (!pSlot)
+    {
+        return;
+    }
+
+    ++m_nFrameNumber;
+
+    pSlot->frameNumber = m_nFrameNumber;
+    pSlot->timestamp   = nTime;
+    pSlot->width       = nWidth;
+    pSlot->height      = nHeight;
+    pSlot->stride      = nStride;
+    pSlot->format      = format;
+    pSlot->frameBytes  = nStride * nHeight;
+
+    // Even sequence publishes the pixels and metadata written above
+    uint32_t nSequence = pSlot->sequence.load(std::memory_order_relaxed);
+    pSlot->sequence.store(nSequence + 1, std::memory_order_release);
+
+    m_pHeader->latestFrame.store(m_nFrameNumber, std::memory_order_release);
+
+    m_pPendingSlot = NULL;
+}
+
+/// <summary>
+/// Copies a frame into the next slot and publishes it
+/// </summary>
+/// <param name="nTime">timestamp of frame</param>
+/// <param name="pData">pixel data</param>
+/// <param name="nWidth">width (in pixels) of the frame</param>
+/// <param name="nHeight">height (in pixels) of the frame</param>
+/// <param name="nStride">length (in bytes) of a single scanline</param>
+/// <param name="format">pixel format of the frame</param>
+/// <returns>true if the frame was published</returns>
+bool FrameRingPublisher::Publish(int64_t nTime, const void* pData, uint32_t nWidth, uint32_t nHeight, uint32_t nStride, PixelFormat format)
+{
+    const size_t cbFrame = static_cast<size_t>(nStride) * nHeight;
+
+    if (!pData || (cbFrame > m_nMaxFrameBytes))
+    {
+        return false;
+    }
+
+    void* pSlotData = BeginFrame();
+    if (!pSlotData)
+    {
+        return false;
+    }
+
+    memcpy(pSlotData, pData, cbFrame);
+
+    CommitFrame(nTime, nWidth, nHeight, nStride, format);
+
+    return true;
+}
@@ -0,0 +1,75 @@
+//------------------------------------------------------------------------------
+// Publishes frames into a shared-memory ring for local consumers
+//------------------------------------------------------------------------------
+
+#pragma once
+
+#include "FrameRing.h"
+
+class FrameRingPublisher
+{
+public:
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    FrameRingPublisher();
+
+    /// <summary>
+    /// Destructor
+    /// </summary>
+    ~FrameRingPublisher();
+
+    /// <summary>
+    /// Creates the shared-memory ring
+    /// </summary>
+    /// <param name="szName">name readers open the ring by</param>
+    /// <param name="nSlotCount">number of frames kept; a reader has nSlotCount - 1 frame periods to use a frame in place</param>
+    /// <param name="nMaxFrameBytes">largest frame that will be published</param>
+    /// <returns>true on success</returns>
+    bool                    Initialize(const char* szName, uint32_t nSlotCount, uint32_t nMaxFrameBytes);
+
+    /// <summary>
+    /// Claims the next slot so a frame can be produced directly into shared memory.
+    /// Must be followed by CommitFrame.
+    /// </summary>
+    /// <returns>pointer to nMaxFrameBytes of writable pixel memory, NULL if not initialized</returns>
+    void*                   BeginFrame();
+
+    /// <summary>
+    /// Completes the frame started by BeginFrame and makes it the latest frame
+    /// </summary>
+    /// <param name="nTime">timestamp of frame</param>
+    /// <param name="nWidth">width (in pixels) of the frame</param>
+    /// <param name="nHeight">height (in pixels) of the frame</param>
+    /// <param name="nStride">length (in bytes) of a single scanline</param>
+    /// <param name="format">pixel format of the frame</param>
+    void                    CommitFrame(int64_t nTime, uint32_t nWidth, uint32_t nHeight, uint32_t nStride, FrameRing::PixelFormat format);
+
+    /// <summary>
+    /// Copies a frame into the next slot and publishes it
+    /// </summary>
+    /// <param name="nTime">timestamp of frame</param>
+    /// <param name="pData">pixel data</param>
+    /// <param name="nWidth">width (in pixels) of the frame</param>
+    /// <param name="nHeight">height (in pixels) of the frame</param>
+    /// <param name="nStride">length (in bytes) of a single scanline</param>
+    /// <param name="format">pixel format of the frame</param>
+    /// <returns>true if the frame was published</returns>
+    bool                    Publish(int64_t nTime, const void* pData, uint32_t nWidth, uint32_t nHeight, uint32_t nStride, FrameRing::PixelFormat format);
+
+    bool                    IsInitialized() const   { return NULL != m_memory.GetData(); }
+    uint32_t                GetMaxFrameBytes() const { return m_nMaxFrameBytes; }
+
+private:
+    FrameRing::SharedMemory m_memory;
+    FrameRing::RingHeader*  m_pHeader;
+    uint32_t                m_nSlotCount;
+    uint32_t                m_nMaxFrameBytes;
+    uint32_t                m_nFrameNumber;
+    FrameRing::SlotHeader*  m_pPendingSlot;
+
+    /// <summary>
+    /// Returns the header of a slot
+    /// </summary>
+    FrameRing::SlotHeader*  GetSlot(uint32_t nSlot) const;
+};
@@ -0,0 +1,200 @@
+//------------------------------------------------------------------------------
+// Lock-free reader for frames published by FrameRingPublisher
+//------------------------------------------------------------------------------
+
+#include "FrameRingReader.h"
+
+#include <cstring>
+
+using namespace FrameRing;
+
+namespace
+{
+    // A copy that keeps colliding with the publisher is given up after this many attempts
+    const int cMaxCopyAttempts = 4;
+}
+
+/// <summary>
+/// Constructor
+/// </summary>
+FrameRingReader::FrameRingReader() :
+    m_pHeader(NULL)
+{
+}
+
+/// <summary>
+/// Maps an existing ring read-only
+/// </summary>
+/// <param name="szName">name the publisher created the ring with</param>
+/// <returns>true on success, false if no publisher is running</returns>
+bool FrameRingReader::Open(const char* szName)
+{
+    Close();
+
+    if (!m_memory.Open(szName) || (m_memory.GetSize() < sizeof(RingHeader)))
+    {
+        m_memory.Close();
+        return false;
+    }
+
+    const RingHeader* pHeader = reinterpret_cast<const RingHeader*>(m_memory.GetData());
+
+    if ((pHeader->magic != cMagic) || (pHeader->version != cVersion))
+    {
+        m_memory.Close();
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    const size_t cbRequired = FirstSlotOffset() + static_cast<size_t>(pHeader->slotStride) * pHeader->slotCount;
+    if (!pHeader->slotCount || (m_memory.GetSize() < cbRequired))
+    {
+        m_memory.Close();
+        return false;
+    }
+
+    m_pHeader = pHeader;
+
+    return true;
+}
+
+/// <summary>
+/// Unmaps the ring
+/// </summary>
+void FrameRingReader::Close()
+{
+    m_pHeader = NULL;
+    m_memory.Close();
+}
+
+/// <summary>
+/// Returns the header of a slot
+/// </summary>
+const SlotHeader* FrameRingReader::GetSlot(uint32_t nSlot) const
+{
+    return reinterpret_cast<const SlotHeader*>(m_memory.GetData() + FirstSlotOffset() + static_cast<size_t>(nSlot) * m_pHeader->slotStride);
+}
+
+/// <summary>
+/// Frame number of the newest published frame, 0 if none
+/// </summary>
+uint32_t FrameRingReader::GetLatestFrameNumber() const
+{
+    if (!m_pHeader)
+    {
+        return 0;
+    }
+
+    return m_pHeader->latestFrame.load(std::memory_order_acquire);
+}
+
+/// <summary>
+/// Gets an in-place view of the newest frame without copying it
+/// </summary>
+/// <param name="pView">receives the view</param>
+/// <returns>true if a complete frame was found</returns>
+bool FrameRingReader::AcquireLatest(FrameView* pView) const
+{
+    if (!pView || !m_pHeader || (m_pHeader->magic != cMagic))
+    {
+        return false;
+    }
+
+    uint32_t nFrame = m_pHeader->latestFrame.load(std::memory_order_acquire);
+    if (!nFrame)
+    {
+        return false;
+    }
+
+    uint32_t nSlot = nFrame % m_pHeader->slotCount;
+    const SlotHeader* pSlot = GetSlot(nSlot);
+
+    uint32_t nSequence = pSlot->sequence.load(std::memory_order_acquire);
+    if (nSequence & 1)
+    {
+        // The publisher has already lapped the ring and is rewriting this slot
+        return false;
+    }
+
+    FrameView view;
+    view.pData        = reinterpret_cast<const uint8_t*>(pSlot) + cSlotHeaderSize;
+    view.nFrameNumber = pSlot->frameNumber;
+    view.nTime        = pSlot->timestamp;
+    view.nWidth       = pSlot->width;
+    view.nHeight      = pSlot->height;
+    view.nStride      = pSlot->stride;
+    view.nFormat      = pSlot->format;
+    view.cbFrame      = pSlot->frameBytes;
+    view.nSlot        = nSlot;
+    view.nSequence    = nSequence;
+
+    // Metadata must have been read under the same sequence to be trusted
+    if (!IsValid(view) || (view.cbFrame > m_pHeader->maxFrameBytes))
+    {
+        return false;
+    }
+
+    *pView = view;
+
+    return true;
+}
+
+/// <summary>
+/// Checks that a view's pixels have not been overwritten since it was acquired.
+/// Call after consuming the data; results computed from an invalid view must be discarded.
+/// </summary>
+/// <param name="view">view returned by AcquireLatest</param>
+/// <returns>true if everything read through the view was consistent</returns>
+bool FrameRingReader::IsValid(const FrameView& view) const
+{
+    if (!m_pHeader || (view.nSlot >= m_pHeader->slotCount))
+    {
+        return false;
+    }
+
+    // Order all earlier reads of the slot before re-reading its sequence
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return GetSlot(view.nSlot)->sequence.load(std::memory_order_relaxed) == view.nSequence;
+}
+
+/// <summary>
+/// Copies the newest frame out of the ring, retrying if the publisher overwrites it mid-copy
+/// </summary>
+/// <param name="pDest">destination buffer</param>
+/// <param name="cbDest">size of the destination buffer in bytes</param>
+/// <param name="pView">receives the frame description, pData points at pDest</param>
+/// <returns>true if a consistent frame was copied</returns>
+bool FrameRingReader::CopyLatest(void* pDest, size_t cbDest, FrameView* pView) const
+{
+    if (!pDest || !pView)
+    {
+        return false;
+    }
+
+    for (int nAttempt = 0; nAttempt < cMaxCopyAttempts; ++nAttempt)
+    {
+        FrameView view;
+        if (!AcquireLatest(&view))
+        {
+            continue;
+        }
+
+        if (view.cbFrame > cbDest)
+        {
+            return false;
+        }
+
+        memcpy(pDest, view.pData, view.cbFrame);
+
+        if (IsValid(view))
+        {
+            view.pData = pDest;
+            *pView = view;
+            return true;
+        }
+    }
+
+    return false;
+}
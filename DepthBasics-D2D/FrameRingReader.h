@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+// Lock-free reader for frames published by FrameRingPublisher
+//------------------------------------------------------------------------------
+
+// Typical zero-copy use:
+//
+//   FrameRingReader reader;
+//   reader.Open("KinectDepthFrames");
+//   FrameRingReader::FrameView view;
+//   if (reader.AcquireLatest(&view))
+//   {
+//       Consume(view.pData, view.nWidth, view.nHeight);
+//       if (!reader.IsValid(view)) { /* publisher lapped us, discard results */ }
+//   }
+
+#pragma once
+
+#include "FrameRing.h"
+
+class FrameRingReader
+{
+public:
+    struct FrameView
+    {
+        const void*         pData;
+        uint32_t            nFrameNumber;
+        int64_t             nTime;
+        uint32_t            nWidth;
+        uint32_t            nHeight;
+        uint32_t            nStride;
+        uint32_t            nFormat;
+        uint32_t            cbFrame;
+
+        // Seqlock state the view was acquired under
+        uint32_t            nSlot;
+        uint32_t            nSequence;
+    };
+
+    /// <summary>
+    /// Constructor
+    /// </summary>
+    FrameRingReader();
+
+    /// <summary>
+    /// Maps an existing ring read-only
+    /// </summary>
+    /// <param name="szName">name the publisher created the ring with</param>
+    /// <returns>true on success, false if no publisher is running</returns>
+    bool                    Open(const char* szName);
+
+    /// <summary>
+    /// Unmaps the ring
+    /// </summary>
+    void                    Close();
+
+    /// <summary>
+    /// Frame number of the newest published frame, 0 if none
+    /// </summary>
+    uint32_t                GetLatestFrameNumber() const;
+
+    /// <summary>
+    /// Gets an in-place view of the newest frame without copying it
+    /// </summary>
+    /// <param name="pView">receives the view</param>
+    /// <returns>true if a complete frame was found</returns>
+    bool                    AcquireLatest(FrameView* pView) const;
+
+    /// <summary>
+    /// Checks that a view's pixels have not been overwritten since it was acquired.
+    /// Call after consuming the data; results computed from an invalid view must be discarded.
+    /// </summary>
+    /// <param name="view">view returned by AcquireLatest</param>
+    /// <returns>true if everything read through the view was consistent</returns>
+    bool                    IsValid(const FrameView& view) const;
+
+    /// <summary>
+    /// Copies the newest frame out of the ring, retrying if the publisher overwrites it mid-copy
+    /// </summary>
+    /// <param name="pDest">destination buffer</param>
+    /// <param name="cbDest">size of the destination buffer in bytes</param>
+    /// <param name="pView">receives the frame description, pData points at pDest</param>
+    /// <returns>true if a consistent frame was copied</returns>
+    bool                    CopyLatest(void* pDest, size_t cbDest, FrameView* pView) const;
+
+    bool                    IsOpen() const      { return NULL != m_pHeader; }
+
+private:
+    FrameRing::SharedMemory         m_memory;
+    const FrameRing::RingHeader*    m_pHeader;
+
+    /// <summary>
+    /// Returns the header of a slot
+    /// </summary>
+    const FrameRing::SlotHeader*    GetSlot(uint32_t nSlot) const;
+};
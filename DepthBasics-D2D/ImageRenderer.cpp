@@ -17,7 +17,9 @@ ImageRenderer::ImageRenderer() :
     m_sourceStride(0),
     m_pD2DFactory(NULL), 
     m_pRenderTarget(NULL),
-    m_pBitmap(0)
+    m_pBitmap(0),
+    m_pRemapTable(NULL),
+    m_pWarpedImage(NULL)
 {
 }
 
@@ -28,6 +30,12 @@ ImageRenderer::~ImageRenderer()
 {
     DiscardResources();
     SafeRelease(m_pD2DFactory);
+
+    if (m_pWarpedImage)
+    {
+        delete [] m_pWarpedImage;
+        m_pWarpedImage = NULL;
+    }
 }
 
 /// <summary>
@@ -113,9 +121,25 @@ HRESULT ImageRenderer::Initialize(HWND hWnd, ID2D1Factory* pD2DFactory, int sour
     m_sourceHeight = sourceHeight;
     m_sourceStride = sourceStride;
 
+    // The warp target is sized from the format, so drop any buffer from a previous format
+    if (m_pWarpedImage)
+    {
+        delete [] m_pWarpedImage;
+        m_pWarpedImage = NULL;
+    }
+
     return S_OK;
 }
 
+/// <summary>
+/// Pre-warps every image drawn from now on, e.g. to pre-distort for an off-axis projector
+/// </summary>
+/// <param name="pRemapTable">table the size of the source image, NULL to draw unwarped. Must stay alive while set.</param>
+void ImageRenderer::SetRemapTable(const ProjectionMapping::RemapTable* pRemapTable)
+{
+    m_pRemapTable = pRemapTable;
+}
+
 /// <summary>
 /// Draws a 32 bit per pixel image of previously specified width, height, and stride to the associated hwnd
 /// </summary>
@@ -130,6 +154,18 @@ HRESULT ImageRenderer::Draw(BYTE* pImage, unsigned long cbImage)
         return E_INVALIDARG;
     }
 
+    // Pre-distort on the CPU before the image is handed to Direct2D
+    if (m_pRemapTable && (m_pRemapTable->GetWidth() == m_sourceWidth) && (m_pRemapTable->GetHeight() == m_sourceHeight))
+    {
+        if (!m_pWarpedImage)
+        {
+            m_pWarpedImage = new BYTE[m_sourceStride * m_sourceHeight];
+        }
+
+        m_warper.Apply(*m_pRemapTable, pImage, m_sourceWidth, m_sourceHeight, m_sourceStride, m_pWarpedImage, m_sourceStride);
+        pImage = m_pWarpedImage;
+    }
+
     // create the resources for this draw device
     // they will be recreated if previously lost
     HRESULT hr = EnsureResources();
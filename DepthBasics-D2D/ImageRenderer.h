@@ -9,6 +9,7 @@
 #pragma once
 
 #include <d2d1.h>
+#include "..\ProjectionMapping\ProjectionMapping\ProjectionMapping.Shared\Imaging\ImageWarp.h"
 
 class ImageRenderer
 {
@@ -43,6 +44,12 @@ public:
     /// <returns>indicates success or failure</returns>
     HRESULT Draw(BYTE* pImage, unsigned long cbImage);
 
+    /// <summary>
+    /// Pre-warps every image drawn from now on, e.g. to pre-distort for an off-axis projector
+    /// </summary>
+    /// <param name="pRemapTable">table the size of the source image, NULL to draw unwarped. Must stay alive while set.</param>
+    void SetRemapTable(const ProjectionMapping::RemapTable* pRemapTable);
+
 private:
     HWND                     m_hWnd;
 
@@ -56,6 +63,11 @@ private:
     ID2D1HwndRenderTarget*   m_pRenderTarget;
     ID2D1Bitmap*             m_pBitmap;
 
+    // CPU pre-warp
+    const ProjectionMapping::RemapTable* m_pRemapTable;
+    ProjectionMapping::ImageWarper       m_warper;
+    BYTE*                    m_pWarpedImage;
+
     /// <summary>
     /// Ensure necessary Direct2d resources are created
     /// </summary>
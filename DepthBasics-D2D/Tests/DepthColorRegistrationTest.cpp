@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+// Equality tests for the vectorised depth to colour registration
+//------------------------------------------------------------------------------
+
+#include "DepthColorRegistration.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // An odd-sized depth frame so the pixel count is not a multiple of the vector width
+    const uint32_t cDepthWidth = 511;
+    const uint32_t cDepthHeight = 423;
+    const uint32_t cColorWidth = 1920;
+    const uint32_t cColorHeight = 1080;
+
+    /// <summary>
+    /// Colour pixel a depth pixel should get, written independently of Register from MapPixel
+    /// </summary>
+    uint32_t ReferenceRegister(const DepthColorRegistration& registration, size_t nIndex, uint16_t nDepth, const std::vector<uint32_t>& color)
+    {
+        if (0 == nDepth)
+        {
+            return 0;
+        }
+
+        float fColorX, fColorY;
+        registration.MapPixel(nIndex, nDepth, &fColorX, &fColorY);
+
+        const float x = fColorX + 0.5f;
+        const float y = fColorY + 0.5f;
+        if (!(x >= 0.0f && x < static_cast<float>(cColorWidth) && y >= 0.0f && y < static_cast<float>(cColorHeight)))
+        {
+            return 0;
+        }
+
+        return color[static_cast<size_t>(y) * cColorWidth + static_cast<uint32_t>(x)];
+    }
+
+    /// <summary>
+    /// Fits every depth pixel from two pinhole cameras 52 mm apart, as the coordinate mapper would report them
+    /// </summary>
+    void FitPinhole(DepthColorRegistration* pRegistration)
+    {
+        for (uint32_t y = 0; y < cDepthHeight; ++y)
+        {
+            for (uint32_t x = 0; x < cDepthWidth; ++x)
+            {
+                float colorX[DepthColorRegistration::cSampleCount], colorY[DepthColorRegistration::cSampleCount];
+                for (int s = 0; s < DepthColorRegistration::cSampleCount; ++s)
+                {
+                    const double z = DepthColorRegistration::cSampleDepths[s];
+                    colorX[s] = static_cast<float>(1060.0 * ((x - 256.0) / 365.0 * z + 52.0) / z + 960.0);
+                    colorY[s] = static_cast<float>(1060.0 * (y - 212.0) / 365.0 + 540.0);
+                }
+                pRegistration->FitPixel(static_cast<size_t>(y) * cDepthWidth + x, colorX, colorY);
+            }
+        }
+    }
+
+    /// <summary>
+    /// Colour frame where every pixel holds its own index, so a wrong fetch cannot go unnoticed
+    /// </summary>
+    std::vector<uint32_t> MakeColorFrame()
+    {
+        std::vector<uint32_t> color(static_cast<size_t>(cColorWidth) * cColorHeight);
+        for (size_t i = 0; i < color.size(); ++i)
+        {
+            color[i] = static_cast<uint32_t>(i) | 0xFF000000u;
+        }
+        return color;
+    }
+
+    /// <summary>
+    /// Counts the pixels where Register differs from the per-pixel reference
+    /// </summary>
+    int CountMismatches(const DepthColorRegistration& registration, const std::vector<uint16_t>& depth, const std::vector<uint32_t>& color)
+    {
+        // Filled with a marker so a pixel Register skips is counted too
+        std::vector<uint32_t> registered(depth.size(), 0xDEADBEEFu);
+        registration.Register(depth.data(), color.data(), registered.data());
+
+        int nMismatches = 0;
+        for (size_t i = 0; i < depth.size(); ++i)
+        {
+            if (registered[i] != ReferenceRegister(registration, i, depth[i], color))
+            {
+                ++nMismatches;
+            }
+        }
+        return nMismatches;
+    }
+
+    /// <summary>
+    /// The pinhole fit reproduces the model, and Register matches the reference over random depths,
+    /// including invalid ones and depths beyond the sensor range that project outside the colour image
+    /// </summary>
+    void TestMatchesReferenceOnRandomDepths()
+    {
+        DepthColorRegistration registration;
+        registration.Initialize(cDepthWidth, cDepthHeight, cColorWidth, cColorHeight);
+        FitPinhole(&registration);
+
+        double fWorst = 0.0;
+        for (uint32_t nDepth = 400; nDepth <= 8000; nDepth += 100)
+        {
+            const size_t nIndex = 100 * cDepthWidth + 37;
+            float fColorX, fColorY;
+            registration.MapPixel(nIndex, static_cast<uint16_t>(nDepth), &fColorX, &fColorY);
+            const double fExpected = 1060.0 * ((37 - 256.0) / 365.0 * nDepth + 52.0) / nDepth + 960.0;
+            fWorst = std::fmax(fWorst, std::fabs(fColorX - fExpected));
+        }
+        CHECK(fWorst < 0.01);
+
+        const std::vector<uint32_t> color = MakeColorFrame();
+        std::vector<uint16_t> depth(static_cast<size_t>(cDepthWidth) * cDepthHeight);
+        std::mt19937 random(1);
+        for (int nFrame = 0; nFrame < 4; ++nFrame)
+        {
+            for (size_t i = 0; i < depth.size(); ++i)
+            {
+                const uint32_t r = random();
+                depth[i] = (r % 10 == 0) ? 0 : static_cast<uint16_t>(nFrame < 3 ? 400 + r % 7600 : 1 + r % 0xFFFF);
+            }
+            CHECK(0 == CountMismatches(registration, depth, color));
+        }
+    }
+
+    /// <summary>
+    /// Pixels with a constant colour coordinate right on the edges of the image, in every vector lane.
+    /// x + 0.5 == 0 is inside, x + 0.5 == width is outside, and the largest float below each edge decides the other way.
+    /// </summary>
+    void TestImageEdges()
+    {
+        DepthColorRegistration registration;
+        registration.Initialize(cDepthWidth, cDepthHeight, cColorWidth, cColorHeight);
+        FitPinhole(&registration);
+
+        const float fInside = 100.0f;
+        const float fEdges[][2] =
+        {
+            { -0.5f, fInside },
+            { std::nextafter(-0.5f, -1.0f), fInside },
+            { cColorWidth - 0.5f, fInside },
+            { std::nextafter(cColorWidth - 0.5f, 0.0f), fInside },
+            { fInside, -0.5f },
+            { fInside, std::nextafter(-0.5f, -1.0f) },
+            { fInside, cColorHeight - 0.5f },
+            { fInside, std::nextafter(cColorHeight - 0.5f, 0.0f) },
+            { -1.0e5f, fInside },
+            { fInside, 1.0e5f },
+        };
+        const size_t nEdgeCount = sizeof(fEdges) / sizeof(fEdges[0]);
+
+        // Consecutive pixels, so each edge lands in a different lane as the start moves
+        const size_t nStarts[] = { 0, 1001, 2002, 3003, static_cast<size_t>(cDepthWidth) * cDepthHeight - nEdgeCount };
+        for (size_t s = 0; s < sizeof(nStarts) / sizeof(nStarts[0]); ++s)
+        {
+            for (size_t e = 0; e < nEdgeCount; ++e)
+            {
+                const float colorX[DepthColorRegistration::cSampleCount] = { fEdges[e][0], fEdges[e][0], fEdges[e][0] };
+                const float colorY[DepthColorRegistration::cSampleCount] = { fEdges[e][1], fEdges[e][1], fEdges[e][1] };
+                CHECK(registration.FitPixel(nStarts[s] + e, colorX, colorY));
+            }
+        }
+
+        const std::vector<uint32_t> color = MakeColorFrame();
+        std::vector<uint16_t> depth(static_cast<size_t>(cDepthWidth) * cDepthHeight, 2000);
+        CHECK(0 == CountMismatches(registration, depth, color));
+
+        // The reference agrees with the documented edges
+        CHECK(ReferenceRegister(registration, 0, 2000, color) == color[100 * cColorWidth]);
+        CHECK(0 == ReferenceRegister(registration, 1, 2000, color));
+        CHECK(0 == ReferenceRegister(registration, 2, 2000, color));
+        CHECK(ReferenceRegister(registration, 3, 2000, color) == color[100 * cColorWidth + cColorWidth - 1]);
+    }
+
+    /// <summary>
+    /// Pixels the coordinate mapper cannot map stay unregistered, and an uninitialised table writes nothing
+    /// </summary>
+    void TestUnmappedPixels()
+    {
+        DepthColorRegistration registration;
+        registration.Initialize(cDepthWidth, cDepthHeight, cColorWidth, cColorHeight);
+        FitPinhole(&registration);
+
+        // Two neighbouring pixels in the middle of the frame, which the pinhole maps inside the colour image
+        const size_t nUnmapped = 200 * cDepthWidth + 257;
+        const size_t nCleared = nUnmapped + 1;
+        const float fInfinity = std::numeric_limits<float>::infinity();
+        const float colorX[DepthColorRegistration::cSampleCount] = { 500.0f, -fInfinity, 500.0f };
+        const float colorY[DepthColorRegistration::cSampleCount] = { 500.0f, 500.0f, 500.0f };
+        CHECK(!registration.FitPixel(nUnmapped, colorX, colorY));
+        registration.ClearPixel(nCleared);
+
+        const std::vector<uint32_t> color = MakeColorFrame();
+        const std::vector<uint16_t> depth(static_cast<size_t>(cDepthWidth) * cDepthHeight, 1500);
+        std::vector<uint32_t> registered(depth.size());
+        registration.Register(depth.data(), color.data(), registered.data());
+        CHECK(0 == registered[nUnmapped] && 0 == registered[nCleared]);
+        CHECK(0 != registered[nUnmapped - 1] && 0 != registered[nCleared + 1]);
+        CHECK(0 == CountMismatches(registration, depth, color));
+
+        DepthColorRegistration empty;
+        CHECK(!empty.IsInitialized());
+        registered.assign(depth.size(), 0xDEADBEEFu);
+        empty.Register(depth.data(), color.data(), registered.data());
+        CHECK(0xDEADBEEFu == registered[0]);
+    }
+}
+
+int main()
+{
+    TestMatchesReferenceOnRandomDepths();
+    TestImageEdges();
+    TestUnmappedPixels();
+    return TestCheck::TestResult();
+}
@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+// Timing of the depth to intensity conversion: the original per-pixel loop
+// against the lookup table, on 512x424 frames
+//------------------------------------------------------------------------------
+
+#include "DepthIntensityTable.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    static const int        cDepthWidth  = 512;
+    static const int        cDepthHeight = 424;
+    static const int        cFrameCount  = 2000;
+    static const uint16_t   cMinDepth    = 500;
+    static const uint16_t   cMaxDepth    = 4500;
+
+    /// <summary>
+    /// The loop ProcessDepth ran before the table: a range test and a division per pixel
+    /// </summary>
+    void ConvertWithDivision(const uint16_t* pDepth, uint32_t* pRGBX, size_t nCount, uint16_t nMinDepth, uint16_t nMaxDepth)
+    {
+        const uint16_t* pDepthEnd = pDepth + nCount;
+
+        while (pDepth < pDepthEnd)
+        {
+            uint16_t depth = *pDepth;
+            uint8_t intensity = static_cast<uint8_t>((depth >= nMinDepth) && (depth <= nMaxDepth) ? (depth * 256 / 8000) : 0);
+            *pRGBX = intensity * 0x010101u;
+
+            ++pRGBX;
+            ++pDepth;
+        }
+    }
+
+    /// <summary>
+    /// Milliseconds per frame of a conversion over every frame; the checksum keeps the work from being optimized away
+    /// </summary>
+    template <typename Convert>
+    double TimeFrames(const std::vector<uint16_t>& frames, std::vector<uint32_t>* pRGBX, Convert convert, uint32_t* pChecksum)
+    {
+        const size_t nPixels = pRGBX->size();
+        const size_t nFrames = frames.size() / nPixels;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int nFrame = 0; nFrame < cFrameCount; ++nFrame)
+        {
+            convert(&frames[(nFrame % nFrames) * nPixels], pRGBX->data(), nPixels);
+            *pChecksum += (*pRGBX)[nFrame % nPixels];
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        return elapsed.count() / cFrameCount;
+    }
+}
+
+int main()
+{
+    // A few frames of noisy depth across the whole sensor range, including invalid zeros and far values
+    const size_t nPixels = static_cast<size_t>(cDepthWidth) * cDepthHeight;
+    const size_t nFrames = 8;
+    std::vector<uint16_t> frames(nPixels * nFrames);
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> depth(0, 8000);
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        frames[i] = static_cast<uint16_t>(depth(random));
+    }
+
+    std::vector<uint32_t> rgbx(nPixels);
+    uint32_t nChecksum = 0;
+
+    // Warm both paths up so the first timing does not pay for page faults
+    DepthIntensityTable* pTable = new DepthIntensityTable();
+    pTable->Update(cMinDepth, cMaxDepth);
+    ConvertWithDivision(frames.data(), rgbx.data(), nPixels, cMinDepth, cMaxDepth);
+    pTable->Convert(frames.data(), rgbx.data(), nPixels);
+
+    double fDivision = TimeFrames(frames, &rgbx, [](const uint16_t* pDepth, uint32_t* pRGBX, size_t nCount)
+    {
+        ConvertWithDivision(pDepth, pRGBX, nCount, cMinDepth, cMaxDepth);
+    }, &nChecksum);
+
+    double fTable = TimeFrames(frames, &rgbx, [pTable](const uint16_t* pDepth, uint32_t* pRGBX, size_t nCount)
+    {
+        pTable->Convert(pDepth, pRGBX, nCount);
+    }, &nChecksum);
+
+    // The table is rebuilt only when the reliable range changes, so alternate two ranges to time a rebuild
+    const int cRebuildCount = 200;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < cRebuildCount; ++i)
+    {
+        pTable->Update(cMinDepth, static_cast<uint16_t>(cMaxDepth + (i & 1)));
+        nChecksum += (*pTable)[static_cast<uint16_t>(i)];
+    }
+    std::chrono::duration<double, std::milli> rebuild = std::chrono::steady_clock::now() - start;
+    delete pTable;
+
+    printf("%dx%d depth frames, %d frames each\n", cDepthWidth, cDepthHeight, cFrameCount);
+    printf("division per pixel: %.3f ms per frame\n", fDivision);
+    printf("lookup table:       %.3f ms per frame (%.2fx)\n", fTable, fDivision / fTable);
+    printf("table rebuild:      %.3f ms\n", rebuild.count() / cRebuildCount);
+    printf("checksum %u\n", nChecksum);
+    return 0;
+}
@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+// Bit-exactness tests for the fixed-point depth to intensity conversion
+//------------------------------------------------------------------------------
+
+#include "DepthIntensityTable.h"
+#include "FixedPoint.h"
+#include "TestCheck.h"
+
+#include <vector>
+
+namespace
+{
+    /// <summary>
+    /// Intensity the original per-pixel loop computed with a division
+    /// </summary>
+    uint8_t ReferenceIntensity(uint32_t nDepth, uint16_t nMinDepth, uint16_t nMaxDepth)
+    {
+        return static_cast<uint8_t>((nDepth >= nMinDepth) && (nDepth <= nMaxDepth) ? (nDepth * 256 / 8000) : 0);
+    }
+
+    /// <summary>
+    /// Table and frame conversion against the division over every 16-bit depth
+    /// </summary>
+    void TestMatchesDivision(DepthIntensityTable* pTable, uint16_t nMinDepth, uint16_t nMaxDepth)
+    {
+        pTable->Update(nMinDepth, nMaxDepth);
+
+        std::vector<uint16_t> depth(65536);
+        for (uint32_t nDepth = 0; nDepth <= 0xFFFF; ++nDepth)
+        {
+            depth[nDepth] = static_cast<uint16_t>(nDepth);
+        }
+
+        std::vector<uint32_t> rgbx(depth.size());
+        pTable->Convert(depth.data(), rgbx.data(), depth.size());
+
+        int nMismatches = 0;
+        for (uint32_t nDepth = 0; nDepth <= 0xFFFF; ++nDepth)
+        {
+            const uint8_t nExpected = ReferenceIntensity(nDepth, nMinDepth, nMaxDepth);
+            if (((*pTable)[static_cast<uint16_t>(nDepth)] != nExpected) || (rgbx[nDepth] != nExpected * 0x010101u))
+            {
+                ++nMismatches;
+            }
+        }
+        CHECK(0 == nMismatches);
+    }
+
+    /// <summary>
+    /// The reciprocal divider against integer division
+    /// </summary>
+    void TestReciprocalDivider()
+    {
+        // Every numerator the intensity table divides
+        const FixedPoint::ReciprocalDivider displayDivider(DepthIntensityTable::cDisplayRange, 24);
+        int nMismatches = 0;
+        for (uint32_t n = 0; n < (1u << 24); ++n)
+        {
+            if (displayDivider.Divide(n) != n / DepthIntensityTable::cDisplayRange)
+            {
+                ++nMismatches;
+            }
+        }
+        CHECK(0 == nMismatches);
+
+        // Other divisors and widths, over every 16-bit numerator and the top of the declared range
+        const uint32_t nDivisors[] = { 1, 2, 3, 7, 125, 1000, 4096, 8000, 65535, 0x7FFFFFFF };
+        const unsigned int nWidths[] = { 16, 24, 31 };
+
+        nMismatches = 0;
+        for (size_t d = 0; d < sizeof(nDivisors) / sizeof(nDivisors[0]); ++d)
+        {
+            for (size_t w = 0; w < sizeof(nWidths) / sizeof(nWidths[0]); ++w)
+            {
+                const FixedPoint::ReciprocalDivider divider(nDivisors[d], nWidths[w]);
+                const uint32_t nLimit = static_cast<uint32_t>((1ull << nWidths[w]) - 1);
+
+                for (uint32_t n = 0; n <= 0xFFFF; ++n)
+                {
+                    if (divider.Divide(n) != n / nDivisors[d])
+                    {
+                        ++nMismatches;
+                    }
+                }
+
+                for (uint32_t n = nLimit - 0xFFFF; n != nLimit; ++n)
+                {
+                    if (divider.Divide(n) != n / nDivisors[d])
+                    {
+                        ++nMismatches;
+                    }
+                }
+
+                if (divider.Divide(nLimit) != nLimit / nDivisors[d])
+                {
+                    ++nMismatches;
+                }
+            }
+        }
+        CHECK(0 == nMismatches);
+    }
+}
+
+int main()
+{
+    TestReciprocalDivider();
+
+    // The table is reused, so each range also checks that a changed range rebuilds it
+    DepthIntensityTable* pTable = new DepthIntensityTable();
+    TestMatchesDivision(pTable, 0, 0xFFFF);
+    TestMatchesDivision(pTable, 500, 0xFFFF);
+    TestMatchesDivision(pTable, 500, 4500);
+    TestMatchesDivision(pTable, 1234, 1234);
+    TestMatchesDivision(pTable, 4500, 500);
+    TestMatchesDivision(pTable, 0, 0xFFFF);
+    delete pTable;
+
+    return TestCheck::TestResult();
+}
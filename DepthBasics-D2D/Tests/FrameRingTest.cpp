@@ -0,0 +1,319 @@
+//------------------------------------------------------------------------------
+// Round-trip tests for the shared-memory frame ring
+//------------------------------------------------------------------------------
+
+#include "FrameRingPublisher.h"
+#include "FrameRingReader.h"
+#include "TestCheck.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace FrameRing;
+
+namespace
+{
+    const uint32_t cWidth       = 64;
+    const uint32_t cHeight      = 48;
+    const uint32_t cStride      = cWidth * sizeof(uint16_t);
+    const uint32_t cFrameBytes  = cStride * cHeight;
+    const uint32_t cSlotCount   = 3;
+
+    /// <summary>
+    /// Builds an object name that does not collide with other test runs
+    /// </summary>
+    void MakeName(const char* szTest, char* szName, size_t cchName)
+    {
+#if defined(_WIN32)
+        _snprintf_s(szName, cchName, _TRUNCATE, "FrameRingTest-%s-%lu", szTest, GetCurrentProcessId());
+#else
+        snprintf(szName, cchName, "FrameRingTest-%s-%ld", szTest, static_cast<long>(getpid()));
+#endif
+    }
+
+    /// <summary>
+    /// Fills a depth frame with values derived from the frame number
+    /// </summary>
+    void FillFrame(uint32_t nFrame, std::vector<uint16_t>* pFrame)
+    {
+        for (size_t i = 0; i < pFrame->size(); ++i)
+        {
+            (*pFrame)[i] = static_cast<uint16_t>(nFrame * 131 + i);
+        }
+    }
+
+    /// <summary>
+    /// Create, open, publish and read back frames through both the in-place and the copying path
+    /// </summary>
+    void TestRoundTrip()
+    {
+        char szName[64];
+        MakeName("RoundTrip", szName, sizeof(szName));
+
+        FrameRingPublisher publisher;
+        CHECK(publisher.Initialize(szName, cSlotCount, cFrameBytes));
+
+        FrameRingReader reader;
+        CHECK(reader.Open(szName));
+        CHECK(reader.IsOpen());
+
+        // Nothing has been published yet
+        FrameRingReader::FrameView view;
+        CHECK(0 == reader.GetLatestFrameNumber());
+        CHECK(!reader.AcquireLatest(&view));
+
+        std::vector<uint16_t> frame(cWidth * cHeight);
+        std::vector<uint16_t> copy(cWidth * cHeight);
+
+        // Publish more frames than there are slots so the ring wraps around
+        for (uint32_t nFrame = 1; nFrame <= cSlotCount * 2 + 1; ++nFrame)
+        {
+            FillFrame(nFrame, &frame);
+            CHECK(publisher.Publish(1000 + nFrame, frame.data(), cWidth, cHeight, cStride, PixelFormatDepth16));
+
+            CHECK(nFrame == reader.GetLatestFrameNumber());
+
+            CHECK(reader.AcquireLatest(&view));
+            CHECK(nFrame == view.nFrameNumber);
+            CHECK(1000 + nFrame == view.nTime);
+            CHECK(cWidth == view.nWidth);
+            CHECK(cHeight == view.nHeight);
+            CHECK(cStride == view.nStride);
+            CHECK(PixelFormatDepth16 == view.nFormat);
+            CHECK(cFrameBytes == view.cbFrame);
+            CHECK(0 == memcmp(view.pData, frame.data(), cFrameBytes));
+            CHECK(reader.IsValid(view));
+
+            CHECK(reader.CopyLatest(copy.data(), copy.size() * sizeof(uint16_t), &view));
+            CHECK(view.pData == copy.data());
+            CHECK(frame == copy);
+        }
+
+        // The in-place view goes stale once the publisher laps its slot
+        CHECK(reader.AcquireLatest(&view));
+        for (uint32_t i = 0; i < cSlotCount; ++i)
+        {
+            CHECK(publisher.Publish(0, frame.data(), cWidth, cHeight, cStride, PixelFormatDepth16));
+        }
+        CHECK(!reader.IsValid(view));
+
+        // Frames larger than a slot are rejected, and so are copies into a short buffer
+        std::vector<uint16_t> large(cWidth * (cHeight + 1));
+        CHECK(!publisher.Publish(0, large.data(), cWidth, cHeight + 1, cStride, PixelFormatDepth16));
+        CHECK(!reader.CopyLatest(copy.data(), cFrameBytes - 1, &view));
+    }
+
+    /// <summary>
+    /// Frames produced in place through BeginFrame/CommitFrame
+    /// </summary>
+    void TestInPlaceFrame()
+    {
+        char szName[64];
+        MakeName("InPlace", szName, sizeof(szName));
+
+        FrameRingPublisher publisher;
+        CHECK(publisher.Initialize(szName, cSlotCount, cFrameBytes));
+
+        FrameRingReader reader;
+        CHECK(reader.Open(szName));
+
+        uint16_t* pPixels = static_cast<uint16_t*>(publisher.BeginFrame());
+        CHECK(NULL != pPixels);
+        if (!pPixels)
+        {
+            return;
+        }
+
+        // The frame is invisible until it is committed
+        CHECK(0 == reader.GetLatestFrameNumber());
+
+        for (uint32_t i = 0; i < cWidth * cHeight; ++i)
+        {
+            pPixels[i] = static_cast<uint16_t>(i);
+        }
+        publisher.CommitFrame(42, cWidth, cHeight, cStride, PixelFormatDepth16);
+
+        FrameRingReader::FrameView view;
+        CHECK(reader.AcquireLatest(&view));
+        CHECK(42 == view.nTime);
+        CHECK(0 == memcmp(view.pData, pPixels, cFrameBytes));
+    }
+
+    /// <summary>
+    /// The publisher removes the name, and readers cannot open what was never created
+    /// </summary>
+    void TestLifetime()
+    {
+        char szName[64];
+        MakeName("Lifetime", szName, sizeof(szName));
+
+        FrameRingReader reader;
+        CHECK(!reader.Open(szName));
+        CHECK(!reader.IsOpen());
+
+        {
+            FrameRingPublisher publisher;
+            CHECK(publisher.Initialize(szName, cSlotCount, cFrameBytes));
+            CHECK(reader.Open(szName));
+            reader.Close();
+        }
+
+        CHECK(!reader.Open(szName));
+
+        // Invalid layouts are rejected before anything is created
+        FrameRingPublisher publisher;
+        CHECK(!publisher.Initialize(szName, 1, cFrameBytes));
+        CHECK(!publisher.Initialize(szName, cSlotCount, 0));
+        CHECK(!publisher.IsInitialized());
+        CHECK(NULL == publisher.BeginFrame());
+    }
+
+    /// <summary>
+    /// Sensor-sized frames streamed from a publisher thread while a reader copies the latest one.
+    /// Reports the rates achieved; every copy the reader accepts must be a whole, untorn frame.
+    /// </summary>
+    void TestThroughput()
+    {
+        const uint32_t cSensorWidth     = 512;
+        const uint32_t cSensorHeight    = 424;
+        const uint32_t cSensorStride    = cSensorWidth * sizeof(uint16_t);
+        const uint32_t cSensorBytes     = cSensorStride * cSensorHeight;
+        const uint32_t cFrames          = 2000;
+
+        char szName[64];
+        MakeName("Throughput", szName, sizeof(szName));
+
+        FrameRingPublisher publisher;
+        CHECK(publisher.Initialize(szName, 4, cSensorBytes));
+
+        FrameRingReader reader;
+        CHECK(reader.Open(szName));
+        if (!publisher.IsInitialized() || !reader.IsOpen())
+        {
+            return;
+        }
+
+        std::vector<uint16_t> frame(cSensorWidth * cSensorHeight);
+        std::vector<uint16_t> copy(frame.size());
+        std::atomic<bool> bDone(false);
+
+        typedef std::chrono::steady_clock Clock;
+        const Clock::time_point start = Clock::now();
+
+        // The publisher regenerates each frame in place, as the capture loop does
+        std::thread writer([&]()
+        {
+            for (uint32_t nFrame = 1; nFrame <= cFrames; ++nFrame)
+            {
+                uint16_t* pPixels = static_cast<uint16_t*>(publisher.BeginFrame());
+                for (uint32_t i = 0; i < cSensorWidth * cSensorHeight; ++i)
+                {
+                    pPixels[i] = static_cast<uint16_t>(nFrame * 131 + i);
+                }
+                publisher.CommitFrame(nFrame, cSensorWidth, cSensorHeight, cSensorStride, PixelFormatDepth16);
+            }
+            bDone = true;
+        });
+
+        uint32_t nRead = 0;
+        uint32_t nLastFrame = 0;
+        int nTorn = 0;
+        FrameRingReader::FrameView view;
+        while (!bDone || (reader.GetLatestFrameNumber() != nLastFrame))
+        {
+            if (!reader.CopyLatest(copy.data(), cSensorBytes, &view) || (view.nFrameNumber == nLastFrame))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            FillFrame(view.nFrameNumber, &frame);
+            if (frame != copy)
+            {
+                ++nTorn;
+            }
+            nLastFrame = view.nFrameNumber;
+            ++nRead;
+        }
+        writer.join();
+
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // The reader's own copy rate, without a publisher competing for the cores
+        const Clock::time_point copyStart = Clock::now();
+        for (uint32_t i = 0; i < cFrames; ++i)
+        {
+            CHECK(reader.CopyLatest(copy.data(), cSensorBytes, &view));
+        }
+        const double copySeconds = std::chrono::duration<double>(Clock::now() - copyStart).count();
+
+        printf("FrameRing throughput, %ux%u depth frames:\n", cSensorWidth, cSensorHeight);
+        printf("  published %u in %.3f s: %.0f frames/s, %.1f MB/s (%u read while publishing)\n",
+               cFrames, seconds, cFrames / seconds, cFrames * static_cast<double>(cSensorBytes) / seconds / 1e6, nRead);
+        printf("  copied %u in %.3f s: %.0f frames/s, %.1f MB/s\n",
+               cFrames, copySeconds, cFrames / copySeconds, cFrames * static_cast<double>(cSensorBytes) / copySeconds / 1e6);
+
+        CHECK(0 == nTorn);
+        CHECK(cFrames == nLastFrame);
+        CHECK(nRead > 0);
+
+        // The sensor delivers 30 frames per second; the ring has to keep up by a wide margin
+        CHECK(cFrames / seconds > 30.0);
+        CHECK(cFrames / copySeconds > 30.0);
+    }
+
+#if !defined(_WIN32)
+    /// <summary>
+    /// A Create that fails after the object was created must not leave the name behind
+    /// </summary>
+    void TestFailedCreateUnlinks()
+    {
+        char szName[64];
+        MakeName("FailedCreate", szName, sizeof(szName));
+
+        // Too large to size or map, so Create fails after shm_open succeeded
+        SharedMemory memory;
+        CHECK(!memory.Create(szName, static_cast<size_t>(-1) / 2));
+        CHECK(NULL == memory.GetData());
+
+        char szPath[80];
+        snprintf(szPath, sizeof(szPath), "/%s", szName);
+
+        int fd = shm_open(szPath, O_RDONLY, 0);
+        CHECK(fd < 0);
+        if (fd >= 0)
+        {
+            close(fd);
+            shm_unlink(szPath);
+        }
+    }
+#endif
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestInPlaceFrame();
+    TestLifetime();
+    TestThroughput();
+#if !defined(_WIN32)
+    TestFailedCreateUnlinks();
+#endif
+
+    return TestCheck::TestResult();
+}
@@ -0,0 +1,55 @@
+//------------------------------------------------------------------------------
+// Minimal assertion helpers shared by the portable unit tests
+//------------------------------------------------------------------------------
+
+// Each test is a small executable registered with CTest. CHECK reports every
+// failing condition instead of stopping at the first, and the test's main
+// returns TestResult() so CTest sees a non-zero exit code on any failure.
+
+#pragma once
+
+#include <cstdio>
+
+namespace TestCheck
+{
+    /// <summary>
+    /// Number of failed checks in this executable
+    /// </summary>
+    inline int& FailureCount()
+    {
+        static int nFailures = 0;
+        return nFailures;
+    }
+
+    /// <summary>
+    /// Records a failed check
+    /// </summary>
+    inline void Fail(const char* szFile, int nLine, const char* szExpression)
+    {
+        fprintf(stderr, "%s(%d): check failed: %s\n", szFile, nLine, szExpression);
+        ++FailureCount();
+    }
+
+    /// <summary>
+    /// Exit code for main, prints a summary
+    /// </summary>
+    inline int TestResult()
+    {
+        if (FailureCount())
+        {
+            fprintf(stderr, "%d check(s) failed\n", FailureCount());
+            return 1;
+        }
+
+        return 0;
+    }
+}
+
+#define CHECK(expression) \
+    do \
+    { \
+        if (!(expression)) \
+        { \
+            TestCheck::Fail(__FILE__, __LINE__, #expression); \
+        } \
+    } while (0)
@@ -0,0 +1,755 @@
+﻿#include "ProjectorCalibration.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// すべてのキャリブレーションで一意な世代番号を払い出します。
+	std::atomic<uint32_t> s_nextGeneration(1);
+
+	const int MinCorrespondences = 6;
+	const int RefineParameterCount = 10;	// fx, fy, cx, cy, 回転ベクトル (3), 平行移動 (3)
+	const int MaxRefineIterations = 50;
+
+	// 対称行列の固有値分解 (巡回 Jacobi 法)。固有ベクトルは列に格納されます。
+	void JacobiEigen(double* a, double* vectors, double* values, int n)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			for (int j = 0; j < n; j++)
+			{
+				vectors[i * n + j] = (i == j) ? 1.0 : 0.0;
+			}
+		}
+
+		for (int sweep = 0; sweep < 100; sweep++)
+		{
+			double offDiagonal = 0.0;
+			for (int p = 0; p < n; p++)
+			{
+				for (int q = p + 1; q < n; q++)
+				{
+					offDiagonal += a[p * n + q] * a[p * n + q];
+				}
+			}
+
+			if (offDiagonal < 1e-30)
+			{
+				break;
+			}
+
+			for (int p = 0; p < n; p++)
+			{
+				for (int q = p + 1; q < n; q++)
+				{
+					double apq = a[p * n + q];
+					if (fabs(apq) < 1e-300)
+					{
+						continue;
+					}
+
+					double theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+					double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+					double c = 1.0 / sqrt(t * t + 1.0);
+					double s = t * c;
+
+					for (int k = 0; k < n; k++)
+					{
+						double akp = a[k * n + p];
+						double akq = a[k * n + q];
+						a[k * n + p] = c * akp - s * akq;
+						a[k * n + q] = s * akp + c * akq;
+					}
+
+					for (int k = 0; k < n; k++)
+					{
+						double apk = a[p * n + k];
+						double aqk = a[q * n + k];
+						a[p * n + k] = c * apk - s * aqk;
+						a[q * n + k] = s * apk + c * aqk;
+					}
+
+					for (int k = 0; k < n; k++)
+					{
+						double vkp = vectors[k * n + p];
+						double vkq = vectors[k * n + q];
+						vectors[k * n + p] = c * vkp - s * vkq;
+						vectors[k * n + q] = s * vkp + c * vkq;
+					}
+				}
+			}
+		}
+
+		for (int i = 0; i < n; i++)
+		{
+			values[i] = a[i * n + i];
+		}
+	}
+
+	// 対称正定値の連立方程式をコレスキー分解で解きます。
+	bool CholeskySolve(const double* a, const double* b, double* x, int n)
+	{
+		double l[RefineParameterCount * RefineParameterCount] = {};
+
+		for (int i = 0; i < n; i++)
+		{
+			for (int j = 0; j <= i; j++)
+			{
+				double sum = a[i * n + j];
+				for (int k = 0; k < j; k++)
+				{
+					sum -= l[i * n + k] * l[j * n + k];
+				}
+
+				if (i == j)
+				{
+					if (sum <= 0.0)
+					{
+						return false;
+					}
+					l[i * n + i] = sqrt(sum);
+				}
+				else
+				{
+					l[i * n + j] = sum / l[j * n + j];
+				}
+			}
+		}
+
+		double y[RefineParameterCount];
+		for (int i = 0; i < n; i++)
+		{
+			double sum = b[i];
+			for (int k = 0; k < i; k++)
+			{
+				sum -= l[i * n + k] * y[k];
+			}
+			y[i] = sum / l[i * n + i];
+		}
+
+		for (int i = n - 1; i >= 0; i--)
+		{
+			double sum = y[i];
+			for (int k = i + 1; k < n; k++)
+			{
+				sum -= l[k * n + i] * x[k];
+			}
+			x[i] = sum / l[i * n + i];
+		}
+
+		return true;
+	}
+
+	// 回転ベクトル (Rodrigues) から回転行列を生成します。
+	void RodriguesToMatrix(const double* r, double m[3][3])
+	{
+		double theta = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+		if (theta < 1e-12)
+		{
+			m[0][0] = 1.0;   m[0][1] = -r[2]; m[0][2] = r[1];
+			m[1][0] = r[2];  m[1][1] = 1.0;   m[1][2] = -r[0];
+			m[2][0] = -r[1]; m[2][1] = r[0];  m[2][2] = 1.0;
+			return;
+		}
+
+		double kx = r[0] / theta, ky = r[1] / theta, kz = r[2] / theta;
+		double c = cos(theta), s = sin(theta), v = 1.0 - c;
+
+		m[0][0] = c + kx * kx * v;		m[0][1] = kx * ky * v - kz * s;	m[0][2] = kx * kz * v + ky * s;
+		m[1][0] = ky * kx * v + kz * s;	m[1][1] = c + ky * ky * v;		m[1][2] = ky * kz * v - kx * s;
+		m[2][0] = kz * kx * v - ky * s;	m[2][1] = kz * ky * v + kx * s;	m[2][2] = c + kz * kz * v;
+	}
+
+	// 回転行列から回転ベクトル (Rodrigues) を求めます。
+	void MatrixToRodrigues(const double m[3][3], double* r)
+	{
+		double cosTheta = (m[0][0] + m[1][1] + m[2][2] - 1.0) * 0.5;
+		cosTheta = cosTheta > 1.0 ? 1.0 : (cosTheta < -1.0 ? -1.0 : cosTheta);
+		double theta = acos(cosTheta);
+
+		double rx = m[2][1] - m[1][2];
+		double ry = m[0][2] - m[2][0];
+		double rz = m[1][0] - m[0][1];
+		double sinTheta = sin(theta);
+
+		if (sinTheta > 1e-6)
+		{
+			double scale = theta / (2.0 * sinTheta);
+			r[0] = rx * scale;
+			r[1] = ry * scale;
+			r[2] = rz * scale;
+		}
+		else if (cosTheta > 0.0)
+		{
+			r[0] = rx * 0.5;
+			r[1] = ry * 0.5;
+			r[2] = rz * 0.5;
+		}
+		else
+		{
+			// theta が π 付近では対角成分から回転軸を復元します。
+			double kx = sqrt((m[0][0] + 1.0) * 0.5);
+			double ky = sqrt((m[1][1] + 1.0) * 0.5);
+			double kz = sqrt((m[2][2] + 1.0) * 0.5);
+			if (m[0][1] < 0.0) ky = -ky;
+			if (m[0][2] < 0.0) kz = -kz;
+			r[0] = kx * theta;
+			r[1] = ky * theta;
+			r[2] = kz * theta;
+		}
+	}
+
+	// パラメーター ベクトルから 1 点の再投影を計算します。
+	bool ProjectWithParameters(const double* p, const double rotation[3][3], const CalibrationCorrespondence& c, double* u, double* v)
+	{
+		double x = rotation[0][0] * c.x + rotation[0][1] * c.y + rotation[0][2] * c.z + p[7];
+		double y = rotation[1][0] * c.x + rotation[1][1] * c.y + rotation[1][2] * c.z + p[8];
+		double z = rotation[2][0] * c.x + rotation[2][1] * c.y + rotation[2][2] * c.z + p[9];
+
+		if (z <= 1e-9)
+		{
+			return false;
+		}
+
+		*u = p[0] * x / z + p[2];
+		*v = p[1] * y / z + p[3];
+		return true;
+	}
+
+	double SumSquaredResiduals(const double* p, const std::vector<CalibrationCorrespondence>& correspondences)
+	{
+		double rotation[3][3];
+		RodriguesToMatrix(p + 4, rotation);
+
+		double sum = 0.0;
+		for (size_t i = 0; i < correspondences.size(); i++)
+		{
+			double u, v;
+			if (!ProjectWithParameters(p, rotation, correspondences[i], &u, &v))
+			{
+				return HUGE_VAL;
+			}
+
+			double du = u - correspondences[i].u;
+			double dv = v - correspondences[i].v;
+			sum += du * du + dv * dv;
+		}
+		return sum;
+	}
+}
+
+ProjectorCalibration::ProjectorCalibration() :
+	m_reprojectionError(0.0),
+	m_generation(0),
+	m_valid(false)
+{
+	memset(&m_intrinsics, 0, sizeof(m_intrinsics));
+	memset(&m_extrinsics, 0, sizeof(m_extrinsics));
+}
+
+void ProjectorCalibration::UpdateGeneration()
+{
+	m_generation = s_nextGeneration.fetch_add(1);
+}
+
+void ProjectorCalibration::Set(const ProjectorIntrinsics& intrinsics, const ProjectorExtrinsics& extrinsics)
+{
+	m_intrinsics = intrinsics;
+	m_extrinsics = extrinsics;
+	m_reprojectionError = 0.0;
+	m_valid = true;
+	UpdateGeneration();
+}
+
+bool ProjectorCalibration::Solve(const std::vector<CalibrationCorrespondence>& correspondences, uint32_t projectorWidth, uint32_t projectorHeight)
+{
+	const size_t count = correspondences.size();
+	if (count < MinCorrespondences)
+	{
+		return false;
+	}
+
+	// 数値安定性のため、3D 点と 2D 点をそれぞれ正規化します (Hartley 正規化)。
+	double mean3[3] = {}, mean2[2] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		mean3[0] += correspondences[i].x;
+		mean3[1] += correspondences[i].y;
+		mean3[2] += correspondences[i].z;
+		mean2[0] += correspondences[i].u;
+		mean2[1] += correspondences[i].v;
+	}
+	for (int k = 0; k < 3; k++) mean3[k] /= count;
+	for (int k = 0; k < 2; k++) mean2[k] /= count;
+
+	double spread3 = 0.0, spread2 = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		const CalibrationCorrespondence& c = correspondences[i];
+		spread3 += sqrt((c.x - mean3[0]) * (c.x - mean3[0]) + (c.y - mean3[1]) * (c.y - mean3[1]) + (c.z - mean3[2]) * (c.z - mean3[2]));
+		spread2 += sqrt((c.u - mean2[0]) * (c.u - mean2[0]) + (c.v - mean2[1]) * (c.v - mean2[1]));
+	}
+
+	if (spread3 <= 0.0 || spread2 <= 0.0)
+	{
+		return false;
+	}
+
+	double scale3 = sqrt(3.0) * count / spread3;
+	double scale2 = sqrt(2.0) * count / spread2;
+
+	// DLT: A^T A (12x12) を直接累積し、最小固有値の固有ベクトルを射影行列とします。
+	double ata[144] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		const CalibrationCorrespondence& c = correspondences[i];
+		double X[4] = { (c.x - mean3[0]) * scale3, (c.y - mean3[1]) * scale3, (c.z - mean3[2]) * scale3, 1.0 };
+		double u = (c.u - mean2[0]) * scale2;
+		double v = (c.v - mean2[1]) * scale2;
+
+		double row0[12] = { X[0], X[1], X[2], X[3], 0, 0, 0, 0, -u * X[0], -u * X[1], -u * X[2], -u * X[3] };
+		double row1[12] = { 0, 0, 0, 0, X[0], X[1], X[2], X[3], -v * X[0], -v * X[1], -v * X[2], -v * X[3] };
+
+		for (int r = 0; r < 12; r++)
+		{
+			for (int k = 0; k < 12; k++)
+			{
+				ata[r * 12 + k] += row0[r] * row0[k] + row1[r] * row1[k];
+			}
+		}
+	}
+
+	double vectors[144], values[12];
+	JacobiEigen(ata, vectors, values, 12);
+
+	int smallest = 0;
+	for (int k = 1; k < 12; k++)
+	{
+		if (values[k] < values[smallest])
+		{
+			smallest = k;
+		}
+	}
+
+	double pn[3][4];
+	for (int r = 0; r < 3; r++)
+	{
+		for (int k = 0; k < 4; k++)
+		{
+			pn[r][k] = vectors[(r * 4 + k) * 12 + smallest];
+		}
+	}
+
+	// 正規化を戻します: P = T2^-1 * Pn * T3
+	double t3[4][4] = {
+		{ scale3, 0, 0, -scale3 * mean3[0] },
+		{ 0, scale3, 0, -scale3 * mean3[1] },
+		{ 0, 0, scale3, -scale3 * mean3[2] },
+		{ 0, 0, 0, 1 },
+	};
+	double t2inv[3][3] = {
+		{ 1.0 / scale2, 0, mean2[0] },
+		{ 0, 1.0 / scale2, mean2[1] },
+		{ 0, 0, 1 },
+	};
+
+	double pt[3][4] = {};
+	for (int r = 0; r < 3; r++)
+		for (int k = 0; k < 4; k++)
+			for (int j = 0; j < 4; j++)
+				pt[r][k] += pn[r][j] * t3[j][k];
+
+	double P[3][4] = {};
+	for (int r = 0; r < 3; r++)
+		for (int k = 0; k < 4; k++)
+			for (int j = 0; j < 3; j++)
+				P[r][k] += t2inv[r][j] * pt[j][k];
+
+	// 点群がプロジェクターの前方 (w > 0) に来るよう符号を合わせます。
+	double w = P[2][0] * mean3[0] + P[2][1] * mean3[1] + P[2][2] * mean3[2] + P[2][3];
+	if (w < 0.0)
+	{
+		for (int r = 0; r < 3; r++)
+			for (int k = 0; k < 4; k++)
+				P[r][k] = -P[r][k];
+	}
+
+	// RQ 分解: P[:, 0:3] = K * R (グラム・シュミットを 3 行目から順に適用します)。
+	double R[3][3], K[3][3] = {};
+	double* m1 = P[0];
+	double* m2 = P[1];
+	double* m3 = P[2];
+
+	K[2][2] = sqrt(m3[0] * m3[0] + m3[1] * m3[1] + m3[2] * m3[2]);
+	if (K[2][2] <= 0.0)
+	{
+		return false;
+	}
+	for (int k = 0; k < 3; k++) R[2][k] = m3[k] / K[2][2];
+
+	K[1][2] = m2[0] * R[2][0] + m2[1] * R[2][1] + m2[2] * R[2][2];
+	double r2[3] = { m2[0] - K[1][2] * R[2][0], m2[1] - K[1][2] * R[2][1], m2[2] - K[1][2] * R[2][2] };
+	K[1][1] = sqrt(r2[0] * r2[0] + r2[1] * r2[1] + r2[2] * r2[2]);
+	if (K[1][1] <= 0.0)
+	{
+		return false;
+	}
+	for (int k = 0; k < 3; k++) R[1][k] = r2[k] / K[1][1];
+
+	K[0][2] = m1[0] * R[2][0] + m1[1] * R[2][1] + m1[2] * R[2][2];
+	K[0][1] = m1[0] * R[1][0] + m1[1] * R[1][1] + m1[2] * R[1][2];
+	double r1[3];
+	for (int k = 0; k < 3; k++) r1[k] = m1[k] - K[0][2] * R[2][k] - K[0][1] * R[1][k];
+	K[0][0] = sqrt(r1[0] * r1[0] + r1[1] * r1[1] + r1[2] * r1[2]);
+	if (K[0][0] <= 0.0)
+	{
+		return false;
+	}
+	for (int k = 0; k < 3; k++) R[0][k] = r1[k] / K[0][0];
+
+	// 鏡像の光学系 (リア プロジェクションなど) では det(R) = -1 になるため、fy の符号で吸収します。
+	double det = R[0][0] * (R[1][1] * R[2][2] - R[1][2] * R[2][1])
+		- R[0][1] * (R[1][0] * R[2][2] - R[1][2] * R[2][0])
+		+ R[0][2] * (R[1][0] * R[2][1] - R[1][1] * R[2][0]);
+	if (det < 0.0)
+	{
+		for (int k = 0; k < 3; k++) R[1][k] = -R[1][k];
+		K[1][1] = -K[1][1];
+		K[0][1] = -K[0][1];
+	}
+
+	// t = K^-1 * p4 (K は上三角なので後退代入で解きます)。
+	double t[3];
+	t[2] = P[2][3] / K[2][2];
+	t[1] = (P[1][3] - K[1][2] * t[2]) / K[1][1];
+	t[0] = (P[0][3] - K[0][1] * t[1] - K[0][2] * t[2]) / K[0][0];
+
+	m_intrinsics.fx = K[0][0] / K[2][2];
+	m_intrinsics.fy = K[1][1] / K[2][2];
+	m_intrinsics.cx = K[0][2] / K[2][2];
+	m_intrinsics.cy = K[1][2] / K[2][2];
+	m_intrinsics.skew = 0.0;	// 非線形最適化ではスキューを 0 に固定します。
+	m_intrinsics.width = projectorWidth;
+	m_intrinsics.height = projectorHeight;
+
+	memcpy(m_extrinsics.rotation, R, sizeof(R));
+	memcpy(m_extrinsics.translation, t, sizeof(t));
+
+	Refine(correspondences);
+
+	m_valid = true;
+	UpdateGeneration();
+	return true;
+}
+
+// Levenberg-Marquardt 法で再投影誤差の二乗和を最小化します。ヤコビアンは数値微分で求めます。
+void ProjectorCalibration::Refine(const std::vector<CalibrationCorrespondence>& correspondences)
+{
+	const int n = RefineParameterCount;
+	const size_t count = correspondences.size();
+
+	double p[RefineParameterCount];
+	p[0] = m_intrinsics.fx;
+	p[1] = m_intrinsics.fy;
+	p[2] = m_intrinsics.cx;
+	p[3] = m_intrinsics.cy;
+	MatrixToRodrigues(m_extrinsics.rotation, p + 4);
+	p[7] = m_extrinsics.translation[0];
+	p[8] = m_extrinsics.translation[1];
+	p[9] = m_extrinsics.translation[2];
+
+	double error = SumSquaredResiduals(p, correspondences);
+	double lambda = 1e-3;
+
+	std::vector<double> jacobian(count * 2 * n);
+	std::vector<double> residuals(count * 2);
+
+	for (int iteration = 0; iteration < MaxRefineIterations && error < HUGE_VAL; iteration++)
+	{
+		double rotation[3][3];
+		RodriguesToMatrix(p + 4, rotation);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			double u, v;
+			ProjectWithParameters(p, rotation, correspondences[i], &u, &v);
+			residuals[i * 2 + 0] = u - correspondences[i].u;
+			residuals[i * 2 + 1] = v - correspondences[i].v;
+		}
+
+		for (int k = 0; k < n; k++)
+		{
+			double step = 1e-6 * (fabs(p[k]) > 1.0 ? fabs(p[k]) : 1.0);
+			double saved = p[k];
+			p[k] = saved + step;
+
+			double stepped[3][3];
+			RodriguesToMatrix(p + 4, stepped);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				double u = 0.0, v = 0.0;
+				ProjectWithParameters(p, stepped, correspondences[i], &u, &v);
+				jacobian[(i * 2 + 0) * n + k] = (u - correspondences[i].u - residuals[i * 2 + 0]) / step;
+				jacobian[(i * 2 + 1) * n + k] = (v - correspondences[i].v - residuals[i * 2 + 1]) / step;
+			}
+
+			p[k] = saved;
+		}
+
+		double jtj[RefineParameterCount * RefineParameterCount] = {};
+		double jtr[RefineParameterCount] = {};
+		for (size_t row = 0; row < count * 2; row++)
+		{
+			const double* jr = &jacobian[row * n];
+			for (int a = 0; a < n; a++)
+			{
+				jtr[a] -= jr[a] * residuals[row];
+				for (int b = 0; b <= a; b++)
+				{
+					jtj[a * n + b] += jr[a] * jr[b];
+				}
+			}
+		}
+		for (int a = 0; a < n; a++)
+		{
+			for (int b = a + 1; b < n; b++)
+			{
+				jtj[a * n + b] = jtj[b * n + a];
+			}
+		}
+
+		// 減衰係数を調整しながら誤差が減少するステップを探します。
+		bool improved = false;
+		for (int attempt = 0; attempt < 10 && !improved; attempt++)
+		{
+			double damped[RefineParameterCount * RefineParameterCount];
+			memcpy(damped, jtj, sizeof(damped));
+			for (int a = 0; a < n; a++)
+			{
+				damped[a * n + a] += lambda * (jtj[a * n + a] > 1e-12 ? jtj[a * n + a] : 1e-12);
+			}
+
+			double delta[RefineParameterCount];
+			if (CholeskySolve(damped, jtr, delta, n))
+			{
+				double candidate[RefineParameterCount];
+				for (int a = 0; a < n; a++)
+				{
+					candidate[a] = p[a] + delta[a];
+				}
+
+				double candidateError = SumSquaredResiduals(candidate, correspondences);
+				if (candidateError < error)
+				{
+					bool converged = (error - candidateError) < 1e-12 * error;
+					memcpy(p, candidate, sizeof(p));
+					error = candidateError;
+					lambda = (lambda * 0.1 > 1e-12) ? lambda * 0.1 : 1e-12;
+					improved = true;
+
+					if (converged)
+					{
+						iteration = MaxRefineIterations;
+					}
+				}
+			}
+
+			if (!improved)
+			{
+				lambda *= 10.0;
+			}
+		}
+
+		if (!improved)
+		{
+			break;
+		}
+	}
+
+	m_intrinsics.fx = p[0];
+	m_intrinsics.fy = p[1];
+	m_intrinsics.cx = p[2];
+	m_intrinsics.cy = p[3];
+	RodriguesToMatrix(p + 4, m_extrinsics.rotation);
+	m_extrinsics.translation[0] = p[7];
+	m_extrinsics.translation[1] = p[8];
+	m_extrinsics.translation[2] = p[9];
+
+	m_reprojectionError = (error < HUGE_VAL) ? sqrt(error / count) : error;
+}
+
+bool ProjectorCalibration::Project(double x, double y, double z, double* u, double* v) const
+{
+	const double (*R)[3] = m_extrinsics.rotation;
+	const double* t = m_extrinsics.translation;
+
+	double px = R[0][0] * x + R[0][1] * y + R[0][2] * z + t[0];
+	double py = R[1][0] * x + R[1][1] * y + R[1][2] * z + t[1];
+	double pz = R[2][0] * x + R[2][1] * y + R[2][2] * z + t[2];
+
+	if (pz <= 0.0)
+	{
+		return false;
+	}
+
+	*u = m_intrinsics.fx * px / pz + m_intrinsics.skew * py / pz + m_intrinsics.cx;
+	*v = m_intrinsics.fy * py / pz + m_intrinsics.cy;
+	return true;
+}
+
+// プロジェクター カメラ空間 (x 右, y 下, z 前方) を、ビュー空間 (x 右, y 上, -z 前方) に変換します。
+Float4x4 ProjectorCalibration::GetViewMatrix() const
+{
+	const double (*R)[3] = m_extrinsics.rotation;
+	const double* t = m_extrinsics.translation;
+	static const double flip[3] = { 1.0, -1.0, -1.0 };
+
+	Float4x4 view = {};
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 3; column++)
+		{
+			// 行ベクトル規約なので (F * R) の転置を格納します。
+			view.m[row][column] = static_cast<float>(flip[column] * R[column][row]);
+		}
+	}
+
+	for (int column = 0; column < 3; column++)
+	{
+		view.m[3][column] = static_cast<float>(flip[column] * t[column]);
+	}
+	view.m[3][3] = 1.0f;
+
+	return view;
+}
+
+// 内部パラメーターから、画素座標が一致するプロジェクション行列 (深度範囲 0..1) を生成します。
+Float4x4 ProjectorCalibration::GetProjectionMatrix(float nearZ, float farZ) const
+{
+	const double w = static_cast<double>(m_intrinsics.width);
+	const double h = static_cast<double>(m_intrinsics.height);
+
+	Float4x4 projection = {};
+	projection.m[0][0] = static_cast<float>(2.0 * m_intrinsics.fx / w);
+	projection.m[1][0] = static_cast<float>(-2.0 * m_intrinsics.skew / w);
+	projection.m[2][0] = static_cast<float>(1.0 - 2.0 * m_intrinsics.cx / w);
+	projection.m[1][1] = static_cast<float>(2.0 * m_intrinsics.fy / h);
+	projection.m[2][1] = static_cast<float>(2.0 * m_intrinsics.cy / h - 1.0);
+	projection.m[2][2] = farZ / (nearZ - farZ);
+	projection.m[3][2] = nearZ * farZ / (nearZ - farZ);
+	projection.m[2][3] = -1.0f;
+
+	return projection;
+}
+
+DepthToProjectorMap::DepthToProjectorMap() :
+	m_width(0),
+	m_height(0),
+	m_generation(0),
+	m_raysChanged(false)
+{
+	m_offset[0] = m_offset[1] = m_offset[2] = 0.0f;
+}
+
+void DepthToProjectorMap::SetDepthRays(const float* raysXY, uint32_t width, uint32_t height)
+{
+	m_rays.assign(raysXY, raysXY + static_cast<size_t>(width) * height * 2);
+	m_width = width;
+	m_height = height;
+	m_raysChanged = true;
+}
+
+void DepthToProjectorMap::SetDepthIntrinsics(float fx, float fy, float cx, float cy, uint32_t width, uint32_t height)
+{
+	m_rays.resize(static_cast<size_t>(width) * height * 2);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			size_t i = (static_cast<size_t>(y) * width + x) * 2;
+			m_rays[i + 0] = (x - cx) / fx;
+			m_rays[i + 1] = (cy - y) / fy;	// カメラ空間は y 上向きです。
+		}
+	}
+	m_width = width;
+	m_height = height;
+	m_raysChanged = true;
+}
+
+bool DepthToProjectorMap::Update(const ProjectorCalibration& calibration)
+{
+	if (!calibration.IsValid() || m_rays.empty())
+	{
+		return false;
+	}
+
+	if (!m_raysChanged && calibration.GetGeneration() == m_generation)
+	{
+		return false;
+	}
+
+	// P = K [R | t] の左 3x3 と 4 列目。深度はミリメートルで与えられるので 0.001 を畳み込みます。
+	const ProjectorIntrinsics& k = calibration.GetIntrinsics();
+	const ProjectorExtrinsics& e = calibration.GetExtrinsics();
+	double P[3][4];
+	for (int c = 0; c < 3; c++)
+	{
+		P[0][c] = k.fx * e.rotation[0][c] + k.skew * e.rotation[1][c] + k.cx * e.rotation[2][c];
+		P[1][c] = k.fy * e.rotation[1][c] + k.cy * e.rotation[2][c];
+		P[2][c] = e.rotation[2][c];
+	}
+	P[0][3] = k.fx * e.translation[0] + k.skew * e.translation[1] + k.cx * e.translation[2];
+	P[1][3] = k.fy * e.translation[1] + k.cy * e.translation[2];
+	P[2][3] = e.translation[2];
+
+	m_offset[0] = static_cast<float>(P[0][3]);
+	m_offset[1] = static_cast<float>(P[1][3]);
+	m_offset[2] = static_cast<float>(P[2][3]);
+
+	const size_t count = static_cast<size_t>(m_width) * m_height;
+	m_table.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		double rx = m_rays[i * 2 + 0] * 0.001;
+		double ry = m_rays[i * 2 + 1] * 0.001;
+		double rz = 0.001;
+
+		Entry& entry = m_table[i];
+		entry.ax = static_cast<float>(P[0][0] * rx + P[0][1] * ry + P[0][2] * rz);
+		entry.ay = static_cast<float>(P[1][0] * rx + P[1][1] * ry + P[1][2] * rz);
+		entry.az = static_cast<float>(P[2][0] * rx + P[2][1] * ry + P[2][2] * rz);
+		entry.pad = 0.0f;
+	}
+
+	m_generation = calibration.GetGeneration();
+	m_raysChanged = false;
+	return true;
+}
+
+void DepthToProjectorMap::MapDepthFrame(const uint16_t* depth, float* uv) const
+{
+	const size_t count = m_table.size();
+	const Entry* table = m_table.data();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		float d = static_cast<float>(depth[i]);
+		float w = d * table[i].az + m_offset[2];
+
+		if (depth[i] == 0 || w <= 0.0f)
+		{
+			uv[i * 2 + 0] = -1.0f;
+			uv[i * 2 + 1] = -1.0f;
+			continue;
+		}
+
+		float invW = 1.0f / w;
+		uv[i * 2 + 0] = (d * table[i].ax + m_offset[0]) * invW;
+		uv[i * 2 + 1] = (d * table[i].ay + m_offset[1]) * invW;
+	}
+}
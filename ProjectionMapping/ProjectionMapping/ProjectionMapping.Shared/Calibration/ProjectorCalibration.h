@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../Math/VectorMath.h"
+
+namespace ProjectionMapping
+{
+	// 深度カメラ空間の 3D 点と、それが投影されたプロジェクター画素の対応点。
+	struct CalibrationCorrespondence
+	{
+		double x, y, z;	// 深度カメラ空間の座標 (メートル)。
+		double u, v;	// プロジェクター画像の画素座標。
+	};
+
+	// プロジェクターの内部パラメーター (ピンホール モデル)。
+	struct ProjectorIntrinsics
+	{
+		double fx, fy;
+		double cx, cy;
+		double skew;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	// 深度カメラ空間からプロジェクター カメラ空間への剛体変換 (Xp = R * Xd + t)。
+	struct ProjectorExtrinsics
+	{
+		double rotation[3][3];
+		double translation[3];
+	};
+
+	// 対応点からプロジェクターの内部/外部パラメーターを推定し、描画用の行列を生成します。
+	class ProjectorCalibration
+	{
+	public:
+		ProjectorCalibration();
+
+		// DLT で初期解を求め、Levenberg-Marquardt 法で再投影誤差を最小化します。
+		// 6 点以上の一般位置にある対応点が必要です。
+		bool Solve(const std::vector<CalibrationCorrespondence>& correspondences, uint32_t projectorWidth, uint32_t projectorHeight);
+
+		// 既知のパラメーターを直接設定します (保存済みのキャリブレーションの読み込みなど)。
+		void Set(const ProjectorIntrinsics& intrinsics, const ProjectorExtrinsics& extrinsics);
+
+		bool IsValid() const										{ return m_valid; }
+		const ProjectorIntrinsics& GetIntrinsics() const			{ return m_intrinsics; }
+		const ProjectorExtrinsics& GetExtrinsics() const			{ return m_extrinsics; }
+
+		// キャリブレーションが変わるたびに変化する値。キャッシュの無効化に使用します。
+		uint32_t GetGeneration() const								{ return m_generation; }
+
+		// 直近の Solve での再投影誤差の RMS (画素)。
+		double GetReprojectionError() const							{ return m_reprojectionError; }
+
+		// 深度カメラ空間の点をプロジェクター画素に投影します。プロジェクターの背後の点では false を返します。
+		bool Project(double x, double y, double z, double* u, double* v) const;
+
+		// 右手座標系のビュー行列とプロジェクション行列 (XMMatrixLookAtRH / XMMatrixPerspectiveFovRH と同じ規約)。
+		Float4x4 GetViewMatrix() const;
+		Float4x4 GetProjectionMatrix(float nearZ, float farZ) const;
+
+	private:
+		void Refine(const std::vector<CalibrationCorrespondence>& correspondences);
+		void UpdateGeneration();
+
+		ProjectorIntrinsics	m_intrinsics;
+		ProjectorExtrinsics	m_extrinsics;
+		double				m_reprojectionError;
+		uint32_t			m_generation;
+		bool				m_valid;
+	};
+
+	// 深度画素からプロジェクター画素への対応表。
+	// 画素ごとの光線とキャリブレーションから事前計算し、キャリブレーションが変わるまで再利用します。
+	class DepthToProjectorMap
+	{
+	public:
+		DepthToProjectorMap();
+
+		// 画素ごとの Z = 1 のカメラ空間光線 (x, y の組)。
+		// ICoordinateMapper::GetDepthFrameToCameraSpaceTable が返す表をそのまま渡せます。
+		void SetDepthRays(const float* raysXY, uint32_t width, uint32_t height);
+
+		// レンズ歪みを無視したピンホール モデルから光線を生成します。
+		void SetDepthIntrinsics(float fx, float fy, float cx, float cy, uint32_t width, uint32_t height);
+
+		// キャリブレーションが変わった場合のみ表を再計算します。再計算した場合は true を返します。
+		bool Update(const ProjectorCalibration& calibration);
+
+		// 深度フレーム (ミリメートル) をプロジェクター画素座標 (u, v の組) に変換します。
+		// 無効な深度の画素には (-1, -1) を書き込みます。
+		void MapDepthFrame(const uint16_t* depth, float* uv) const;
+
+		uint32_t GetWidth() const									{ return m_width; }
+		uint32_t GetHeight() const									{ return m_height; }
+		bool IsReady() const										{ return !m_table.empty(); }
+
+	private:
+		// 画素ごとに (d * a.x + b.x) / (d * a.z + b.z) の a を保持します (d はミリメートル)。
+		struct Entry
+		{
+			float ax, ay, az, pad;
+		};
+
+		std::vector<float>	m_rays;
+		std::vector<Entry>	m_table;
+		float				m_offset[3];
+		uint32_t			m_width;
+		uint32_t			m_height;
+		uint32_t			m_generation;
+		bool				m_raysChanged;
+	};
+}
@@ -57,6 +57,9 @@ DX::DeviceResources::DeviceResources() :
 	m_nativeOrientation(DisplayOrientations::None),
 	m_currentOrientation(DisplayOrientations::None),
 	m_dpi(-1.0f),
+	m_frameStatistics(),
+	m_lastPresentCount(0),
+	m_hasFrameStatistics(false),
 	m_deviceNotify(nullptr)
 {
 	CreateDeviceIndependentResources();
@@ -538,6 +541,10 @@ void DX::DeviceResources::HandleDeviceLost()
 {
 	m_swapChain = nullptr;
 
+	// 新しいスワップ チェーンでは Present の回数が 0 からやり直しになります。
+	m_hasFrameStatistics = false;
+	m_lastPresentCount = 0;
+
 	if (m_deviceNotify != nullptr)
 	{
 		m_deviceNotify->OnDeviceLost();
@@ -594,7 +601,22 @@ void DX::DeviceResources::Present()
 	else
 	{
 		DX::ThrowIfFailed(hr);
+
+		// 遅延の測定に使用する表示の統計を取得します。統計がまだない場合や取得できない場合は失敗します。
+		m_hasFrameStatistics = SUCCEEDED(m_swapChain->GetFrameStatistics(&m_frameStatistics));
+		m_swapChain->GetLastPresentCount(&m_lastPresentCount);
+	}
+}
+
+bool DX::DeviceResources::GetFrameStatistics(DXGI_FRAME_STATISTICS* statistics) const
+{
+	if (!m_hasFrameStatistics)
+	{
+		return false;
 	}
+
+	*statistics = m_frameStatistics;
+	return true;
 }
 
 // このメソッドは、表示デバイスのネイティブの方向と、次のものとの間での回転を決定します:
@@ -47,6 +47,10 @@ namespace DX
 		IWICImagingFactory2*	GetWicImagingFactory() const			{ return m_wicFactory.Get(); }
 		D2D1::Matrix3x2F		GetOrientationTransform2D() const		{ return m_orientationTransform2D; }
 
+		// 表示のタイミング。直近の Present の後に取得した値です。
+		UINT					GetLastPresentCount() const				{ return m_lastPresentCount; }
+		bool					GetFrameStatistics(DXGI_FRAME_STATISTICS* statistics) const;
+
 	private:
 		void CreateDeviceIndependentResources();
 		void CreateDeviceResources();
@@ -89,6 +93,11 @@ namespace DX
 		D2D1::Matrix3x2F	m_orientationTransform2D;
 		DirectX::XMFLOAT4X4	m_orientationTransform3D;
 
+		// 直近の Present の表示の統計。
+		DXGI_FRAME_STATISTICS	m_frameStatistics;
+		UINT					m_lastPresentCount;
+		bool					m_hasFrameStatistics;
+
 		// IDeviceNotify は DeviceResources を所有しているため、直接保持することもできます。
 		IDeviceNotify* m_deviceNotify;
 	};
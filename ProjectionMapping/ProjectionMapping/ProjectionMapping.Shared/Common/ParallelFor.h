@@ -0,0 +1,214 @@
+﻿#pragma once
+
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#include <ppl.h>
+#else
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+namespace DX
+{
+#if defined(_MSC_VER)
+	// [begin, end) の各インデックスで body を並列に呼び出します。PPL のスケジューラーを使用します。
+	template<typename TBody>
+	inline void ParallelFor(size_t begin, size_t end, const TBody& body)
+	{
+		if (end <= begin)
+		{
+			return;
+		}
+
+		if (end - begin == 1)
+		{
+			body(begin);
+			return;
+		}
+
+		Concurrency::parallel_for(begin, end, [&body](size_t index) { body(index); });
+	}
+
+	inline unsigned int GetWorkerCount()
+	{
+		return Concurrency::GetProcessorCount();
+	}
+#else
+	namespace Detail
+	{
+		// PPL がない環境向けの常駐ワーカー スレッド。フレームごとのスレッド生成を避けます。
+		class WorkerPool
+		{
+		public:
+			// threadCount 本のワーカー スレッドを起動します。呼び出し元のスレッドも処理に加わります。
+			explicit WorkerPool(unsigned int threadCount) :
+				m_body(nullptr),
+				m_next(0),
+				m_end(0),
+				m_active(0),
+				m_generation(0),
+				m_exit(false)
+			{
+				for (unsigned int i = 0; i < threadCount; i++)
+				{
+					m_threads.push_back(std::thread([this]() { WorkerMain(); }));
+				}
+			}
+
+			~WorkerPool()
+			{
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_exit = true;
+				}
+				m_wake.notify_all();
+				for (size_t i = 0; i < m_threads.size(); i++)
+				{
+					m_threads[i].join();
+				}
+			}
+
+			// プロセッサの数のスレッド (呼び出し元を含む) で実行する共有のプール。
+			static WorkerPool& Get()
+			{
+				static WorkerPool pool(GetDefaultThreadCount());
+				return pool;
+			}
+
+			unsigned int GetWorkerCount() const { return static_cast<unsigned int>(m_threads.size()) + 1; }
+
+			void Run(size_t begin, size_t end, const std::function<void(size_t)>& body)
+			{
+				// body の中から呼ばれた場合は入れ子の並列化を行わずに実行します。
+				// 外側の Run が m_runMutex を保持しているので、もう一度ロックすると止まります。
+				if (IsWorkerThread() || m_threads.empty())
+				{
+					for (size_t i = begin; i < end; i++)
+					{
+						body(i);
+					}
+					return;
+				}
+
+				std::lock_guard<std::mutex> runLock(m_runMutex);
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_body = &body;
+					m_next.store(begin);
+					m_end = end;
+					m_active = static_cast<unsigned int>(m_threads.size());
+					m_generation++;
+				}
+				m_wake.notify_all();
+
+				// 呼び出し元のスレッドも body を実行する間はワーカーとして扱います。
+				IsWorkerThread() = true;
+				Drain();
+				IsWorkerThread() = false;
+
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_done.wait(lock, [this]() { return m_active == 0; });
+				m_body = nullptr;
+			}
+
+		private:
+			WorkerPool(const WorkerPool&);
+			WorkerPool& operator=(const WorkerPool&);
+
+			static unsigned int GetDefaultThreadCount()
+			{
+				const unsigned int count = std::thread::hardware_concurrency();
+				return count > 1 ? count - 1 : 0;
+			}
+
+			// ワーカー スレッドと、Run の中で body を実行している呼び出し元のスレッドで true です。
+			static bool& IsWorkerThread()
+			{
+				static thread_local bool isWorker = false;
+				return isWorker;
+			}
+
+			void Drain()
+			{
+				for (;;)
+				{
+					size_t index = m_next.fetch_add(1);
+					if (index >= m_end)
+					{
+						break;
+					}
+					(*m_body)(index);
+				}
+			}
+
+			void WorkerMain()
+			{
+				IsWorkerThread() = true;
+				unsigned long long seen = 0;
+
+				for (;;)
+				{
+					{
+						std::unique_lock<std::mutex> lock(m_mutex);
+						m_wake.wait(lock, [&]() { return m_exit || m_generation != seen; });
+						if (m_exit)
+						{
+							return;
+						}
+						seen = m_generation;
+					}
+
+					Drain();
+
+					std::lock_guard<std::mutex> lock(m_mutex);
+					if (--m_active == 0)
+					{
+						m_done.notify_one();
+					}
+				}
+			}
+
+			std::vector<std::thread>				m_threads;
+			std::mutex								m_runMutex;
+			std::mutex								m_mutex;
+			std::condition_variable					m_wake;
+			std::condition_variable					m_done;
+			const std::function<void(size_t)>*		m_body;
+			std::atomic<size_t>						m_next;
+			size_t									m_end;
+			unsigned int							m_active;
+			unsigned long long						m_generation;
+			bool									m_exit;
+		};
+	}
+
+	// [begin, end) の各インデックスで body を並列に呼び出します。常駐ワーカー スレッドを使用します。
+	template<typename TBody>
+	inline void ParallelFor(size_t begin, size_t end, const TBody& body)
+	{
+		if (end <= begin)
+		{
+			return;
+		}
+
+		if (end - begin == 1)
+		{
+			body(begin);
+			return;
+		}
+
+		std::function<void(size_t)> function = [&body](size_t index) { body(index); };
+		Detail::WorkerPool::Get().Run(begin, end, function);
+	}
+
+	inline unsigned int GetWorkerCount()
+	{
+		return Detail::WorkerPool::Get().GetWorkerCount();
+	}
+#endif
+}
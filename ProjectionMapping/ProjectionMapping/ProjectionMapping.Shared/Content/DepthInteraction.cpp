@@ -0,0 +1,104 @@
+﻿#include "pch.h"
+#include "DepthInteraction.h"
+
+using namespace ProjectionMapping;
+
+DepthInteraction::DepthInteraction(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources),
+	m_pendingWidth(0),
+	m_pendingHeight(0),
+	m_pendingTime(0.0),
+	m_pendingFrame(false),
+	m_resetBackground(false),
+	m_width(0)
+{
+}
+
+// フレームをコピーするだけにして、センサーのスレッドをすぐに返します。
+void DepthInteraction::SubmitDepthFrame(const uint16_t* depth, uint32_t width, uint32_t height, double captureTime)
+{
+	std::lock_guard<std::mutex> lock(m_pendingMutex);
+	m_pendingDepth.assign(depth, depth + static_cast<size_t>(width) * height);
+	m_pendingWidth = width;
+	m_pendingHeight = height;
+	m_pendingTime = captureTime;
+	m_pendingFrame = true;
+}
+
+void DepthInteraction::ResetBackground()
+{
+	std::lock_guard<std::mutex> lock(m_pendingMutex);
+	m_resetBackground = true;
+}
+
+void DepthInteraction::Update(Sample3DSceneRenderer* sceneRenderer, double photonTime)
+{
+	uint32_t width = 0, height = 0;
+	double captureTime = 0.0;
+	bool newFrame = false;
+	m_touchEvents.clear();
+	{
+		std::lock_guard<std::mutex> lock(m_pendingMutex);
+		if (m_resetBackground)
+		{
+			m_detector.ResetBackground();
+			m_touchDetector.ResetSurface();
+			m_tracker.Reset();
+			m_resetBackground = false;
+		}
+
+		if (m_pendingFrame)
+		{
+			// バッファーを交換して、ロックを保持したまま検出しないようにします。
+			m_depth.swap(m_pendingDepth);
+			width = m_pendingWidth;
+			height = m_pendingHeight;
+			captureTime = m_pendingTime;
+			m_pendingFrame = false;
+			newFrame = true;
+		}
+	}
+
+	if (newFrame)
+	{
+		// 解像度が変わった場合は背景も学習し直されます。
+		if (m_detector.GetBackgroundFrameCount() < BackgroundFrameCount || !m_detector.Detect(m_depth.data(), width, height, &m_blobs))
+		{
+			m_detector.AccumulateBackground(m_depth.data(), width, height);
+			m_touchDetector.AccumulateSurface(m_depth.data(), width, height);
+			m_blobs.clear();
+			m_tracker.Reset();
+			m_width = 0;
+		}
+		else
+		{
+			m_tracker.Update(m_blobs, captureTime);
+			m_touchDetector.Detect(m_depth.data(), width, height, &m_touchEvents);
+			m_width = width;
+		}
+	}
+
+	if (m_width == 0)
+	{
+		return;
+	}
+
+	// センサーのフレームより描画のフレームの方が多いので、新しいフレームがなくても毎回予測し直します。
+	m_tracker.Predict(photonTime, &m_targets);
+
+	// 最も長く追跡している目標の水平位置を、出力画面上のポインター位置として扱います。
+	if (!m_targets.empty())
+	{
+		if (!sceneRenderer->IsTracking())
+		{
+			sceneRenderer->StartTracking();
+		}
+
+		float positionX = m_targets[0].x / m_width * m_deviceResources->GetOutputSize().Width;
+		sceneRenderer->TrackingUpdate(positionX);
+	}
+	else if (sceneRenderer->IsTracking())
+	{
+		sceneRenderer->StopTracking();
+	}
+}
@@ -0,0 +1,65 @@
+﻿#pragma once
+
+#include <mutex>
+#include <vector>
+#include "..\Common\DeviceResources.h"
+#include "..\Tracking\BlobDetector.h"
+#include "..\Tracking\TargetTracker.h"
+#include "..\Tracking\TouchDetector.h"
+#include "Sample3DSceneRenderer.h"
+
+namespace ProjectionMapping
+{
+	// 深度カメラで検出した手や体の位置で、ポインターの代わりにシーンを操作します。
+	// 投影面に触れた指先は、マルチタッチのイベントとして取得できます。
+	class DepthInteraction
+	{
+	public:
+		DepthInteraction(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+
+		// 深度フレーム (ミリメートル) を受け取ります。センサーのスレッドから呼び出すことができます。
+		// captureTime は露光した時刻 (QueryPerformanceCounter の秒) です。
+		// 最初の BackgroundFrameCount フレームは、物体のない背景 (タッチする面を含む) として学習します。
+		void SubmitDepthFrame(const uint16_t* depth, uint32_t width, uint32_t height, double captureTime);
+
+		// 背景を学習し直します。
+		void ResetBackground();
+
+		// 最新の深度フレームから前景を検出して追跡し、photonTime での予測位置でレンダラーのトラッキングを更新します。
+		void Update(Sample3DSceneRenderer* sceneRenderer, double photonTime);
+
+		// 直近の検出結果 (面積の大きい順)。
+		const std::vector<Blob>& GetBlobs() const { return m_blobs; }
+
+		// photonTime に予測した目標の位置 (古い目標から順)。
+		const std::vector<TrackedTarget>& GetTargets() const { return m_targets; }
+
+		// 直近の Update で処理した深度フレームでのタッチの変化。新しいフレームがなかった場合は空です。
+		const std::vector<TouchEvent>& GetTouchEvents() const { return m_touchEvents; }
+
+		static const uint32_t BackgroundFrameCount = 30;
+
+	private:
+		// デバイス リソースへのキャッシュされたポインター。
+		std::shared_ptr<DX::DeviceResources> m_deviceResources;
+
+		// センサーのスレッドから受け取った、まだ処理していないフレーム。
+		std::mutex				m_pendingMutex;
+		std::vector<uint16_t>	m_pendingDepth;
+		uint32_t				m_pendingWidth;
+		uint32_t				m_pendingHeight;
+		double					m_pendingTime;
+		bool					m_pendingFrame;
+		bool					m_resetBackground;
+
+		// 検出に使用する変数。
+		std::vector<uint16_t>	m_depth;
+		BlobDetector			m_detector;
+		std::vector<Blob>		m_blobs;
+		TargetTracker			m_tracker;
+		std::vector<TrackedTarget>	m_targets;
+		TouchDetector			m_touchDetector;
+		std::vector<TouchEvent>	m_touchEvents;
+		uint32_t				m_width;
+	};
+}
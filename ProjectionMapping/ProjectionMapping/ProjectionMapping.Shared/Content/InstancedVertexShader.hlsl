@@ -0,0 +1,42 @@
+// CPU  view  projection |킹D̃}gbNXۑAt[Ƃ̒萔obt@[B
+cbuffer ViewProjectionConstantBuffer : register(b0)
+{
+	matrix viewProjection;
+};
+
+// _VF[_[ւ̓͂ƂĎgp钸_Ƃ̃f[^ƁACX^XƂ̃f[^ (InstanceData)B
+struct VertexShaderInput
+{
+	float3 pos : POSITION;
+	float3 color : COLOR0;
+	float4 world0 : WORLD0;
+	float4 world1 : WORLD1;
+	float4 world2 : WORLD2;
+	float4 instanceColor : COLOR1;
+};
+
+// sNZ VF[_[ʂēnsNZƂ̐Ff[^B
+struct PixelShaderInput
+{
+	float4 pos : SV_POSITION;
+	float3 color : COLOR0;
+};
+
+// bVACX^XƂ̃[hsƐFŕ`悷VF[_[B
+PixelShaderInput main(VertexShaderInput input)
+{
+	PixelShaderInput output;
+	float4 pos = float4(input.pos, 1.0f);
+
+	// CX^X̃[hs̗Ƃ̓ςŁACX^Ẍʒuɕϊ܂B
+	pos = float4(dot(pos, input.world0), dot(pos, input.world1), dot(pos, input.world2), 1.0f);
+
+	// _̈ʒuAˉeꂽ̈ɕϊ܂B
+	pos = mul(pos, viewProjection);
+	output.pos = pos;
+
+	// _̐FɃCX^X̐F|܂B
+	output.color = input.color * input.instanceColor.rgb;
+
+	return output;
+}
@@ -0,0 +1,100 @@
+﻿#include "pch.h"
+#include "KinectDepthSource.h"
+
+using namespace ProjectionMapping;
+
+#if defined(PROJECTIONMAPPING_KINECT)
+using namespace WindowsPreview::Kinect;
+using namespace Windows::Foundation;
+
+KinectDepthSource::KinectDepthSource(const FrameCallback& callback) :
+	m_callback(callback),
+	m_qpcSecondsPerTick(0.0),
+	m_clockOffset(0.0),
+	m_clockOffsetValid(false)
+{
+	LARGE_INTEGER frequency;
+	if (!QueryPerformanceFrequency(&frequency))
+	{
+		throw ref new Platform::FailureException();
+	}
+	m_qpcSecondsPerTick = 1.0 / static_cast<double>(frequency.QuadPart);
+
+	// センサーが接続されていなくても既定のセンサーは取得できます。
+	m_sensor = KinectSensor::GetDefault();
+	if (m_sensor == nullptr)
+	{
+		return;
+	}
+
+	m_reader = m_sensor->DepthFrameSource->OpenReader();
+	m_frameArrivedToken = m_reader->FrameArrived +=
+		ref new TypedEventHandler<DepthFrameReader^, DepthFrameArrivedEventArgs^>([this](DepthFrameReader^, DepthFrameArrivedEventArgs^ args)
+	{
+		OnFrameArrived(args);
+	});
+
+	m_sensor->Open();
+}
+
+KinectDepthSource::~KinectDepthSource()
+{
+	if (m_reader != nullptr)
+	{
+		m_reader->FrameArrived -= m_frameArrivedToken;
+		delete m_reader;
+		m_reader = nullptr;
+	}
+
+	if (m_sensor != nullptr)
+	{
+		m_sensor->Close();
+		m_sensor = nullptr;
+	}
+}
+
+void KinectDepthSource::OnFrameArrived(DepthFrameArrivedEventArgs^ args)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	// 次のフレームが届いている場合は、古いフレームを取得できません。
+	DepthFrame^ frame = args->FrameReference->AcquireFrame();
+	if (frame == nullptr)
+	{
+		return;
+	}
+
+	FrameDescription^ description = frame->FrameDescription;
+	const uint32_t width = static_cast<uint32_t>(description->Width);
+	const uint32_t height = static_cast<uint32_t>(description->Height);
+	if (m_frameData == nullptr || m_frameData->Length != width * height)
+	{
+		m_frameData = ref new Platform::Array<uint16>(width * height);
+	}
+	frame->CopyFrameDataToArray(m_frameData);
+	const double sensorTime = frame->RelativeTime.Duration * 1.0e-7;
+
+	// センサーがフレームを次に使えるように、すぐに閉じます。
+	delete frame;
+
+	// 届いた時刻とセンサーの時刻の差は、転送の遅れが最も小さいフレームで最小になります。
+	// その差でセンサーの時刻を QueryPerformanceCounter の時刻に換算します。換算した時刻は最小の転送の遅れの分だけ遅くなります。
+	const double offset = now.QuadPart * m_qpcSecondsPerTick - sensorTime;
+	if (!m_clockOffsetValid || offset < m_clockOffset)
+	{
+		m_clockOffset = offset;
+		m_clockOffsetValid = true;
+	}
+
+	m_callback(m_frameData->Data, width, height, sensorTime + m_clockOffset);
+}
+#else
+KinectDepthSource::KinectDepthSource(const FrameCallback&)
+{
+}
+
+KinectDepthSource::~KinectDepthSource()
+{
+}
+#endif
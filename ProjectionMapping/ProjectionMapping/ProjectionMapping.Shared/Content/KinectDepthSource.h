@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Kinect for Windows SDK 2.0 の Windows ストア アプリ向け API は x86 と x64 の Windows だけで使用できます。
+#if !(WINAPI_FAMILY == WINAPI_FAMILY_PHONE_APP) && !defined(_M_ARM)
+#define PROJECTIONMAPPING_KINECT
+#endif
+
+namespace ProjectionMapping
+{
+	// 既定の Kinect センサーから深度フレームを受け取り、露光した時刻とともにコールバックに渡します。
+	// センサーが接続されていない間は何も渡しません。接続されるとフレームが届き始めます。
+	// Kinect を使用できないプラットフォームでは何もしません。
+	class KinectDepthSource
+	{
+	public:
+		// depth はミリメートルの深度、captureTime は露光した時刻 (QueryPerformanceCounter の秒) です。
+		// depth はコールバックの中でだけ有効です。
+		typedef std::function<void(const uint16_t* depth, uint32_t width, uint32_t height, double captureTime)> FrameCallback;
+
+		KinectDepthSource(const FrameCallback& callback);
+		~KinectDepthSource();
+
+	private:
+#if defined(PROJECTIONMAPPING_KINECT)
+		void OnFrameArrived(WindowsPreview::Kinect::DepthFrameArrivedEventArgs^ args);
+
+		FrameCallback								m_callback;
+		WindowsPreview::Kinect::KinectSensor^		m_sensor;
+		WindowsPreview::Kinect::DepthFrameReader^	m_reader;
+		Windows::Foundation::EventRegistrationToken	m_frameArrivedToken;
+		Platform::Array<uint16>^					m_frameData;
+
+		// センサーの時刻から QueryPerformanceCounter の時刻への換算。
+		double										m_qpcSecondsPerTick;
+		double										m_clockOffset;
+		bool										m_clockOffsetValid;
+#endif
+	};
+}
@@ -5,17 +5,61 @@
 
 using namespace ProjectionMapping;
 
-using namespace DirectX;
 using namespace Windows::Foundation;
 
+namespace
+{
+	// タイルの列と行の数。
+	const int TileColumns = 48;
+	const int TileRows = 48;
+
+	// タイルの間隔と大きさ、並べる高さ。
+	const float TileSpacing = 0.05f;
+	const float TileScale = 0.04f;
+	const float TileBaseHeight = -0.75f;
+	const float TileWaveHeight = 0.05f;
+
+	// キューブとタイルは Y 軸まわりに回るので、水平方向の境界は対角の長さの半分にします。
+	const float CubeHorizontalExtent = 0.5f * 1.41421356f;
+	const float CubeVerticalExtent = 0.5f;
+
+	// BVH でキューブを表す番号。タイルの番号 (0 から TileColumns * TileRows - 1) と区別します。
+	const uint32_t CubeObject = TileColumns * TileRows;
+
+	Aabb TileBounds(const InstanceTransforms& tiles, size_t i)
+	{
+		const float horizontal = CubeHorizontalExtent * tiles.scale[i];
+		const float vertical = CubeVerticalExtent * tiles.scale[i];
+		return Aabb::FromCenterExtent(tiles.positionX[i], tiles.positionY[i], tiles.positionZ[i], horizontal, vertical, horizontal);
+	}
+}
+
 // ファイルから頂点とピクセル シェーダーを読み込み、キューブのジオメトリをインスタンス化します。
-Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources, const std::shared_ptr<RenderBackend>& backend) :
 	m_loadingComplete(false),
 	m_degreesPerSecond(45),
-	m_indexCount(0),
 	m_tracking(false),
-	m_deviceResources(deviceResources)
+	m_deviceResources(deviceResources),
+	m_backend(backend),
+	m_pipeline(InvalidHandle),
+	m_instancedPipeline(InvalidHandle)
 {
+	m_model = Matrix::Identity().ToFloat4x4();
+
+	for (size_t i = 0; i < MaxViews; i++)
+	{
+		m_frameConstantBuffers[i] = InvalidHandle;
+	}
+
+	// 既定では 1 つのビューでバック バッファー全体に描画します。
+	m_views.resize(1);
+	const ProjectorViewport fullViewport = { 0.0f, 0.0f, 1.0f, 1.0f };
+	m_views[0].viewport = fullViewport;
+
+	CreateTiles();
+	m_sceneBvh.CreateProxy(Aabb::FromCenterExtent(0.0f, 0.0f, 0.0f, CubeHorizontalExtent, CubeVerticalExtent, CubeHorizontalExtent), CubeObject);
+	m_sceneBvh.Update();
+
 	CreateDeviceDependentResources();
 	CreateWindowSizeDependentResources();
 }
@@ -23,9 +67,39 @@ Sample3DSceneRenderer::Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceRes
 // ウィンドウのサイズが変更されたときに、ビューのパラメーターを初期化します。
 void Sample3DSceneRenderer::CreateWindowSizeDependentResources()
 {
+	for (View& view : m_views)
+	{
+		UpdateView(&view);
+	}
+}
+
+// ビューポートの画素の矩形と、ビュー プロジェクション、視錐台を計算します。
+void Sample3DSceneRenderer::UpdateView(View* view)
+{
+	const D3D11_VIEWPORT screenViewport = m_deviceResources->GetScreenViewport();
+	view->pixelViewport[0] = screenViewport.TopLeftX + view->viewport.left * screenViewport.Width;
+	view->pixelViewport[1] = screenViewport.TopLeftY + view->viewport.top * screenViewport.Height;
+	view->pixelViewport[2] = view->viewport.width * screenViewport.Width;
+	view->pixelViewport[3] = view->viewport.height * screenViewport.Height;
+	view->frameConstantsDirty = true;
+
+	// キャリブレーション済みの場合は、物理的なプロジェクターと一致するビューとプロジェクションを使用します。
+	if (view->calibration.IsValid())
+	{
+		Float4x4 calibratedProjection = view->calibration.GetProjectionMatrix(0.01f, 100.0f);
+		Float4x4 calibratedView = view->calibration.GetViewMatrix();
+
+		DirectX::XMFLOAT4X4 orientation = m_deviceResources->GetOrientationTransform3D();
+
+		view->viewProjection = (Matrix::Load(calibratedView) * Matrix::Load(calibratedProjection) * Matrix::Load(&orientation.m[0][0])).ToFloat4x4();
+		view->frustum = Frustum::FromViewProjection(view->viewProjection);
+		return;
+	}
+
+	// 縦横比はビューポートの大きさで決めます。
 	Size outputSize = m_deviceResources->GetOutputSize();
-	float aspectRatio = outputSize.Width / outputSize.Height;
-	float fovAngleY = 70.0f * XM_PI / 180.0f;
+	float aspectRatio = (outputSize.Width * view->viewport.width) / (outputSize.Height * view->viewport.height);
+	float fovAngleY = 70.0f * Pi / 180.0f;
 
 	// これは、アプリケーションが縦向きビューまたはスナップ ビュー内にあるときに行うことのできる
 	// 変更の簡単な例です。
@@ -41,28 +115,25 @@ void Sample3DSceneRenderer::CreateWindowSizeDependentResources()
 	// 適用する必要はありません。
 
 	// このサンプルでは、行優先のマトリックスを使用した右辺座標系を使用しています。
-	XMMATRIX perspectiveMatrix = XMMatrixPerspectiveFovRH(
+	Matrix perspectiveMatrix = Matrix::PerspectiveFovRH(
 		fovAngleY,
 		aspectRatio,
 		0.01f,
 		100.0f
 		);
 
-	XMFLOAT4X4 orientation = m_deviceResources->GetOrientationTransform3D();
-
-	XMMATRIX orientationMatrix = XMLoadFloat4x4(&orientation);
+	DirectX::XMFLOAT4X4 orientation = m_deviceResources->GetOrientationTransform3D();
 
-	XMStoreFloat4x4(
-		&m_constantBufferData.projection,
-		XMMatrixTranspose(perspectiveMatrix * orientationMatrix)
-		);
+	Matrix orientationMatrix = Matrix::Load(&orientation.m[0][0]);
 
 	// 視点は (0,0.7,1.5) の位置にあり、y 軸に沿って上方向のポイント (0,-0.1,0) を見ています。
-	static const XMVECTORF32 eye = { 0.0f, 0.7f, 1.5f, 0.0f };
-	static const XMVECTORF32 at = { 0.0f, -0.1f, 0.0f, 0.0f };
-	static const XMVECTORF32 up = { 0.0f, 1.0f, 0.0f, 0.0f };
+	const Vector eye = Vector::Set(0.0f, 0.7f, 1.5f, 0.0f);
+	const Vector at = Vector::Set(0.0f, -0.1f, 0.0f, 0.0f);
+	const Vector up = Vector::Set(0.0f, 1.0f, 0.0f, 0.0f);
 
-	XMStoreFloat4x4(&m_constantBufferData.view, XMMatrixTranspose(XMMatrixLookAtRH(eye, at, up)));
+	// ビューとプロジェクションは頂点ごとではなく、ここで 1 回だけ掛け合わせます。
+	view->viewProjection = (Matrix::LookAtRH(eye, at, up) * perspectiveMatrix * orientationMatrix).ToFloat4x4();
+	view->frustum = Frustum::FromViewProjection(view->viewProjection);
 }
 
 // フレームごとに 1 回呼び出し、キューブを回転させてから、モデルおよびビューのマトリックスを計算します。
@@ -71,19 +142,106 @@ void Sample3DSceneRenderer::Update(DX::StepTimer const& timer)
 	if (!m_tracking)
 	{
 		// 度をラジアンに変換し、秒を回転角度に変換します
-		float radiansPerSecond = XMConvertToRadians(m_degreesPerSecond);
+		float radiansPerSecond = Scalar::ToRadians(m_degreesPerSecond);
 		double totalRotation = timer.GetTotalSeconds() * radiansPerSecond;
-		float radians = static_cast<float>(fmod(totalRotation, XM_2PI));
+		float radians = static_cast<float>(fmod(totalRotation, TwoPi));
 
 		Rotate(radians);
 	}
+
+	UpdateTiles(static_cast<float>(timer.GetTotalSeconds()));
+}
+
+// タイルを格子状に並べ、中心からの距離に応じた波の位相を決めます。
+void Sample3DSceneRenderer::CreateTiles()
+{
+	m_tiles.Resize(TileColumns * TileRows);
+	m_tilePhases.resize(TileColumns * TileRows);
+	m_tileProxies.resize(TileColumns * TileRows);
+
+	for (int row = 0; row < TileRows; row++)
+	{
+		for (int column = 0; column < TileColumns; column++)
+		{
+			const size_t i = row * TileColumns + column;
+			const float x = (column - (TileColumns - 1) * 0.5f) * TileSpacing;
+			const float z = (row - (TileRows - 1) * 0.5f) * TileSpacing;
+
+			m_tiles.positionX[i] = x;
+			m_tiles.positionY[i] = TileBaseHeight;
+			m_tiles.positionZ[i] = z;
+			m_tiles.scale[i] = TileScale;
+			m_tilePhases[i] = sqrtf(x * x + z * z) * 8.0f;
+			m_tileProxies[i] = m_sceneBvh.CreateProxy(TileBounds(m_tiles, i), static_cast<uint32_t>(i));
+		}
+	}
+}
+
+// タイルの高さ、向き、色を配列ごとにまとめて更新します。
+void Sample3DSceneRenderer::UpdateTiles(float seconds)
+{
+	const size_t count = m_tiles.GetCount();
+	const float time = fmodf(seconds, 1000.0f) * 2.0f;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const float wave = sinf(m_tilePhases[i] - time);
+		m_tiles.positionY[i] = TileBaseHeight + TileWaveHeight * wave;
+
+		// Y 軸まわりに、波に合わせて傾けます。
+		const float halfAngle = 0.5f * (m_tilePhases[i] - time);
+		m_tiles.rotationY[i] = sinf(halfAngle);
+		m_tiles.rotationW[i] = cosf(halfAngle);
+
+		m_tiles.colorR[i] = 0.55f + 0.45f * wave;
+		m_tiles.colorG[i] = 0.6f;
+		m_tiles.colorB[i] = 0.55f - 0.45f * wave;
+
+		m_sceneBvh.MoveProxy(m_tileProxies[i], TileBounds(m_tiles, i));
+	}
+
+	m_sceneBvh.Update();
 }
 
 //3D キューブ モデルを、ラジアン単位で設定された大きさだけ回転させます。
 void Sample3DSceneRenderer::Rotate(float radians)
 {
 	//更新されたモデル マトリックスをシェーダーに渡す準備をします
-	XMStoreFloat4x4(&m_constantBufferData.model, XMMatrixTranspose(XMMatrixRotationY(radians)));
+	m_model = Matrix::RotationY(radians).ToFloat4x4();
+}
+
+// キャリブレーションを更新し、ビューのパラメーターを再計算します。
+void Sample3DSceneRenderer::SetProjectorCalibration(const ProjectorCalibration& calibration)
+{
+	SetProjectors(&calibration, nullptr, 1);
+}
+
+// プロジェクターごとにビューを作り直し、ビューのパラメーターを再計算します。
+void Sample3DSceneRenderer::SetProjectors(const ProjectorCalibration* calibrations, const ProjectorViewport* viewports, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	count = count < MaxViews ? count : MaxViews;
+
+	m_views.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		View& view = m_views[i];
+		view.calibration = calibrations[i];
+		if (viewports != nullptr)
+		{
+			view.viewport = viewports[i];
+		}
+		else
+		{
+			const ProjectorViewport column = { static_cast<float>(i) / count, 0.0f, 1.0f / count, 1.0f };
+			view.viewport = column;
+		}
+	}
+
+	CreateWindowSizeDependentResources();
 }
 
 void Sample3DSceneRenderer::StartTracking()
@@ -96,7 +254,7 @@ void Sample3DSceneRenderer::TrackingUpdate(float positionX)
 {
 	if (m_tracking)
 	{
-		float radians = XM_2PI * 2.0f * positionX / m_deviceResources->GetOutputSize().Width;
+		float radians = TwoPi * 2.0f * positionX / m_deviceResources->GetOutputSize().Width;
 		Rotate(radians);
 	}
 }
@@ -106,75 +264,84 @@ void Sample3DSceneRenderer::StopTracking()
 	m_tracking = false;
 }
 
-// 頂点とピクセル シェーダーを使用して、1 つのフレームを描画します。
-void Sample3DSceneRenderer::Render()
+// 頂点とピクセル シェーダーを使用して、1 つのビューのフレームの描画を記録します。
+// 共有するシーン (BVH、タイル、メッシュ) は読むだけで、書き換えるのは viewIndex のビューの状態だけです。
+void Sample3DSceneRenderer::Render(size_t viewIndex, CommandList* commands)
 {
 	// 読み込みは非同期です。読み込みが完了した後にのみ描画してください。
-	if (!m_loadingComplete)
+	if (!m_loadingComplete || viewIndex >= m_views.size())
 	{
 		return;
 	}
 
-	auto context = m_deviceResources->GetD3DDeviceContext();
-
-	// 定数バッファーを準備して、グラフィックス デバイスに送信します。
-	context->UpdateSubresource(
-		m_constantBuffer.Get(),
-		0,
-		NULL,
-		&m_constantBufferData,
-		0,
-		0
-		);
-
-	// 各頂点は、VertexPositionColor 構造体の 1 つのインスタンスです。
-	UINT stride = sizeof(VertexPositionColor);
-	UINT offset = 0;
-	context->IASetVertexBuffers(
-		0,
-		1,
-		m_vertexBuffer.GetAddressOf(),
-		&stride,
-		&offset
-		);
+	View& view = m_views[viewIndex];
+	const BufferHandle frameConstantBuffer = m_frameConstantBuffers[viewIndex];
 
-	context->IASetIndexBuffer(
-		m_indexBuffer.Get(),
-		DXGI_FORMAT_R16_UINT, // 各インデックスは、1 つの 16 ビット符号なし整数 (short) です。
-		0
-		);
+	// フレームごとの定数は、ビューかプロジェクションが変わったときだけ送信します。
+	if (view.frameConstantsDirty)
+	{
+		ViewProjectionConstantBuffer frameConstantData;
+		frameConstantData.viewProjection = Matrix::Load(view.viewProjection).Transpose().ToFloat4x4();
+		commands->UpdateBuffer(frameConstantBuffer, &frameConstantData, sizeof(frameConstantData));
+		view.frameConstantsDirty = false;
+	}
 
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	// このプロジェクターの出力先の領域に描画します。
+	commands->SetViewport(view.pixelViewport[0], view.pixelViewport[1], view.pixelViewport[2], view.pixelViewport[3]);
 
-	context->IASetInputLayout(m_inputLayout.Get());
+	// ビューの視錐台と交差するオブジェクトだけを描画します。
+	m_sceneBvh.Cull(view.frustum, &view.visibleObjects);
 
-	// 頂点シェーダーをアタッチします。
-	context->VSSetShader(
-		m_vertexShader.Get(),
-		nullptr,
-		0
-		);
+	bool cubeVisible = false;
+	view.visibleTiles.clear();
+	for (uint32_t object : view.visibleObjects)
+	{
+		if (object == CubeObject)
+		{
+			cubeVisible = true;
+		}
+		else
+		{
+			view.visibleTiles.push_back(object);
+		}
+	}
 
-	// 定数バッファーをグラフィックス デバイスに送信します。
-	context->VSSetConstantBuffers(
-		0,
-		1,
-		m_constantBuffer.GetAddressOf()
-		);
+	if (cubeVisible)
+	{
+		// オブジェクトごとの MVP は CPU でまとめて計算し、このフレームのリングに書き込みます。
+		TransientAllocation objectConstants;
+		if (!m_backend->AllocateTransient(BufferDescription::Constant, RenderBackend::ConstantAlignment, RenderBackend::ConstantAlignment, &objectConstants))
+		{
+			return;
+		}
+		MathBatch::MultiplyTransposed(&m_model, 1, Matrix::Load(view.viewProjection), objectConstants.data, RenderBackend::ConstantAlignment);
+
+		// 頂点とインデックスの形式、描画の範囲はメッシュが設定します。
+		DrawPacket material = {};
+		material.pipeline = m_pipeline;
+		material.frameConstants.buffer = frameConstantBuffer;
+		material.objectConstants.buffer = objectConstants.buffer;
+		material.objectConstants.offset = objectConstants.offset;
+		material.objectConstants.size = sizeof(ObjectConstantBuffer);
+
+		// 不透明なので手前から描画します。深度は原点にある立方体の中心のクリップ空間の w です。
+		const uint64_t sortKey = DrawKey::Make(0, m_pipeline, m_cube.GetVertexBuffer(), view.viewProjection.m[3][3]);
+
+		// オブジェクトを描画します。
+		m_cube.Record(commands, material, sortKey);
+	}
 
-	// ピクセル シェーダーをアタッチします。
-	context->PSSetShader(
-		m_pixelShader.Get(),
-		nullptr,
-		0
-		);
+	// タイルはインスタンスごとのワールド行列とフレームごとのビュー プロジェクションで変換するので、オブジェクトの定数は不要です。
+	if (m_instancedPipeline != InvalidHandle)
+	{
+		DrawPacket tileMaterial = {};
+		tileMaterial.pipeline = m_instancedPipeline;
+		tileMaterial.frameConstants.buffer = frameConstantBuffer;
 
-	// オブジェクトを描画します。
-	context->DrawIndexed(
-		m_indexCount,
-		0,
-		0
-		);
+		// 見えるタイルだけを詰めて、1 回のアップロードと 1 回の描画で描画します。インスタンスはまとめて描画するので、深度では並べ替えません。
+		const uint64_t sortKey = DrawKey::Make(0, m_instancedPipeline, m_cube.GetVertexBuffer(), 0.0f);
+		m_cube.RecordInstances(m_backend.get(), commands, tileMaterial, m_tiles, view.visibleTiles.data(), view.visibleTiles.size(), sortKey);
+	}
 }
 
 void Sample3DSceneRenderer::CreateDeviceDependentResources()
@@ -182,85 +349,73 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 	// シェーダーを非同期で読み込みます。
 	auto loadVSTask = DX::ReadDataAsync(L"SampleVertexShader.cso");
 	auto loadPSTask = DX::ReadDataAsync(L"SamplePixelShader.cso");
+	auto loadInstancedVSTask = DX::ReadDataAsync(L"InstancedVertexShader.cso");
 
-	// 頂点シェーダー ファイルを読み込んだ後、シェーダーと入力レイアウトを作成します。
+	// シェーダー ファイルを読み込んだ後、パイプラインの作成まで内容を保持します。
 	auto createVSTask = loadVSTask.then([this](const std::vector<byte>& fileData) {
-		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreateVertexShader(
-				&fileData[0],
-				fileData.size(),
-				nullptr,
-				&m_vertexShader
-				)
-			);
-
-		static const D3D11_INPUT_ELEMENT_DESC vertexDesc [] =
-		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-		};
-
-		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreateInputLayout(
-				vertexDesc,
-				ARRAYSIZE(vertexDesc),
-				&fileData[0],
-				fileData.size(),
-				&m_inputLayout
-				)
-			);
+		m_vertexShaderData = fileData;
 	});
 
-	// ピクセル シェーダー ファイルを読み込んだ後、シェーダーと定数バッファーを作成します。
 	auto createPSTask = loadPSTask.then([this](const std::vector<byte>& fileData) {
-		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreatePixelShader(
-				&fileData[0],
-				fileData.size(),
-				nullptr,
-				&m_pixelShader
-				)
-			);
-
-		CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ModelViewProjectionConstantBuffer) , D3D11_BIND_CONSTANT_BUFFER);
-		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreateBuffer(
-				&constantBufferDesc,
-				nullptr,
-				&m_constantBuffer
-				)
-			);
+		m_pixelShaderData = fileData;
 	});
 
-	// 両方のシェーダーの読み込みが完了したら、メッシュを作成します。
-	auto createCubeTask = (createPSTask && createVSTask).then([this] () {
+	auto createInstancedVSTask = loadInstancedVSTask.then([this](const std::vector<byte>& fileData) {
+		m_instancedVertexShaderData = fileData;
+	});
+
+	// すべてのシェーダーの読み込みが完了したら、パイプラインと定数バッファー、メッシュを作成します。
+	auto createCubeTask = (createPSTask && createVSTask && createInstancedVSTask).then([this] () {
+
+		PipelineDescription pipelineDesc;
+		pipelineDesc.vertexShader = &m_vertexShaderData[0];
+		pipelineDesc.vertexShaderSize = m_vertexShaderData.size();
+		pipelineDesc.pixelShader = &m_pixelShaderData[0];
+		pipelineDesc.pixelShaderSize = m_pixelShaderData.size();
+		pipelineDesc.cullMode = PipelineDescription::CullBack;
+		pipelineDesc.vertexLayout = PipelineDescription::PositionColor;
+		m_pipeline = m_backend->CreatePipeline(pipelineDesc);
+
+		// インスタンス化に対応しない機能レベルでは、タイルを描画しません。
+		if (m_backend->SupportsInstancing())
+		{
+			pipelineDesc.vertexShader = &m_instancedVertexShaderData[0];
+			pipelineDesc.vertexShaderSize = m_instancedVertexShaderData.size();
+			pipelineDesc.vertexLayout = PipelineDescription::PositionColorInstance;
+			m_instancedPipeline = m_backend->CreatePipeline(pipelineDesc);
+		}
+
+		m_vertexShaderData.clear();
+		m_pixelShaderData.clear();
+		m_instancedVertexShaderData.clear();
+
+		// ビューの数はあとから変えられるので、最大数のバッファーを作成します。内容は最初の Render で送信します。
+		BufferDescription constantBufferDesc;
+		constantBufferDesc.usage = BufferDescription::Constant;
+		constantBufferDesc.size = sizeof(ViewProjectionConstantBuffer);
+		constantBufferDesc.initialData = nullptr;
+		for (size_t i = 0; i < MaxViews; i++)
+		{
+			m_frameConstantBuffers[i] = m_backend->CreateBuffer(constantBufferDesc);
+		}
+		for (View& view : m_views)
+		{
+			view.frameConstantsDirty = true;
+		}
 
 		// メッシュの頂点を読み込みます。各頂点には、位置と色があります。
 		static const VertexPositionColor cubeVertices[] = 
 		{
-			{XMFLOAT3(-0.5f, -0.5f, -0.5f), XMFLOAT3(0.0f, 0.0f, 0.0f)},
-			{XMFLOAT3(-0.5f, -0.5f,  0.5f), XMFLOAT3(0.0f, 0.0f, 1.0f)},
-			{XMFLOAT3(-0.5f,  0.5f, -0.5f), XMFLOAT3(0.0f, 1.0f, 0.0f)},
-			{XMFLOAT3(-0.5f,  0.5f,  0.5f), XMFLOAT3(0.0f, 1.0f, 1.0f)},
-			{XMFLOAT3( 0.5f, -0.5f, -0.5f), XMFLOAT3(1.0f, 0.0f, 0.0f)},
-			{XMFLOAT3( 0.5f, -0.5f,  0.5f), XMFLOAT3(1.0f, 0.0f, 1.0f)},
-			{XMFLOAT3( 0.5f,  0.5f, -0.5f), XMFLOAT3(1.0f, 1.0f, 0.0f)},
-			{XMFLOAT3( 0.5f,  0.5f,  0.5f), XMFLOAT3(1.0f, 1.0f, 1.0f)},
+			{{-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, 0.0f}},
+			{{-0.5f, -0.5f,  0.5f}, {0.0f, 0.0f, 1.0f}},
+			{{-0.5f,  0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
+			{{-0.5f,  0.5f,  0.5f}, {0.0f, 1.0f, 1.0f}},
+			{{ 0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+			{{ 0.5f, -0.5f,  0.5f}, {1.0f, 0.0f, 1.0f}},
+			{{ 0.5f,  0.5f, -0.5f}, {1.0f, 1.0f, 0.0f}},
+			{{ 0.5f,  0.5f,  0.5f}, {1.0f, 1.0f, 1.0f}},
 		};
 
-		D3D11_SUBRESOURCE_DATA vertexBufferData = {0};
-		vertexBufferData.pSysMem = cubeVertices;
-		vertexBufferData.SysMemPitch = 0;
-		vertexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC vertexBufferDesc(sizeof(cubeVertices), D3D11_BIND_VERTEX_BUFFER);
-		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreateBuffer(
-				&vertexBufferDesc,
-				&vertexBufferData,
-				&m_vertexBuffer
-				)
-			);
-
 		// メッシュのインデックスを読み込みます。インデックスの 3 つ 1 組の値のそれぞれは、次のものを表します:
 		// 画面上に描画される三角形を表します。
 		// たとえば、0,2,1 とは、頂点バッファーからのインデックスを意味します:
@@ -287,20 +442,16 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 			1,7,5,
 		};
 
-		m_indexCount = ARRAYSIZE(cubeIndices);
-
-		D3D11_SUBRESOURCE_DATA indexBufferData = {0};
-		indexBufferData.pSysMem = cubeIndices;
-		indexBufferData.SysMemPitch = 0;
-		indexBufferData.SysMemSlicePitch = 0;
-		CD3D11_BUFFER_DESC indexBufferDesc(sizeof(cubeIndices), D3D11_BIND_INDEX_BUFFER);
-		DX::ThrowIfFailed(
-			m_deviceResources->GetD3DDevice()->CreateBuffer(
-				&indexBufferDesc,
-				&indexBufferData,
-				&m_indexBuffer
-				)
-			);
+		// インデックスの形式は頂点数に応じて RenderMesh が選びます。
+		TriangleMesh cube;
+		for (const VertexPositionColor& vertex : cubeVertices)
+		{
+			MeshVertex meshVertex = { { vertex.pos.x, vertex.pos.y, vertex.pos.z }, { vertex.color.x, vertex.color.y, vertex.color.z } };
+			cube.vertices.push_back(meshVertex);
+		}
+		cube.indices.assign(cubeIndices, cubeIndices + ARRAYSIZE(cubeIndices));
+
+		m_cube.Create(m_backend.get(), cube, RenderMesh::AutoIndex);
 	});
 
 	// キューブが読み込まれたら、オブジェクトを描画する準備が完了します。
@@ -311,11 +462,13 @@ void Sample3DSceneRenderer::CreateDeviceDependentResources()
 
 void Sample3DSceneRenderer::ReleaseDeviceDependentResources()
 {
+	// リソースはデバイスとともにバックエンドが解放するので、番号だけを無効にします。
 	m_loadingComplete = false;
-	m_vertexShader.Reset();
-	m_inputLayout.Reset();
-	m_pixelShader.Reset();
-	m_constantBuffer.Reset();
-	m_vertexBuffer.Reset();
-	m_indexBuffer.Reset();
+	m_pipeline = InvalidHandle;
+	m_instancedPipeline = InvalidHandle;
+	for (size_t i = 0; i < MaxViews; i++)
+	{
+		m_frameConstantBuffers[i] = InvalidHandle;
+	}
+	m_cube.Reset();
 }
\ No newline at end of file
@@ -3,43 +3,104 @@
 #include "..\Common\DeviceResources.h"
 #include "ShaderStructures.h"
 #include "..\Common\StepTimer.h"
+#include "..\Calibration\ProjectorCalibration.h"
+#include "..\Rendering\RenderBackend.h"
+#include "..\Rendering\RenderMesh.h"
+#include "..\Rendering\DynamicBvh.h"
+#include "..\Math\VectorMath.h"
 
 namespace ProjectionMapping
 {
+	// プロジェクターの出力先。複数のプロジェクターにまたがる 1 つのウィンドウの中で、バック バッファーに対する割合 (0..1) で表します。
+	struct ProjectorViewport
+	{
+		float left;
+		float top;
+		float width;
+		float height;
+	};
+
 	// このサンプル レンダリングでは、基本的なレンダリング パイプラインをインスタンス化します。
+	// プロジェクターごとにビュー (ビュー プロジェクション、視錐台、ビューポート) を持ち、アニメーションと BVH の更新は Update で全ビューに 1 回だけ行います。
 	class Sample3DSceneRenderer
 	{
 	public:
-		Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+		// 同時に出力できるプロジェクターの数。
+		static const size_t MaxViews = 6;
+
+		Sample3DSceneRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources, const std::shared_ptr<RenderBackend>& backend);
 		void CreateDeviceDependentResources();
 		void CreateWindowSizeDependentResources();
 		void ReleaseDeviceDependentResources();
 		void Update(DX::StepTimer const& timer);
-		void Render();
+
+		// view の描画を commands に記録します。異なるビューは別々のスレッドから同時に記録できます。
+		void Render(size_t view, CommandList* commands);
+		size_t GetViewCount() const { return m_views.size(); }
 		void StartTracking();
 		void TrackingUpdate(float positionX);
 		void StopTracking();
 		bool IsTracking() { return m_tracking; }
 
+		// キャリブレーション済みのプロジェクターのビュー/プロジェクションで、バック バッファー全体に描画します。
+		void SetProjectorCalibration(const ProjectorCalibration& calibration);
+
+		// プロジェクターごとのキャリブレーションと出力先を設定します。count は MaxViews までです。
+		// viewports が nullptr の場合は、プロジェクターを左から順に同じ幅で並べます。無効なキャリブレーションのビューは既定のカメラを使用します。
+		void SetProjectors(const ProjectorCalibration* calibrations, const ProjectorViewport* viewports, size_t count);
+
 
 	private:
+		// プロジェクター 1 台分の描画の状態。Render はビューごとの状態だけを書き換えます。
+		struct View
+		{
+			ProjectorCalibration	calibration;			// 無効な場合は既定のカメラを使用します。
+			ProjectorViewport		viewport;
+			float					pixelViewport[4];		// x, y, 幅, 高さ (画素)。
+			Float4x4				viewProjection;
+			Frustum					frustum;
+			bool					frameConstantsDirty;	// m_frameConstantBuffers の内容を送信し直す必要があります。
+			std::vector<uint32_t>	visibleObjects;
+			std::vector<uint32_t>	visibleTiles;
+		};
+
+		void UpdateView(View* view);
 		void Rotate(float radians);
+		void CreateTiles();
+		void UpdateTiles(float seconds);
 
 	private:
 		// デバイス リソースへのキャッシュされたポインター。
 		std::shared_ptr<DX::DeviceResources> m_deviceResources;
 
-		// キューブ ジオメトリの Direct3D リソース。
-		Microsoft::WRL::ComPtr<ID3D11InputLayout>	m_inputLayout;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_vertexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_indexBuffer;
-		Microsoft::WRL::ComPtr<ID3D11VertexShader>	m_vertexShader;
-		Microsoft::WRL::ComPtr<ID3D11PixelShader>	m_pixelShader;
-		Microsoft::WRL::ComPtr<ID3D11Buffer>		m_constantBuffer;
-
-		// キューブ ジオメトリのシステム リソース。
-		ModelViewProjectionConstantBuffer	m_constantBufferData;
-		uint32	m_indexCount;
+		// キューブ ジオメトリを作成する描画バックエンド。
+		std::shared_ptr<RenderBackend> m_backend;
+
+		// キューブ ジオメトリのバックエンド リソース。オブジェクトごとの定数はフレームごとにリングに書き込みます。
+		// フレームの定数 (ビュー プロジェクション) はビューごとのバッファーに置き、変更したときだけ送信します。
+		PipelineHandle	m_pipeline;
+		BufferHandle	m_frameConstantBuffers[MaxViews];
+		RenderMesh		m_cube;
+
+		// キューブの下に並べ、波のように動かすタイル。キューブのメッシュをインスタンス化して 1 回で描画します。
+		PipelineHandle		m_instancedPipeline;
+		InstanceTransforms	m_tiles;
+		std::vector<float>	m_tilePhases;
+
+		// キューブとタイルの境界を入れる BVH。タイルが動くたびに refit し、ビューごとに視錐台で見えるものだけを描画します。
+		DynamicBvh				m_sceneBvh;
+		std::vector<uint32_t>	m_tileProxies;
+
+		// プロジェクターごとのビュー。少なくとも 1 つあります。
+		std::vector<View>		m_views;
+
+		// 両方の読み込みが終わってパイプラインを作成するまで保持するシェーダー。
+		std::vector<byte>	m_vertexShaderData;
+		std::vector<byte>	m_pixelShaderData;
+		std::vector<byte>	m_instancedVertexShaderData;
+
+		// キューブ ジオメトリのシステム リソース。行ベクトル規約の行列で、定数バッファーに書き込むときに転置します。
+		Float4x4	m_model;
 
 		// レンダリング ループで使用する変数。
 		bool	m_loadingComplete;
@@ -38,20 +38,25 @@ SampleFpsTextRenderer::SampleFpsTextRenderer(const std::shared_ptr<DX::DeviceRes
 }
 
 // 表示するテキストを更新します。
-void SampleFpsTextRenderer::Update(DX::StepTimer const& timer)
+void SampleFpsTextRenderer::Update(DX::StepTimer const& timer, const SubmitStatistics& statistics)
 {
 	// 表示するテキストを更新します。
 	uint32 fps = timer.GetFramesPerSecond();
 
 	m_text = (fps > 0) ? std::to_wstring(fps) + L" FPS" : L" - FPS";
 
+	// 描画の数、状態の変更の数、Submit の時間を 2 行目に表示します。
+	wchar_t statisticsText[64];
+	swprintf_s(statisticsText, L"\n%u draws, %u states, %.2f ms", statistics.draws, statistics.stateChanges, statistics.submitMilliseconds);
+	m_text += statisticsText;
+
 	DX::ThrowIfFailed(
 		m_deviceResources->GetDWriteFactory()->CreateTextLayout(
 			m_text.c_str(),
 			(uint32) m_text.length(),
 			m_textFormat.Get(),
-			240.0f, // 入力テキストの最大幅。
-			50.0f, // 入力テキストの最大高さ。
+			480.0f, // 入力テキストの最大幅。
+			100.0f, // 入力テキストの最大高さ。
 			&m_textLayout
 			)
 		);
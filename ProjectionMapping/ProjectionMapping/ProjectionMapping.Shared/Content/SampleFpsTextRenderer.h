@@ -3,17 +3,18 @@
 #include <string>
 #include "..\Common\DeviceResources.h"
 #include "..\Common\StepTimer.h"
+#include "..\Rendering\RenderBackend.h"
 
 namespace ProjectionMapping
 {
-	// Direct2D および DirectWrite を使用して、画面右下隅に現在の FPS 値を描画します。
+	// Direct2D および DirectWrite を使用して、画面右下隅に現在の FPS 値と、前のフレームの描画の統計を描画します。
 	class SampleFpsTextRenderer
 	{
 	public:
 		SampleFpsTextRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources);
 		void CreateDeviceDependentResources();
 		void ReleaseDeviceDependentResources();
-		void Update(DX::StepTimer const& timer);
+		void Update(DX::StepTimer const& timer, const SubmitStatistics& statistics);
 		void Render();
 
 	private:
@@ -1,9 +1,8 @@
-// WIg쐬邽߂ 3 ̊{IȗD̃}gbNXۑ萔obt@[B
-cbuffer ModelViewProjectionConstantBuffer : register(b0)
+// CPU  model, view, projection |킹D̃}gbNXۑAIuWFNgƂ̒萔obt@[B
+// Xbg 0 ̃t[Ƃ̒萔obt@[ (ViewProjectionConstantBuffer) ͎gp܂B
+cbuffer ObjectConstantBuffer : register(b1)
 {
-	matrix model;
-	matrix view;
-	matrix projection;
+	matrix modelViewProjection;
 };
 
 // _VF[_[ւ̓͂ƂĎgp钸_Ƃ̃f[^B
@@ -27,9 +26,7 @@ PixelShaderInput main(VertexShaderInput input)
 	float4 pos = float4(input.pos, 1.0f);
 
 	// _̈ʒuAˉeꂽ̈ɕϊ܂B
-	pos = mul(pos, model);
-	pos = mul(pos, view);
-	pos = mul(pos, projection);
+	pos = mul(pos, modelViewProjection);
 	output.pos = pos;
 
 	// ύXɐFpXX[܂B
@@ -1,19 +1,26 @@
 ﻿#pragma once
 
+#include "..\Math\VectorMath.h"
+
 namespace ProjectionMapping
 {
-	// MVP マトリックスを頂点シェーダーに送信するために使用する定数バッファー。
-	struct ModelViewProjectionConstantBuffer
+	// ビューとプロジェクションを掛け合わせたマトリックスを頂点シェーダーに送信する、フレームごとの定数バッファー (スロット 0)。
+	// ウィンドウのサイズやキャリブレーションが変わったときだけ更新します。
+	struct ViewProjectionConstantBuffer
+	{
+		Float4x4 viewProjection;
+	};
+
+	// CPU で計算した MVP マトリックスを頂点シェーダーに送信する、オブジェクトごとの定数バッファー (スロット 1)。
+	struct ObjectConstantBuffer
 	{
-		DirectX::XMFLOAT4X4 model;
-		DirectX::XMFLOAT4X4 view;
-		DirectX::XMFLOAT4X4 projection;
+		Float4x4 modelViewProjection;
 	};
 
 	// 頂点シェーダーへの頂点ごとのデータの送信に使用します。
 	struct VertexPositionColor
 	{
-		DirectX::XMFLOAT3 pos;
-		DirectX::XMFLOAT3 color;
+		Float3 pos;
+		Float3 color;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,105 @@
+﻿#include "pch.h"
+#include "WarpPostProcess.h"
+
+#include "..\Common\DirectXHelper.h"
+
+using namespace ProjectionMapping;
+
+using namespace Microsoft::WRL;
+
+WarpPostProcess::WarpPostProcess(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources)
+{
+}
+
+// バック バッファーの大きさが変わるため、ステージング テクスチャを作り直します。
+void WarpPostProcess::CreateWindowSizeDependentResources()
+{
+	m_stagingTexture.Reset();
+}
+
+void WarpPostProcess::ReleaseDeviceDependentResources()
+{
+	m_stagingTexture.Reset();
+}
+
+void WarpPostProcess::SetRemapTable(const RemapTable& table)
+{
+	m_remapTable = table;
+}
+
+// source を読み戻してワープし、結果でバック バッファーを上書きします。
+void WarpPostProcess::Render(ID3D11Texture2D* source)
+{
+	auto context = m_deviceResources->GetD3DDeviceContext();
+
+	ComPtr<ID3D11Resource> backBufferResource;
+	m_deviceResources->GetBackBufferRenderTargetView()->GetResource(&backBufferResource);
+
+	ComPtr<ID3D11Texture2D> backBuffer;
+	DX::ThrowIfFailed(
+		backBufferResource.As(&backBuffer)
+		);
+
+	D3D11_TEXTURE2D_DESC backBufferDesc;
+	backBuffer->GetDesc(&backBufferDesc);
+
+	// テーブルは出力画素ごとに 1 要素なので、大きさが一致しない間はゆがめずに出力します。
+	if (!IsEnabled() || backBufferDesc.Width != m_remapTable.GetWidth() || backBufferDesc.Height != m_remapTable.GetHeight())
+	{
+		context->CopyResource(backBuffer.Get(), source);
+		return;
+	}
+
+	if (m_stagingTexture == nullptr)
+	{
+		CD3D11_TEXTURE2D_DESC stagingDesc(
+			backBufferDesc.Format,
+			backBufferDesc.Width,
+			backBufferDesc.Height,
+			1,
+			1,
+			0,
+			D3D11_USAGE_STAGING,
+			D3D11_CPU_ACCESS_READ
+			);
+
+		DX::ThrowIfFailed(
+			m_deviceResources->GetD3DDevice()->CreateTexture2D(
+				&stagingDesc,
+				nullptr,
+				&m_stagingTexture
+				)
+			);
+
+		m_warpedImage.resize(backBufferDesc.Width * backBufferDesc.Height * 4);
+	}
+
+	context->CopyResource(m_stagingTexture.Get(), source);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	DX::ThrowIfFailed(
+		context->Map(m_stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mapped)
+		);
+
+	m_warper.Apply(
+		m_remapTable,
+		static_cast<const uint8_t*>(mapped.pData),
+		backBufferDesc.Width,
+		backBufferDesc.Height,
+		mapped.RowPitch,
+		m_warpedImage.data(),
+		backBufferDesc.Width * 4
+		);
+
+	context->Unmap(m_stagingTexture.Get(), 0);
+
+	context->UpdateSubresource(
+		backBuffer.Get(),
+		0,
+		nullptr,
+		m_warpedImage.data(),
+		backBufferDesc.Width * 4,
+		0
+		);
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+#include <vector>
+#include "..\Common\DeviceResources.h"
+#include "..\Imaging\ImageWarp.h"
+
+namespace ProjectionMapping
+{
+	// シーンを描画したテクスチャを CPU に読み戻し、リマップ テーブルでプリディストーションしてバック バッファーに書き込みます。
+	// 曲面や斜めの投影面に合わせて出力全体をゆがめるための後処理です。
+	class WarpPostProcess
+	{
+	public:
+		WarpPostProcess(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+		void CreateWindowSizeDependentResources();
+		void ReleaseDeviceDependentResources();
+
+		// バック バッファーと同じ大きさのテーブルを設定します。空のテーブルで後処理を無効にします。
+		void SetRemapTable(const RemapTable& table);
+		bool IsEnabled() const { return !m_remapTable.IsEmpty(); }
+
+		// source はバック バッファーと同じ形式と大きさのテクスチャです。後処理が無効な場合は source をそのままコピーします。
+		void Render(ID3D11Texture2D* source);
+
+	private:
+		// デバイス リソースへのキャッシュされたポインター。
+		std::shared_ptr<DX::DeviceResources> m_deviceResources;
+
+		// シーンの読み戻し用のステージング テクスチャ。
+		Microsoft::WRL::ComPtr<ID3D11Texture2D>	m_stagingTexture;
+
+		// ワープのシステム リソース。
+		RemapTable				m_remapTable;
+		ImageWarper				m_warper;
+		std::vector<uint8_t>	m_warpedImage;
+	};
+}
@@ -0,0 +1,271 @@
+﻿#include "ImageWarp.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PROJECTIONMAPPING_WARP_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PROJECTIONMAPPING_WARP_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace ProjectionMapping;
+
+const int32_t RemapTable::InvalidCoordinate;
+
+namespace
+{
+	const float FixedOne = 65536.0f;
+
+	// 2 画素間の線形補間。SIMD 版と同じ丸めを行うため、結果はビット単位で一致します。
+	inline uint32_t LerpChannel(uint32_t a, uint32_t b, uint32_t weight)
+	{
+		return (a * (256 - weight) + b * weight + 128) >> 8;
+	}
+
+	inline uint32_t LerpPixel(uint32_t a, uint32_t b, uint32_t weight)
+	{
+		uint32_t result = 0;
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			result |= LerpChannel((a >> shift) & 0xFF, (b >> shift) & 0xFF, weight) << shift;
+		}
+		return result;
+	}
+
+	inline const uint32_t* SourceRow(const uint8_t* source, uint32_t stride, int32_t y)
+	{
+		return reinterpret_cast<const uint32_t*>(source + static_cast<size_t>(y) * stride);
+	}
+
+	// 画像の端にかかる画素の補間。範囲外の近傍は端の画素で置き換えます。
+	uint32_t SampleClamped(const uint8_t* source, int32_t width, int32_t height, uint32_t stride, int32_t fixedX, int32_t fixedY)
+	{
+		if (fixedX == RemapTable::InvalidCoordinate)
+		{
+			return 0;
+		}
+
+		int32_t x0 = fixedX >> 16;
+		int32_t y0 = fixedY >> 16;
+		if (x0 < -1 || y0 < -1 || x0 >= width || y0 >= height)
+		{
+			return 0;
+		}
+
+		uint32_t fx = (fixedX >> 8) & 0xFF;
+		uint32_t fy = (fixedY >> 8) & 0xFF;
+
+		int32_t x1 = x0 + 1 < width ? x0 + 1 : width - 1;
+		int32_t y1 = y0 + 1 < height ? y0 + 1 : height - 1;
+		x0 = x0 < 0 ? 0 : x0;
+		y0 = y0 < 0 ? 0 : y0;
+
+		const uint32_t* row0 = SourceRow(source, stride, y0);
+		const uint32_t* row1 = SourceRow(source, stride, y1);
+
+		uint32_t top = LerpPixel(row0[x0], row0[x1], fx);
+		uint32_t bottom = LerpPixel(row1[x0], row1[x1], fx);
+		return LerpPixel(top, bottom, fy);
+	}
+
+	// 近傍 4 画素がすべて画像内にある画素の補間。
+	inline uint32_t SampleInterior(const uint8_t* source, uint32_t stride, int32_t fixedX, int32_t fixedY)
+	{
+		int32_t x0 = fixedX >> 16;
+		int32_t y0 = fixedY >> 16;
+		uint32_t fx = (fixedX >> 8) & 0xFF;
+		uint32_t fy = (fixedY >> 8) & 0xFF;
+
+		const uint32_t* row0 = SourceRow(source, stride, y0) + x0;
+		const uint32_t* row1 = SourceRow(source, stride, y0 + 1) + x0;
+
+#if defined(PROJECTIONMAPPING_WARP_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i round = _mm_set1_epi16(128);
+
+		// 上下の行からそれぞれ隣接 2 画素を 16 ビットに展開します: [p0 (BGRA), p1 (BGRA)]
+		__m128i top = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row0)), zero);
+		__m128i bottom = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row1)), zero);
+
+		short wx0 = static_cast<short>(256 - fx), wx1 = static_cast<short>(fx);
+		__m128i weightX = _mm_set_epi16(wx1, wx1, wx1, wx1, wx0, wx0, wx0, wx0);
+
+		top = _mm_mullo_epi16(top, weightX);
+		bottom = _mm_mullo_epi16(bottom, weightX);
+		top = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(top, _mm_srli_si128(top, 8)), round), 8);
+		bottom = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(bottom, _mm_srli_si128(bottom, 8)), round), 8);
+
+		short wy0 = static_cast<short>(256 - fy), wy1 = static_cast<short>(fy);
+		__m128i weightY = _mm_set_epi16(wy1, wy1, wy1, wy1, wy0, wy0, wy0, wy0);
+
+		__m128i vertical = _mm_mullo_epi16(_mm_unpacklo_epi64(top, bottom), weightY);
+		vertical = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(vertical, _mm_srli_si128(vertical, 8)), round), 8);
+
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(vertical, zero)));
+#elif defined(PROJECTIONMAPPING_WARP_NEON)
+		uint16x8_t top = vmovl_u8(vld1_u8(reinterpret_cast<const uint8_t*>(row0)));
+		uint16x8_t bottom = vmovl_u8(vld1_u8(reinterpret_cast<const uint8_t*>(row1)));
+
+		uint16x8_t weightX = vcombine_u16(vdup_n_u16(static_cast<uint16_t>(256 - fx)), vdup_n_u16(static_cast<uint16_t>(fx)));
+		top = vmulq_u16(top, weightX);
+		bottom = vmulq_u16(bottom, weightX);
+
+		uint16x4_t topSum = vrshr_n_u16(vadd_u16(vget_low_u16(top), vget_high_u16(top)), 8);
+		uint16x4_t bottomSum = vrshr_n_u16(vadd_u16(vget_low_u16(bottom), vget_high_u16(bottom)), 8);
+
+		uint16x8_t weightY = vcombine_u16(vdup_n_u16(static_cast<uint16_t>(256 - fy)), vdup_n_u16(static_cast<uint16_t>(fy)));
+		uint16x8_t vertical = vmulq_u16(vcombine_u16(topSum, bottomSum), weightY);
+		uint16x4_t result = vrshr_n_u16(vadd_u16(vget_low_u16(vertical), vget_high_u16(vertical)), 8);
+
+		return vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(result, result))), 0);
+#else
+		uint32_t top = LerpPixel(row0[0], row0[1], fx);
+		uint32_t bottom = LerpPixel(row1[0], row1[1], fx);
+		return LerpPixel(top, bottom, fy);
+#endif
+	}
+
+	void WarpSpan(
+		const int32_t* coordinates,
+		uint32_t count,
+		const uint8_t* source,
+		int32_t sourceWidth,
+		int32_t sourceHeight,
+		uint32_t sourceStride,
+		uint32_t* destination)
+	{
+		// 内部の画素は 16.16 の座標が [0, size - 1) の範囲にあります。
+		const uint32_t maxInteriorX = static_cast<uint32_t>(sourceWidth - 1) << 16;
+		const uint32_t maxInteriorY = static_cast<uint32_t>(sourceHeight - 1) << 16;
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			int32_t fixedX = coordinates[i * 2 + 0];
+			int32_t fixedY = coordinates[i * 2 + 1];
+
+			// 符号なし比較で負の座標と無効値もまとめて除外します。
+			if (static_cast<uint32_t>(fixedX) < maxInteriorX && static_cast<uint32_t>(fixedY) < maxInteriorY)
+			{
+				destination[i] = SampleInterior(source, sourceStride, fixedX, fixedY);
+			}
+			else
+			{
+				destination[i] = SampleClamped(source, sourceWidth, sourceHeight, sourceStride, fixedX, fixedY);
+			}
+		}
+	}
+}
+
+RemapTable::RemapTable() :
+	m_width(0),
+	m_height(0),
+	m_generation(0)
+{
+}
+
+void RemapTable::Resize(uint32_t width, uint32_t height)
+{
+	m_width = width;
+	m_height = height;
+	m_coordinates.assign(static_cast<size_t>(width) * height * 2, InvalidCoordinate);
+	m_generation++;
+}
+
+void RemapTable::Set(uint32_t x, uint32_t y, float sourceX, float sourceY)
+{
+	size_t index = (static_cast<size_t>(y) * m_width + x) * 2;
+
+	// 16.16 に収まらない座標は画像外として扱います。
+	if (!(fabsf(sourceX) < 32767.0f) || !(fabsf(sourceY) < 32767.0f))
+	{
+		SetInvalid(x, y);
+		return;
+	}
+
+	m_coordinates[index + 0] = static_cast<int32_t>(floorf(sourceX * FixedOne + 0.5f));
+	m_coordinates[index + 1] = static_cast<int32_t>(floorf(sourceY * FixedOne + 0.5f));
+}
+
+void RemapTable::SetInvalid(uint32_t x, uint32_t y)
+{
+	size_t index = (static_cast<size_t>(y) * m_width + x) * 2;
+	m_coordinates[index + 0] = InvalidCoordinate;
+	m_coordinates[index + 1] = InvalidCoordinate;
+}
+
+void RemapTable::SetIdentity()
+{
+	for (uint32_t y = 0; y < m_height; y++)
+	{
+		for (uint32_t x = 0; x < m_width; x++)
+		{
+			size_t index = (static_cast<size_t>(y) * m_width + x) * 2;
+			m_coordinates[index + 0] = static_cast<int32_t>(x << 16);
+			m_coordinates[index + 1] = static_cast<int32_t>(y << 16);
+		}
+	}
+	m_generation++;
+}
+
+ImageWarper::ImageWarper() :
+	m_tileWidth(64),
+	m_tileHeight(32)
+{
+}
+
+void ImageWarper::SetTileSize(uint32_t width, uint32_t height)
+{
+	m_tileWidth = width > 0 ? width : 1;
+	m_tileHeight = height > 0 ? height : 1;
+}
+
+void ImageWarper::Apply(
+	const RemapTable& table,
+	const uint8_t* source,
+	uint32_t sourceWidth,
+	uint32_t sourceHeight,
+	uint32_t sourceStride,
+	uint8_t* destination,
+	uint32_t destinationStride
+	) const
+{
+	const uint32_t width = table.GetWidth();
+	const uint32_t height = table.GetHeight();
+
+	if (table.IsEmpty() || !source || !destination || sourceWidth == 0 || sourceHeight == 0)
+	{
+		return;
+	}
+
+	const uint32_t tileWidth = m_tileWidth;
+	const uint32_t tileHeight = m_tileHeight;
+	const uint32_t tilesX = (width + tileWidth - 1) / tileWidth;
+	const uint32_t tilesY = (height + tileHeight - 1) / tileHeight;
+	const int32_t* coordinates = table.GetData();
+
+	DX::ParallelFor(0, static_cast<size_t>(tilesX) * tilesY, [&](size_t tile)
+	{
+		uint32_t x0 = static_cast<uint32_t>(tile % tilesX) * tileWidth;
+		uint32_t y0 = static_cast<uint32_t>(tile / tilesX) * tileHeight;
+		uint32_t x1 = (x0 + tileWidth < width) ? x0 + tileWidth : width;
+		uint32_t y1 = (y0 + tileHeight < height) ? y0 + tileHeight : height;
+
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			WarpSpan(
+				coordinates + (static_cast<size_t>(y) * width + x0) * 2,
+				x1 - x0,
+				source,
+				static_cast<int32_t>(sourceWidth),
+				static_cast<int32_t>(sourceHeight),
+				sourceStride,
+				reinterpret_cast<uint32_t*>(destination + static_cast<size_t>(y) * destinationStride) + x0
+				);
+		}
+	});
+}
@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ProjectionMapping
+{
+	// 出力画素ごとの参照元座標を 16.16 固定小数点で保持するリマップ テーブル。
+	class RemapTable
+	{
+	public:
+		// 参照元がない画素を示す値。出力は透明な黒になります。
+		static const int32_t InvalidCoordinate = INT32_MIN;
+
+		RemapTable();
+
+		void Resize(uint32_t width, uint32_t height);
+
+		// 出力画素 (x, y) が参照元画像の (sourceX, sourceY) を参照するように設定します。
+		void Set(uint32_t x, uint32_t y, float sourceX, float sourceY);
+		void SetInvalid(uint32_t x, uint32_t y);
+
+		// mapping(x, y, &sourceX, &sourceY) で全画素を設定します。false を返した画素は無効になります。
+		template<typename TMapping>
+		void Fill(const TMapping& mapping)
+		{
+			for (uint32_t y = 0; y < m_height; y++)
+			{
+				for (uint32_t x = 0; x < m_width; x++)
+				{
+					float sourceX, sourceY;
+					if (mapping(x, y, &sourceX, &sourceY))
+					{
+						Set(x, y, sourceX, sourceY);
+					}
+					else
+					{
+						SetInvalid(x, y);
+					}
+				}
+			}
+			m_generation++;
+		}
+
+		// 参照元座標を恒等写像に設定します。
+		void SetIdentity();
+
+		uint32_t GetWidth() const				{ return m_width; }
+		uint32_t GetHeight() const				{ return m_height; }
+		uint32_t GetGeneration() const			{ return m_generation; }
+		bool IsEmpty() const					{ return m_coordinates.empty(); }
+
+		// x, y の組が行優先で並びます。
+		const int32_t* GetData() const			{ return m_coordinates.data(); }
+
+	private:
+		std::vector<int32_t>	m_coordinates;
+		uint32_t				m_width;
+		uint32_t				m_height;
+		uint32_t				m_generation;
+	};
+
+	// BGRA 画像にリマップ テーブルを適用する双線形ワープ。
+	// 出力をキャッシュに収まるタイルに分割し、タイルをスレッドに分配して SIMD で補間します。
+	class ImageWarper
+	{
+	public:
+		ImageWarper();
+
+		// 出力 1 タイルの大きさ (画素)。参照元の局所性が高いほど大きなタイルが有利です。
+		void SetTileSize(uint32_t width, uint32_t height);
+
+		// source (sourceWidth x sourceHeight) を table に従って destination (テーブルと同じ大きさ) にワープします。
+		// ストライドはバイト単位です。
+		void Apply(
+			const RemapTable& table,
+			const uint8_t* source,
+			uint32_t sourceWidth,
+			uint32_t sourceHeight,
+			uint32_t sourceStride,
+			uint8_t* destination,
+			uint32_t destinationStride
+			) const;
+
+	private:
+		uint32_t	m_tileWidth;
+		uint32_t	m_tileHeight;
+	};
+}
@@ -0,0 +1,156 @@
+﻿#pragma once
+
+#include <limits>
+#include "VectorMath.h"
+
+namespace ProjectionMapping
+{
+	// 軸に平行な境界ボックス。
+	struct Aabb
+	{
+		float min[3];
+		float max[3];
+
+		// 何も含まない境界。Merge で最初の境界がそのまま入ります。
+		static Aabb Empty()
+		{
+			const float infinity = std::numeric_limits<float>::infinity();
+			Aabb box = { { infinity, infinity, infinity }, { -infinity, -infinity, -infinity } };
+			return box;
+		}
+
+		static Aabb FromCenterExtent(float centerX, float centerY, float centerZ, float extentX, float extentY, float extentZ)
+		{
+			Aabb box = { { centerX - extentX, centerY - extentY, centerZ - extentZ }, { centerX + extentX, centerY + extentY, centerZ + extentZ } };
+			return box;
+		}
+
+		bool IsEmpty() const
+		{
+			return min[0] > max[0] || min[1] > max[1] || min[2] > max[2];
+		}
+
+		void Merge(const Aabb& other)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				min[i] = other.min[i] < min[i] ? other.min[i] : min[i];
+				max[i] = other.max[i] > max[i] ? other.max[i] : max[i];
+			}
+		}
+
+		bool Contains(const Aabb& other) const
+		{
+			return min[0] <= other.min[0] && min[1] <= other.min[1] && min[2] <= other.min[2] &&
+				max[0] >= other.max[0] && max[1] >= other.max[1] && max[2] >= other.max[2];
+		}
+
+		// 表面積の半分。SAH のコストの比較に使用します。空の境界は 0 です。
+		float HalfArea() const
+		{
+			if (IsEmpty())
+			{
+				return 0.0f;
+			}
+			const float dx = max[0] - min[0], dy = max[1] - min[1], dz = max[2] - min[2];
+			return dx * dy + dy * dz + dz * dx;
+		}
+	};
+
+	// ビュー プロジェクション行列の 6 つの平面で囲まれた視錐台。
+	// 平面を要素ごとの配列 (SoA) で 8 枚分保持し、境界ボックスを 4 枚ずつ SIMD で判定します。
+	class Frustum
+	{
+	public:
+		enum Containment
+		{
+			Outside,		// すべての点が平面の外側にあります。
+			Intersecting,	// 平面をまたいでいます。
+			Inside			// すべての点が視錐台の内側にあります。
+		};
+
+		// すべての平面が 0 の視錐台。どの境界ボックスも内側と判定します。
+		Frustum()
+		{
+			for (int i = 0; i < PlaneSlots; i++)
+			{
+				m_x[i] = m_y[i] = m_z[i] = m_w[i] = 0.0f;
+				m_absX[i] = m_absY[i] = m_absZ[i] = 0.0f;
+			}
+		}
+
+		// 行ベクトル規約のビュー プロジェクション行列から平面を取り出します。クリップ空間の深度は D3D と同じ 0..w です。
+		// 平面は正規化しません。判定は符号だけを使用するので、結果は変わりません。
+		static Frustum FromViewProjection(const Float4x4& viewProjection)
+		{
+			const float (*m)[4] = viewProjection.m;
+
+			// 左、右、下、上、近、遠の順に、クリップ座標 c = p * M の w * wScale + sign * c[column] >= 0 を表します。
+			const float wScales[6] = { 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+			const float signs[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+			const int columns[6] = { 0, 0, 1, 1, 2, 2 };
+
+			Frustum frustum;
+			for (int plane = 0; plane < PlaneSlots; plane++)
+			{
+				// 余った 2 枚は左の平面を繰り返し、判定に影響しないようにします。
+				const int p = plane < 6 ? plane : 0;
+				float coefficients[4];
+				for (int row = 0; row < 4; row++)
+				{
+					coefficients[row] = wScales[p] * m[row][3] + signs[p] * m[row][columns[p]];
+				}
+
+				frustum.m_x[plane] = coefficients[0];
+				frustum.m_y[plane] = coefficients[1];
+				frustum.m_z[plane] = coefficients[2];
+				frustum.m_w[plane] = coefficients[3];
+				frustum.m_absX[plane] = std::fabs(coefficients[0]);
+				frustum.m_absY[plane] = std::fabs(coefficients[1]);
+				frustum.m_absZ[plane] = std::fabs(coefficients[2]);
+			}
+			return frustum;
+		}
+
+		// 境界ボックスの中心 c と半径 e について、各平面の n・c + w と |n|・e を 4 枚ずつ比べます。
+		Containment Test(const Aabb& box) const
+		{
+			const Vector half = Vector::Splat(0.5f);
+			const Vector minimum = Vector::Load3(box.min, 0.0f);
+			const Vector maximum = Vector::Load3(box.max, 0.0f);
+			const Vector center = (minimum + maximum) * half;
+			const Vector extent = (maximum - minimum) * half;
+			const Vector cx = center.SplatX(), cy = center.SplatY(), cz = center.SplatZ();
+			const Vector ex = extent.SplatX(), ey = extent.SplatY(), ez = extent.SplatZ();
+			const Vector zero = Vector::Zero();
+
+			int intersecting = 0;
+			for (int i = 0; i < PlaneSlots; i += 4)
+			{
+				const Vector distance = Vector::MultiplyAdd(Vector::Load(m_x + i), cx,
+					Vector::MultiplyAdd(Vector::Load(m_y + i), cy,
+					Vector::MultiplyAdd(Vector::Load(m_z + i), cz, Vector::Load(m_w + i))));
+				const Vector radius = Vector::MultiplyAdd(Vector::Load(m_absX + i), ex,
+					Vector::MultiplyAdd(Vector::Load(m_absY + i), ey, Vector::Load(m_absZ + i) * ez));
+
+				if (Vector::LessMask(distance + radius, zero) != 0)
+				{
+					return Outside;
+				}
+				intersecting |= Vector::LessMask(distance - radius, zero);
+			}
+			return intersecting != 0 ? Intersecting : Inside;
+		}
+
+	private:
+		static const int PlaneSlots = 8;
+
+		float m_x[PlaneSlots];
+		float m_y[PlaneSlots];
+		float m_z[PlaneSlots];
+		float m_w[PlaneSlots];
+		float m_absX[PlaneSlots];
+		float m_absY[PlaneSlots];
+		float m_absZ[PlaneSlots];
+	};
+}
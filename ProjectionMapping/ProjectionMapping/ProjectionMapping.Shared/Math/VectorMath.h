@@ -0,0 +1,852 @@
+﻿#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// ヘッダーだけのベクトル、行列、クォータニオンのライブラリ。DirectXMath の代わりに Windows 以外でも使用します。
+// 規約は DirectXMath と同じ行ベクトル (v * M) で、行列の積、変換、正規化、三角関数は DirectXMath の SSE2 の経路と
+// 同じ順序で計算し、同じ入力から同じビット列の結果になることを目指しています。SSE2 (AVX)、NEON、スカラーの経路は互いに一致します。
+// DirectXMath 自体との照合は VectorMathTest の VECTORMATHTEST_CAPTURE_DIRECTXMATH で行います。
+// 積和は融合しない乗算と加算で計算します。GCC や Clang で FMA を有効にする場合は -ffp-contract=off を指定してください。
+// Vector と Matrix は SIMD レジスターを保持するので、引数には参照で渡し、配列に保存する場合は Float4x4 などに格納します。
+
+// PROJECTIONMAPPING_MATH_NO_INTRINSICS を定義すると、どのプロセッサーでもスカラーの経路を使用します (_XM_NO_INTRINSICS_ と同じ)。
+
+#if defined(PROJECTIONMAPPING_MATH_NO_INTRINSICS)
+#elif defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PROJECTIONMAPPING_MATH_SSE2
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define PROJECTIONMAPPING_MATH_AVX
+#include <immintrin.h>
+#endif
+#elif defined(_M_ARM) || defined(_M_ARM64) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PROJECTIONMAPPING_MATH_NEON
+#include <arm_neon.h>
+#if defined(_M_ARM64) || defined(__aarch64__)
+#define PROJECTIONMAPPING_MATH_NEON64
+#endif
+#endif
+
+namespace ProjectionMapping
+{
+	// XM_PI などと同じ値。
+	const float Pi = 3.141592654f;
+	const float TwoPi = 6.283185307f;
+	const float HalfPi = 1.570796327f;
+	const float InverseTwoPi = 0.159154943f;
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	// DirectXMath と同じ行ベクトル規約 (v * M) の 4x4 行列。XMFLOAT4X4 と同じレイアウトです。
+	struct Float4x4
+	{
+		float m[4][4];
+	};
+
+	class Scalar
+	{
+	public:
+		static float ToRadians(float degrees)
+		{
+			return degrees * (Pi / 180.0f);
+		}
+
+		// XMScalarSinCos と同じ多項式近似 (sin は 11 次、cos は 10 次) です。角度を [-π, π] に畳んでから評価します。
+		static void SinCos(float angle, float* sine, float* cosine)
+		{
+			float quotient = InverseTwoPi * angle;
+			if (angle >= 0.0f)
+			{
+				quotient = static_cast<float>(static_cast<int>(quotient + 0.5f));
+			}
+			else
+			{
+				quotient = static_cast<float>(static_cast<int>(quotient - 0.5f));
+			}
+			float y = angle - TwoPi * quotient;
+
+			// sin(y) が変わらないように [-π/2, π/2] に折り返します。cos は符号が反転します。
+			float sign;
+			if (y > HalfPi)
+			{
+				y = Pi - y;
+				sign = -1.0f;
+			}
+			else if (y < -HalfPi)
+			{
+				y = -Pi - y;
+				sign = -1.0f;
+			}
+			else
+			{
+				sign = +1.0f;
+			}
+
+			const float y2 = y * y;
+			*sine = (((((-2.3889859e-08f * y2 + 2.7525562e-06f) * y2 - 0.00019840874f) * y2 + 0.0083333310f) * y2 - 0.16666667f) * y2 + 1.0f) * y;
+
+			const float p = ((((-2.6051615e-07f * y2 + 2.4760495e-05f) * y2 - 0.0013888378f) * y2 + 0.041666638f) * y2 - 0.5f) * y2 + 1.0f;
+			*cosine = sign * p;
+		}
+	};
+
+	// 4 要素の float のベクトル。3 次元の点や方向は w を 1 か 0 にして使用します。
+	class Vector
+	{
+	public:
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+		typedef __m128 Native;
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+		typedef float32x4_t Native;
+#else
+		struct Native
+		{
+			float v[4];
+		};
+#endif
+
+		Vector()
+		{
+		}
+
+		explicit Vector(Native value) :
+			m_v(value)
+		{
+		}
+
+		Native GetNative() const							{ return m_v; }
+
+		static Vector Set(float x, float y, float z, float w)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_set_ps(w, z, y, x));
+#else
+			const float values[4] = { x, y, z, w };
+			return Load(values);
+#endif
+		}
+
+		static Vector Splat(float value)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_set1_ps(value));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vdupq_n_f32(value));
+#else
+			return Set(value, value, value, value);
+#endif
+		}
+
+		static Vector Zero()
+		{
+			return Splat(0.0f);
+		}
+
+		// 4 個の float を読み込みます。整列は不要です。
+		static Vector Load(const float* p)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_loadu_ps(p));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vld1q_f32(p));
+#else
+			Native r;
+			for (int i = 0; i < 4; i++)
+			{
+				r.v[i] = p[i];
+			}
+			return Vector(r);
+#endif
+		}
+
+		// 3 個の float を読み込み、w を設定します。p[3] は読みません。
+		static Vector Load3(const float* p, float w)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			const __m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+			const __m128 zw = _mm_set_ps(0.0f, 0.0f, w, p[2]);
+			return Vector(_mm_movelh_ps(xy, zw));
+#else
+			return Set(p[0], p[1], p[2], w);
+#endif
+		}
+
+		void Store(float* p) const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			_mm_storeu_ps(p, m_v);
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			vst1q_f32(p, m_v);
+#else
+			for (int i = 0; i < 4; i++)
+			{
+				p[i] = m_v.v[i];
+			}
+#endif
+		}
+
+		// x, y, z だけを書き込みます。p[3] には触れません。
+		void Store3(float* p) const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			_mm_store_sd(reinterpret_cast<double*>(p), _mm_castps_pd(m_v));
+			_mm_store_ss(p + 2, _mm_movehl_ps(m_v, m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			vst1_f32(p, vget_low_f32(m_v));
+			vst1q_lane_f32(p + 2, m_v, 2);
+#else
+			for (int i = 0; i < 3; i++)
+			{
+				p[i] = m_v.v[i];
+			}
+#endif
+		}
+
+		float GetX() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return _mm_cvtss_f32(m_v);
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return vgetq_lane_f32(m_v, 0);
+#else
+			return m_v.v[0];
+#endif
+		}
+
+		float GetY() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return _mm_cvtss_f32(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(1, 1, 1, 1)));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return vgetq_lane_f32(m_v, 1);
+#else
+			return m_v.v[1];
+#endif
+		}
+
+		float GetZ() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return _mm_cvtss_f32(_mm_movehl_ps(m_v, m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return vgetq_lane_f32(m_v, 2);
+#else
+			return m_v.v[2];
+#endif
+		}
+
+		float GetW() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return _mm_cvtss_f32(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(3, 3, 3, 3)));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return vgetq_lane_f32(m_v, 3);
+#else
+			return m_v.v[3];
+#endif
+		}
+
+		// 1 つの要素をすべての要素に複製します。
+		Vector SplatX() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(0, 0, 0, 0)));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vdupq_lane_f32(vget_low_f32(m_v), 0));
+#else
+			return Splat(m_v.v[0]);
+#endif
+		}
+
+		Vector SplatY() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(1, 1, 1, 1)));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vdupq_lane_f32(vget_low_f32(m_v), 1));
+#else
+			return Splat(m_v.v[1]);
+#endif
+		}
+
+		Vector SplatZ() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(2, 2, 2, 2)));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vdupq_lane_f32(vget_high_f32(m_v), 0));
+#else
+			return Splat(m_v.v[2]);
+#endif
+		}
+
+		Vector SplatW() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_shuffle_ps(m_v, m_v, _MM_SHUFFLE(3, 3, 3, 3)));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vdupq_lane_f32(vget_high_f32(m_v), 1));
+#else
+			return Splat(m_v.v[3]);
+#endif
+		}
+
+		Vector operator+(const Vector& other) const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_add_ps(m_v, other.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vaddq_f32(m_v, other.m_v));
+#else
+			Native r;
+			for (int i = 0; i < 4; i++)
+			{
+				r.v[i] = m_v.v[i] + other.m_v.v[i];
+			}
+			return Vector(r);
+#endif
+		}
+
+		Vector operator-(const Vector& other) const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_sub_ps(m_v, other.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vsubq_f32(m_v, other.m_v));
+#else
+			Native r;
+			for (int i = 0; i < 4; i++)
+			{
+				r.v[i] = m_v.v[i] - other.m_v.v[i];
+			}
+			return Vector(r);
+#endif
+		}
+
+		// 要素ごとの積。
+		Vector operator*(const Vector& other) const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_mul_ps(m_v, other.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vmulq_f32(m_v, other.m_v));
+#else
+			Native r;
+			for (int i = 0; i < 4; i++)
+			{
+				r.v[i] = m_v.v[i] * other.m_v.v[i];
+			}
+			return Vector(r);
+#endif
+		}
+
+		// 要素ごとの商。ARMv7 の NEON には除算がないので、近似ではなく要素ごとに割ります。
+		Vector operator/(const Vector& other) const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_div_ps(m_v, other.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON64)
+			return Vector(vdivq_f32(m_v, other.m_v));
+#else
+			return Set(GetX() / other.GetX(), GetY() / other.GetY(), GetZ() / other.GetZ(), GetW() / other.GetW());
+#endif
+		}
+
+		Vector operator-() const
+		{
+			return Zero() - *this;
+		}
+
+		// a * b + c。融合しないので、乗算と加算を別々に丸めます。
+		static Vector MultiplyAdd(const Vector& a, const Vector& b, const Vector& c)
+		{
+			return a * b + c;
+		}
+
+		static Vector Sqrt(const Vector& v)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_sqrt_ps(v.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON64)
+			return Vector(vsqrtq_f32(v.m_v));
+#else
+			return Set(std::sqrt(v.GetX()), std::sqrt(v.GetY()), std::sqrt(v.GetZ()), std::sqrt(v.GetW()));
+#endif
+		}
+
+		static Vector Min(const Vector& a, const Vector& b)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_min_ps(a.m_v, b.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vminq_f32(a.m_v, b.m_v));
+#else
+			Native r;
+			for (int i = 0; i < 4; i++)
+			{
+				r.v[i] = a.m_v.v[i] < b.m_v.v[i] ? a.m_v.v[i] : b.m_v.v[i];
+			}
+			return Vector(r);
+#endif
+		}
+
+		static Vector Max(const Vector& a, const Vector& b)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return Vector(_mm_max_ps(a.m_v, b.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			return Vector(vmaxq_f32(a.m_v, b.m_v));
+#else
+			Native r;
+			for (int i = 0; i < 4; i++)
+			{
+				r.v[i] = a.m_v.v[i] > b.m_v.v[i] ? a.m_v.v[i] : b.m_v.v[i];
+			}
+			return Vector(r);
+#endif
+		}
+
+		// a < b の要素のビットを立てた 4 ビットのマスク (x がビット 0) を返します。
+		static int LessMask(const Vector& a, const Vector& b)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			return _mm_movemask_ps(_mm_cmplt_ps(a.m_v, b.m_v));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			static const uint32_t bits[4] = { 1, 2, 4, 8 };
+			const uint32x4_t masked = vandq_u32(vcltq_f32(a.m_v, b.m_v), vld1q_u32(bits));
+			const uint32x2_t pairs = vorr_u32(vget_low_u32(masked), vget_high_u32(masked));
+			return static_cast<int>(vget_lane_u32(pairs, 0) | vget_lane_u32(pairs, 1));
+#else
+			int mask = 0;
+			for (int i = 0; i < 4; i++)
+			{
+				mask |= (a.m_v.v[i] < b.m_v.v[i]) ? (1 << i) : 0;
+			}
+			return mask;
+#endif
+		}
+
+		// x, y, z の内積をすべての要素に複製します。(x*x + y*y) + z*z の順に足します。
+		static Vector Dot3(const Vector& a, const Vector& b)
+		{
+			const Vector product = a * b;
+			return (product.SplatX() + product.SplatY()) + product.SplatZ();
+		}
+
+		// x, y, z の外積。w は 0 です。
+		static Vector Cross3(const Vector& a, const Vector& b)
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			const __m128 a1 = _mm_shuffle_ps(a.m_v, a.m_v, _MM_SHUFFLE(3, 0, 2, 1));
+			const __m128 b1 = _mm_shuffle_ps(b.m_v, b.m_v, _MM_SHUFFLE(3, 1, 0, 2));
+			const __m128 a2 = _mm_shuffle_ps(a1, a1, _MM_SHUFFLE(3, 0, 2, 1));
+			const __m128 b2 = _mm_shuffle_ps(b1, b1, _MM_SHUFFLE(3, 1, 0, 2));
+			const __m128 result = _mm_sub_ps(_mm_mul_ps(a1, b1), _mm_mul_ps(a2, b2));
+			return Vector(_mm_and_ps(result, _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1))));
+#else
+			const float ax = a.GetX(), ay = a.GetY(), az = a.GetZ();
+			const float bx = b.GetX(), by = b.GetY(), bz = b.GetZ();
+			return Set(ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx, 0.0f);
+#endif
+		}
+
+		// x, y, z を長さ 1 にします。w も同じ長さで割ります。長さが 0 の場合は 0 を返します。
+		static Vector Normalize3(const Vector& v)
+		{
+			const Vector length = Sqrt(Dot3(v, v));
+			if (length.GetX() == 0.0f)
+			{
+				return Zero();
+			}
+			return v / length;
+		}
+
+	private:
+		Native m_v;
+	};
+
+	// 行ベクトル規約の 4x4 行列。rows[3] が平行移動です。
+	struct Matrix
+	{
+		Vector rows[4];
+
+		Matrix()
+		{
+		}
+
+		Matrix(const Vector& row0, const Vector& row1, const Vector& row2, const Vector& row3)
+		{
+			rows[0] = row0;
+			rows[1] = row1;
+			rows[2] = row2;
+			rows[3] = row3;
+		}
+
+		static Matrix Identity()
+		{
+			return Matrix(
+				Vector::Set(1.0f, 0.0f, 0.0f, 0.0f),
+				Vector::Set(0.0f, 1.0f, 0.0f, 0.0f),
+				Vector::Set(0.0f, 0.0f, 1.0f, 0.0f),
+				Vector::Set(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		// 行優先に並んだ 16 個の float (XMFLOAT4X4 など) を読み込みます。
+		static Matrix Load(const float* m)
+		{
+			return Matrix(Vector::Load(m), Vector::Load(m + 4), Vector::Load(m + 8), Vector::Load(m + 12));
+		}
+
+		static Matrix Load(const Float4x4& m)
+		{
+			return Load(&m.m[0][0]);
+		}
+
+		void Store(Float4x4* m) const
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				rows[i].Store(m->m[i]);
+			}
+		}
+
+		Float4x4 ToFloat4x4() const
+		{
+			Float4x4 m;
+			Store(&m);
+			return m;
+		}
+
+		// 行ベクトル v と行列の積。(x*r0 + z*r2) + (y*r1 + w*r3) の順に足します (XMMatrixMultiply と同じ)。
+		static Vector MultiplyRow(const Vector& v, const Matrix& m)
+		{
+			const Vector x = v.SplatX() * m.rows[0];
+			const Vector y = v.SplatY() * m.rows[1];
+			const Vector z = v.SplatZ() * m.rows[2];
+			const Vector w = v.SplatW() * m.rows[3];
+			return (x + z) + (y + w);
+		}
+
+		// this を適用してから other を適用する行列です。
+		Matrix operator*(const Matrix& other) const
+		{
+			return Matrix(
+				MultiplyRow(rows[0], other),
+				MultiplyRow(rows[1], other),
+				MultiplyRow(rows[2], other),
+				MultiplyRow(rows[3], other));
+		}
+
+		Matrix Transpose() const
+		{
+#if defined(PROJECTIONMAPPING_MATH_SSE2)
+			__m128 r0 = rows[0].GetNative(), r1 = rows[1].GetNative(), r2 = rows[2].GetNative(), r3 = rows[3].GetNative();
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			return Matrix(Vector(r0), Vector(r1), Vector(r2), Vector(r3));
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+			const float32x4x2_t ab = vtrnq_f32(rows[0].GetNative(), rows[1].GetNative());
+			const float32x4x2_t cd = vtrnq_f32(rows[2].GetNative(), rows[3].GetNative());
+			return Matrix(
+				Vector(vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]))),
+				Vector(vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]))),
+				Vector(vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]))),
+				Vector(vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]))));
+#else
+			Float4x4 m = ToFloat4x4();
+			Float4x4 t;
+			for (int row = 0; row < 4; row++)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					t.m[row][column] = m.m[column][row];
+				}
+			}
+			return Load(t);
+#endif
+		}
+
+		// (x, y, z, 1) * M。x*r0 + (y*r1 + (z*r2 + r3)) の順に計算します (XMVector3Transform と同じ)。w で割りません。
+		Vector TransformPoint(const Vector& point) const
+		{
+			Vector result = Vector::MultiplyAdd(point.SplatZ(), rows[2], rows[3]);
+			result = Vector::MultiplyAdd(point.SplatY(), rows[1], result);
+			return Vector::MultiplyAdd(point.SplatX(), rows[0], result);
+		}
+
+		// (x, y, z, 0) * M。x*r0 + (y*r1 + z*r2) の順に計算します (XMVector3TransformNormal と同じ)。
+		Vector TransformNormal(const Vector& normal) const
+		{
+			Vector result = normal.SplatZ() * rows[2];
+			result = Vector::MultiplyAdd(normal.SplatY(), rows[1], result);
+			return Vector::MultiplyAdd(normal.SplatX(), rows[0], result);
+		}
+
+		static Matrix Translation(float x, float y, float z)
+		{
+			Matrix m = Identity();
+			m.rows[3] = Vector::Set(x, y, z, 1.0f);
+			return m;
+		}
+
+		static Matrix Scaling(float x, float y, float z)
+		{
+			return Matrix(
+				Vector::Set(x, 0.0f, 0.0f, 0.0f),
+				Vector::Set(0.0f, y, 0.0f, 0.0f),
+				Vector::Set(0.0f, 0.0f, z, 0.0f),
+				Vector::Set(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		static Matrix RotationX(float angle)
+		{
+			float sine, cosine;
+			Scalar::SinCos(angle, &sine, &cosine);
+			return Matrix(
+				Vector::Set(1.0f, 0.0f, 0.0f, 0.0f),
+				Vector::Set(0.0f, cosine, sine, 0.0f),
+				Vector::Set(0.0f, -sine, cosine, 0.0f),
+				Vector::Set(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		static Matrix RotationY(float angle)
+		{
+			float sine, cosine;
+			Scalar::SinCos(angle, &sine, &cosine);
+			return Matrix(
+				Vector::Set(cosine, 0.0f, -sine, 0.0f),
+				Vector::Set(0.0f, 1.0f, 0.0f, 0.0f),
+				Vector::Set(sine, 0.0f, cosine, 0.0f),
+				Vector::Set(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		static Matrix RotationZ(float angle)
+		{
+			float sine, cosine;
+			Scalar::SinCos(angle, &sine, &cosine);
+			return Matrix(
+				Vector::Set(cosine, sine, 0.0f, 0.0f),
+				Vector::Set(-sine, cosine, 0.0f, 0.0f),
+				Vector::Set(0.0f, 0.0f, 1.0f, 0.0f),
+				Vector::Set(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		// 単位クォータニオン (x, y, z, w) の回転 (XMMatrixRotationQuaternion と同じ)。
+		static Matrix RotationQuaternion(const Vector& quaternion)
+		{
+			const float x = quaternion.GetX(), y = quaternion.GetY(), z = quaternion.GetZ(), w = quaternion.GetW();
+			const float x2 = x + x, y2 = y + y, z2 = z + z;
+			const float xx2 = x * x2, yy2 = y * y2, zz2 = z * z2;
+			const float xy2 = x * y2, xz2 = x * z2, yz2 = y * z2;
+			const float wx2 = w * x2, wy2 = w * y2, wz2 = w * z2;
+			return Matrix(
+				Vector::Set((1.0f - yy2) - zz2, xy2 + wz2, xz2 - wy2, 0.0f),
+				Vector::Set(xy2 - wz2, (1.0f - xx2) - zz2, yz2 + wx2, 0.0f),
+				Vector::Set(xz2 + wy2, yz2 - wx2, (1.0f - xx2) - yy2, 0.0f),
+				Vector::Set(0.0f, 0.0f, 0.0f, 1.0f));
+		}
+
+		// 右手系の透視投影 (XMMatrixPerspectiveFovRH と同じ)。深度は 0..1 です。
+		static Matrix PerspectiveFovRH(float fovAngleY, float aspectRatio, float nearZ, float farZ)
+		{
+			float sine, cosine;
+			Scalar::SinCos(0.5f * fovAngleY, &sine, &cosine);
+
+			const float height = cosine / sine;
+			const float width = height / aspectRatio;
+			const float range = farZ / (nearZ - farZ);
+			return Matrix(
+				Vector::Set(width, 0.0f, 0.0f, 0.0f),
+				Vector::Set(0.0f, height, 0.0f, 0.0f),
+				Vector::Set(0.0f, 0.0f, range, -1.0f),
+				Vector::Set(0.0f, 0.0f, range * nearZ, 0.0f));
+		}
+
+		// 右手系のビュー行列 (XMMatrixLookAtRH と同じ)。
+		static Matrix LookAtRH(const Vector& eye, const Vector& focus, const Vector& up)
+		{
+			// 右手系では視線の逆向きが z 軸になります。
+			const Vector r2 = Vector::Normalize3(eye - focus);
+			const Vector r0 = Vector::Normalize3(Vector::Cross3(up, r2));
+			const Vector r1 = Vector::Cross3(r2, r0);
+
+			const Vector negativeEye = -eye;
+			const Matrix m(
+				Vector::Set(r0.GetX(), r0.GetY(), r0.GetZ(), Vector::Dot3(r0, negativeEye).GetX()),
+				Vector::Set(r1.GetX(), r1.GetY(), r1.GetZ(), Vector::Dot3(r1, negativeEye).GetX()),
+				Vector::Set(r2.GetX(), r2.GetY(), r2.GetZ(), Vector::Dot3(r2, negativeEye).GetX()),
+				Vector::Set(0.0f, 0.0f, 0.0f, 1.0f));
+			return m.Transpose();
+		}
+	};
+
+	// (x, y, z, w) の単位クォータニオンの操作。
+	class Quaternion
+	{
+	public:
+		static Vector Identity()
+		{
+			return Vector::Set(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+
+		// 単位ベクトル axis まわりに angle (ラジアン) 回転するクォータニオン。
+		static Vector RotationNormal(const Vector& axis, float angle)
+		{
+			float sine, cosine;
+			Scalar::SinCos(0.5f * angle, &sine, &cosine);
+			return Vector::Set(axis.GetX() * sine, axis.GetY() * sine, axis.GetZ() * sine, cosine);
+		}
+
+		// first の回転の後に second の回転を行うクォータニオン (XMQuaternionMultiply と同じ順序)。
+		// (w2 の項 + x2 の項) + (y2 の項 + z2 の項) の順に足します。
+		static Vector Multiply(const Vector& first, const Vector& second)
+		{
+			const float x1 = first.GetX(), y1 = first.GetY(), z1 = first.GetZ(), w1 = first.GetW();
+			const float x2 = second.GetX(), y2 = second.GetY(), z2 = second.GetZ(), w2 = second.GetW();
+			return Vector::Set(
+				((w2 * x1) + (x2 * w1)) + ((y2 * z1) - (z2 * y1)),
+				((w2 * y1) - (x2 * z1)) + ((y2 * w1) + (z2 * x1)),
+				((w2 * z1) + (x2 * y1)) + ((z2 * w1) - (y2 * x1)),
+				((w2 * w1) - (x2 * x1)) - ((y2 * y1) + (z2 * z1)));
+		}
+
+		// 長さ 1 にします。(x*x + z*z) + (y*y + w*w) の順に足します (XMQuaternionNormalize と同じ)。長さが 0 の場合は単位元を返します。
+		static Vector Normalize(const Vector& quaternion)
+		{
+			const Vector product = quaternion * quaternion;
+			const Vector length = Vector::Sqrt((product.SplatX() + product.SplatZ()) + (product.SplatY() + product.SplatW()));
+			if (length.GetX() == 0.0f)
+			{
+				return Identity();
+			}
+			return quaternion / length;
+		}
+	};
+
+	// 多数の点や行列をまとめて変換します。1 要素ずつの Matrix の演算と同じ順序で計算するので、結果も同じです。
+	// AVX を有効にしてビルドした場合は 2 要素ずつ 256 ビットで計算します。
+	class MathBatch
+	{
+	public:
+		// xyz を並べた count 個の点を (x, y, z, 1) * matrix で変換し、output に xyz で書き込みます。output は points と同じでもかまいません。
+		static void TransformPoints(const Matrix& matrix, const float* points, size_t count, float* output)
+		{
+			size_t i = 0;
+#if defined(PROJECTIONMAPPING_MATH_AVX)
+			const __m256 r0 = Duplicate(matrix.rows[0]), r1 = Duplicate(matrix.rows[1]), r2 = Duplicate(matrix.rows[2]), r3 = Duplicate(matrix.rows[3]);
+			for (; i + 2 <= count; i += 2)
+			{
+				const float* p = points + i * 3;
+				__m256 result = _mm256_add_ps(_mm256_mul_ps(Pair(p[2], p[5]), r2), r3);
+				result = _mm256_add_ps(_mm256_mul_ps(Pair(p[1], p[4]), r1), result);
+				result = _mm256_add_ps(_mm256_mul_ps(Pair(p[0], p[3]), r0), result);
+				Vector(_mm256_castps256_ps128(result)).Store3(output + i * 3);
+				Vector(_mm256_extractf128_ps(result, 1)).Store3(output + i * 3 + 3);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				matrix.TransformPoint(Vector::Load3(points + i * 3, 1.0f)).Store3(output + i * 3);
+			}
+		}
+
+		// xyz を並べた count 個の方向を (x, y, z, 0) * matrix で変換します。法線には逆転置行列を渡してください。
+		static void TransformNormals(const Matrix& matrix, const float* normals, size_t count, float* output)
+		{
+			size_t i = 0;
+#if defined(PROJECTIONMAPPING_MATH_AVX)
+			const __m256 r0 = Duplicate(matrix.rows[0]), r1 = Duplicate(matrix.rows[1]), r2 = Duplicate(matrix.rows[2]);
+			for (; i + 2 <= count; i += 2)
+			{
+				const float* n = normals + i * 3;
+				__m256 result = _mm256_mul_ps(Pair(n[2], n[5]), r2);
+				result = _mm256_add_ps(_mm256_mul_ps(Pair(n[1], n[4]), r1), result);
+				result = _mm256_add_ps(_mm256_mul_ps(Pair(n[0], n[3]), r0), result);
+				Vector(_mm256_castps256_ps128(result)).Store3(output + i * 3);
+				Vector(_mm256_extractf128_ps(result, 1)).Store3(output + i * 3 + 3);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				matrix.TransformNormal(Vector::Load3(normals + i * 3, 0.0f)).Store3(output + i * 3);
+			}
+		}
+
+		// left[i] * right を output[i] に書き込みます。output は left と同じでもかまいません。
+		static void Multiply(const Float4x4* left, size_t count, const Matrix& right, Float4x4* output)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+#if defined(PROJECTIONMAPPING_MATH_AVX)
+				__m256 low, high;
+				MultiplyRows(left[i], right, &low, &high);
+				_mm256_storeu_ps(output[i].m[0], low);
+				_mm256_storeu_ps(output[i].m[2], high);
+#else
+				(Matrix::Load(left[i]) * right).Store(&output[i]);
+#endif
+			}
+		}
+
+		// left[i] * right を HLSL の列優先に合わせて転置し、output から stride バイトごとに書き込みます。
+		// 定数バッファーに直接書き込むためのもので、output の整列は不要です。
+		static void MultiplyTransposed(const Float4x4* left, size_t count, const Matrix& right, void* output, size_t stride)
+		{
+			uint8_t* destination = static_cast<uint8_t*>(output);
+			for (size_t i = 0; i < count; i++)
+			{
+#if defined(PROJECTIONMAPPING_MATH_AVX)
+				__m256 low, high;
+				MultiplyRows(left[i], right, &low, &high);
+				const Matrix product(
+					Vector(_mm256_castps256_ps128(low)), Vector(_mm256_extractf128_ps(low, 1)),
+					Vector(_mm256_castps256_ps128(high)), Vector(_mm256_extractf128_ps(high, 1)));
+#else
+				const Matrix product = Matrix::Load(left[i]) * right;
+#endif
+				const Matrix transposed = product.Transpose();
+				float* m = reinterpret_cast<float*>(destination + i * stride);
+				for (int row = 0; row < 4; row++)
+				{
+					transposed.rows[row].Store(m + row * 4);
+				}
+			}
+		}
+
+	private:
+#if defined(PROJECTIONMAPPING_MATH_AVX)
+		// 同じ 4 要素を上下の 128 ビットに置きます。
+		static __m256 Duplicate(const Vector& v)
+		{
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(v.GetNative()), v.GetNative(), 1);
+		}
+
+		// 下の 128 ビットに a、上に b を複製します。
+		static __m256 Pair(float a, float b)
+		{
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)), _mm_set1_ps(b), 1);
+		}
+
+		// left の 2 行ずつを Matrix::MultiplyRow と同じ順序で right に掛けます。
+		static void MultiplyRows(const Float4x4& left, const Matrix& right, __m256* low, __m256* high)
+		{
+			const __m256 r0 = Duplicate(right.rows[0]), r1 = Duplicate(right.rows[1]), r2 = Duplicate(right.rows[2]), r3 = Duplicate(right.rows[3]);
+			const float (*l)[4] = left.m;
+			for (int pair = 0; pair < 2; pair++)
+			{
+				const float* a = l[pair * 2];
+				const float* b = l[pair * 2 + 1];
+				const __m256 x = _mm256_mul_ps(Pair(a[0], b[0]), r0);
+				const __m256 y = _mm256_mul_ps(Pair(a[1], b[1]), r1);
+				const __m256 z = _mm256_mul_ps(Pair(a[2], b[2]), r2);
+				const __m256 w = _mm256_mul_ps(Pair(a[3], b[3]), r3);
+				(pair == 0 ? *low : *high) = _mm256_add_ps(_mm256_add_ps(x, z), _mm256_add_ps(y, w));
+			}
+		}
+#endif
+	};
+}
@@ -1,6 +1,7 @@
 ﻿#include "pch.h"
 #include "ProjectionMappingMain.h"
 #include "Common\DirectXHelper.h"
+#include "Common\ParallelFor.h"
 
 using namespace ProjectionMapping;
 
@@ -10,16 +11,38 @@ using namespace Concurrency;
 
 // アプリケーションの読み込み時にアプリケーション資産を読み込んで初期化します。
 ProjectionMappingMain::ProjectionMappingMain(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
-	m_deviceResources(deviceResources)
+	m_deviceResources(deviceResources),
+	m_qpcSecondsPerTick(0.0)
 {
 	// デバイスが失われたときや再作成されたときに通知を受けるように登録します
 	m_deviceResources->RegisterDeviceNotify(this);
 
+	m_renderBackend = std::make_shared<D3D11RenderBackend>(m_deviceResources);
+	m_renderTargets = std::unique_ptr<D3D11RenderTargetPool>(new D3D11RenderTargetPool(m_deviceResources));
+
 	// TODO: これをアプリのコンテンツの初期化で置き換えます。
-	m_sceneRenderer = std::unique_ptr<Sample3DSceneRenderer>(new Sample3DSceneRenderer(m_deviceResources));
+	m_sceneRenderer = std::unique_ptr<Sample3DSceneRenderer>(new Sample3DSceneRenderer(m_deviceResources, m_renderBackend));
 
 	m_fpsTextRenderer = std::unique_ptr<SampleFpsTextRenderer>(new SampleFpsTextRenderer(m_deviceResources));
 
+	m_warpPostProcess = std::unique_ptr<WarpPostProcess>(new WarpPostProcess(m_deviceResources));
+
+	m_depthInteraction = std::unique_ptr<DepthInteraction>(new DepthInteraction(m_deviceResources));
+
+	// 深度カメラのフレームで検出した前景でシーンを操作します。フレームはセンサーのイベントで届きます。
+	DepthInteraction* depthInteraction = m_depthInteraction.get();
+	m_depthSource = std::unique_ptr<KinectDepthSource>(new KinectDepthSource([depthInteraction](const uint16_t* depth, uint32_t width, uint32_t height, double captureTime)
+	{
+		depthInteraction->SubmitDepthFrame(depth, width, height, captureTime);
+	}));
+
+	LARGE_INTEGER frequency;
+	if (!QueryPerformanceFrequency(&frequency))
+	{
+		throw ref new Platform::FailureException();
+	}
+	m_qpcSecondsPerTick = 1.0 / static_cast<double>(frequency.QuadPart);
+
 	// TODO: 既定の可変タイムステップ モード以外のモードが必要な場合は、タイマー設定を変更してください。
 	// 例: 60 FPS 固定タイムステップ更新ロジックでは、次を呼び出します:
 	/*
@@ -39,20 +62,48 @@ void ProjectionMappingMain::CreateWindowSizeDependentResources()
 {
 	// TODO: これをアプリのコンテンツのサイズに依存する初期化で置き換えます。
 	m_sceneRenderer->CreateWindowSizeDependentResources();
+	m_warpPostProcess->CreateWindowSizeDependentResources();
 }
 
 // アプリケーション状態をフレームごとに 1 回更新します。
 void ProjectionMappingMain::Update() 
 {
+	double frameStartTime = UpdatePresentTiming();
+
 	// シーン オブジェクトを更新します。
 	m_timer.Tick([&]()
 	{
 		// TODO: これをアプリのコンテンツの更新関数で置き換えます。
+		// 操作は、このフレームの光が投影される時刻での手の位置に合わせます。
+		m_depthInteraction->Update(m_sceneRenderer.get(), m_latency.PredictPhotonTime(frameStartTime));
 		m_sceneRenderer->Update(m_timer);
-		m_fpsTextRenderer->Update(m_timer);
+		m_fpsTextRenderer->Update(m_timer, m_renderBackend->GetStatistics());
 	});
 }
 
+// 前のフレームまでの表示の統計を取り込み、これから描画するフレームの開始時刻 (秒) を返します。
+double ProjectionMappingMain::UpdatePresentTiming()
+{
+	DXGI_FRAME_STATISTICS statistics;
+	if (m_deviceResources->GetFrameStatistics(&statistics))
+	{
+		m_latency.FrameDisplayed(
+			statistics.PresentCount,
+			statistics.PresentRefreshCount,
+			statistics.SyncRefreshCount,
+			statistics.SyncQPCTime.QuadPart * m_qpcSecondsPerTick
+			);
+	}
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	double frameStartTime = now.QuadPart * m_qpcSecondsPerTick;
+
+	// このフレームは次の Present で表示されます。
+	m_latency.BeginFrame(m_deviceResources->GetLastPresentCount() + 1, frameStartTime);
+	return frameStartTime;
+}
+
 // 現在のアプリケーション状態に応じて現在のフレームをレンダリングします。
 // フレームがレンダリングされ、表示準備が完了すると、true を返します。
 bool ProjectionMappingMain::Render() 
@@ -63,24 +114,86 @@ bool ProjectionMappingMain::Render()
 		return false;
 	}
 
-	auto context = m_deviceResources->GetD3DDeviceContext();
-
-	// ビューポートをリセットして全画面をターゲットとします。
-	auto viewport = m_deviceResources->GetScreenViewport();
-	context->RSSetViewports(1, &viewport);
-
-	// レンダリング ターゲットを画面にリセットします。
-	ID3D11RenderTargetView *const targets[1] = { m_deviceResources->GetBackBufferRenderTargetView() };
-	context->OMSetRenderTargets(1, targets, m_deviceResources->GetDepthStencilView());
+	// リング バッファーをこのフレームの書き込みに使えるようにしてから記録します。
+	m_renderBackend->BeginFrame();
+	m_commandList.Reset();
 
 	// バック バッファーと深度ステンシル ビューをクリアします。
-	context->ClearRenderTargetView(m_deviceResources->GetBackBufferRenderTargetView(), DirectX::Colors::CornflowerBlue);
-	context->ClearDepthStencilView(m_deviceResources->GetDepthStencilView(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	m_commandList.Clear(DirectX::Colors::CornflowerBlue, 1.0f);
 
-	// シーン オブジェクトをレンダリングします。
+	// シーン オブジェクトをレンダリングします。カリングと記録はプロジェクターのビューごとに並列に行います。
+	// パス、パイプライン、マテリアル、深度の順に並べ替え、状態の変更を減らします。
 	// TODO: これをアプリのコンテンツのレンダリング関数で置き換えます。
-	m_sceneRenderer->Render();
-	m_fpsTextRenderer->Render();
+	const size_t viewCount = m_sceneRenderer->GetViewCount();
+	if (m_viewCommandLists.size() < viewCount)
+	{
+		m_viewCommandLists.resize(viewCount);
+	}
+	DX::ParallelFor(0, viewCount, [this](size_t view)
+	{
+		CommandList& commands = m_viewCommandLists[view];
+		commands.Reset();
+		m_sceneRenderer->Render(view, &commands);
+		commands.Sort();
+	});
+
+	m_submitLists.clear();
+	m_submitLists.push_back(&m_commandList);
+	for (size_t view = 0; view < viewCount; view++)
+	{
+		m_submitLists.push_back(&m_viewCommandLists[view]);
+	}
+
+	// シーン、ワープ、FPS 表示のパスを宣言します。ワープが無効な場合は、シーンをバック バッファーに直接描画します。
+	m_renderGraph.Reset();
+	RenderGraph::ResourceHandle backBuffer = m_renderGraph.Import("BackBuffer");
+	RenderGraph::ResourceHandle sceneColor = backBuffer;
+	if (m_warpPostProcess->IsEnabled())
+	{
+		const D3D11_VIEWPORT viewport = m_deviceResources->GetScreenViewport();
+		const RenderTargetDescription sceneDescription = { static_cast<uint32_t>(viewport.Width), static_cast<uint32_t>(viewport.Height), RenderTargetDescription::Color };
+		sceneColor = m_renderGraph.CreateTransient("SceneColor", sceneDescription);
+	}
+
+	// 記録したコマンドを描画します。ビューポートとレンダリング ターゲットも Submit で設定されます。深度ステンシルは DeviceResources のものです。
+	// パスは Execute で実行されるので、ハンドルは値でキャプチャします。
+	const RenderGraph::PassHandle scenePass = m_renderGraph.AddPass("Scene", [this, sceneColor](const RenderGraph& graph)
+	{
+		m_renderBackend->SetRenderTargets(m_renderTargets->GetRenderTargetView(graph, sceneColor), nullptr);
+		m_renderBackend->Submit(m_submitLists.data(), m_submitLists.size());
+		m_renderBackend->SetRenderTargets(nullptr, nullptr);
+	});
+	const RenderGraph::ResourceHandle sceneOutput = m_renderGraph.Write(scenePass, sceneColor);
+
+	// FPS 表示はゆがめないように、シーンだけをワープします。書き込みは新しい版を返すので、書き込む前のハンドルで比べます。
+	if (sceneColor != backBuffer)
+	{
+		const RenderGraph::PassHandle warpPass = m_renderGraph.AddPass("Warp", [this, sceneOutput](const RenderGraph& graph)
+		{
+			m_warpPostProcess->Render(m_renderTargets->GetTexture(graph, sceneOutput));
+		});
+		m_renderGraph.Read(warpPass, sceneOutput);
+		backBuffer = m_renderGraph.Write(warpPass, backBuffer);
+	}
+	else
+	{
+		backBuffer = sceneOutput;
+	}
+
+	const RenderGraph::PassHandle overlayPass = m_renderGraph.AddPass("Overlay", [this](const RenderGraph&)
+	{
+		m_fpsTextRenderer->Render();
+	});
+	m_renderGraph.Read(overlayPass, backBuffer);
+	backBuffer = m_renderGraph.Write(overlayPass, backBuffer);
+	m_renderGraph.MarkOutput(backBuffer);
+
+	if (!m_renderGraph.Compile())
+	{
+		throw ref new Platform::FailureException();
+	}
+	m_renderTargets->Prepare(m_renderGraph);
+	m_renderGraph.Execute();
 
 	return true;
 }
@@ -89,12 +202,16 @@ bool ProjectionMappingMain::Render()
 void ProjectionMappingMain::OnDeviceLost()
 {
 	m_sceneRenderer->ReleaseDeviceDependentResources();
+	m_renderBackend->ReleaseDeviceDependentResources();
+	m_renderTargets->ReleaseDeviceDependentResources();
 	m_fpsTextRenderer->ReleaseDeviceDependentResources();
+	m_warpPostProcess->ReleaseDeviceDependentResources();
 }
 
 // デバイス リソースの再作成が可能になったことをレンダラーに通知します。
 void ProjectionMappingMain::OnDeviceRestored()
 {
+	m_renderBackend->CreateDeviceDependentResources();
 	m_sceneRenderer->CreateDeviceDependentResources();
 	m_fpsTextRenderer->CreateDeviceDependentResources();
 	CreateWindowSizeDependentResources();
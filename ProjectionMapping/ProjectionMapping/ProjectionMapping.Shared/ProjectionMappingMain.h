@@ -4,6 +4,13 @@
 #include "Common\DeviceResources.h"
 #include "Content\Sample3DSceneRenderer.h"
 #include "Content\SampleFpsTextRenderer.h"
+#include "Content\WarpPostProcess.h"
+#include "Content\DepthInteraction.h"
+#include "Content\KinectDepthSource.h"
+#include "Tracking\LatencyEstimator.h"
+#include "Rendering\D3D11RenderBackend.h"
+#include "Rendering\D3D11RenderTargetPool.h"
+#include "Rendering\RenderGraph.h"
 
 // Direct2D および 3D コンテンツを画面上でレンダリングします。
 namespace ProjectionMapping
@@ -17,19 +24,50 @@ namespace ProjectionMapping
 		void Update();
 		bool Render();
 
+		// 投影面に合わせたプリディストーションを設定します。
+		void SetWarpTable(const RemapTable& table) { m_warpPostProcess->SetRemapTable(table); }
+
+		// 1 つのウィンドウにまたがる複数のプロジェクターに、それぞれのキャリブレーションで描画します。
+		void SetProjectors(const ProjectorCalibration* calibrations, const ProjectorViewport* viewports, size_t count) { m_sceneRenderer->SetProjectors(calibrations, viewports, count); }
+
+		// 直近の Update で検出した、投影面へのタッチの変化。
+		const std::vector<TouchEvent>& GetTouchEvents() const { return m_depthInteraction->GetTouchEvents(); }
+
 		// IDeviceNotify
 		virtual void OnDeviceLost();
 		virtual void OnDeviceRestored();
 
 	private:
+		double UpdatePresentTiming();
+
 		// デバイス リソースへのキャッシュされたポインター。
 		std::shared_ptr<DX::DeviceResources> m_deviceResources;
 
+		// シーンの描画はコマンド リストに記録して、フレームごとに 1 回バックエンドへ送信します。
+		// クリアは m_commandList に、プロジェクターのビューごとの描画は m_viewCommandLists に並列に記録します。
+		std::shared_ptr<D3D11RenderBackend> m_renderBackend;
+		CommandList m_commandList;
+		std::vector<CommandList> m_viewCommandLists;
+		std::vector<const CommandList*> m_submitLists;
+
+		// フレームのパスはレンダー グラフで毎フレーム宣言し、一時的なターゲットはプールの実体を共有します。
+		RenderGraph m_renderGraph;
+		std::unique_ptr<D3D11RenderTargetPool> m_renderTargets;
+
 		// TODO: これを独自のコンテンツ レンダラーで置き換えます。
 		std::unique_ptr<Sample3DSceneRenderer> m_sceneRenderer;
 		std::unique_ptr<SampleFpsTextRenderer> m_fpsTextRenderer;
+		std::unique_ptr<WarpPostProcess> m_warpPostProcess;
+		std::unique_ptr<DepthInteraction> m_depthInteraction;
+
+		// 深度カメラのフレームを m_depthInteraction に渡します。m_depthInteraction より先に破棄します。
+		std::unique_ptr<KinectDepthSource> m_depthSource;
 
 		// ループ タイマーをレンダリングしています。
 		DX::StepTimer m_timer;
+
+		// 描画の開始から表示までの遅延の測定。
+		LatencyEstimator m_latency;
+		double m_qpcSecondsPerTick;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <cstdint>
+#include "../Math/VectorMath.h"
+
+namespace ProjectionMapping
+{
+	// 深度カメラのピンホール モデル。レンズ歪みは補正済みとします。
+	struct DepthCameraIntrinsics
+	{
+		float fx, fy;
+		float cx, cy;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	// 剛体変換 (p' = R * p + t)。長さはメートルです。
+	struct RigidTransform
+	{
+		float rotation[3][3];
+		float translation[3];
+
+		static RigidTransform Identity()
+		{
+			RigidTransform transform = { { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }, { 0.0f, 0.0f, 0.0f } };
+			return transform;
+		}
+
+		void Apply(const float* point, float* result) const
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] = rotation[i][0] * point[0] + rotation[i][1] * point[1] + rotation[i][2] * point[2] + translation[i];
+			}
+		}
+
+		void ApplyRotation(const float* vector, float* result) const
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] = rotation[i][0] * vector[0] + rotation[i][1] * vector[1] + rotation[i][2] * vector[2];
+			}
+		}
+
+		// 行ベクトル規約 (p' = p * M) の 4x4 行列。MathBatch で多数の点をまとめて変換するのに使用します。
+		Float4x4 ToMatrix() const
+		{
+			Float4x4 matrix;
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					matrix.m[i][j] = rotation[j][i];
+				}
+				matrix.m[i][3] = 0.0f;
+				matrix.m[3][i] = translation[i];
+			}
+			matrix.m[3][3] = 1.0f;
+			return matrix;
+		}
+
+		RigidTransform Inverse() const
+		{
+			RigidTransform inverse;
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					inverse.rotation[i][j] = rotation[j][i];
+				}
+			}
+			for (int i = 0; i < 3; i++)
+			{
+				inverse.translation[i] = -(inverse.rotation[i][0] * translation[0] + inverse.rotation[i][1] * translation[1] + inverse.rotation[i][2] * translation[2]);
+			}
+			return inverse;
+		}
+
+		// (*this) * other、つまり other を適用してからこの変換を適用します。
+		RigidTransform operator*(const RigidTransform& other) const
+		{
+			RigidTransform result;
+			for (int i = 0; i < 3; i++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					result.rotation[i][j] = rotation[i][0] * other.rotation[0][j] + rotation[i][1] * other.rotation[1][j] + rotation[i][2] * other.rotation[2][j];
+				}
+				result.translation[i] = rotation[i][0] * other.translation[0] + rotation[i][1] * other.translation[1] + rotation[i][2] * other.translation[2] + translation[i];
+			}
+			return result;
+		}
+	};
+}
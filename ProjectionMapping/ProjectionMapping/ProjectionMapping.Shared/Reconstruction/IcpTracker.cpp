@@ -0,0 +1,498 @@
+﻿#include "IcpTracker.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 1 ストリップの最小の行数。
+	const uint32_t MinStripRows = 8;
+
+	// 縮小するときに平均する深度の差の上限 (メートル)。物体の輪郭をまたいで平均しないようにします。
+	const float DownsampleDepthThreshold = 0.03f;
+
+	// 法線を求める隣接画素との深度の差の上限 (メートル)。
+	const float NormalDepthThreshold = 0.05f;
+
+	// 更新量がこれより小さくなったら、その段の反復を打ち切ります。
+	const double ConvergenceThreshold = 1.0e-6;
+
+	// 解くのに必要な最小の対応点の数。
+	const double MinCorrespondences = 100.0;
+
+	template<typename TBody>
+	void ForEachStrip(uint32_t height, const TBody& body)
+	{
+		uint32_t stripCount = std::max(1u, std::min(DX::GetWorkerCount() * 2, height / MinStripRows));
+		uint32_t stripRows = (height + stripCount - 1) / stripCount;
+		stripCount = (height + stripRows - 1) / stripRows;
+
+		DX::ParallelFor(0, stripCount, [&](size_t strip)
+		{
+			uint32_t y0 = static_cast<uint32_t>(strip) * stripRows;
+			body(strip, y0, std::min(y0 + stripRows, height));
+		});
+	}
+
+	inline uint32_t GetStripCount(uint32_t height)
+	{
+		uint32_t stripCount = std::max(1u, std::min(DX::GetWorkerCount() * 2, height / MinStripRows));
+		uint32_t stripRows = (height + stripCount - 1) / stripCount;
+		return (height + stripRows - 1) / stripRows;
+	}
+
+	// 対称な 6x6 行列 a (上三角を行順に 21 個) について a x = b を Cholesky 分解で解きます。
+	bool SolveSymmetric(const double* upper, const double* b, double* x)
+	{
+		double a[6][6];
+		for (int i = 0, k = 0; i < 6; i++)
+		{
+			for (int j = i; j < 6; j++, k++)
+			{
+				a[i][j] = upper[k];
+				a[j][i] = upper[k];
+			}
+		}
+
+		double l[6][6] = {};
+		for (int j = 0; j < 6; j++)
+		{
+			double sum = a[j][j];
+			for (int k = 0; k < j; k++)
+			{
+				sum -= l[j][k] * l[j][k];
+			}
+			if (sum <= 1.0e-12 * (a[j][j] + 1.0e-30))
+			{
+				return false;
+			}
+			l[j][j] = std::sqrt(sum);
+
+			for (int i = j + 1; i < 6; i++)
+			{
+				double value = a[i][j];
+				for (int k = 0; k < j; k++)
+				{
+					value -= l[i][k] * l[j][k];
+				}
+				l[i][j] = value / l[j][j];
+			}
+		}
+
+		double y[6];
+		for (int i = 0; i < 6; i++)
+		{
+			double value = b[i];
+			for (int k = 0; k < i; k++)
+			{
+				value -= l[i][k] * y[k];
+			}
+			y[i] = value / l[i][i];
+		}
+		for (int i = 5; i >= 0; i--)
+		{
+			double value = y[i];
+			for (int k = i + 1; k < 6; k++)
+			{
+				value -= l[k][i] * x[k];
+			}
+			x[i] = value / l[i][i];
+		}
+		return true;
+	}
+
+	// 微小な回転 (回転ベクトル) と並進を、姿勢の左から掛けます。回転は Rodrigues の式で正規直交に保ちます。
+	RigidTransform ApplyIncrement(const double* increment, const RigidTransform& pose)
+	{
+		const double angle = std::sqrt(increment[0] * increment[0] + increment[1] * increment[1] + increment[2] * increment[2]);
+		RigidTransform delta = RigidTransform::Identity();
+		if (angle > 0.0)
+		{
+			const double axis[3] = { increment[0] / angle, increment[1] / angle, increment[2] / angle };
+			const double c = std::cos(angle);
+			const double s = std::sin(angle);
+			const double t = 1.0 - c;
+			delta.rotation[0][0] = static_cast<float>(c + axis[0] * axis[0] * t);
+			delta.rotation[0][1] = static_cast<float>(axis[0] * axis[1] * t - axis[2] * s);
+			delta.rotation[0][2] = static_cast<float>(axis[0] * axis[2] * t + axis[1] * s);
+			delta.rotation[1][0] = static_cast<float>(axis[1] * axis[0] * t + axis[2] * s);
+			delta.rotation[1][1] = static_cast<float>(c + axis[1] * axis[1] * t);
+			delta.rotation[1][2] = static_cast<float>(axis[1] * axis[2] * t - axis[0] * s);
+			delta.rotation[2][0] = static_cast<float>(axis[2] * axis[0] * t - axis[1] * s);
+			delta.rotation[2][1] = static_cast<float>(axis[2] * axis[1] * t + axis[0] * s);
+			delta.rotation[2][2] = static_cast<float>(c + axis[2] * axis[2] * t);
+		}
+		delta.translation[0] = static_cast<float>(increment[3]);
+		delta.translation[1] = static_cast<float>(increment[4]);
+		delta.translation[2] = static_cast<float>(increment[5]);
+		return delta * pose;
+	}
+}
+
+IcpTracker::IcpTracker() :
+	m_distanceThreshold(0.1f),
+	m_normalThreshold(0.8f),
+	m_minDepth(500),
+	m_maxDepth(4500),
+	m_hasReference(false)
+{
+	SetIterations(10, 5, 4);
+}
+
+void IcpTracker::SetIterations(uint32_t coarse, uint32_t middle, uint32_t fine)
+{
+	m_iterations[2] = coarse;
+	m_iterations[1] = middle;
+	m_iterations[0] = fine;
+}
+
+void IcpTracker::SetDepthRange(uint16_t minDepth, uint16_t maxDepth)
+{
+	m_minDepth = minDepth;
+	m_maxDepth = maxDepth;
+}
+
+// 深度をメートルにして 1/2 ずつ縮小し、各段の頂点と法線を求めます。
+void IcpTracker::BuildPyramid(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, Level* levels)
+{
+	const uint16_t minDepth = m_minDepth;
+	const uint16_t maxDepth = m_maxDepth;
+
+	for (uint32_t l = 0; l < LevelCount; l++)
+	{
+		Level& level = levels[l];
+		if (l == 0)
+		{
+			level.intrinsics = intrinsics;
+		}
+		else
+		{
+			// 画素の中心が一致するように主点をずらします。
+			const DepthCameraIntrinsics& finer = levels[l - 1].intrinsics;
+			level.intrinsics.fx = finer.fx * 0.5f;
+			level.intrinsics.fy = finer.fy * 0.5f;
+			level.intrinsics.cx = (finer.cx + 0.5f) * 0.5f - 0.5f;
+			level.intrinsics.cy = (finer.cy + 0.5f) * 0.5f - 0.5f;
+			level.intrinsics.width = finer.width / 2;
+			level.intrinsics.height = finer.height / 2;
+		}
+
+		const uint32_t width = level.intrinsics.width;
+		const uint32_t height = level.intrinsics.height;
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		level.depth.resize(pixelCount);
+		level.vertices.resize(pixelCount * 3);
+		level.normals.resize(pixelCount * 3);
+
+		ForEachStrip(height, [&](size_t, uint32_t y0, uint32_t y1)
+		{
+			for (uint32_t y = y0; y < y1; y++)
+			{
+				float* row = &level.depth[y * width];
+				if (l == 0)
+				{
+					const uint16_t* source = depth + y * width;
+					for (uint32_t x = 0; x < width; x++)
+					{
+						row[x] = (source[x] >= minDepth && source[x] <= maxDepth) ? source[x] * 0.001f : 0.0f;
+					}
+					continue;
+				}
+
+				// 2x2 の有効な画素のうち、最初の画素に近いものだけを平均します。
+				const Level& finer = levels[l - 1];
+				const uint32_t finerWidth = finer.intrinsics.width;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					const float* source = &finer.depth[(y * 2) * finerWidth + x * 2];
+					const float samples[4] = { source[0], source[1], source[finerWidth], source[finerWidth + 1] };
+					float center = 0.0f;
+					float sum = 0.0f;
+					uint32_t count = 0;
+					for (int i = 0; i < 4; i++)
+					{
+						if (samples[i] == 0.0f)
+						{
+							continue;
+						}
+						if (count == 0)
+						{
+							center = samples[i];
+						}
+						if (std::fabs(samples[i] - center) <= DownsampleDepthThreshold)
+						{
+							sum += samples[i];
+							count++;
+						}
+					}
+					row[x] = count ? sum / count : 0.0f;
+				}
+			}
+		});
+
+		const DepthCameraIntrinsics& k = level.intrinsics;
+		const float inverseFx = 1.0f / k.fx;
+		const float inverseFy = 1.0f / k.fy;
+		ForEachStrip(height, [&](size_t, uint32_t y0, uint32_t y1)
+		{
+			for (uint32_t y = y0; y < y1; y++)
+			{
+				const float rayY = (static_cast<float>(y) - k.cy) * inverseFy;
+				for (uint32_t x = 0; x < width; x++)
+				{
+					const size_t i = y * width + x;
+					const float z = level.depth[i];
+					float* vertex = &level.vertices[i * 3];
+					vertex[0] = (static_cast<float>(x) - k.cx) * inverseFx * z;
+					vertex[1] = rayY * z;
+					vertex[2] = z;
+				}
+			}
+		});
+
+		// 右と下の画素との差の外積を法線とします。カメラの方向を向くように符号をそろえます。
+		ForEachStrip(height, [&](size_t, uint32_t y0, uint32_t y1)
+		{
+			for (uint32_t y = y0; y < y1; y++)
+			{
+				for (uint32_t x = 0; x < width; x++)
+				{
+					const size_t i = y * width + x;
+					float* normal = &level.normals[i * 3];
+					normal[0] = normal[1] = normal[2] = 0.0f;
+
+					if (x + 1 >= width || y + 1 >= height)
+					{
+						continue;
+					}
+
+					const float z = level.depth[i];
+					const float zRight = level.depth[i + 1];
+					const float zDown = level.depth[i + width];
+					if (z == 0.0f || zRight == 0.0f || zDown == 0.0f ||
+						std::fabs(zRight - z) > NormalDepthThreshold || std::fabs(zDown - z) > NormalDepthThreshold)
+					{
+						continue;
+					}
+
+					const float* v = &level.vertices[i * 3];
+					const float* right = &level.vertices[(i + 1) * 3];
+					const float* down = &level.vertices[(i + width) * 3];
+					const float a[3] = { right[0] - v[0], right[1] - v[1], right[2] - v[2] };
+					const float b[3] = { down[0] - v[0], down[1] - v[1], down[2] - v[2] };
+					float n[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0] };
+					const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length <= 0.0f)
+					{
+						continue;
+					}
+
+					const float scale = ((n[0] * v[0] + n[1] * v[1] + n[2] * v[2]) > 0.0f ? -1.0f : 1.0f) / length;
+					normal[0] = n[0] * scale;
+					normal[1] = n[1] * scale;
+					normal[2] = n[2] * scale;
+				}
+			}
+		});
+	}
+}
+
+bool IcpTracker::SetReference(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics)
+{
+	m_hasReference = false;
+	if (!depth || intrinsics.width >> (LevelCount - 1) == 0 || intrinsics.height >> (LevelCount - 1) == 0)
+	{
+		return false;
+	}
+
+	BuildPyramid(depth, intrinsics, m_reference);
+	m_hasReference = true;
+	return true;
+}
+
+// 現在の点を pose で参照のカメラ座標に移し、参照の画像に投影して対応点を探します。
+// 点と面の距離 e = n・(q - r) を、q に加える微小な回転 w と並進 t で線形化した
+// e + (q × n)・w + n・t の 2 乗和の正規方程式を、ストリップごとに集計します。
+void IcpTracker::Accumulate(const Level& current, const Level& reference, const RigidTransform& pose, double* system)
+{
+	const uint32_t width = current.intrinsics.width;
+	const uint32_t height = current.intrinsics.height;
+	const DepthCameraIntrinsics& k = reference.intrinsics;
+	const int32_t referenceWidth = static_cast<int32_t>(k.width);
+	const int32_t referenceHeight = static_cast<int32_t>(k.height);
+	const float distanceThreshold = m_distanceThreshold;
+	const float normalThreshold = m_normalThreshold;
+
+	const uint32_t stripCount = GetStripCount(height);
+	m_stripSystems.assign(static_cast<size_t>(stripCount) * SystemSize, 0.0);
+
+	// ストリップごとに変換した 1 行分の点と法線を置く作業領域。段が変わっても確保し直さないよう、縮めずに使い回します。
+	const size_t rowScratchSize = static_cast<size_t>(width) * 6;
+	if (m_stripRows.size() < stripCount * rowScratchSize)
+	{
+		m_stripRows.resize(stripCount * rowScratchSize);
+	}
+
+	const Matrix poseMatrix = Matrix::Load(pose.ToMatrix());
+
+	ForEachStrip(height, [&](size_t strip, uint32_t y0, uint32_t y1)
+	{
+		// 集計はローカル変数で行い、最後にまとめて書き出します。
+		double sums[SystemSize] = {};
+
+		// 行ごとに点と法線をまとめて pose で変換します。
+		float* rowVertices = &m_stripRows[strip * rowScratchSize];
+		float* rowNormals = rowVertices + width * 3;
+
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			MathBatch::TransformPoints(poseMatrix, &current.vertices[y * width * 3], width, rowVertices);
+			MathBatch::TransformNormals(poseMatrix, &current.normals[y * width * 3], width, rowNormals);
+
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const size_t i = y * width + x;
+				const float* normal = &current.normals[i * 3];
+				if (normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f)
+				{
+					continue;
+				}
+
+				const float* q = &rowVertices[x * 3];
+				if (q[2] <= 0.0f)
+				{
+					continue;
+				}
+
+				const int32_t u = static_cast<int32_t>(k.fx * q[0] / q[2] + k.cx + 0.5f);
+				const int32_t v = static_cast<int32_t>(k.fy * q[1] / q[2] + k.cy + 0.5f);
+				if (u < 0 || v < 0 || u >= referenceWidth || v >= referenceHeight)
+				{
+					continue;
+				}
+
+				const size_t j = static_cast<size_t>(v) * referenceWidth + u;
+				const float* n = &reference.normals[j * 3];
+				if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f)
+				{
+					continue;
+				}
+
+				const float* r = &reference.vertices[j * 3];
+				const float d[3] = { q[0] - r[0], q[1] - r[1], q[2] - r[2] };
+				if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2] > distanceThreshold * distanceThreshold)
+				{
+					continue;
+				}
+
+				const float* rotatedNormal = &rowNormals[x * 3];
+				if (rotatedNormal[0] * n[0] + rotatedNormal[1] * n[1] + rotatedNormal[2] * n[2] < normalThreshold)
+				{
+					continue;
+				}
+
+				const double e = n[0] * d[0] + n[1] * d[1] + n[2] * d[2];
+				const double jacobian[6] =
+				{
+					q[1] * n[2] - q[2] * n[1],
+					q[2] * n[0] - q[0] * n[2],
+					q[0] * n[1] - q[1] * n[0],
+					n[0], n[1], n[2]
+				};
+
+				int s = 0;
+				for (int a = 0; a < 6; a++)
+				{
+					for (int b = a; b < 6; b++)
+					{
+						sums[s++] += jacobian[a] * jacobian[b];
+					}
+				}
+				for (int a = 0; a < 6; a++)
+				{
+					sums[s++] -= jacobian[a] * e;
+				}
+				sums[s++] += e * e;
+				sums[s] += 1.0;
+			}
+		}
+
+		memcpy(&m_stripSystems[strip * SystemSize], sums, sizeof(sums));
+	});
+
+	memset(system, 0, sizeof(double) * SystemSize);
+	for (uint32_t strip = 0; strip < stripCount; strip++)
+	{
+		for (uint32_t s = 0; s < SystemSize; s++)
+		{
+			system[s] += m_stripSystems[strip * SystemSize + s];
+		}
+	}
+}
+
+bool IcpTracker::Track(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& initialPose, IcpResult* result)
+{
+	if (!m_hasReference || !depth ||
+		intrinsics.width != m_reference[0].intrinsics.width || intrinsics.height != m_reference[0].intrinsics.height)
+	{
+		return false;
+	}
+
+	BuildPyramid(depth, intrinsics, m_current);
+
+	RigidTransform pose = initialPose;
+	double system[SystemSize] = {};
+	uint32_t iterations = 0;
+
+	for (int l = LevelCount - 1; l >= 0; l--)
+	{
+		for (uint32_t iteration = 0; iteration < m_iterations[l]; iteration++)
+		{
+			Accumulate(m_current[l], m_reference[l], pose, system);
+			iterations++;
+			if (system[SystemSize - 1] < MinCorrespondences)
+			{
+				break;
+			}
+
+			double increment[6];
+			if (!SolveSymmetric(system, system + 21, increment))
+			{
+				break;
+			}
+
+			pose = ApplyIncrement(increment, pose);
+
+			double norm = 0.0;
+			for (int i = 0; i < 6; i++)
+			{
+				norm += increment[i] * increment[i];
+			}
+			if (norm < ConvergenceThreshold * ConvergenceThreshold)
+			{
+				break;
+			}
+		}
+	}
+
+	// 誤差は最も細かい段の最後の集計のものを使います。収束していれば更新後の姿勢との差はわずかです。
+	if (m_iterations[0] == 0)
+	{
+		Accumulate(m_current[0], m_reference[0], pose, system);
+	}
+	if (system[SystemSize - 1] < MinCorrespondences)
+	{
+		return false;
+	}
+
+	result->pose = pose;
+	result->rmsError = static_cast<float>(std::sqrt(system[SystemSize - 2] / system[SystemSize - 1]));
+	result->inlierCount = static_cast<uint32_t>(system[SystemSize - 1]);
+	result->iterations = iterations;
+	return true;
+}
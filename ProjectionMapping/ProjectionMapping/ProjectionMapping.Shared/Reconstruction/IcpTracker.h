@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "DepthCamera.h"
+
+namespace ProjectionMapping
+{
+	// 位置合わせの結果。
+	struct IcpResult
+	{
+		RigidTransform pose;		// 現在のカメラ座標から参照のカメラ座標への変換。
+		float rmsError;				// 最も細かい段での点と面の距離の RMS (メートル)。
+		uint32_t inlierCount;		// 最も細かい段で対応付けた点の数。
+		uint32_t iterations;		// 全段の反復回数の合計。
+	};
+
+	// 深度フレームを参照モデルに point-to-plane ICP で位置合わせし、センサーのずれを推定します。
+	// 対応点は参照の深度画像への投影で探し (projective data association)、
+	// 6x6 の正規方程式はストリップごとに並列に集計して合算します。画像ピラミッドで粗い段から細かい段へ反復します。
+	class IcpTracker
+	{
+	public:
+		// ピラミッドの段数。段 0 が元の解像度です。
+		static const uint32_t LevelCount = 3;
+
+		IcpTracker();
+
+		// 各段の最大反復回数 (粗い段から)。
+		void SetIterations(uint32_t coarse, uint32_t middle, uint32_t fine);
+
+		// 対応付ける点の距離 (メートル) と法線の内積の閾値。
+		void SetDistanceThreshold(float distance)			{ m_distanceThreshold = distance; }
+		void SetNormalThreshold(float cosine)				{ m_normalThreshold = cosine; }
+
+		// 使用する深度の範囲 (ミリメートル)。
+		void SetDepthRange(uint16_t minDepth, uint16_t maxDepth);
+
+		// 参照モデルとなる深度フレーム (キャリブレーション時のものなど) を設定します。
+		bool SetReference(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics);
+		bool HasReference() const							{ return m_hasReference; }
+
+		// depth を参照に位置合わせします。initialPose は推定の初期値 (前のフレームの結果など) です。
+		// 参照がない場合や対応点が少なすぎる場合は false を返します。
+		bool Track(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& initialPose, IcpResult* result);
+
+	private:
+		// 1 段分の画像。頂点と法線はカメラ座標で xyz を並べたもので、z = 0 は無効です。
+		struct Level
+		{
+			DepthCameraIntrinsics intrinsics;
+			std::vector<float> depth;
+			std::vector<float> vertices;
+			std::vector<float> normals;
+		};
+
+		// 正規方程式の上三角 21 個、右辺 6 個、誤差の 2 乗和、対応点の数。
+		static const uint32_t SystemSize = 29;
+
+		void BuildPyramid(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, Level* levels);
+		void Accumulate(const Level& current, const Level& reference, const RigidTransform& pose, double* system);
+
+		uint32_t				m_iterations[LevelCount];
+		float					m_distanceThreshold;
+		float					m_normalThreshold;
+		uint16_t				m_minDepth;
+		uint16_t				m_maxDepth;
+		bool					m_hasReference;
+
+		Level					m_reference[LevelCount];
+		Level					m_current[LevelCount];
+		std::vector<double>		m_stripSystems;
+		std::vector<float>		m_stripRows;
+	};
+}
@@ -0,0 +1,573 @@
+﻿#include "MarchingCubes.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const uint32_t BlockSize = TsdfVolume::BlockSize;
+
+	// ブロックのセルは自分のボクセルと、+x、+y、+z 側の隣のブロックの 1 層目のボクセルを角に使います。
+	const uint32_t SampleSize = BlockSize + 1;
+	const uint32_t SampleCount = SampleSize * SampleSize * SampleSize;
+
+	const uint16_t NoVertex = 0xFFFF;
+
+	// セルの角の位置。角 0 が原点で、0-3 が z = 0 の面、4-7 が z = 1 の面です。
+	const uint8_t CornerOffsets[8][3] =
+	{
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+		{ 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 }
+	};
+
+	// 各辺の、座標の小さい方の角と辺の向き (0 = x、1 = y、2 = z)。辺のキャッシュはこの角と向きで引きます。
+	const uint8_t EdgeOrigins[12][2] =
+	{
+		{ 0, 0 }, { 1, 1 }, { 3, 0 }, { 0, 1 },
+		{ 4, 0 }, { 5, 1 }, { 7, 0 }, { 4, 1 },
+		{ 0, 2 }, { 1, 2 }, { 2, 2 }, { 3, 2 }
+	};
+
+	// 角の内外 (距離が負の角のビット) ごとの三角形の辺の番号。-1 で終わります。
+	// 面の曖昧な場合は常に内側の角を分けるように決めているので、隣のセルとの間に穴はできません。
+	const int8_t TriangleTable[256][16] =
+	{
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 9, 0, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 9, 8, 3, 1, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 9, 2, 10, 9, 0, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 9, 8, 3, 10, 9, 3, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 2, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 2, 3, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 9, 8, 11, 1, 9, 11, 2, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 1, 3, 11, 10, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 1, 0, 11, 10, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 3, 11, 9, 0, 11, 10, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 9, 8, 11, 10, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 4, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 0, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 9, 4, 3, 1, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 0, 4, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 9, 2, 10, 9, 0, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 9, 4, 3, 10, 9, 3, 2, 10, -1, -1, -1, -1 },
+		{ 8, 4, 7, 11, 2, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 4, 7, 11, 0, 4, 11, 2, 0, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 11, 2, 3, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 4, 7, 11, 9, 4, 11, 1, 9, 11, 2, 1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 11, 1, 3, 11, 10, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 4, 7, 11, 0, 4, 11, 1, 0, 11, 10, 1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 11, 0, 3, 11, 9, 0, 11, 10, 9, -1, -1, -1, -1 },
+		{ 11, 4, 7, 11, 9, 4, 11, 10, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 4, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 0, 1, 5, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 8, 3, 5, 4, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 2, 10, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, 1, 2, 10, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 2, 10, 5, 0, 2, 5, 4, 0, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 8, 3, 5, 4, 3, 10, 5, 3, 2, 10, -1, -1, -1, -1 },
+		{ 11, 2, 3, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 2, 0, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 2, 3, 5, 0, 1, 5, 4, 0, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 4, 8, 11, 5, 4, 11, 1, 5, 11, 2, 1, -1, -1, -1, -1 },
+		{ 11, 1, 3, 11, 10, 1, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 1, 0, 11, 10, 1, 5, 4, 9, -1, -1, -1, -1 },
+		{ 11, 0, 3, 11, 4, 0, 11, 5, 4, 11, 10, 5, -1, -1, -1, -1 },
+		{ 11, 4, 8, 11, 5, 4, 11, 10, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 5, 7, 8, 9, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 5, 7, 3, 9, 5, 3, 0, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 5, 7, 8, 1, 5, 8, 0, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 5, 7, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 5, 7, 8, 9, 5, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 5, 7, 3, 9, 5, 3, 0, 9, 1, 2, 10, -1, -1, -1, -1 },
+		{ 8, 5, 7, 8, 10, 5, 8, 2, 10, 8, 0, 2, -1, -1, -1, -1 },
+		{ 3, 5, 7, 3, 10, 5, 3, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 5, 7, 8, 9, 5, 11, 2, 3, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 5, 7, 11, 9, 5, 11, 0, 9, 11, 2, 0, -1, -1, -1, -1 },
+		{ 8, 5, 7, 8, 1, 5, 8, 0, 1, 11, 2, 3, -1, -1, -1, -1 },
+		{ 11, 5, 7, 11, 1, 5, 11, 2, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 5, 7, 8, 9, 5, 11, 1, 3, 11, 10, 1, -1, -1, -1, -1 },
+		{ 11, 5, 7, 11, 9, 5, 11, 0, 9, 11, 1, 0, 11, 10, 1, -1 },
+		{ 8, 5, 7, 8, 10, 5, 8, 11, 10, 8, 3, 11, 8, 0, 3, -1 },
+		{ 11, 5, 7, 11, 10, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 9, 0, 1, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 9, 8, 3, 1, 9, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 6, 5, 1, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, 1, 6, 5, 1, 2, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 9, 6, 5, 9, 2, 6, 9, 0, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 9, 8, 3, 5, 9, 3, 6, 5, 3, 2, 6, -1, -1, -1, -1 },
+		{ 11, 2, 3, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 2, 0, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 2, 3, 9, 0, 1, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 9, 8, 11, 1, 9, 11, 2, 1, 10, 6, 5, -1, -1, -1, -1 },
+		{ 11, 1, 3, 11, 5, 1, 11, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 1, 0, 11, 5, 1, 11, 6, 5, -1, -1, -1, -1 },
+		{ 11, 0, 3, 11, 9, 0, 11, 5, 9, 11, 6, 5, -1, -1, -1, -1 },
+		{ 11, 9, 8, 11, 5, 9, 11, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 0, 4, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 4, 7, 9, 0, 1, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 9, 4, 3, 1, 9, 10, 6, 5, -1, -1, -1, -1 },
+		{ 8, 4, 7, 1, 6, 5, 1, 2, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 0, 4, 1, 6, 5, 1, 2, 6, -1, -1, -1, -1 },
+		{ 8, 4, 7, 9, 6, 5, 9, 2, 6, 9, 0, 2, -1, -1, -1, -1 },
+		{ 3, 4, 7, 3, 9, 4, 3, 5, 9, 3, 6, 5, 3, 2, 6, -1 },
+		{ 8, 4, 7, 11, 2, 3, 10, 6, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 4, 7, 11, 0, 4, 11, 2, 0, 10, 6, 5, -1, -1, -1, -1 },
+		{ 8, 4, 7, 11, 2, 3, 9, 0, 1, 10, 6, 5, -1, -1, -1, -1 },
+		{ 11, 4, 7, 11, 9, 4, 11, 1, 9, 11, 2, 1, 10, 6, 5, -1 },
+		{ 8, 4, 7, 11, 1, 3, 11, 5, 1, 11, 6, 5, -1, -1, -1, -1 },
+		{ 11, 4, 7, 11, 0, 4, 11, 1, 0, 11, 5, 1, 11, 6, 5, -1 },
+		{ 8, 4, 7, 11, 0, 3, 11, 9, 0, 11, 5, 9, 11, 6, 5, -1 },
+		{ 11, 4, 7, 11, 9, 4, 11, 5, 9, 11, 6, 5, -1, -1, -1, -1 },
+		{ 10, 4, 9, 10, 6, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, 10, 4, 9, 10, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10, 0, 1, 10, 4, 0, 10, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 8, 3, 6, 4, 3, 10, 6, 3, 1, 10, -1, -1, -1, -1 },
+		{ 1, 4, 9, 1, 6, 4, 1, 2, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 0, 8, 1, 4, 9, 1, 6, 4, 1, 2, 6, -1, -1, -1, -1 },
+		{ 0, 6, 4, 0, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 4, 8, 3, 6, 4, 3, 2, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 2, 3, 10, 4, 9, 10, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 2, 0, 10, 4, 9, 10, 6, 4, -1, -1, -1, -1 },
+		{ 11, 2, 3, 10, 0, 1, 10, 4, 0, 10, 6, 4, -1, -1, -1, -1 },
+		{ 11, 4, 8, 11, 6, 4, 11, 10, 6, 11, 1, 10, 11, 2, 1, -1 },
+		{ 11, 1, 3, 11, 9, 1, 11, 4, 9, 11, 6, 4, -1, -1, -1, -1 },
+		{ 11, 0, 8, 11, 1, 0, 11, 9, 1, 11, 4, 9, 11, 6, 4, -1 },
+		{ 11, 0, 3, 11, 4, 0, 11, 6, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 11, 4, 8, 11, 6, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 6, 7, 8, 10, 6, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 6, 7, 3, 10, 6, 3, 9, 10, 3, 0, 9, -1, -1, -1, -1 },
+		{ 8, 6, 7, 8, 10, 6, 8, 1, 10, 8, 0, 1, -1, -1, -1, -1 },
+		{ 3, 6, 7, 3, 10, 6, 3, 1, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 6, 7, 8, 2, 6, 8, 1, 2, 8, 9, 1, -1, -1, -1, -1 },
+		{ 3, 6, 7, 3, 2, 6, 3, 1, 2, 3, 9, 1, 3, 0, 9, -1 },
+		{ 8, 6, 7, 8, 2, 6, 8, 0, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 6, 7, 3, 2, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 6, 7, 8, 10, 6, 8, 9, 10, 11, 2, 3, -1, -1, -1, -1 },
+		{ 11, 6, 7, 11, 10, 6, 11, 9, 10, 11, 0, 9, 11, 2, 0, -1 },
+		{ 8, 6, 7, 8, 10, 6, 8, 1, 10, 8, 0, 1, 11, 2, 3, -1 },
+		{ 11, 6, 7, 11, 10, 6, 11, 1, 10, 11, 2, 1, -1, -1, -1, -1 },
+		{ 8, 6, 7, 8, 11, 6, 8, 3, 11, 8, 1, 3, 8, 9, 1, -1 },
+		{ 11, 6, 7, 1, 0, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 6, 7, 8, 11, 6, 8, 3, 11, 8, 0, 3, -1, -1, -1, -1 },
+		{ 11, 6, 7, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 0, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 9, 8, 3, 1, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 0, 8, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 9, 2, 10, 9, 0, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 9, 8, 3, 10, 9, 3, 2, 10, -1, -1, -1, -1 },
+		{ 7, 2, 3, 7, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 2, 0, 7, 6, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 2, 3, 7, 6, 2, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 9, 8, 7, 1, 9, 7, 2, 1, 7, 6, 2, -1, -1, -1, -1 },
+		{ 7, 1, 3, 7, 10, 1, 7, 6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 1, 0, 7, 10, 1, 7, 6, 10, -1, -1, -1, -1 },
+		{ 7, 0, 3, 7, 9, 0, 7, 10, 9, 7, 6, 10, -1, -1, -1, -1 },
+		{ 7, 9, 8, 7, 10, 9, 7, 6, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 6, 11, 8, 4, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 6, 11, 3, 4, 6, 3, 0, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 6, 11, 8, 4, 6, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 6, 11, 3, 4, 6, 3, 9, 4, 3, 1, 9, -1, -1, -1, -1 },
+		{ 8, 6, 11, 8, 4, 6, 1, 2, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 6, 11, 3, 4, 6, 3, 0, 4, 1, 2, 10, -1, -1, -1, -1 },
+		{ 8, 6, 11, 8, 4, 6, 9, 2, 10, 9, 0, 2, -1, -1, -1, -1 },
+		{ 3, 6, 11, 3, 4, 6, 3, 9, 4, 3, 10, 9, 3, 2, 10, -1 },
+		{ 8, 2, 3, 8, 6, 2, 8, 4, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 4, 2, 0, 4, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 2, 3, 8, 6, 2, 8, 4, 6, 9, 0, 1, -1, -1, -1, -1 },
+		{ 9, 2, 1, 9, 6, 2, 9, 4, 6, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 1, 3, 8, 10, 1, 8, 6, 10, 8, 4, 6, -1, -1, -1, -1 },
+		{ 1, 6, 10, 1, 4, 6, 1, 0, 4, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 0, 3, 8, 9, 0, 8, 10, 9, 8, 6, 10, 8, 4, 6, -1 },
+		{ 9, 6, 10, 9, 4, 6, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 0, 8, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 5, 0, 1, 5, 4, 0, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 4, 8, 3, 5, 4, 3, 1, 5, -1, -1, -1, -1 },
+		{ 7, 6, 11, 1, 2, 10, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 0, 8, 1, 2, 10, 5, 4, 9, -1, -1, -1, -1 },
+		{ 7, 6, 11, 5, 2, 10, 5, 0, 2, 5, 4, 0, -1, -1, -1, -1 },
+		{ 7, 6, 11, 3, 4, 8, 3, 5, 4, 3, 10, 5, 3, 2, 10, -1 },
+		{ 7, 2, 3, 7, 6, 2, 5, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 2, 0, 7, 6, 2, 5, 4, 9, -1, -1, -1, -1 },
+		{ 7, 2, 3, 7, 6, 2, 5, 0, 1, 5, 4, 0, -1, -1, -1, -1 },
+		{ 7, 4, 8, 7, 5, 4, 7, 1, 5, 7, 2, 1, 7, 6, 2, -1 },
+		{ 7, 1, 3, 7, 10, 1, 7, 6, 10, 5, 4, 9, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 1, 0, 7, 10, 1, 7, 6, 10, 5, 4, 9, -1 },
+		{ 7, 0, 3, 7, 4, 0, 7, 5, 4, 7, 10, 5, 7, 6, 10, -1 },
+		{ 7, 4, 8, 7, 5, 4, 7, 10, 5, 7, 6, 10, -1, -1, -1, -1 },
+		{ 8, 6, 11, 8, 5, 6, 8, 9, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 6, 11, 3, 5, 6, 3, 9, 5, 3, 0, 9, -1, -1, -1, -1 },
+		{ 8, 6, 11, 8, 5, 6, 8, 1, 5, 8, 0, 1, -1, -1, -1, -1 },
+		{ 3, 6, 11, 3, 5, 6, 3, 1, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 6, 11, 8, 5, 6, 8, 9, 5, 1, 2, 10, -1, -1, -1, -1 },
+		{ 3, 6, 11, 3, 5, 6, 3, 9, 5, 3, 0, 9, 1, 2, 10, -1 },
+		{ 8, 6, 11, 8, 5, 6, 8, 10, 5, 8, 2, 10, 8, 0, 2, -1 },
+		{ 3, 6, 11, 3, 5, 6, 3, 10, 5, 3, 2, 10, -1, -1, -1, -1 },
+		{ 8, 2, 3, 8, 6, 2, 8, 5, 6, 8, 9, 5, -1, -1, -1, -1 },
+		{ 5, 0, 9, 5, 2, 0, 5, 6, 2, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 2, 3, 8, 6, 2, 8, 5, 6, 8, 1, 5, 8, 0, 1, -1 },
+		{ 5, 2, 1, 5, 6, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 1, 3, 8, 10, 1, 8, 6, 10, 8, 5, 6, 8, 9, 5, -1 },
+		{ 1, 6, 10, 1, 5, 6, 1, 9, 5, 1, 0, 9, -1, -1, -1, -1 },
+		{ 8, 0, 3, 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 5, 6, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 5, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 5, 10, 3, 0, 8, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 5, 10, 9, 0, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 5, 10, 3, 9, 8, 3, 1, 9, -1, -1, -1, -1 },
+		{ 7, 2, 11, 7, 1, 2, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 2, 11, 7, 1, 2, 7, 5, 1, 3, 0, 8, -1, -1, -1, -1 },
+		{ 7, 2, 11, 7, 0, 2, 7, 9, 0, 7, 5, 9, -1, -1, -1, -1 },
+		{ 7, 2, 11, 7, 3, 2, 7, 8, 3, 7, 9, 8, 7, 5, 9, -1 },
+		{ 7, 2, 3, 7, 10, 2, 7, 5, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 2, 0, 7, 10, 2, 7, 5, 10, -1, -1, -1, -1 },
+		{ 7, 2, 3, 7, 10, 2, 7, 5, 10, 9, 0, 1, -1, -1, -1, -1 },
+		{ 7, 9, 8, 7, 1, 9, 7, 2, 1, 7, 10, 2, 7, 5, 10, -1 },
+		{ 7, 1, 3, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 1, 0, 7, 5, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 0, 3, 7, 9, 0, 7, 5, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 9, 8, 7, 5, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 10, 11, 8, 5, 10, 8, 4, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 10, 11, 3, 5, 10, 3, 4, 5, 3, 0, 4, -1, -1, -1, -1 },
+		{ 8, 10, 11, 8, 5, 10, 8, 4, 5, 9, 0, 1, -1, -1, -1, -1 },
+		{ 3, 10, 11, 3, 5, 10, 3, 4, 5, 3, 9, 4, 3, 1, 9, -1 },
+		{ 8, 2, 11, 8, 1, 2, 8, 5, 1, 8, 4, 5, -1, -1, -1, -1 },
+		{ 3, 2, 11, 3, 1, 2, 3, 5, 1, 3, 4, 5, 3, 0, 4, -1 },
+		{ 8, 2, 11, 8, 0, 2, 8, 9, 0, 8, 5, 9, 8, 4, 5, -1 },
+		{ 3, 2, 11, 9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 2, 3, 8, 10, 2, 8, 5, 10, 8, 4, 5, -1, -1, -1, -1 },
+		{ 10, 4, 5, 10, 0, 4, 10, 2, 0, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 2, 3, 8, 10, 2, 8, 5, 10, 8, 4, 5, 9, 0, 1, -1 },
+		{ 9, 2, 1, 9, 10, 2, 9, 5, 10, 9, 4, 5, -1, -1, -1, -1 },
+		{ 8, 1, 3, 8, 5, 1, 8, 4, 5, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 4, 5, 1, 0, 4, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 0, 3, 8, 9, 0, 8, 5, 9, 8, 4, 5, -1, -1, -1, -1 },
+		{ 9, 4, 5, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 9, 10, 7, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 9, 10, 7, 4, 9, 3, 0, 8, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 1, 10, 7, 0, 1, 7, 4, 0, -1, -1, -1, -1 },
+		{ 7, 10, 11, 7, 1, 10, 7, 3, 1, 7, 8, 3, 7, 4, 8, -1 },
+		{ 7, 2, 11, 7, 1, 2, 7, 9, 1, 7, 4, 9, -1, -1, -1, -1 },
+		{ 7, 2, 11, 7, 1, 2, 7, 9, 1, 7, 4, 9, 3, 0, 8, -1 },
+		{ 7, 2, 11, 7, 0, 2, 7, 4, 0, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 2, 11, 7, 3, 2, 7, 8, 3, 7, 4, 8, -1, -1, -1, -1 },
+		{ 7, 2, 3, 7, 10, 2, 7, 9, 10, 7, 4, 9, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 2, 0, 7, 10, 2, 7, 9, 10, 7, 4, 9, -1 },
+		{ 7, 2, 3, 7, 10, 2, 7, 1, 10, 7, 0, 1, 7, 4, 0, -1 },
+		{ 7, 4, 8, 10, 2, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 1, 3, 7, 9, 1, 7, 4, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 0, 8, 7, 1, 0, 7, 9, 1, 7, 4, 9, -1, -1, -1, -1 },
+		{ 7, 0, 3, 7, 4, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 7, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 10, 11, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 10, 11, 3, 9, 10, 3, 0, 9, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 10, 11, 8, 1, 10, 8, 0, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 10, 11, 3, 1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 2, 11, 8, 1, 2, 8, 9, 1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 2, 11, 3, 1, 2, 3, 9, 1, 3, 0, 9, -1, -1, -1, -1 },
+		{ 8, 2, 11, 8, 0, 2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 3, 2, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 2, 3, 8, 10, 2, 8, 9, 10, -1, -1, -1, -1, -1, -1, -1 },
+		{ 10, 0, 9, 10, 2, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 2, 3, 8, 10, 2, 8, 1, 10, 8, 0, 1, -1, -1, -1, -1 },
+		{ 10, 2, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 1, 3, 8, 9, 1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 1, 0, 9, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ 8, 0, 3, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+		{ -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+	};
+
+	inline uint32_t SampleIndex(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return (z * SampleSize + y) * SampleSize + x;
+	}
+}
+
+MarchingCubes::MarchingCubes() :
+	m_extractedStamp(0),
+	m_extractedResetCount(0),
+	m_minWeight(1),
+	m_simplifyRatio(1.0f),
+	m_simplifyMaxError(1.0e30f),
+	m_maxBlocksPerUpdate(0xFFFFFFFF)
+{
+}
+
+void MarchingCubes::SetSimplification(float ratio, float maxError)
+{
+	m_simplifyRatio = ratio;
+	m_simplifyMaxError = maxError;
+}
+
+void MarchingCubes::Reset()
+{
+	m_meshes.clear();
+	m_dirty.clear();
+	m_dirtyList.clear();
+	m_extractedStamp = 0;
+}
+
+void MarchingCubes::ExtractBlock(const TsdfVolume& volume, uint32_t blockIndex, BlockMesh* mesh) const
+{
+	const TsdfVolume::Block& block = volume.GetBlock(blockIndex);
+	mesh->coordinate = block.coordinate;
+	mesh->vertices.clear();
+	mesh->indices.clear();
+
+	// 自分と +x、+y、+z 側の 7 つの隣のブロック。番号のビット 0、1、2 がそれぞれ x、y、z の隣です。
+	const TsdfVolume::Block* blocks[8];
+	for (uint32_t n = 0; n < 8; n++)
+	{
+		TsdfBlockCoordinate coordinate = block.coordinate;
+		coordinate.x += n & 1;
+		coordinate.y += (n >> 1) & 1;
+		coordinate.z += (n >> 2) & 1;
+		blocks[n] = n ? volume.FindBlock(coordinate) : &block;
+	}
+
+	// セルの角の距離を集めます。観測の足りないボクセルは NaN にして、そのセルを省きます。
+	// 表面から離れたブロックが大半なので、符号が変わらなければセルを調べずに終えます。
+	float distances[SampleCount];
+	bool hasInside = false;
+	bool hasOutside = false;
+	for (uint32_t z = 0; z < SampleSize; z++)
+	{
+		for (uint32_t y = 0; y < SampleSize; y++)
+		{
+			for (uint32_t x = 0; x < SampleSize; x++)
+			{
+				const uint32_t n = (x / BlockSize) | ((y / BlockSize) << 1) | ((z / BlockSize) << 2);
+				float& distance = distances[SampleIndex(x, y, z)];
+				distance = NAN;
+				if (!blocks[n])
+				{
+					continue;
+				}
+
+				const TsdfVoxel& voxel = blocks[n]->voxels[((z % BlockSize) * BlockSize + (y % BlockSize)) * BlockSize + (x % BlockSize)];
+				if (voxel.weight >= m_minWeight)
+				{
+					distance = static_cast<float>(voxel.distance) / TsdfVolume::DistanceScale;
+					hasInside = hasInside || voxel.distance < 0;
+					hasOutside = hasOutside || voxel.distance >= 0;
+				}
+			}
+		}
+	}
+
+	if (!hasInside || !hasOutside)
+	{
+		return;
+	}
+
+	uint16_t edgeVertices[SampleCount * 3];
+	memset(edgeVertices, 0xFF, sizeof(edgeVertices));
+
+	const float voxelSize = volume.GetVoxelSize();
+	const float origin[3] =
+	{
+		static_cast<float>(block.coordinate.x) * BlockSize + 0.5f,
+		static_cast<float>(block.coordinate.y) * BlockSize + 0.5f,
+		static_cast<float>(block.coordinate.z) * BlockSize + 0.5f
+	};
+
+	for (uint32_t z = 0; z < BlockSize; z++)
+	{
+		for (uint32_t y = 0; y < BlockSize; y++)
+		{
+			for (uint32_t x = 0; x < BlockSize; x++)
+			{
+				float corners[8];
+				uint32_t cubeIndex = 0;
+				bool valid = true;
+				for (uint32_t c = 0; c < 8; c++)
+				{
+					corners[c] = distances[SampleIndex(x + CornerOffsets[c][0], y + CornerOffsets[c][1], z + CornerOffsets[c][2])];
+					valid = valid && !std::isnan(corners[c]);
+					cubeIndex |= (corners[c] < 0.0f ? 1u : 0u) << c;
+				}
+
+				if (!valid || cubeIndex == 0 || cubeIndex == 0xFF)
+				{
+					continue;
+				}
+
+				const int8_t* edges = TriangleTable[cubeIndex];
+				for (uint32_t i = 0; edges[i] >= 0; i++)
+				{
+					const uint8_t* edgeOrigin = EdgeOrigins[edges[i]];
+					const uint8_t* offset = CornerOffsets[edgeOrigin[0]];
+					const uint32_t axis = edgeOrigin[1];
+					const uint32_t sample = SampleIndex(x + offset[0], y + offset[1], z + offset[2]);
+					uint16_t& vertexIndex = edgeVertices[sample * 3 + axis];
+
+					if (vertexIndex == NoVertex)
+					{
+						// 辺の両端の距離から、距離が 0 になる位置を線形に補間します。
+						const float d0 = distances[sample];
+						const float d1 = distances[sample + (axis == 0 ? 1 : axis == 1 ? SampleSize : SampleSize * SampleSize)];
+						const float t = d0 / (d0 - d1);
+
+						MeshVertex vertex;
+						vertex.position[0] = (origin[0] + x + offset[0] + (axis == 0 ? t : 0.0f)) * voxelSize;
+						vertex.position[1] = (origin[1] + y + offset[1] + (axis == 1 ? t : 0.0f)) * voxelSize;
+						vertex.position[2] = (origin[2] + z + offset[2] + (axis == 2 ? t : 0.0f)) * voxelSize;
+						vertex.color[0] = vertex.color[1] = vertex.color[2] = 0.0f;
+
+						vertexIndex = static_cast<uint16_t>(mesh->vertices.size());
+						mesh->vertices.push_back(vertex);
+					}
+
+					mesh->indices.push_back(vertexIndex);
+				}
+			}
+		}
+	}
+
+	// 面の法線を面積で重み付けして頂点に足し込み、法線を色にします。
+	// 三角形は内側を向いた外積になる向きなので、符号を反転して外向きにします。
+	for (size_t i = 0; i < mesh->indices.size(); i += 3)
+	{
+		MeshVertex& a = mesh->vertices[mesh->indices[i]];
+		MeshVertex& b = mesh->vertices[mesh->indices[i + 1]];
+		MeshVertex& c = mesh->vertices[mesh->indices[i + 2]];
+		const float u[3] = { b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2] };
+		const float v[3] = { c.position[0] - a.position[0], c.position[1] - a.position[1], c.position[2] - a.position[2] };
+		const float normal[3] = { v[1] * u[2] - v[2] * u[1], v[2] * u[0] - v[0] * u[2], v[0] * u[1] - v[1] * u[0] };
+		for (int k = 0; k < 3; k++)
+		{
+			a.color[k] += normal[k];
+			b.color[k] += normal[k];
+			c.color[k] += normal[k];
+		}
+	}
+
+	for (size_t i = 0; i < mesh->vertices.size(); i++)
+	{
+		float* color = mesh->vertices[i].color;
+		const float length = std::sqrt(color[0] * color[0] + color[1] * color[1] + color[2] * color[2]);
+		const float scale = length > 0.0f ? 0.5f / length : 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			color[k] = color[k] * scale + 0.5f;
+		}
+	}
+}
+
+// ブロックのメッシュを 32 ビットのインデックスの scratch に移して減らし、書き戻します。
+void MarchingCubes::SimplifyBlock(MeshSimplifier* simplifier, TriangleMesh* scratch, BlockMesh* mesh) const
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(mesh->indices.size() / 3);
+	const uint32_t targetTriangleCount = static_cast<uint32_t>(triangleCount * m_simplifyRatio);
+	if (targetTriangleCount >= triangleCount)
+	{
+		return;
+	}
+
+	scratch->vertices.swap(mesh->vertices);
+	scratch->indices.assign(mesh->indices.begin(), mesh->indices.end());
+
+	simplifier->SetLockBoundary(true);
+	simplifier->SetMaxError(m_simplifyMaxError);
+	simplifier->Simplify(scratch, targetTriangleCount);
+
+	mesh->vertices.swap(scratch->vertices);
+	mesh->indices.resize(scratch->indices.size());
+	for (size_t i = 0; i < scratch->indices.size(); i++)
+	{
+		mesh->indices[i] = static_cast<uint16_t>(scratch->indices[i]);
+	}
+}
+
+uint32_t MarchingCubes::Update(const TsdfVolume& volume, std::vector<uint32_t>* updated)
+{
+	updated->clear();
+
+	// ボリュームが作り直された場合は、すべてのブロックを抽出し直します。
+	if (volume.GetResetCount() != m_extractedResetCount)
+	{
+		Reset();
+		m_extractedResetCount = volume.GetResetCount();
+	}
+
+	const uint32_t blockCount = volume.GetBlockCount();
+	m_meshes.resize(blockCount);
+	m_dirty.resize(blockCount, 0);
+
+	// 変更されたブロックのボクセルは、-x、-y、-z 側の隣のブロックのセルの角にもなるので、それらも作り直します。
+	for (uint32_t i = 0; i < blockCount; i++)
+	{
+		const TsdfVolume::Block& block = volume.GetBlock(i);
+		if (block.modifiedStamp <= m_extractedStamp)
+		{
+			continue;
+		}
+
+		for (uint32_t n = 0; n < 8; n++)
+		{
+			TsdfBlockCoordinate coordinate = block.coordinate;
+			coordinate.x -= n & 1;
+			coordinate.y -= (n >> 1) & 1;
+			coordinate.z -= (n >> 2) & 1;
+
+			const uint32_t index = n ? volume.FindBlockIndex(coordinate) : i;
+			if (index != TsdfVolume::InvalidBlock && !m_dirty[index])
+			{
+				m_dirty[index] = 1;
+				m_dirtyList.push_back(index);
+			}
+		}
+	}
+
+	m_extractedStamp = volume.GetIntegrationCount();
+
+	// ブロックのメッシュは互いに独立しているので、並列に作ります。
+	// 作業ごとに MeshSimplifier を使い分けるため、ブロックを作業の数の間隔で分配します。
+	const size_t dirtyCount = std::min<size_t>(m_dirtyList.size(), m_maxBlocksPerUpdate);
+	const size_t taskCount = std::min<size_t>(dirtyCount, DX::GetWorkerCount());
+	const bool simplify = m_simplifyRatio < 1.0f;
+	if (simplify && m_simplifiers.size() < taskCount)
+	{
+		m_simplifiers.resize(taskCount);
+		m_simplifyMeshes.resize(taskCount);
+	}
+
+	DX::ParallelFor(0, taskCount, [&](size_t task)
+	{
+		for (size_t i = task; i < dirtyCount; i += taskCount)
+		{
+			BlockMesh* mesh = &m_meshes[m_dirtyList[i]];
+			ExtractBlock(volume, m_dirtyList[i], mesh);
+			if (simplify)
+			{
+				SimplifyBlock(&m_simplifiers[task], &m_simplifyMeshes[task], mesh);
+			}
+		}
+	});
+
+	updated->assign(m_dirtyList.begin(), m_dirtyList.begin() + dirtyCount);
+	for (size_t i = 0; i < dirtyCount; i++)
+	{
+		m_dirty[m_dirtyList[i]] = 0;
+	}
+	m_dirtyList.erase(m_dirtyList.begin(), m_dirtyList.begin() + dirtyCount);
+	return static_cast<uint32_t>(updated->size());
+}
@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "MeshSimplifier.h"
+#include "TriangleMesh.h"
+#include "TsdfVolume.h"
+
+namespace ProjectionMapping
+{
+	// 1 ブロック分の三角形メッシュ。1 ブロックの頂点は 65536 個に収まるので、16 ビットのインデックスを使います。
+	// 三角形は Sample3DSceneRenderer の立方体と同じく、外側から見て時計回りです。
+	struct BlockMesh
+	{
+		TsdfBlockCoordinate coordinate;
+		std::vector<MeshVertex> vertices;
+		std::vector<uint16_t> indices;
+	};
+
+	// TSDF ボリュームの表面をマーチング キューブ法でメッシュにします。
+	// 前回の抽出から変更されたブロック (と、そのボクセルを共有する隣のブロック) だけを並列に作り直します。
+	// 頂点はブロックごとの辺のキャッシュで共有し、インデックス付きのメッシュにします。
+	class MarchingCubes
+	{
+	public:
+		MarchingCubes();
+
+		// 重みがこれより小さいボクセルを含むセルは、観測が足りないとして省きます。
+		void SetMinWeight(uint16_t minWeight)				{ m_minWeight = minWeight; }
+
+		// 作り直したブロックのメッシュを、三角形の数の ratio 倍まで MeshSimplifier で減らします。1 以上で減らしません。
+		// ブロックの境界の頂点は固定するので、隣のブロックとの継ぎ目は開きません。maxError は縮約の誤差の上限 (メートル^2) です。
+		void SetSimplification(float ratio, float maxError);
+
+		// 1 回の Update で作り直すブロック数の上限。超えた分は古いものから順に次の Update で作り直します。
+		// 減らす場合は 1 コアで 1 ブロックあたり約 0.1 ミリ秒かかるので、フレームの時間に収まるように抑えます。
+		// 毎フレーム統合すると見えているブロックはすべて変更されるので、予算が足りない間は残りのブロックのメッシュが古いままです。
+		// 時間は MeshSimplifierBenchmark で測れます。
+		void SetMaxBlocksPerUpdate(uint32_t maxBlocks)		{ m_maxBlocksPerUpdate = maxBlocks; }
+
+		// 変更されたがまだ作り直していないブロックの数。
+		uint32_t GetPendingBlockCount() const				{ return static_cast<uint32_t>(m_dirtyList.size()); }
+
+		// すべてのメッシュを破棄して、次の Update ですべてのブロックを作り直します。
+		void Reset();
+
+		// volume の変更を反映します。作り直したメッシュの番号を updated に格納し、その数を返します。
+		// メッシュの番号は volume のブロックの番号と同じです。
+		uint32_t Update(const TsdfVolume& volume, std::vector<uint32_t>* updated);
+
+		uint32_t GetMeshCount() const						{ return static_cast<uint32_t>(m_meshes.size()); }
+		const BlockMesh& GetMesh(uint32_t index) const		{ return m_meshes[index]; }
+
+	private:
+		void ExtractBlock(const TsdfVolume& volume, uint32_t blockIndex, BlockMesh* mesh) const;
+		void SimplifyBlock(MeshSimplifier* simplifier, TriangleMesh* scratch, BlockMesh* mesh) const;
+
+		std::vector<BlockMesh>	m_meshes;
+		uint32_t				m_extractedStamp;
+		uint32_t				m_extractedResetCount;
+		uint16_t				m_minWeight;
+		float					m_simplifyRatio;
+		float					m_simplifyMaxError;
+		uint32_t				m_maxBlocksPerUpdate;
+
+		// まだ作り直していないブロックの印と、その番号 (古い順)。
+		std::vector<uint8_t>	m_dirty;
+		std::vector<uint32_t>	m_dirtyList;
+
+		// 並列の作業ごとの MeshSimplifier と、その入出力。
+		std::vector<MeshSimplifier>	m_simplifiers;
+		std::vector<TriangleMesh>	m_simplifyMeshes;
+	};
+}
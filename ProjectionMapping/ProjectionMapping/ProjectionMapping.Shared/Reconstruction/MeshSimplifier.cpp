@@ -0,0 +1,781 @@
+﻿#include "MeshSimplifier.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 並列に処理する単位の頂点や三角形の数。
+	const uint32_t ChunkSize = 4096;
+
+	// 最適な位置を解く 3x3 の行列式の下限。これより小さい場合は端点と中点から選びます。
+	const double MinDeterminant = 1.0e-12;
+
+	// 縮約の誤差に加える、辺の長さの 2 乗の重み。
+	const double EdgeLengthWeight = 1.0e-6;
+
+	// 縮約できる辺がない頂点の誤差。
+	const float NoCollapse = 3.0e38f;
+
+	const uint32_t NotInHeap = 0xFFFFFFFF;
+
+	template<typename TBody>
+	void ForEachChunk(size_t count, const TBody& body)
+	{
+		const size_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+		DX::ParallelFor(0, chunkCount, [&](size_t chunk)
+		{
+			const size_t begin = chunk * ChunkSize;
+			body(begin, std::min(begin + ChunkSize, count));
+		});
+	}
+
+	inline void Cross(const float* a, const float* b, double* result)
+	{
+		result[0] = static_cast<double>(a[1]) * b[2] - static_cast<double>(a[2]) * b[1];
+		result[1] = static_cast<double>(a[2]) * b[0] - static_cast<double>(a[0]) * b[2];
+		result[2] = static_cast<double>(a[0]) * b[1] - static_cast<double>(a[1]) * b[0];
+	}
+
+	// 平面 ax + by + cz + d = 0 からの距離の 2 乗を weight 倍した二次誤差を加えます。
+	inline void AddPlane(double* m, double a, double b, double c, double d, double weight)
+	{
+		m[0] += weight * a * a;	m[1] += weight * a * b;	m[2] += weight * a * c;	m[3] += weight * a * d;
+		m[4] += weight * b * b;	m[5] += weight * b * c;	m[6] += weight * b * d;
+		m[7] += weight * c * c;	m[8] += weight * c * d;
+		m[9] += weight * d * d;
+	}
+
+	inline double Evaluate(const double* m, double x, double y, double z)
+	{
+		return
+			m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x +
+			m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y +
+			m[7] * z * z + 2.0 * m[8] * z +
+			m[9];
+	}
+
+	// 三角形の (b - a) × (c - a)。
+	inline void TriangleNormal(const float* a, const float* b, const float* c, double* normal)
+	{
+		const float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		Cross(u, v, normal);
+	}
+}
+
+MeshSimplifier::MeshSimplifier() :
+	m_boundaryWeight(100.0f),
+	m_maxError(1.0e30f),
+	m_lockBoundary(false),
+	m_triangleCount(0)
+{
+}
+
+// 頂点ごとに、その頂点を含む三角形の番号を m_refs にまとめます。
+void MeshSimplifier::BuildRefs()
+{
+	for (size_t i = 0; i < m_vertices.size(); i++)
+	{
+		m_vertices[i].refCount = 0;
+	}
+	for (size_t t = 0; t < m_triangles.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			m_vertices[m_triangles[t].v[k]].refCount++;
+		}
+	}
+
+	uint32_t offset = 0;
+	for (size_t i = 0; i < m_vertices.size(); i++)
+	{
+		m_vertices[i].refBegin = offset;
+		offset += m_vertices[i].refCount;
+		m_vertices[i].refCount = 0;
+	}
+
+	// 縮約のたびに新しい範囲を末尾に追加するので、余裕を持って確保します。
+	m_refs.clear();
+	m_refs.reserve(static_cast<size_t>(offset) * 3);
+	m_refs.resize(offset);
+	for (size_t t = 0; t < m_triangles.size(); t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			Vertex& vertex = m_vertices[m_triangles[t].v[k]];
+			m_refs[vertex.refBegin + vertex.refCount++] = static_cast<uint32_t>(t);
+		}
+	}
+}
+
+void MeshSimplifier::Initialize(const TriangleMesh& mesh)
+{
+	m_vertices.resize(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		Vertex& vertex = m_vertices[i];
+		memcpy(vertex.position, mesh.vertices[i].position, sizeof(vertex.position));
+		memcpy(vertex.color, mesh.vertices[i].color, sizeof(vertex.color));
+		vertex.heapIndex = NotInHeap;
+		vertex.removed = false;
+		vertex.locked = false;
+	}
+
+	// 頂点を共有する退化した三角形は除きます。
+	m_triangles.clear();
+	m_triangles.reserve(mesh.indices.size() / 3);
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		Triangle triangle = { { mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] }, false };
+		if (triangle.v[0] != triangle.v[1] && triangle.v[1] != triangle.v[2] && triangle.v[2] != triangle.v[0])
+		{
+			m_triangles.push_back(triangle);
+		}
+	}
+	m_triangleCount = static_cast<uint32_t>(m_triangles.size());
+
+	BuildRefs();
+
+	// 頂点の二次誤差は、周りの三角形の平面からの距離の 2 乗を面積で重み付けした和です。
+	// 頂点ごとに自分の三角形だけを足すので、並列に求められます。
+	ForEachChunk(m_vertices.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			Vertex& vertex = m_vertices[i];
+			memset(&vertex.quadric, 0, sizeof(Quadric));
+
+			for (uint32_t r = 0; r < vertex.refCount; r++)
+			{
+				const Triangle& triangle = m_triangles[m_refs[vertex.refBegin + r]];
+				const float* p0 = m_vertices[triangle.v[0]].position;
+				double normal[3];
+				TriangleNormal(p0, m_vertices[triangle.v[1]].position, m_vertices[triangle.v[2]].position, normal);
+
+				const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				if (length <= 0.0)
+				{
+					continue;
+				}
+
+				const double a = normal[0] / length;
+				const double b = normal[1] / length;
+				const double c = normal[2] / length;
+				const double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+				AddPlane(vertex.quadric.m, a, b, c, d, length * 0.5);
+			}
+		}
+	});
+
+	AddBoundaryQuadrics();
+}
+
+// 1 つの三角形にしか含まれない辺を境界とし、三角形に垂直で辺を含む平面の二次誤差を両端に加えます。
+void MeshSimplifier::AddBoundaryQuadrics()
+{
+	std::vector<uint8_t>& boundaryEdges = m_boundaryEdges;
+	boundaryEdges.assign(m_triangles.size(), 0);
+	ForEachChunk(m_triangles.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			const Triangle& triangle = m_triangles[t];
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t a = triangle.v[k];
+				const uint32_t b = triangle.v[(k + 1) % 3];
+				const Vertex& vertex = m_vertices[a];
+
+				uint32_t shared = 0;
+				for (uint32_t r = 0; r < vertex.refCount; r++)
+				{
+					const Triangle& other = m_triangles[m_refs[vertex.refBegin + r]];
+					if (other.v[0] == b || other.v[1] == b || other.v[2] == b)
+					{
+						shared++;
+					}
+				}
+
+				if (shared == 1)
+				{
+					boundaryEdges[t] |= static_cast<uint8_t>(1 << k);
+				}
+			}
+		}
+	});
+
+	for (size_t t = 0; t < m_triangles.size(); t++)
+	{
+		if (!boundaryEdges[t])
+		{
+			continue;
+		}
+
+		const Triangle& triangle = m_triangles[t];
+		double normal[3];
+		TriangleNormal(m_vertices[triangle.v[0]].position, m_vertices[triangle.v[1]].position, m_vertices[triangle.v[2]].position, normal);
+
+		for (int k = 0; k < 3; k++)
+		{
+			if (!(boundaryEdges[t] & (1 << k)))
+			{
+				continue;
+			}
+
+			Vertex& a = m_vertices[triangle.v[k]];
+			Vertex& b = m_vertices[triangle.v[(k + 1) % 3]];
+			a.locked = m_lockBoundary;
+			b.locked = m_lockBoundary;
+
+			const float edge[3] = { b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2] };
+			const float faceNormal[3] = { static_cast<float>(normal[0]), static_cast<float>(normal[1]), static_cast<float>(normal[2]) };
+			double plane[3];
+			Cross(edge, faceNormal, plane);
+
+			const double length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			if (length <= 0.0)
+			{
+				continue;
+			}
+
+			// 辺の長さの 2 乗で重み付けして、面の二次誤差と単位をそろえます。
+			const double edgeLengthSquared = static_cast<double>(edge[0]) * edge[0] + static_cast<double>(edge[1]) * edge[1] + static_cast<double>(edge[2]) * edge[2];
+			const double pa = plane[0] / length;
+			const double pb = plane[1] / length;
+			const double pc = plane[2] / length;
+			const double pd = -(pa * a.position[0] + pb * a.position[1] + pc * a.position[2]);
+			AddPlane(a.quadric.m, pa, pb, pc, pd, m_boundaryWeight * edgeLengthSquared);
+			AddPlane(b.quadric.m, pa, pb, pc, pd, m_boundaryWeight * edgeLengthSquared);
+		}
+	}
+}
+
+// 2 つの頂点の二次誤差の和を最小にする位置を求めます。解けない場合は端点と中点のうち最小のものにします。
+// 固定した頂点は消さず、残す場合はその位置のままにします。
+bool MeshSimplifier::ComputeCollapse(uint32_t a, uint32_t b, Collapse* collapse) const
+{
+	const Vertex& va = m_vertices[a];
+	const Vertex& vb = m_vertices[b];
+	if (vb.locked)
+	{
+		return false;
+	}
+
+	double q[10];
+	for (int i = 0; i < 10; i++)
+	{
+		q[i] = va.quadric.m[i] + vb.quadric.m[i];
+	}
+
+	const double determinant =
+		q[0] * (q[4] * q[7] - q[5] * q[5]) -
+		q[1] * (q[1] * q[7] - q[5] * q[2]) +
+		q[2] * (q[1] * q[5] - q[4] * q[2]);
+
+	double position[3];
+	double cost;
+	if (va.locked)
+	{
+		position[0] = va.position[0];
+		position[1] = va.position[1];
+		position[2] = va.position[2];
+		cost = Evaluate(q, position[0], position[1], position[2]);
+	}
+	else if (std::fabs(determinant) > MinDeterminant)
+	{
+		// Cramer の公式で [q0 q1 q2; q1 q4 q5; q2 q5 q7] x = -[q3 q6 q8] を解きます。
+		const double inverse = 1.0 / determinant;
+		position[0] = -inverse * (q[3] * (q[4] * q[7] - q[5] * q[5]) - q[1] * (q[6] * q[7] - q[5] * q[8]) + q[2] * (q[6] * q[5] - q[4] * q[8]));
+		position[1] = -inverse * (q[0] * (q[6] * q[7] - q[8] * q[5]) - q[3] * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * q[8] - q[6] * q[2]));
+		position[2] = -inverse * (q[0] * (q[4] * q[8] - q[5] * q[6]) - q[1] * (q[1] * q[8] - q[6] * q[2]) + q[3] * (q[1] * q[5] - q[4] * q[2]));
+		cost = Evaluate(q, position[0], position[1], position[2]);
+	}
+	else
+	{
+		const double candidates[3][3] =
+		{
+			{ va.position[0], va.position[1], va.position[2] },
+			{ vb.position[0], vb.position[1], vb.position[2] },
+			{ (va.position[0] + vb.position[0]) * 0.5, (va.position[1] + vb.position[1]) * 0.5, (va.position[2] + vb.position[2]) * 0.5 }
+		};
+
+		memcpy(position, candidates[0], sizeof(position));
+		cost = Evaluate(q, position[0], position[1], position[2]);
+		for (int c = 1; c < 3; c++)
+		{
+			const double error = Evaluate(q, candidates[c][0], candidates[c][1], candidates[c][2]);
+			if (error < cost)
+			{
+				cost = error;
+				memcpy(position, candidates[c], sizeof(position));
+			}
+		}
+	}
+
+	// 平らな部分では誤差がすべて 0 になり、同じ頂点に縮約が集中して次数が増え続けるので、
+	// 辺の長さの 2 乗をわずかに加えて短い辺を優先します。
+	const double edge[3] = { vb.position[0] - va.position[0], vb.position[1] - va.position[1], vb.position[2] - va.position[2] };
+	cost = std::max(cost, 0.0) + EdgeLengthWeight * (edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2]);
+
+	collapse->cost = static_cast<float>(cost);
+	collapse->keep = a;
+	collapse->remove = b;
+	for (int i = 0; i < 3; i++)
+	{
+		collapse->position[i] = static_cast<float>(position[i]);
+	}
+	return std::isfinite(collapse->cost);
+}
+
+bool MeshSimplifier::IsCollapseValid(const Collapse& collapse)
+{
+	const Vertex& keep = m_vertices[collapse.keep];
+	const Vertex& remove = m_vertices[collapse.remove];
+
+	// 両方の頂点に隣接する頂点は、辺を共有する三角形の向かいの頂点だけでなければなりません。
+	// そうでないと縮約で同じ辺を持つ三角形が 3 つ以上になり、多様体でなくなります。
+	m_neighbors.clear();
+	m_otherNeighbors.clear();
+	uint32_t sharedTriangles = 0;
+	for (uint32_t r = 0; r < keep.refCount; r++)
+	{
+		const Triangle& triangle = m_triangles[m_refs[keep.refBegin + r]];
+		if (triangle.removed)
+		{
+			continue;
+		}
+		if (triangle.v[0] == collapse.remove || triangle.v[1] == collapse.remove || triangle.v[2] == collapse.remove)
+		{
+			sharedTriangles++;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			m_neighbors.push_back(triangle.v[k]);
+		}
+	}
+	for (uint32_t r = 0; r < remove.refCount; r++)
+	{
+		const Triangle& triangle = m_triangles[m_refs[remove.refBegin + r]];
+		if (triangle.removed)
+		{
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			m_otherNeighbors.push_back(triangle.v[k]);
+		}
+	}
+
+	std::sort(m_neighbors.begin(), m_neighbors.end());
+	m_neighbors.erase(std::unique(m_neighbors.begin(), m_neighbors.end()), m_neighbors.end());
+	std::sort(m_otherNeighbors.begin(), m_otherNeighbors.end());
+	m_otherNeighbors.erase(std::unique(m_otherNeighbors.begin(), m_otherNeighbors.end()), m_otherNeighbors.end());
+
+	uint32_t sharedNeighbors = 0;
+	for (size_t i = 0, j = 0; i < m_neighbors.size() && j < m_otherNeighbors.size(); )
+	{
+		if (m_neighbors[i] < m_otherNeighbors[j])
+		{
+			i++;
+		}
+		else if (m_otherNeighbors[j] < m_neighbors[i])
+		{
+			j++;
+		}
+		else
+		{
+			if (m_neighbors[i] != collapse.keep && m_neighbors[i] != collapse.remove)
+			{
+				sharedNeighbors++;
+			}
+			i++;
+			j++;
+		}
+	}
+
+	if (sharedTriangles == 0 || sharedNeighbors != sharedTriangles)
+	{
+		return false;
+	}
+
+	// 残る三角形が裏返ったり潰れたりしないことを確かめます。
+	const uint32_t vertices[2] = { collapse.keep, collapse.remove };
+	for (int side = 0; side < 2; side++)
+	{
+		const Vertex& vertex = m_vertices[vertices[side]];
+		for (uint32_t r = 0; r < vertex.refCount; r++)
+		{
+			const Triangle& triangle = m_triangles[m_refs[vertex.refBegin + r]];
+			if (triangle.removed)
+			{
+				continue;
+			}
+
+			const float* positions[3];
+			bool shared = false;
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t v = triangle.v[k];
+				shared = shared || (v == vertices[1 - side]);
+				positions[k] = m_vertices[v].position;
+			}
+			if (shared)
+			{
+				continue;
+			}
+
+			double before[3];
+			TriangleNormal(positions[0], positions[1], positions[2], before);
+			for (int k = 0; k < 3; k++)
+			{
+				if (triangle.v[k] == vertices[side])
+				{
+					positions[k] = collapse.position;
+				}
+			}
+			double after[3];
+			TriangleNormal(positions[0], positions[1], positions[2], after);
+
+			const double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+			const double afterLengthSquared = after[0] * after[0] + after[1] * after[1] + after[2] * after[2];
+			if (dot <= 0.0 || afterLengthSquared <= 0.0)
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// remove を keep に縮約します。両方を含む三角形は消え、remove を含む三角形は keep を含むように付け替えます。
+void MeshSimplifier::ApplyCollapse(const Collapse& collapse)
+{
+	Vertex& keep = m_vertices[collapse.keep];
+	Vertex& remove = m_vertices[collapse.remove];
+
+	// 色は新しい位置を辺に射影した割合で補間します。
+	const float edge[3] = { remove.position[0] - keep.position[0], remove.position[1] - keep.position[1], remove.position[2] - keep.position[2] };
+	const float edgeLengthSquared = edge[0] * edge[0] + edge[1] * edge[1] + edge[2] * edge[2];
+	float t = 0.5f;
+	if (edgeLengthSquared > 0.0f)
+	{
+		t = ((collapse.position[0] - keep.position[0]) * edge[0] + (collapse.position[1] - keep.position[1]) * edge[1] + (collapse.position[2] - keep.position[2]) * edge[2]) / edgeLengthSquared;
+		t = std::min(std::max(t, 0.0f), 1.0f);
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		keep.position[i] = collapse.position[i];
+		keep.color[i] += (remove.color[i] - keep.color[i]) * t;
+	}
+	for (int i = 0; i < 10; i++)
+	{
+		keep.quadric.m[i] += remove.quadric.m[i];
+	}
+	remove.removed = true;
+
+	// 残った三角形の番号を、m_refs の末尾に keep の新しい範囲として追加します。
+	const uint32_t refBegin = static_cast<uint32_t>(m_refs.size());
+	for (uint32_t r = 0; r < keep.refCount; r++)
+	{
+		const uint32_t t = m_refs[keep.refBegin + r];
+		Triangle& triangle = m_triangles[t];
+		if (triangle.removed)
+		{
+			continue;
+		}
+		if (triangle.v[0] == collapse.remove || triangle.v[1] == collapse.remove || triangle.v[2] == collapse.remove)
+		{
+			triangle.removed = true;
+			m_triangleCount--;
+			continue;
+		}
+		m_refs.push_back(t);
+	}
+	for (uint32_t r = 0; r < remove.refCount; r++)
+	{
+		const uint32_t t = m_refs[remove.refBegin + r];
+		Triangle& triangle = m_triangles[t];
+		if (triangle.removed)
+		{
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			if (triangle.v[k] == collapse.remove)
+			{
+				triangle.v[k] = collapse.keep;
+			}
+		}
+		m_refs.push_back(t);
+	}
+
+	keep.refBegin = refBegin;
+	keep.refCount = static_cast<uint32_t>(m_refs.size()) - refBegin;
+	remove.refCount = 0;
+}
+
+void MeshSimplifier::GatherNeighbors(uint32_t vertex, std::vector<uint32_t>* neighbors) const
+{
+	const Vertex& v = m_vertices[vertex];
+	neighbors->clear();
+	for (uint32_t r = 0; r < v.refCount; r++)
+	{
+		const Triangle& triangle = m_triangles[m_refs[v.refBegin + r]];
+		if (triangle.removed)
+		{
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			if (triangle.v[k] != vertex)
+			{
+				neighbors->push_back(triangle.v[k]);
+			}
+		}
+	}
+
+	std::sort(neighbors->begin(), neighbors->end());
+	neighbors->erase(std::unique(neighbors->begin(), neighbors->end()), neighbors->end());
+}
+
+// vertex から隣の頂点への縮約のうち、誤差の最も小さいものを求めてキューを更新します。
+void MeshSimplifier::UpdateBestCollapse(uint32_t vertex)
+{
+	Collapse& best = m_best[vertex];
+	const float previousCost = best.cost;
+	best.cost = NoCollapse;
+	best.keep = vertex;
+	best.remove = vertex;
+
+	GatherNeighbors(vertex, &m_otherNeighbors);
+	for (size_t i = 0; i < m_otherNeighbors.size(); i++)
+	{
+		Collapse collapse;
+		if (ComputeCollapse(vertex, m_otherNeighbors[i], &collapse) && collapse.cost < best.cost)
+		{
+			best = collapse;
+		}
+	}
+
+	const uint32_t position = m_vertices[vertex].heapIndex;
+	if (position == NotInHeap)
+	{
+		return;
+	}
+	if (best.cost < previousCost)
+	{
+		HeapSiftUp(position);
+	}
+	else
+	{
+		HeapSiftDown(position);
+	}
+}
+
+void MeshSimplifier::HeapSiftUp(uint32_t position)
+{
+	const uint32_t vertex = m_heap[position];
+	const float cost = m_best[vertex].cost;
+	while (position > 0)
+	{
+		const uint32_t parent = (position - 1) / 2;
+		if (m_best[m_heap[parent]].cost <= cost)
+		{
+			break;
+		}
+		m_heap[position] = m_heap[parent];
+		m_vertices[m_heap[position]].heapIndex = position;
+		position = parent;
+	}
+	m_heap[position] = vertex;
+	m_vertices[vertex].heapIndex = position;
+}
+
+void MeshSimplifier::HeapSiftDown(uint32_t position)
+{
+	const uint32_t count = static_cast<uint32_t>(m_heap.size());
+	const uint32_t vertex = m_heap[position];
+	const float cost = m_best[vertex].cost;
+	for (;;)
+	{
+		uint32_t child = position * 2 + 1;
+		if (child >= count)
+		{
+			break;
+		}
+		if (child + 1 < count && m_best[m_heap[child + 1]].cost < m_best[m_heap[child]].cost)
+		{
+			child++;
+		}
+		if (cost <= m_best[m_heap[child]].cost)
+		{
+			break;
+		}
+		m_heap[position] = m_heap[child];
+		m_vertices[m_heap[position]].heapIndex = position;
+		position = child;
+	}
+	m_heap[position] = vertex;
+	m_vertices[vertex].heapIndex = position;
+}
+
+void MeshSimplifier::HeapRemove(uint32_t vertex)
+{
+	const uint32_t position = m_vertices[vertex].heapIndex;
+	if (position == NotInHeap)
+	{
+		return;
+	}
+
+	m_vertices[vertex].heapIndex = NotInHeap;
+	const uint32_t last = m_heap.back();
+	m_heap.pop_back();
+	if (last == vertex)
+	{
+		return;
+	}
+
+	m_heap[position] = last;
+	m_vertices[last].heapIndex = position;
+	HeapSiftUp(position);
+	HeapSiftDown(m_vertices[last].heapIndex);
+}
+
+// 残った三角形が使う頂点だけを詰めて mesh に書き戻します。
+void MeshSimplifier::Compact(TriangleMesh* mesh) const
+{
+	std::vector<uint32_t> remap(m_vertices.size(), 0xFFFFFFFF);
+	mesh->vertices.clear();
+	mesh->indices.clear();
+	mesh->indices.reserve(static_cast<size_t>(m_triangleCount) * 3);
+
+	for (size_t t = 0; t < m_triangles.size(); t++)
+	{
+		const Triangle& triangle = m_triangles[t];
+		if (triangle.removed)
+		{
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t v = triangle.v[k];
+			if (remap[v] == 0xFFFFFFFF)
+			{
+				remap[v] = static_cast<uint32_t>(mesh->vertices.size());
+				MeshVertex vertex;
+				memcpy(vertex.position, m_vertices[v].position, sizeof(vertex.position));
+				memcpy(vertex.color, m_vertices[v].color, sizeof(vertex.color));
+				mesh->vertices.push_back(vertex);
+			}
+			mesh->indices.push_back(remap[v]);
+		}
+	}
+}
+
+uint32_t MeshSimplifier::Simplify(TriangleMesh* mesh, uint32_t targetTriangleCount)
+{
+	Initialize(*mesh);
+
+	if (m_triangleCount > targetTriangleCount)
+	{
+		// 頂点ごとの最良の縮約を並列に求めてから、キューを作ります。
+		m_best.resize(m_vertices.size());
+		ForEachChunk(m_vertices.size(), [&](size_t begin, size_t end)
+		{
+			std::vector<uint32_t> neighbors;
+			for (size_t v = begin; v < end; v++)
+			{
+				Collapse& best = m_best[v];
+				best.cost = NoCollapse;
+				best.keep = static_cast<uint32_t>(v);
+				best.remove = static_cast<uint32_t>(v);
+
+				GatherNeighbors(static_cast<uint32_t>(v), &neighbors);
+				for (size_t i = 0; i < neighbors.size(); i++)
+				{
+					Collapse collapse;
+					if (ComputeCollapse(static_cast<uint32_t>(v), neighbors[i], &collapse) && collapse.cost < best.cost)
+					{
+						best = collapse;
+					}
+				}
+			}
+		});
+
+		m_heap.clear();
+		for (uint32_t v = 0; v < m_vertices.size(); v++)
+		{
+			if (m_vertices[v].refCount > 0)
+			{
+				m_heap.push_back(v);
+			}
+		}
+		for (uint32_t i = 0; i < m_heap.size(); i++)
+		{
+			m_vertices[m_heap[i]].heapIndex = i;
+		}
+		for (uint32_t i = static_cast<uint32_t>(m_heap.size() / 2); i-- > 0; )
+		{
+			HeapSiftDown(i);
+		}
+
+		// 縮約は互いに影響するので、誤差の小さい順に逐次で行います。
+		while (m_triangleCount > targetTriangleCount && !m_heap.empty())
+		{
+			const uint32_t vertex = m_heap[0];
+			const Collapse collapse = m_best[vertex];
+			if (collapse.cost == NoCollapse || collapse.cost > m_maxError)
+			{
+				break;
+			}
+
+			if (!IsCollapseValid(collapse))
+			{
+				// 周りが変わるまで、この頂点は縮約しません。
+				m_best[vertex].cost = NoCollapse;
+				HeapSiftDown(0);
+				continue;
+			}
+
+			ApplyCollapse(collapse);
+			HeapRemove(collapse.remove);
+
+			// 残した頂点の辺の誤差はすべて変わります。隣の頂点では残した頂点への辺だけが変わるので、
+			// 最良の縮約が縮約した辺の頂点を向いていた場合を除いて、その辺だけを比べ直します。
+			UpdateBestCollapse(collapse.keep);
+			GatherNeighbors(collapse.keep, &m_neighbors);
+			for (size_t i = 0; i < m_neighbors.size(); i++)
+			{
+				const uint32_t neighbor = m_neighbors[i];
+				const Collapse& best = m_best[neighbor];
+				if (best.cost == NoCollapse || best.remove == collapse.keep || best.remove == collapse.remove)
+				{
+					UpdateBestCollapse(neighbor);
+					continue;
+				}
+
+				Collapse candidate;
+				if (ComputeCollapse(neighbor, collapse.keep, &candidate) && candidate.cost < best.cost)
+				{
+					m_best[neighbor] = candidate;
+					HeapSiftUp(m_vertices[neighbor].heapIndex);
+				}
+			}
+		}
+	}
+
+	Compact(mesh);
+
+	m_heap.clear();
+	m_refs.clear();
+	return m_triangleCount;
+}
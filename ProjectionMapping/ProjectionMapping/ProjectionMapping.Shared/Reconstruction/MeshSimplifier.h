@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "TriangleMesh.h"
+
+namespace ProjectionMapping
+{
+	// 二次誤差 (quadric error metrics) による辺の縮約で、メッシュを三角形の予算まで減らします。
+	// 誤差の小さい辺から優先度付きキューで順に縮約し、面が裏返る縮約や多様体でなくなる縮約は行いません。
+	// 境界の辺には垂直な面の二次誤差を加えて、輪郭を保ちます。深度の不連続は、メッシュを作る段階で
+	// 三角形をつながないことで境界になるので、同じように保たれます。
+	// 縮約は逐次なので、センサーの解像度のメッシュ全体 (約 43 万三角形) には 1 フレームより桁違いに長くかかります。
+	// そのためフレームごとには、MarchingCubes::SetSimplification で変更されたブロックのメッシュだけを境界を固定して減らし、
+	// 1 回の Update で減らすブロックの数を MarchingCubes::SetMaxBlocksPerUpdate の予算に抑えます。
+	// 時間は MeshSimplifierBenchmark で測れます。
+	class MeshSimplifier
+	{
+	public:
+		MeshSimplifier();
+
+		// 境界の辺を保つ強さ。大きいほど輪郭が崩れにくくなります。
+		void SetBoundaryWeight(float weight)				{ m_boundaryWeight = weight; }
+
+		// 縮約の誤差 (距離の 2 乗、メートル^2) の上限。予算に届かなくても、これを超える縮約は行いません。
+		void SetMaxError(float error)						{ m_maxError = error; }
+
+		// 境界の頂点を動かさず、縮約で消しもしません。ブロックに分けたメッシュを別々に減らしても継ぎ目が開きません。
+		void SetLockBoundary(bool lock)						{ m_lockBoundary = lock; }
+
+		// mesh の三角形を targetTriangleCount 個以下に減らし、使われなくなった頂点を詰めます。
+		// 残った三角形の数を返します。
+		uint32_t Simplify(TriangleMesh* mesh, uint32_t targetTriangleCount);
+
+	private:
+		// 対称な 4x4 行列の上三角 (a^2, ab, ac, ad, b^2, bc, bd, c^2, cd, d^2)。
+		struct Quadric
+		{
+			double m[10];
+		};
+
+		struct Vertex
+		{
+			float position[3];
+			float color[3];
+			Quadric quadric;
+			uint32_t refBegin;		// m_refs の中の、この頂点を含む三角形の番号の範囲。
+			uint32_t refCount;
+			uint32_t heapIndex;		// m_heap での位置。キューにない場合は NotInHeap です。
+			bool removed;
+			bool locked;			// 境界を固定する場合の境界の頂点。
+		};
+
+		struct Triangle
+		{
+			uint32_t v[3];
+			bool removed;
+		};
+
+		struct Collapse
+		{
+			float cost;
+			uint32_t keep;
+			uint32_t remove;
+			float position[3];
+		};
+
+		void Initialize(const TriangleMesh& mesh);
+		void BuildRefs();
+		void AddBoundaryQuadrics();
+		bool ComputeCollapse(uint32_t a, uint32_t b, Collapse* collapse) const;
+		bool IsCollapseValid(const Collapse& collapse);
+		void ApplyCollapse(const Collapse& collapse);
+		void UpdateBestCollapse(uint32_t vertex);
+		void GatherNeighbors(uint32_t vertex, std::vector<uint32_t>* neighbors) const;
+		void HeapSiftUp(uint32_t position);
+		void HeapSiftDown(uint32_t position);
+		void HeapRemove(uint32_t vertex);
+		void Compact(TriangleMesh* mesh) const;
+
+		float					m_boundaryWeight;
+		float					m_maxError;
+		bool					m_lockBoundary;
+
+		std::vector<Vertex>		m_vertices;
+		std::vector<Triangle>	m_triangles;
+		std::vector<uint32_t>	m_refs;
+
+		// 頂点ごとの最も誤差の小さい縮約と、その誤差で並べた頂点の優先度付きキュー (二分ヒープ)。
+		// 縮約のたびに周りの頂点の要素をその場で更新するので、古い要素は残りません。
+		std::vector<Collapse>	m_best;
+		std::vector<uint32_t>	m_heap;
+		std::vector<uint8_t>	m_boundaryEdges;		// 三角形ごとの、境界の辺のビット。
+		uint32_t				m_triangleCount;
+
+		// 縮約の判定の作業領域。
+		std::vector<uint32_t>	m_neighbors;
+		std::vector<uint32_t>	m_otherNeighbors;
+	};
+}
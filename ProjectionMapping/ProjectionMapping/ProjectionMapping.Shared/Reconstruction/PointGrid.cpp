@@ -0,0 +1,335 @@
+﻿#include "PointGrid.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// セル座標を詰めるビット数。各軸 ±2^20 セルまで扱えます。
+	const int32_t CoordinateBits = 21;
+	const int32_t CoordinateBias = 1 << (CoordinateBits - 1);
+	const uint64_t CoordinateMask = (1ull << CoordinateBits) - 1;
+
+	const uint64_t EmptyKey = ~0ull;
+
+	// 並列に処理する単位の点や問い合わせの数。
+	const uint32_t ChunkSize = 4096;
+
+	inline uint64_t PackCell(int32_t x, int32_t y, int32_t z)
+	{
+		return
+			(static_cast<uint64_t>((x + CoordinateBias) & CoordinateMask)) |
+			(static_cast<uint64_t>((y + CoordinateBias) & CoordinateMask) << CoordinateBits) |
+			(static_cast<uint64_t>((z + CoordinateBias) & CoordinateMask) << (CoordinateBits * 2));
+	}
+
+	// 64 ビットの混合関数 (splitmix64 の最終段)。
+	inline uint64_t HashKey(uint64_t key)
+	{
+		key ^= key >> 30;
+		key *= 0xBF58476D1CE4E5B9ull;
+		key ^= key >> 27;
+		key *= 0x94D049BB133111EBull;
+		key ^= key >> 31;
+		return key;
+	}
+
+	inline float SquaredDistance(const float* a, const float* b)
+	{
+		const float dx = a[0] - b[0];
+		const float dy = a[1] - b[1];
+		const float dz = a[2] - b[2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	template<typename TBody>
+	void ForEachChunk(uint32_t count, const TBody& body)
+	{
+		const uint32_t chunkCount = (count + ChunkSize - 1) / ChunkSize;
+		DX::ParallelFor(0, chunkCount, [&](size_t chunk)
+		{
+			const uint32_t begin = static_cast<uint32_t>(chunk) * ChunkSize;
+			body(begin, std::min(begin + ChunkSize, count));
+		});
+	}
+}
+
+PointGrid::PointGrid() :
+	m_cellSize(1.0f),
+	m_inverseCellSize(1.0f)
+{
+}
+
+void PointGrid::Build(const float* points, uint32_t count, float cellSize)
+{
+	m_cellSize = cellSize;
+	m_inverseCellSize = 1.0f / cellSize;
+	m_pointKeys.resize(count);
+	m_pointSlots.resize(count);
+
+	// 1. 点ごとのセルのキーを並列に求めます。
+	const float inverseCellSize = m_inverseCellSize;
+	ForEachChunk(count, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const float* p = points + i * 3;
+			m_pointKeys[i] = (p[2] == 0.0f) ? EmptyKey : PackCell(
+				static_cast<int32_t>(std::floor(p[0] * inverseCellSize)),
+				static_cast<int32_t>(std::floor(p[1] * inverseCellSize)),
+				static_cast<int32_t>(std::floor(p[2] * inverseCellSize)));
+		}
+	});
+
+	// 2. セルをハッシュ表に登録して点を数えます。表は点の数の 2 倍以上にして、負荷率を 1/2 以下に保ちます。
+	size_t capacity = 1024;
+	while (capacity < static_cast<size_t>(count) * 2)
+	{
+		capacity *= 2;
+	}
+	const Cell empty = { EmptyKey, 0, 0 };
+	m_cells.assign(capacity, empty);
+
+	const size_t mask = capacity - 1;
+	uint32_t validCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint64_t key = m_pointKeys[i];
+		if (key == EmptyKey)
+		{
+			m_pointSlots[i] = InvalidIndex;
+			continue;
+		}
+
+		size_t slot = HashKey(key) & mask;
+		while (m_cells[slot].key != key && m_cells[slot].key != EmptyKey)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_cells[slot].key = key;
+		m_cells[slot].count++;
+		m_pointSlots[i] = static_cast<uint32_t>(slot);
+		validCount++;
+	}
+
+	// 3. セルの開始位置を決め、点をセルの順に詰めます。
+	uint32_t offset = 0;
+	for (size_t slot = 0; slot < capacity; slot++)
+	{
+		m_cells[slot].begin = offset;
+		offset += m_cells[slot].count;
+		m_cells[slot].count = 0;
+	}
+
+	m_points.resize(static_cast<size_t>(validCount) * 3);
+	m_indices.resize(validCount);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (m_pointSlots[i] == InvalidIndex)
+		{
+			continue;
+		}
+
+		Cell& cell = m_cells[m_pointSlots[i]];
+		const uint32_t position = cell.begin + cell.count++;
+		m_points[position * 3] = points[i * 3];
+		m_points[position * 3 + 1] = points[i * 3 + 1];
+		m_points[position * 3 + 2] = points[i * 3 + 2];
+		m_indices[position] = i;
+	}
+}
+
+const PointGrid::Cell* PointGrid::FindCell(int32_t x, int32_t y, int32_t z) const
+{
+	const uint64_t key = PackCell(x, y, z);
+	const size_t mask = m_cells.size() - 1;
+	for (size_t slot = HashKey(key) & mask; ; slot = (slot + 1) & mask)
+	{
+		const Cell& cell = m_cells[slot];
+		if (cell.key == key)
+		{
+			return &cell;
+		}
+		if (cell.key == EmptyKey)
+		{
+			return nullptr;
+		}
+	}
+}
+
+// 問い合わせの点のセルから、チェビシェフ距離で 1 つずつ外側の殻のセルを調べます。
+// 殻 r の外側の点は少なくとも r * cellSize 離れているので、k 番目の距離がそれより近くなったら打ち切ります。
+uint32_t PointGrid::FindNearest(const float* query, uint32_t k, float maxRadius, uint32_t* indices, float* squaredDistances) const
+{
+	if (k == 0 || m_indices.empty())
+	{
+		return 0;
+	}
+
+	const int32_t cx = static_cast<int32_t>(std::floor(query[0] * m_inverseCellSize));
+	const int32_t cy = static_cast<int32_t>(std::floor(query[1] * m_inverseCellSize));
+	const int32_t cz = static_cast<int32_t>(std::floor(query[2] * m_inverseCellSize));
+	const int32_t maxShell = static_cast<int32_t>(maxRadius * m_inverseCellSize) + 1;
+	const float maxSquaredDistance = maxRadius * maxRadius;
+
+	// 近い順に並べた k 個の候補。挿入ソートで保ちます。
+	uint32_t found = 0;
+	float kthDistance = maxSquaredDistance;
+	float* distances = squaredDistances;
+	std::vector<float> localDistances;
+	if (!distances)
+	{
+		localDistances.resize(k);
+		distances = localDistances.data();
+	}
+
+	for (int32_t shell = 0; shell <= maxShell; shell++)
+	{
+		const float bound = (shell - 1) * m_cellSize;
+		if (shell > 0 && found == k && kthDistance <= bound * bound)
+		{
+			break;
+		}
+
+		for (int32_t dz = -shell; dz <= shell; dz++)
+		{
+			for (int32_t dy = -shell; dy <= shell; dy++)
+			{
+				// 殻の面上のセルだけを調べます。内側の行では x の両端だけです。
+				const bool onFace = (dz == -shell || dz == shell || dy == -shell || dy == shell);
+				const int32_t dxStep = (onFace || shell == 0) ? 1 : 2 * shell;
+
+				for (int32_t dx = -shell; dx <= shell; dx += dxStep)
+				{
+					const Cell* cell = FindCell(cx + dx, cy + dy, cz + dz);
+					if (!cell)
+					{
+						continue;
+					}
+
+					for (uint32_t p = cell->begin; p < cell->begin + cell->count; p++)
+					{
+						const float distance = SquaredDistance(query, &m_points[p * 3]);
+						if (distance > kthDistance || (found == k && distance == kthDistance))
+						{
+							continue;
+						}
+
+						uint32_t position = (found < k) ? found++ : k - 1;
+						while (position > 0 && distances[position - 1] > distance)
+						{
+							distances[position] = distances[position - 1];
+							indices[position] = indices[position - 1];
+							position--;
+						}
+						distances[position] = distance;
+						indices[position] = m_indices[p];
+
+						if (found == k)
+						{
+							kthDistance = distances[k - 1];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+uint32_t PointGrid::FindInRadius(const float* query, float radius, uint32_t maxResults, uint32_t* indices) const
+{
+	if (maxResults == 0 || m_indices.empty())
+	{
+		return 0;
+	}
+
+	const int32_t x0 = static_cast<int32_t>(std::floor((query[0] - radius) * m_inverseCellSize));
+	const int32_t y0 = static_cast<int32_t>(std::floor((query[1] - radius) * m_inverseCellSize));
+	const int32_t z0 = static_cast<int32_t>(std::floor((query[2] - radius) * m_inverseCellSize));
+	const int32_t x1 = static_cast<int32_t>(std::floor((query[0] + radius) * m_inverseCellSize));
+	const int32_t y1 = static_cast<int32_t>(std::floor((query[1] + radius) * m_inverseCellSize));
+	const int32_t z1 = static_cast<int32_t>(std::floor((query[2] + radius) * m_inverseCellSize));
+	const float squaredRadius = radius * radius;
+
+	uint32_t found = 0;
+	for (int32_t z = z0; z <= z1; z++)
+	{
+		for (int32_t y = y0; y <= y1; y++)
+		{
+			for (int32_t x = x0; x <= x1; x++)
+			{
+				const Cell* cell = FindCell(x, y, z);
+				if (!cell)
+				{
+					continue;
+				}
+
+				for (uint32_t p = cell->begin; p < cell->begin + cell->count; p++)
+				{
+					if (SquaredDistance(query, &m_points[p * 3]) <= squaredRadius)
+					{
+						indices[found++] = m_indices[p];
+						if (found == maxResults)
+						{
+							return found;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+void PointGrid::FindNearest(const float* queries, uint32_t queryCount, uint32_t k, float maxRadius, uint32_t* indices, float* squaredDistances, uint32_t* counts) const
+{
+	ForEachChunk(queryCount, [&](uint32_t begin, uint32_t end)
+	{
+		std::vector<float> localDistances(squaredDistances ? 0 : k);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t* result = indices + static_cast<size_t>(i) * k;
+			float* distances = squaredDistances ? squaredDistances + static_cast<size_t>(i) * k : localDistances.data();
+			const uint32_t found = FindNearest(queries + static_cast<size_t>(i) * 3, k, maxRadius, result, distances);
+			std::fill(result + found, result + k, InvalidIndex);
+			if (counts)
+			{
+				counts[i] = found;
+			}
+		}
+	});
+}
+
+void PointGrid::FindInRadius(const float* queries, uint32_t queryCount, float radius, uint32_t maxResults, uint32_t* indices, uint32_t* counts) const
+{
+	// 結果の領域がないので、すべての問い合わせが 0 個です。
+	if (maxResults == 0)
+	{
+		if (counts)
+		{
+			std::fill(counts, counts + queryCount, 0u);
+		}
+		return;
+	}
+
+	ForEachChunk(queryCount, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t* result = indices + static_cast<size_t>(i) * maxResults;
+			const uint32_t found = FindInRadius(queries + static_cast<size_t>(i) * 3, radius, maxResults, result);
+			std::fill(result + found, result + maxResults, InvalidIndex);
+			if (counts)
+			{
+				counts[i] = found;
+			}
+		}
+	});
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ProjectionMapping
+{
+	// 点群の近傍探索のための、ハッシュで引く一様格子。
+	// 点はセルの順に並べ替えて 1 つの配列に詰めるので、同じセルの点は連続したメモリにあります。
+	// 構築は点の数に比例し、深度フレームごとに作り直せます。問い合わせはまとめて並列に処理できます。
+	class PointGrid
+	{
+	public:
+		static const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+		PointGrid();
+
+		// xyz を並べた count 個の点から格子を作ります。z = 0 の点は無効として除きます。
+		// cellSize は主な問い合わせの半径と同じくらいにします。
+		void Build(const float* points, uint32_t count, float cellSize);
+
+		uint32_t GetPointCount() const						{ return static_cast<uint32_t>(m_indices.size()); }
+		float GetCellSize() const							{ return m_cellSize; }
+
+		// query から maxRadius 以内の近い点を最大 k 個、近い順に探します。見つかった数を返します。
+		// indices は Build に渡した点の番号、squaredDistances は距離の 2 乗です (nullptr でもかまいません)。
+		uint32_t FindNearest(const float* query, uint32_t k, float maxRadius, uint32_t* indices, float* squaredDistances) const;
+
+		// query から radius 以内の点を最大 maxResults 個探します (順不同)。見つかった数を返します。
+		uint32_t FindInRadius(const float* query, float radius, uint32_t maxResults, uint32_t* indices) const;
+
+		// queryCount 個の問い合わせを並列に処理します。問い合わせ i の結果は indices[i * k] からの k 個で、
+		// 見つかった数が counts[i] です。残りは InvalidIndex になります。
+		void FindNearest(const float* queries, uint32_t queryCount, uint32_t k, float maxRadius, uint32_t* indices, float* squaredDistances, uint32_t* counts) const;
+		void FindInRadius(const float* queries, uint32_t queryCount, float radius, uint32_t maxResults, uint32_t* indices, uint32_t* counts) const;
+
+	private:
+		// ハッシュ表のセル。点は m_points[begin, begin + count) にあります。
+		struct Cell
+		{
+			uint64_t key;
+			uint32_t begin;
+			uint32_t count;
+		};
+
+		const Cell* FindCell(int32_t x, int32_t y, int32_t z) const;
+
+		float					m_cellSize;
+		float					m_inverseCellSize;
+
+		// 開番地法のハッシュ表。key が EmptyKey のセルは空きです。
+		std::vector<Cell>		m_cells;
+
+		// セルの順に並べた点と、その元の番号。
+		std::vector<float>		m_points;
+		std::vector<uint32_t>	m_indices;
+
+		// 構築の作業領域。点ごとのセルのキーとハッシュ表の位置です。
+		std::vector<uint64_t>	m_pointKeys;
+		std::vector<uint32_t>	m_pointSlots;
+	};
+}
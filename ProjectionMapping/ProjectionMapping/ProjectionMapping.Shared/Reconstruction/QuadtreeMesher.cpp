@@ -0,0 +1,529 @@
+﻿#include "QuadtreeMesher.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const uint32_t NoVertex = 0xFFFFFFFF;
+
+	// グリッドの印。
+	const uint8_t CornerMark = 1;
+	const uint8_t CenterMark = 2;
+
+	// 葉のフラグ。
+	const uint16_t FanLeaf = 1;		// 辺に細かい隣の葉の頂点があり、中心からの扇形で三角形分割します。
+
+	// 葉の境界の点の最大数。
+	const uint32_t MaxBoundaryPoints = QuadtreeMesher::TileSize * 4;
+
+	inline uint16_t FilterDepth(uint16_t depth, uint16_t minDepth, uint16_t maxDepth)
+	{
+		return (depth >= minDepth && depth <= maxDepth) ? depth : 0;
+	}
+}
+
+QuadtreeMesher::QuadtreeMesher() :
+	m_tolerance(5.0f),
+	m_discontinuityThreshold(50.0f),
+	m_changeThreshold(10),
+	m_changePixelCount(16),
+	m_minDepth(500),
+	m_maxDepth(4500),
+	m_width(0),
+	m_height(0),
+	m_tilesX(0),
+	m_tilesY(0),
+	m_rebuildAll(true),
+	m_gridWidth(0)
+{
+}
+
+void QuadtreeMesher::SetChangeThreshold(uint16_t threshold, uint32_t pixelCount)
+{
+	m_changeThreshold = threshold;
+	m_changePixelCount = pixelCount;
+}
+
+void QuadtreeMesher::SetDepthRange(uint16_t minDepth, uint16_t maxDepth)
+{
+	m_minDepth = minDepth;
+	m_maxDepth = maxDepth;
+	m_rebuildAll = true;
+}
+
+void QuadtreeMesher::Reset()
+{
+	m_rebuildAll = true;
+}
+
+uint32_t QuadtreeMesher::GetLeafCount() const
+{
+	uint32_t count = 0;
+	for (size_t t = 0; t < m_tiles.size(); t++)
+	{
+		count += static_cast<uint32_t>(m_tiles[t].leaves.size());
+	}
+	return count;
+}
+
+// タイルに属する画素のうち、深度が大きく変わった画素を数えます。
+bool QuadtreeMesher::IsTileChanged(const uint16_t* depth, uint32_t tileX, uint32_t tileY) const
+{
+	const uint32_t x0 = tileX * TileSize;
+	const uint32_t y0 = tileY * TileSize;
+	const uint32_t x1 = std::min(x0 + TileSize, m_width);
+	const uint32_t y1 = std::min(y0 + TileSize, m_height);
+
+	uint32_t changed = 0;
+	for (uint32_t y = y0; y < y1; y++)
+	{
+		for (uint32_t x = x0; x < x1; x++)
+		{
+			const uint32_t i = y * m_width + x;
+			const uint16_t current = FilterDepth(depth[i], m_minDepth, m_maxDepth);
+			const uint16_t previous = m_depth[i];
+			const bool different = (current == 0) != (previous == 0) ||
+				static_cast<uint16_t>(current > previous ? current - previous : previous - current) > m_changeThreshold;
+			if (different && ++changed > m_changePixelCount)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// 節点を対角線 (右上と左下) で 2 つの三角形に分け、三角形の上で逆深度を線形補間した深度と
+// 実際の深度の差がすべてのグリッド点で許容誤差以内かどうかを調べます。
+// 平面は透視投影で逆深度が画素座標の 1 次式になるので、傾いた平面でも平らとみなせます。
+bool QuadtreeMesher::IsLeafFlat(uint32_t x0, uint32_t y0, uint32_t size) const
+{
+	const uint16_t topLeft = GetDepth(x0, y0);
+	const uint16_t topRight = GetDepth(x0 + size, y0);
+	const uint16_t bottomLeft = GetDepth(x0, y0 + size);
+	const uint16_t bottomRight = GetDepth(x0 + size, y0 + size);
+	if (topLeft == 0 || topRight == 0 || bottomLeft == 0 || bottomRight == 0)
+	{
+		return false;
+	}
+
+	const float inverseTopLeft = 1.0f / topLeft;
+	const float inverseTopRight = 1.0f / topRight;
+	const float inverseBottomLeft = 1.0f / bottomLeft;
+	const float inverseBottomRight = 1.0f / bottomRight;
+	const float step = 1.0f / size;
+	const float tolerance = m_tolerance;
+
+	for (uint32_t j = 0; j <= size; j++)
+	{
+		const float t = j * step;
+		for (uint32_t i = 0; i <= size; i++)
+		{
+			const uint16_t d = GetDepth(x0 + i, y0 + j);
+			if (d == 0)
+			{
+				return false;
+			}
+
+			const float s = i * step;
+			const float inverse = (s + t <= 1.0f) ?
+				inverseTopLeft + s * (inverseTopRight - inverseTopLeft) + t * (inverseBottomLeft - inverseTopLeft) :
+				inverseBottomRight + (1.0f - s) * (inverseBottomLeft - inverseBottomRight) + (1.0f - t) * (inverseTopRight - inverseBottomRight);
+
+			if (std::fabs(d - 1.0f / inverse) > tolerance)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+void QuadtreeMesher::SubdivideTile(Tile* tile, uint32_t tileX, uint32_t tileY) const
+{
+	tile->leaves.clear();
+
+	Leaf stack[4 * 8];
+	uint32_t top = 0;
+	Leaf root = { static_cast<uint16_t>(tileX * TileSize), static_cast<uint16_t>(tileY * TileSize), static_cast<uint16_t>(TileSize), 0 };
+	stack[top++] = root;
+
+	while (top > 0)
+	{
+		const Leaf node = stack[--top];
+
+		// 画像の外だけの節点は捨てます。
+		if (node.x >= m_width || node.y >= m_height)
+		{
+			continue;
+		}
+
+		if (node.size <= MinLeafSize || IsLeafFlat(node.x, node.y, node.size))
+		{
+			tile->leaves.push_back(node);
+			continue;
+		}
+
+		// 左上の子が先に取り出されるように、逆の順に積みます。
+		const uint16_t half = node.size / 2;
+		const Leaf children[4] =
+		{
+			{ static_cast<uint16_t>(node.x + half), static_cast<uint16_t>(node.y + half), half, 0 },
+			{ node.x, static_cast<uint16_t>(node.y + half), half, 0 },
+			{ static_cast<uint16_t>(node.x + half), node.y, half, 0 },
+			{ node.x, node.y, half, 0 }
+		};
+		for (int c = 0; c < 4; c++)
+		{
+			stack[top++] = children[c];
+		}
+	}
+}
+
+// 葉の境界にある印の付いたグリッド点を、左上の角から時計回り (画面上) に集めます。
+uint32_t QuadtreeMesher::GatherBoundary(const Leaf& leaf, uint32_t* points) const
+{
+	const uint32_t x0 = leaf.x;
+	const uint32_t y0 = leaf.y;
+	const uint32_t x1 = x0 + leaf.size;
+	const uint32_t y1 = y0 + leaf.size;
+	const uint32_t stride = m_gridWidth;
+	const uint8_t* marks = m_marks.data();
+	uint32_t count = 0;
+
+	for (uint32_t x = x0; x < x1; x++)
+	{
+		if (marks[y0 * stride + x] & CornerMark)
+		{
+			points[count++] = y0 * stride + x;
+		}
+	}
+	for (uint32_t y = y0; y < y1; y++)
+	{
+		if (marks[y * stride + x1] & CornerMark)
+		{
+			points[count++] = y * stride + x1;
+		}
+	}
+	for (uint32_t x = x1; x > x0; x--)
+	{
+		if (marks[y1 * stride + x] & CornerMark)
+		{
+			points[count++] = y1 * stride + x;
+		}
+	}
+	for (uint32_t y = y1; y > y0; y--)
+	{
+		if (marks[y * stride + x0] & CornerMark)
+		{
+			points[count++] = y * stride + x0;
+		}
+	}
+	return count;
+}
+
+// 印の付いたグリッド点のうち、深度が有効なものに頂点を作ります。
+void QuadtreeMesher::BuildVertices(TriangleMesh* mesh)
+{
+	const uint32_t gridHeight = m_tilesY * TileSize + 1;
+	const float inverseFx = 1.0f / m_intrinsics.fx;
+	const float inverseFy = 1.0f / m_intrinsics.fy;
+
+	mesh->vertices.clear();
+	for (uint32_t y = 0; y < gridHeight; y++)
+	{
+		const float rayY = (static_cast<float>(y) - m_intrinsics.cy) * inverseFy;
+		for (uint32_t x = 0; x < m_gridWidth; x++)
+		{
+			const uint32_t i = y * m_gridWidth + x;
+			const uint16_t d = m_marks[i] ? GetDepth(x, y) : 0;
+			if (d == 0)
+			{
+				m_vertexIndices[i] = NoVertex;
+				continue;
+			}
+
+			const float z = d * 0.001f;
+			MeshVertex vertex;
+			vertex.position[0] = (static_cast<float>(x) - m_intrinsics.cx) * inverseFx * z;
+			vertex.position[1] = rayY * z;
+			vertex.position[2] = z;
+			vertex.color[0] = vertex.color[1] = vertex.color[2] = 0.0f;
+
+			m_vertexIndices[i] = static_cast<uint32_t>(mesh->vertices.size());
+			mesh->vertices.push_back(vertex);
+		}
+	}
+}
+
+void QuadtreeMesher::TriangulateTile(Tile* tile) const
+{
+	tile->indices.clear();
+
+	const uint32_t stride = m_gridWidth;
+	uint32_t points[MaxBoundaryPoints];
+
+	for (size_t l = 0; l < tile->leaves.size(); l++)
+	{
+		const Leaf& leaf = tile->leaves[l];
+
+		uint32_t count;
+		if (leaf.flags & FanLeaf)
+		{
+			count = GatherBoundary(leaf, points);
+		}
+		else
+		{
+			// 左上、右上、右下、左下。
+			count = 4;
+			points[0] = leaf.y * stride + leaf.x;
+			points[1] = leaf.y * stride + leaf.x + leaf.size;
+			points[2] = (leaf.y + leaf.size) * stride + leaf.x + leaf.size;
+			points[3] = (leaf.y + leaf.size) * stride + leaf.x;
+		}
+
+		// 三角形をグリッド点の番号で並べます。どちらも画面上で時計回りです。
+		uint32_t triangles[MaxBoundaryPoints][3];
+		uint32_t triangleCount = 0;
+		if (leaf.flags & FanLeaf)
+		{
+			const uint32_t center = (leaf.y + leaf.size / 2) * stride + leaf.x + leaf.size / 2;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				triangles[i][0] = center;
+				triangles[i][1] = points[i];
+				triangles[i][2] = points[(i + 1) % count];
+			}
+			triangleCount = count;
+		}
+		else
+		{
+			// 右上と左下の対角線で分けます。IsLeafFlat の補間と同じ分け方です。
+			triangles[0][0] = points[0];	triangles[0][1] = points[1];	triangles[0][2] = points[3];
+			triangles[1][0] = points[1];	triangles[1][1] = points[2];	triangles[1][2] = points[3];
+			triangleCount = 2;
+		}
+
+		// 最小の葉は平らとは限らないので、深度が大きく跳ぶ三角形を物体の輪郭とみなして捨てます。
+		const bool checkDiscontinuity = leaf.size <= MinLeafSize;
+
+		for (uint32_t t = 0; t < triangleCount; t++)
+		{
+			uint32_t v[3];
+			uint16_t minDepth = 0xFFFF;
+			uint16_t maxDepth = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t point = triangles[t][k];
+				v[k] = m_vertexIndices[point];
+				const uint16_t d = GetDepth(point % stride, point / stride);
+				minDepth = std::min(minDepth, d);
+				maxDepth = std::max(maxDepth, d);
+			}
+
+			if (v[0] == NoVertex || v[1] == NoVertex || v[2] == NoVertex)
+			{
+				continue;
+			}
+
+			if (checkDiscontinuity && maxDepth - minDepth > m_discontinuityThreshold)
+			{
+				continue;
+			}
+
+			tile->indices.push_back(v[0]);
+			tile->indices.push_back(v[1]);
+			tile->indices.push_back(v[2]);
+		}
+	}
+}
+
+// 面の法線を面積で重み付けして頂点に足し込み、法線を色にします。
+// MarchingCubes と同じく、外積の符号を反転して表 (カメラ側) 向きにします。
+void QuadtreeMesher::ComputeColors(TriangleMesh* mesh) const
+{
+	for (size_t i = 0; i < mesh->indices.size(); i += 3)
+	{
+		MeshVertex& a = mesh->vertices[mesh->indices[i]];
+		MeshVertex& b = mesh->vertices[mesh->indices[i + 1]];
+		MeshVertex& c = mesh->vertices[mesh->indices[i + 2]];
+		const float u[3] = { b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2] };
+		const float v[3] = { c.position[0] - a.position[0], c.position[1] - a.position[1], c.position[2] - a.position[2] };
+		const float normal[3] = { v[1] * u[2] - v[2] * u[1], v[2] * u[0] - v[0] * u[2], v[0] * u[1] - v[1] * u[0] };
+		for (int k = 0; k < 3; k++)
+		{
+			a.color[k] += normal[k];
+			b.color[k] += normal[k];
+			c.color[k] += normal[k];
+		}
+	}
+
+	for (size_t i = 0; i < mesh->vertices.size(); i++)
+	{
+		float* color = mesh->vertices[i].color;
+		const float length = std::sqrt(color[0] * color[0] + color[1] * color[1] + color[2] * color[2]);
+		const float scale = length > 0.0f ? 0.5f / length : 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			color[k] = color[k] * scale + 0.5f;
+		}
+	}
+}
+
+uint32_t QuadtreeMesher::Update(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, TriangleMesh* mesh)
+{
+	mesh->vertices.clear();
+	mesh->indices.clear();
+
+	if (!depth || intrinsics.width == 0 || intrinsics.height == 0 || intrinsics.width > 0x8000 || intrinsics.height > 0x8000)
+	{
+		return 0;
+	}
+
+	if (intrinsics.width != m_width || intrinsics.height != m_height)
+	{
+		m_width = intrinsics.width;
+		m_height = intrinsics.height;
+		m_tilesX = (m_width + TileSize - 1) / TileSize;
+		m_tilesY = (m_height + TileSize - 1) / TileSize;
+		m_gridWidth = m_tilesX * TileSize + 1;
+		m_depth.assign(static_cast<size_t>(m_width) * m_height, 0);
+		m_tiles.assign(static_cast<size_t>(m_tilesX) * m_tilesY, Tile());
+		m_marks.resize(static_cast<size_t>(m_gridWidth) * (m_tilesY * TileSize + 1));
+		m_vertexIndices.resize(m_marks.size());
+		m_rebuildAll = true;
+	}
+	m_intrinsics = intrinsics;
+
+	const uint32_t tileCount = m_tilesX * m_tilesY;
+	m_changed.resize(tileCount);
+	m_subdivide.resize(tileCount);
+
+	// 1. 深度が変わったタイルを探します。
+	const bool rebuildAll = m_rebuildAll;
+	DX::ParallelFor(0, tileCount, [&](size_t t)
+	{
+		const uint32_t tileX = static_cast<uint32_t>(t) % m_tilesX;
+		const uint32_t tileY = static_cast<uint32_t>(t) / m_tilesX;
+		m_changed[t] = (rebuildAll || IsTileChanged(depth, tileX, tileY)) ? 1 : 0;
+	});
+	m_rebuildAll = false;
+
+	// 2. 変わったタイルの深度を取り込みます。各画素はちょうど 1 つのタイルに属します。
+	// 葉の右と下の辺の点は左、上、左上のタイルからも参照されるので、それらのタイルも分割し直します。
+	std::fill(m_subdivide.begin(), m_subdivide.end(), static_cast<uint8_t>(0));
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		if (!m_changed[t])
+		{
+			continue;
+		}
+
+		const uint32_t tileX = t % m_tilesX;
+		const uint32_t tileY = t / m_tilesX;
+		m_subdivide[t] = 1;
+		if (tileX > 0)
+		{
+			m_subdivide[t - 1] = 1;
+		}
+		if (tileY > 0)
+		{
+			m_subdivide[t - m_tilesX] = 1;
+		}
+		if (tileX > 0 && tileY > 0)
+		{
+			m_subdivide[t - m_tilesX - 1] = 1;
+		}
+
+		const uint32_t x0 = (t % m_tilesX) * TileSize;
+		const uint32_t y0 = (t / m_tilesX) * TileSize;
+		const uint32_t x1 = std::min(x0 + TileSize, m_width);
+		const uint32_t y1 = std::min(y0 + TileSize, m_height);
+		for (uint32_t y = y0; y < y1; y++)
+		{
+			for (uint32_t x = x0; x < x1; x++)
+			{
+				const uint32_t i = y * m_width + x;
+				m_depth[i] = FilterDepth(depth[i], m_minDepth, m_maxDepth);
+			}
+		}
+	}
+
+	// 3. 変わったタイルとその左、上、左上のタイルを分割し直します。
+	uint32_t subdividedCount = 0;
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		subdividedCount += m_subdivide[t];
+	}
+
+	DX::ParallelFor(0, tileCount, [&](size_t t)
+	{
+		if (m_subdivide[t])
+		{
+			SubdivideTile(&m_tiles[t], static_cast<uint32_t>(t) % m_tilesX, static_cast<uint32_t>(t) / m_tilesX);
+		}
+	});
+
+	// 4. すべての葉の角に印を付けます。隣の葉と共有する点があるので逐次で行います。
+	std::fill(m_marks.begin(), m_marks.end(), static_cast<uint8_t>(0));
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		const std::vector<Leaf>& leaves = m_tiles[t].leaves;
+		for (size_t l = 0; l < leaves.size(); l++)
+		{
+			const Leaf& leaf = leaves[l];
+			const uint32_t topLeft = leaf.y * m_gridWidth + leaf.x;
+			const uint32_t bottomLeft = topLeft + leaf.size * m_gridWidth;
+			m_marks[topLeft] = CornerMark;
+			m_marks[topLeft + leaf.size] = CornerMark;
+			m_marks[bottomLeft] = CornerMark;
+			m_marks[bottomLeft + leaf.size] = CornerMark;
+		}
+	}
+
+	// 5. 辺に T 字の接続点がある葉は、中心に印を付けて扇形にします。
+	// 中心は葉の内側にあり、ほかの葉の境界にはならないので並列に書き込めます。
+	DX::ParallelFor(0, tileCount, [&](size_t t)
+	{
+		uint32_t points[MaxBoundaryPoints];
+		std::vector<Leaf>& leaves = m_tiles[t].leaves;
+		for (size_t l = 0; l < leaves.size(); l++)
+		{
+			Leaf& leaf = leaves[l];
+			leaf.flags = 0;
+			if (GatherBoundary(leaf, points) > 4)
+			{
+				leaf.flags = FanLeaf;
+				m_marks[(leaf.y + leaf.size / 2) * m_gridWidth + leaf.x + leaf.size / 2] |= CenterMark;
+			}
+		}
+	});
+
+	// 6. 頂点を作ってから、タイルごとに三角形を作ってつなげます。
+	BuildVertices(mesh);
+
+	DX::ParallelFor(0, tileCount, [&](size_t t)
+	{
+		TriangulateTile(&m_tiles[t]);
+	});
+
+	size_t indexCount = 0;
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		indexCount += m_tiles[t].indices.size();
+	}
+	mesh->indices.reserve(indexCount);
+	for (uint32_t t = 0; t < tileCount; t++)
+	{
+		mesh->indices.insert(mesh->indices.end(), m_tiles[t].indices.begin(), m_tiles[t].indices.end());
+	}
+
+	ComputeColors(mesh);
+	return subdividedCount;
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "DepthCamera.h"
+#include "TriangleMesh.h"
+
+namespace ProjectionMapping
+{
+	// 深度画像を四分木で適応的に三角形分割します。
+	// 節点の角の頂点で作った三角形と実際の深度の差が許容誤差を超える場合だけ分割するので、
+	// 平らな壁や床は大きな三角形になります。細かい隣の葉の頂点は T 字の接続点として扇形に取り込み、
+	// 段差の異なる葉の間にも隙間ができません。
+	// 画像は固定の大きさのタイルに分け、深度が変わったタイルと、その画素を辺で参照する左、上、左上のタイルだけを分割し直します。
+	class QuadtreeMesher
+	{
+	public:
+		// タイルの 1 辺と、葉の最小の 1 辺 (どちらも画素の間隔の数)。
+		static const uint32_t TileSize = 64;
+		static const uint32_t MinLeafSize = 2;
+
+		QuadtreeMesher();
+
+		// 三角形と深度の差の許容誤差 (ミリメートル)。
+		void SetTolerance(float tolerance)					{ m_tolerance = tolerance; }
+
+		// 最小の葉で、三角形の頂点の深度の差がこれを超えたら不連続とみなして三角形を作りません (ミリメートル)。
+		void SetDiscontinuityThreshold(float threshold)		{ m_discontinuityThreshold = threshold; }
+
+		// 深度の差が threshold (ミリメートル) を超える画素が pixelCount 個を超えたタイルを、変化したとみなします。
+		void SetChangeThreshold(uint16_t threshold, uint32_t pixelCount);
+
+		// 使用する深度の範囲 (ミリメートル)。
+		void SetDepthRange(uint16_t minDepth, uint16_t maxDepth);
+
+		// 次の Update ですべてのタイルを分割し直します。
+		void Reset();
+
+		// depth を三角形分割して mesh に格納します。頂点はカメラ座標 (メートル) です。
+		// 分割し直したタイルの数を返します。
+		uint32_t Update(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, TriangleMesh* mesh);
+
+		uint32_t GetLeafCount() const;
+
+	private:
+		struct Leaf
+		{
+			uint16_t x, y;
+			uint16_t size;
+			uint16_t flags;
+		};
+
+		struct Tile
+		{
+			std::vector<Leaf> leaves;
+			std::vector<uint32_t> indices;
+		};
+
+		bool IsTileChanged(const uint16_t* depth, uint32_t tileX, uint32_t tileY) const;
+		void SubdivideTile(Tile* tile, uint32_t tileX, uint32_t tileY) const;
+		bool IsLeafFlat(uint32_t x0, uint32_t y0, uint32_t size) const;
+		uint32_t GatherBoundary(const Leaf& leaf, uint32_t* points) const;
+		void TriangulateTile(Tile* tile) const;
+		void BuildVertices(TriangleMesh* mesh);
+		void ComputeColors(TriangleMesh* mesh) const;
+
+		// グリッド点の深度 (ミリメートル)。画像の外や無効な点は 0 です。
+		uint16_t GetDepth(uint32_t x, uint32_t y) const
+		{
+			return (x < m_width && y < m_height) ? m_depth[y * m_width + x] : 0;
+		}
+
+		float					m_tolerance;
+		float					m_discontinuityThreshold;
+		uint16_t				m_changeThreshold;
+		uint32_t				m_changePixelCount;
+		uint16_t				m_minDepth;
+		uint16_t				m_maxDepth;
+
+		uint32_t				m_width;
+		uint32_t				m_height;
+		uint32_t				m_tilesX;
+		uint32_t				m_tilesY;
+		DepthCameraIntrinsics	m_intrinsics;
+
+		// タイルを最後に分割したときの深度。変化していないタイルの頂点もこの深度で作ります。
+		std::vector<uint16_t>	m_depth;
+		std::vector<Tile>		m_tiles;
+		std::vector<uint8_t>	m_changed;
+		std::vector<uint8_t>	m_subdivide;
+		bool					m_rebuildAll;
+
+		// タイルの範囲に広げたグリッド ((m_tilesX * TileSize + 1) x (m_tilesY * TileSize + 1))。
+		// 葉の角と扇形の中心に印を付け、印の付いた点に頂点の番号を割り当てます。
+		uint32_t				m_gridWidth;
+		std::vector<uint8_t>	m_marks;
+		std::vector<uint32_t>	m_vertexIndices;
+	};
+}
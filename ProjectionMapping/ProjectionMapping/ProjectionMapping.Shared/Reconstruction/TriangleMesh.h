@@ -0,0 +1,21 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ProjectionMapping
+{
+	// VertexPositionColor (Content/ShaderStructures.h) と同じレイアウトの頂点。そのまま頂点バッファーに書き込めます。
+	struct MeshVertex
+	{
+		float position[3];
+		float color[3];
+	};
+
+	// 32 ビットのインデックスの三角形メッシュ。三角形は外側から見て時計回りです。
+	struct TriangleMesh
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint32_t> indices;
+	};
+}
@@ -0,0 +1,375 @@
+﻿#include "TsdfVolume.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// ブロック座標を詰めるビット数。各軸 ±2^20 ブロックまで扱えます。
+	const int32_t CoordinateBits = 21;
+	const int32_t CoordinateBias = 1 << (CoordinateBits - 1);
+	const uint64_t CoordinateMask = (1ull << CoordinateBits) - 1;
+
+	// 割り当てでは、この画素数おきに光線をたどります。ブロックは画素の幅より十分大きいので間引いても抜けません。
+	const uint32_t AllocationPixelStep = 2;
+
+	// 1 ストリップの最小の行数。
+	const uint32_t MinStripRows = 16;
+
+	inline uint64_t PackCoordinate(const TsdfBlockCoordinate& coordinate)
+	{
+		return
+			(static_cast<uint64_t>((coordinate.x + CoordinateBias) & CoordinateMask)) |
+			(static_cast<uint64_t>((coordinate.y + CoordinateBias) & CoordinateMask) << CoordinateBits) |
+			(static_cast<uint64_t>((coordinate.z + CoordinateBias) & CoordinateMask) << (CoordinateBits * 2));
+	}
+
+	inline TsdfBlockCoordinate UnpackCoordinate(uint64_t key)
+	{
+		TsdfBlockCoordinate coordinate;
+		coordinate.x = static_cast<int32_t>(key & CoordinateMask) - CoordinateBias;
+		coordinate.y = static_cast<int32_t>((key >> CoordinateBits) & CoordinateMask) - CoordinateBias;
+		coordinate.z = static_cast<int32_t>((key >> (CoordinateBits * 2)) & CoordinateMask) - CoordinateBias;
+		return coordinate;
+	}
+
+	// 64 ビットの混合関数 (splitmix64 の最終段)。近いブロックが同じスロットに集まらないようにします。
+	inline uint64_t HashKey(uint64_t key)
+	{
+		key ^= key >> 30;
+		key *= 0xBF58476D1CE4E5B9ull;
+		key ^= key >> 27;
+		key *= 0x94D049BB133111EBull;
+		key ^= key >> 31;
+		return key;
+	}
+}
+
+TsdfVolume::TsdfVolume(float voxelSize, float truncation) :
+	m_maxWeight(64),
+	m_minDepth(500),
+	m_maxDepth(4500),
+	m_maxBlockCount(1 << 18),
+	m_resetCount(0)
+{
+	Reset(voxelSize, truncation);
+}
+
+void TsdfVolume::Reset(float voxelSize, float truncation)
+{
+	m_voxelSize = voxelSize;
+	m_truncation = std::max(truncation, voxelSize);
+	Reset();
+}
+
+void TsdfVolume::Reset()
+{
+	m_blocks.clear();
+	m_keys.assign(1024, 0);
+	m_slots.assign(1024, 0);
+	m_integrationCount = 0;
+	m_resetCount++;
+}
+
+void TsdfVolume::SetDepthRange(uint16_t minDepth, uint16_t maxDepth)
+{
+	m_minDepth = minDepth;
+	m_maxDepth = maxDepth;
+}
+
+uint32_t TsdfVolume::FindIndex(uint64_t key) const
+{
+	const size_t mask = m_slots.size() - 1;
+	for (size_t slot = HashKey(key) & mask; ; slot = (slot + 1) & mask)
+	{
+		if (m_slots[slot] == 0)
+		{
+			return 0;
+		}
+		if (m_keys[slot] == key)
+		{
+			return m_slots[slot];
+		}
+	}
+}
+
+const TsdfVolume::Block* TsdfVolume::FindBlock(const TsdfBlockCoordinate& coordinate) const
+{
+	uint32_t index = FindIndex(PackCoordinate(coordinate));
+	return index ? &m_blocks[index - 1] : nullptr;
+}
+
+uint32_t TsdfVolume::FindBlockIndex(const TsdfBlockCoordinate& coordinate) const
+{
+	uint32_t index = FindIndex(PackCoordinate(coordinate));
+	return index ? index - 1 : InvalidBlock;
+}
+
+// 表の大きさを 2 倍にして、すべてのブロックを入れ直します。
+void TsdfVolume::GrowTable()
+{
+	const size_t capacity = m_slots.size() * 2;
+	m_keys.assign(capacity, 0);
+	m_slots.assign(capacity, 0);
+
+	const size_t mask = capacity - 1;
+	for (uint32_t index = 0; index < m_blocks.size(); index++)
+	{
+		uint64_t key = PackCoordinate(m_blocks[index].coordinate);
+		size_t slot = HashKey(key) & mask;
+		while (m_slots[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_keys[slot] = key;
+		m_slots[slot] = index + 1;
+	}
+}
+
+// ブロックの番号 + 1 を返します。上限に達して割り当てられない場合は 0 です。
+uint32_t TsdfVolume::FindOrAllocate(const TsdfBlockCoordinate& coordinate)
+{
+	const uint64_t key = PackCoordinate(coordinate);
+	size_t mask = m_slots.size() - 1;
+	size_t slot = HashKey(key) & mask;
+	for (; m_slots[slot] != 0; slot = (slot + 1) & mask)
+	{
+		if (m_keys[slot] == key)
+		{
+			return m_slots[slot];
+		}
+	}
+
+	if (m_blocks.size() >= m_maxBlockCount)
+	{
+		return 0;
+	}
+
+	// 負荷率を 1/2 以下に保ちます。
+	if ((m_blocks.size() + 1) * 2 > m_slots.size())
+	{
+		GrowTable();
+		mask = m_slots.size() - 1;
+		slot = HashKey(key) & mask;
+		while (m_slots[slot] != 0)
+		{
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	Block block;
+	block.coordinate = coordinate;
+	block.modifiedStamp = 0;
+	for (uint32_t i = 0; i < BlockVoxelCount; i++)
+	{
+		block.voxels[i].distance = DistanceScale;
+		block.voxels[i].weight = 0;
+	}
+	m_blocks.push_back(block);
+
+	m_keys[slot] = key;
+	m_slots[slot] = static_cast<uint32_t>(m_blocks.size());
+	return m_slots[slot];
+}
+
+// 深度の各点の前後 truncation の区間を光線に沿ってたどり、通過するブロックを集めます。
+// ストリップごとに並列に座標を集めてから、ハッシュ表への登録だけを逐次で行います。
+void TsdfVolume::AllocateBlocks(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& cameraToWorld)
+{
+	const uint32_t width = intrinsics.width;
+	const uint32_t height = intrinsics.height;
+	const float blockSide = m_voxelSize * BlockSize;
+	const float inverseBlockSide = 1.0f / blockSide;
+	const float truncation = m_truncation;
+	const uint16_t minDepth = m_minDepth;
+	const uint16_t maxDepth = m_maxDepth;
+
+	uint32_t stripCount = std::max(1u, std::min(DX::GetWorkerCount() * 2, height / MinStripRows));
+	uint32_t stripRows = (height + stripCount - 1) / stripCount;
+	stripRows = (stripRows + AllocationPixelStep - 1) / AllocationPixelStep * AllocationPixelStep;
+	stripCount = (height + stripRows - 1) / stripRows;
+	m_stripKeys.resize(stripCount);
+
+	DX::ParallelFor(0, stripCount, [&](size_t strip)
+	{
+		std::vector<uint64_t>& keys = m_stripKeys[strip];
+		keys.clear();
+
+		const uint32_t y0 = static_cast<uint32_t>(strip) * stripRows;
+		const uint32_t y1 = std::min(y0 + stripRows, height);
+		uint64_t lastKey = ~0ull;
+
+		for (uint32_t y = y0; y < y1; y += AllocationPixelStep)
+		{
+			const float rayY = (static_cast<float>(y) - intrinsics.cy) / intrinsics.fy;
+			for (uint32_t x = 0; x < width; x += AllocationPixelStep)
+			{
+				const uint16_t d = depth[y * width + x];
+				if (d < minDepth || d > maxDepth)
+				{
+					continue;
+				}
+
+				// 光線の方向 (Z = 1) をワールド座標にします。
+				const float ray[3] = { (static_cast<float>(x) - intrinsics.cx) / intrinsics.fx, rayY, 1.0f };
+				float direction[3];
+				cameraToWorld.ApplyRotation(ray, direction);
+
+				// 光線に沿った距離の代わりに Z で区間を決めます。傾いた光線ではわずかに長くなるだけです。
+				const float z = d * 0.001f;
+				const float zBegin = std::max(z - truncation, 0.0f);
+				const float zEnd = z + truncation;
+				const float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+				const float zStep = 0.5f * blockSide / length;
+
+				for (float zSample = zBegin; ; zSample += zStep)
+				{
+					zSample = std::min(zSample, zEnd);
+					TsdfBlockCoordinate coordinate;
+					coordinate.x = static_cast<int32_t>(std::floor((cameraToWorld.translation[0] + direction[0] * zSample) * inverseBlockSide));
+					coordinate.y = static_cast<int32_t>(std::floor((cameraToWorld.translation[1] + direction[1] * zSample) * inverseBlockSide));
+					coordinate.z = static_cast<int32_t>(std::floor((cameraToWorld.translation[2] + direction[2] * zSample) * inverseBlockSide));
+
+					// 隣の画素はほとんど同じブロックを通るので、直前と同じものは省きます。
+					uint64_t key = PackCoordinate(coordinate);
+					if (key != lastKey)
+					{
+						keys.push_back(key);
+						lastKey = key;
+					}
+
+					if (zSample >= zEnd)
+					{
+						break;
+					}
+				}
+			}
+		}
+	});
+
+	// 今回の番号で印を付け、同じブロックを二度並べないようにします。
+	const uint32_t stamp = m_integrationCount;
+	m_visible.clear();
+	for (uint32_t strip = 0; strip < stripCount; strip++)
+	{
+		const std::vector<uint64_t>& keys = m_stripKeys[strip];
+		for (size_t k = 0; k < keys.size(); k++)
+		{
+			uint32_t index = FindOrAllocate(UnpackCoordinate(keys[k]));
+			if (index == 0)
+			{
+				continue;
+			}
+
+			Block& block = m_blocks[index - 1];
+			if (block.modifiedStamp != stamp)
+			{
+				block.modifiedStamp = stamp;
+				m_visible.push_back(index - 1);
+			}
+		}
+	}
+}
+
+// ブロックの各ボクセルを深度画像に投影し、投影方向の距離を重み付き平均で取り込みます。
+void TsdfVolume::IntegrateBlock(Block* block, const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& worldToCamera)
+{
+	const int32_t width = static_cast<int32_t>(intrinsics.width);
+	const int32_t height = static_cast<int32_t>(intrinsics.height);
+	const float inverseTruncation = 1.0f / m_truncation;
+	const float minDepth = m_minDepth * 0.001f;
+	const float maxDepth = m_maxDepth * 0.001f;
+	const uint32_t maxWeight = m_maxWeight;
+
+	// ボクセルの中心のカメラ座標は格子の番号の 1 次式なので、原点と各軸の増分から求めます。
+	const float origin[3] =
+	{
+		(block->coordinate.x * static_cast<float>(BlockSize) + 0.5f) * m_voxelSize,
+		(block->coordinate.y * static_cast<float>(BlockSize) + 0.5f) * m_voxelSize,
+		(block->coordinate.z * static_cast<float>(BlockSize) + 0.5f) * m_voxelSize
+	};
+	float base[3];
+	worldToCamera.Apply(origin, base);
+
+	float step[3][3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			step[axis][i] = worldToCamera.rotation[i][axis] * m_voxelSize;
+		}
+	}
+
+	TsdfVoxel* voxel = block->voxels;
+	for (uint32_t z = 0; z < BlockSize; z++)
+	{
+		for (uint32_t y = 0; y < BlockSize; y++)
+		{
+			float p[3];
+			for (int i = 0; i < 3; i++)
+			{
+				p[i] = base[i] + step[1][i] * y + step[2][i] * z;
+			}
+
+			for (uint32_t x = 0; x < BlockSize; x++, voxel++, p[0] += step[0][0], p[1] += step[0][1], p[2] += step[0][2])
+			{
+				if (p[2] <= 0.0f)
+				{
+					continue;
+				}
+
+				const float inverseZ = 1.0f / p[2];
+				const int32_t u = static_cast<int32_t>(intrinsics.fx * p[0] * inverseZ + intrinsics.cx + 0.5f);
+				const int32_t v = static_cast<int32_t>(intrinsics.fy * p[1] * inverseZ + intrinsics.cy + 0.5f);
+				if (u < 0 || v < 0 || u >= width || v >= height)
+				{
+					continue;
+				}
+
+				const float measured = depth[v * width + u] * 0.001f;
+				if (measured < minDepth || measured > maxDepth)
+				{
+					continue;
+				}
+
+				// 表面より奥の打ち切り距離を超えた部分は、隠れているので更新しません。
+				const float distance = (measured - p[2]) * inverseTruncation;
+				if (distance < -1.0f)
+				{
+					continue;
+				}
+
+				const int32_t sample = static_cast<int32_t>(std::min(distance, 1.0f) * DistanceScale);
+				const uint32_t weight = voxel->weight;
+				voxel->distance = static_cast<int16_t>((voxel->distance * static_cast<int32_t>(weight) + sample) / static_cast<int32_t>(weight + 1));
+				voxel->weight = static_cast<uint16_t>(std::min(weight + 1, maxWeight));
+			}
+		}
+	}
+}
+
+uint32_t TsdfVolume::Integrate(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& cameraToWorld)
+{
+	if (!depth || intrinsics.width == 0 || intrinsics.height == 0)
+	{
+		return 0;
+	}
+
+	m_integrationCount++;
+
+	// 1. 表面の近くのブロックを割り当て、今回統合するブロックを集めます。
+	AllocateBlocks(depth, intrinsics, cameraToWorld);
+
+	// 2. ブロックは互いに独立しているので、並列に統合します。
+	const RigidTransform worldToCamera = cameraToWorld.Inverse();
+	DX::ParallelFor(0, m_visible.size(), [&](size_t i)
+	{
+		IntegrateBlock(&m_blocks[m_visible[i]], depth, intrinsics, worldToCamera);
+	});
+
+	return static_cast<uint32_t>(m_visible.size());
+}
@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "DepthCamera.h"
+
+namespace ProjectionMapping
+{
+	// TSDF の 1 ボクセル。距離は打ち切り距離で正規化して [-1, 1] を int16 に量子化します。
+	struct TsdfVoxel
+	{
+		int16_t distance;
+		uint16_t weight;		// 0 は未観測です。
+	};
+
+	// ブロックの格子座標。ブロックの原点はワールド座標で coordinate * BlockSize * voxelSize です。
+	struct TsdfBlockCoordinate
+	{
+		int32_t x, y, z;
+	};
+
+	// 表面の近くだけにボクセルのブロックを割り当てる、疎な TSDF ボリューム (KinectFusion 方式)。
+	// ブロックはハッシュ表で引き、フレームごとに深度の光線に沿って必要なブロックを割り当ててから、
+	// 視野内のブロックを複数のコアで並列に統合します。
+	class TsdfVolume
+	{
+	public:
+		// 1 ブロックの 1 辺のボクセル数。
+		static const uint32_t BlockSize = 8;
+		static const uint32_t BlockVoxelCount = BlockSize * BlockSize * BlockSize;
+
+		struct Block
+		{
+			TsdfBlockCoordinate coordinate;
+			uint32_t modifiedStamp;				// 最後に統合した Integrate の番号 (1 から)。
+			TsdfVoxel voxels[BlockVoxelCount];	// x が最も速く変わる順。
+		};
+
+		// voxelSize と truncation はメートルです。truncation は voxelSize の数倍にします。
+		TsdfVolume(float voxelSize = 0.01f, float truncation = 0.04f);
+
+		// ボリュームを空にして、ボクセルの大きさと打ち切り距離を変えます。
+		void Reset(float voxelSize, float truncation);
+		void Reset();
+
+		// 重みの上限。小さいほど新しいフレームに早く追従します。
+		void SetMaxWeight(uint16_t maxWeight)				{ m_maxWeight = maxWeight; }
+
+		// 統合する深度の範囲 (ミリメートル)。
+		void SetDepthRange(uint16_t minDepth, uint16_t maxDepth);
+
+		// 割り当てるブロック数の上限。これを超えると新しいブロックは割り当てません。
+		void SetMaxBlockCount(uint32_t maxBlockCount)		{ m_maxBlockCount = maxBlockCount; }
+
+		// 深度フレーム (ミリメートル) を cameraToWorld の姿勢で統合します。統合したブロック数を返します。
+		uint32_t Integrate(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& cameraToWorld);
+
+		// 指定した座標のブロックを返します。割り当てられていなければ nullptr です。
+		const Block* FindBlock(const TsdfBlockCoordinate& coordinate) const;
+
+		// 指定した座標のブロックの番号を返します。割り当てられていなければ InvalidBlock です。
+		uint32_t FindBlockIndex(const TsdfBlockCoordinate& coordinate) const;
+		static const uint32_t InvalidBlock = 0xFFFFFFFF;
+
+		uint32_t GetBlockCount() const						{ return static_cast<uint32_t>(m_blocks.size()); }
+		const Block& GetBlock(uint32_t index) const			{ return m_blocks[index]; }
+
+		// Integrate を呼んだ回数。ブロックの modifiedStamp と比べて、変更されたブロックを見つけられます。
+		uint32_t GetIntegrationCount() const				{ return m_integrationCount; }
+
+		// Reset を呼んだ回数。変わっていればブロックの番号と modifiedStamp は以前のものと対応しません。
+		uint32_t GetResetCount() const						{ return m_resetCount; }
+
+		float GetVoxelSize() const							{ return m_voxelSize; }
+		float GetTruncation() const							{ return m_truncation; }
+
+		// 正規化した距離の int16 での 1.0。
+		static const int32_t DistanceScale = 32767;
+
+	private:
+		uint32_t FindOrAllocate(const TsdfBlockCoordinate& coordinate);
+		uint32_t FindIndex(uint64_t key) const;
+		void GrowTable();
+		void AllocateBlocks(const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& cameraToWorld);
+		void IntegrateBlock(Block* block, const uint16_t* depth, const DepthCameraIntrinsics& intrinsics, const RigidTransform& worldToCamera);
+
+		float					m_voxelSize;
+		float					m_truncation;
+		uint16_t				m_maxWeight;
+		uint16_t				m_minDepth;
+		uint16_t				m_maxDepth;
+		uint32_t				m_maxBlockCount;
+		uint32_t				m_integrationCount;
+		uint32_t				m_resetCount;
+
+		// ブロックは割り当て順に並び、削除しません。
+		std::vector<Block>		m_blocks;
+
+		// 開番地法のハッシュ表。キーはブロック座標を詰めたもの、値はブロックの番号 + 1 (0 は空き) です。
+		std::vector<uint64_t>	m_keys;
+		std::vector<uint32_t>	m_slots;
+
+		// フレームごとの作業領域。
+		std::vector<std::vector<uint64_t>>	m_stripKeys;
+		std::vector<uint32_t>				m_visible;
+	};
+}
@@ -0,0 +1,377 @@
+﻿#include "CpuRenderBackend.h"
+#include "InstanceTransforms.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 定数バッファーの行列は HLSL の列優先に合わせて転置されているので、行ベクトル規約に戻します。
+	Float4x4 LoadTransposed(const uint8_t* data)
+	{
+		Float4x4 transposed;
+		memcpy(transposed.m, data, sizeof(transposed.m));
+		return Matrix::Load(transposed).Transpose().ToFloat4x4();
+	}
+
+	// InstanceData の列からワールド行列を組み立てます。
+	Float4x4 LoadInstanceWorld(const InstanceData& instance)
+	{
+		Float4x4 result;
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				result.m[row][column] = instance.world[column][row];
+			}
+			result.m[row][3] = (row == 3) ? 1.0f : 0.0f;
+		}
+		return result;
+	}
+
+	SoftwareRasterizer::CullMode ToRasterizerCullMode(PipelineDescription::CullMode mode)
+	{
+		switch (mode)
+		{
+		case PipelineDescription::CullNone:		return SoftwareRasterizer::CullNone;
+		case PipelineDescription::CullFront:	return SoftwareRasterizer::CullFront;
+		default:								return SoftwareRasterizer::CullBack;
+		}
+	}
+}
+
+CpuRenderBackend::CpuRenderBackend() :
+	m_frameOpen(false)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_ringBuffers[i] = InvalidHandle;
+	}
+}
+
+BufferHandle CpuRenderBackend::CreateBuffer(const BufferDescription& description)
+{
+	uint32_t index;
+	if (!m_freeBuffers.empty())
+	{
+		index = m_freeBuffers.back();
+		m_freeBuffers.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_buffers.size());
+		m_buffers.push_back(Buffer());
+	}
+
+	Buffer& buffer = m_buffers[index];
+	buffer.usage = description.usage;
+	buffer.alive = true;
+	if (description.initialData)
+	{
+		const uint8_t* data = static_cast<const uint8_t*>(description.initialData);
+		buffer.data.assign(data, data + description.size);
+	}
+	else
+	{
+		buffer.data.assign(description.size, 0);
+	}
+
+	return index + 1;
+}
+
+void CpuRenderBackend::DestroyBuffer(BufferHandle buffer)
+{
+	if (buffer == InvalidHandle || buffer > m_buffers.size() || !m_buffers[buffer - 1].alive || IsTransientBuffer(buffer))
+	{
+		return;
+	}
+
+	m_buffers[buffer - 1].alive = false;
+	m_buffers[buffer - 1].data.clear();
+	m_freeBuffers.push_back(buffer - 1);
+}
+
+PipelineHandle CpuRenderBackend::CreatePipeline(const PipelineDescription& description)
+{
+	uint32_t index;
+	if (!m_freePipelines.empty())
+	{
+		index = m_freePipelines.back();
+		m_freePipelines.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_pipelines.size());
+		m_pipelines.push_back(Pipeline());
+	}
+
+	m_pipelines[index].cullMode = description.cullMode;
+	m_pipelines[index].vertexLayout = description.vertexLayout;
+	m_pipelines[index].alive = true;
+	return index + 1;
+}
+
+void CpuRenderBackend::DestroyPipeline(PipelineHandle pipeline)
+{
+	if (pipeline == InvalidHandle || pipeline > m_pipelines.size() || !m_pipelines[pipeline - 1].alive)
+	{
+		return;
+	}
+
+	m_pipelines[pipeline - 1].alive = false;
+	m_freePipelines.push_back(pipeline - 1);
+}
+
+bool CpuRenderBackend::IsTransientBuffer(BufferHandle buffer) const
+{
+	return buffer != InvalidHandle && (buffer == m_ringBuffers[0] || buffer == m_ringBuffers[1] || buffer == m_ringBuffers[2]);
+}
+
+void CpuRenderBackend::BeginFrame()
+{
+	if (m_frameOpen)
+	{
+		return;
+	}
+
+	static const uint32_t capacities[3] =
+	{
+		TransientVertexCapacity,
+		TransientIndexCapacity,
+		TransientConstantCapacity
+	};
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (m_ringBuffers[i] == InvalidHandle)
+		{
+			BufferDescription description;
+			description.usage = static_cast<BufferDescription::Usage>(i);
+			description.size = capacities[i];
+			description.initialData = nullptr;
+			m_ringBuffers[i] = CreateBuffer(description);
+			m_rings[i].Reset(capacities[i]);
+		}
+
+		// 前のフレームは Submit の中で描画し終えています。
+		m_rings[i].Release(m_rings[i].GetHead());
+	}
+
+	m_frameOpen = true;
+}
+
+bool CpuRenderBackend::AllocateTransient(BufferDescription::Usage usage, uint32_t size, uint32_t alignment, TransientAllocation* allocation)
+{
+	if (!m_frameOpen)
+	{
+		return false;
+	}
+
+	if (usage == BufferDescription::Constant)
+	{
+		alignment = std::max<uint32_t>(alignment, 256);
+	}
+
+	uint32_t offset;
+	if (!m_rings[usage].Allocate(size, alignment, &offset))
+	{
+		return false;
+	}
+
+	const BufferHandle buffer = m_ringBuffers[usage];
+	allocation->buffer = buffer;
+	allocation->offset = offset;
+	allocation->data = m_buffers[buffer - 1].data.data() + offset;
+	return true;
+}
+
+void CpuRenderBackend::Submit(const CommandList* const* lists, size_t count)
+{
+	const std::chrono::high_resolution_clock::time_point submitStart = std::chrono::high_resolution_clock::now();
+	m_statistics.draws = 0;
+	m_statistics.stateChanges = 0;
+	m_statistics.redundantStates = 0;
+	m_boundState.Reset();
+
+	for (size_t l = 0; l < count; l++)
+	{
+		const CommandList& list = *lists[l];
+		m_rasterizer.SetViewport(0.0f, 0.0f, static_cast<float>(m_rasterizer.GetWidth()), static_cast<float>(m_rasterizer.GetHeight()));
+		for (size_t c = 0; c < list.GetCommandCount(); c++)
+		{
+			const CommandList::Command& command = list.GetCommand(c);
+			switch (command.type)
+			{
+			case CommandList::Command::Clear:
+				m_rasterizer.Clear(command.clear.color, command.clear.depth);
+				break;
+
+			case CommandList::Command::UpdateBuffer:
+				{
+					const BufferHandle handle = command.update.buffer;
+					if (handle != InvalidHandle && handle <= m_buffers.size() && m_buffers[handle - 1].alive && !IsTransientBuffer(handle))
+					{
+						// ラスタライザーは DrawIndexed の時点で頂点を変換するので、後の更新は前の描画に影響しません。
+						std::vector<uint8_t>& data = m_buffers[handle - 1].data;
+						memcpy(data.data(), list.GetData() + command.update.offset, std::min<size_t>(command.update.size, data.size()));
+						m_boundState.Reset();
+					}
+				}
+				break;
+
+			case CommandList::Command::Viewport:
+				m_rasterizer.SetViewport(command.viewport.x, command.viewport.y, command.viewport.width, command.viewport.height);
+				break;
+
+			case CommandList::Command::Draw:
+				Draw(command.draw);
+				break;
+
+			case CommandList::Command::DrawBatch:
+				{
+					DrawPacket packet = command.batch.packet;
+					const DrawRange* ranges = list.GetRanges(command);
+					for (uint32_t r = 0; r < command.batch.rangeCount; r++)
+					{
+						packet.indexCount = ranges[r].indexCount;
+						packet.startIndex = ranges[r].startIndex;
+						packet.baseVertex = ranges[r].baseVertex;
+						Draw(packet);
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	m_rasterizer.Flush();
+	m_frameOpen = false;
+
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - submitStart;
+	m_statistics.submitMilliseconds = elapsed.count();
+}
+
+const uint8_t* CpuRenderBackend::GetConstants(const ConstantRange& range) const
+{
+	if (range.buffer == InvalidHandle || range.buffer > m_buffers.size() || !m_buffers[range.buffer - 1].alive)
+	{
+		return nullptr;
+	}
+
+	// 頂点シェーダーが参照するのは先頭の 1 つの行列だけです。
+	const std::vector<uint8_t>& data = m_buffers[range.buffer - 1].data;
+	if (range.offset > data.size() || data.size() - range.offset < sizeof(float) * 16)
+	{
+		return nullptr;
+	}
+	return data.data() + range.offset;
+}
+
+void CpuRenderBackend::Draw(const DrawPacket& packet)
+{
+	const size_t bufferCount = m_buffers.size();
+	if (packet.pipeline == InvalidHandle || packet.pipeline > m_pipelines.size() || !m_pipelines[packet.pipeline - 1].alive ||
+		packet.vertexBuffer == InvalidHandle || packet.vertexBuffer > bufferCount ||
+		packet.indexBuffer == InvalidHandle || packet.indexBuffer > bufferCount ||
+		packet.vertexStride != sizeof(MeshVertex))
+	{
+		return;
+	}
+
+	const Buffer& vertexBuffer = m_buffers[packet.vertexBuffer - 1];
+	const Buffer& indexBuffer = m_buffers[packet.indexBuffer - 1];
+	if (!vertexBuffer.alive || !indexBuffer.alive)
+	{
+		return;
+	}
+
+	const uint32_t vertexCount = static_cast<uint32_t>(vertexBuffer.data.size() / sizeof(MeshVertex));
+	if (packet.baseVertex < 0 || static_cast<uint32_t>(packet.baseVertex) >= vertexCount)
+	{
+		return;
+	}
+
+	const uint32_t indexSize = (packet.indexFormat == DrawPacket::Index16) ? 2 : 4;
+	const uint32_t availableIndices = static_cast<uint32_t>(indexBuffer.data.size() / indexSize);
+	if (packet.startIndex >= availableIndices)
+	{
+		return;
+	}
+	const uint32_t indexCount = std::min(packet.indexCount, availableIndices - packet.startIndex);
+
+	// 入力レイアウトとインスタンスのバッファーの有無が一致しない描画は行いません。
+	const Pipeline& pipeline = m_pipelines[packet.pipeline - 1];
+	const bool instanced = (pipeline.vertexLayout == PipelineDescription::PositionColorInstance);
+	const InstanceData* instances = nullptr;
+	uint32_t instanceCount = 1;
+	if (instanced)
+	{
+		if (packet.instanceBuffer == InvalidHandle || packet.instanceBuffer > bufferCount || !m_buffers[packet.instanceBuffer - 1].alive)
+		{
+			return;
+		}
+
+		const std::vector<uint8_t>& data = m_buffers[packet.instanceBuffer - 1].data;
+		const size_t available = packet.instanceOffset < data.size() ? (data.size() - packet.instanceOffset) / sizeof(InstanceData) : 0;
+		instances = reinterpret_cast<const InstanceData*>(data.data() + packet.instanceOffset);
+		instanceCount = static_cast<uint32_t>(std::min<size_t>(packet.instanceCount, available));
+	}
+	else if (packet.instanceBuffer != InvalidHandle)
+	{
+		return;
+	}
+
+	// SampleVertexShader はオブジェクトごとの MVP、InstancedVertexShader はフレームごとのビュー プロジェクションだけを使用します。
+	const uint8_t* constants = GetConstants(instanced ? packet.frameConstants : packet.objectConstants);
+	if (constants == nullptr)
+	{
+		return;
+	}
+
+	const Float4x4 transform = LoadTransposed(constants);
+	const Matrix transformMatrix = Matrix::Load(transform);
+	if (m_boundState.Bind(packet, &m_statistics) & BoundState::PipelineGroup)
+	{
+		m_rasterizer.SetCullMode(ToRasterizerCullMode(pipeline.cullMode));
+	}
+	m_statistics.draws++;
+
+	// 16 ビットのインデックスが参照できるのは baseVertex から 65536 頂点までなので、メッシュレットごとの描画で
+	// 後ろのメッシュレットの頂点まで変換しないように、変換する頂点をその範囲に絞ります。
+	const MeshVertex* vertices = reinterpret_cast<const MeshVertex*>(vertexBuffer.data.data()) + packet.baseVertex;
+	uint32_t baseVertexCount = vertexCount - static_cast<uint32_t>(packet.baseVertex);
+	if (packet.indexFormat == DrawPacket::Index16)
+	{
+		baseVertexCount = std::min(baseVertexCount, 65536u);
+	}
+	static const float white[3] = { 1.0f, 1.0f, 1.0f };
+
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		// InstancedVertexShader と同じく、インスタンスのワールド行列をビュー プロジェクションの前に掛け、色を頂点の色に掛けます。
+		if (instanced)
+		{
+			m_rasterizer.SetTransform((Matrix::Load(LoadInstanceWorld(instances[i])) * transformMatrix).ToFloat4x4());
+			m_rasterizer.SetColorScale(instances[i].color);
+		}
+		else
+		{
+			m_rasterizer.SetTransform(transform);
+			m_rasterizer.SetColorScale(white);
+		}
+
+		if (packet.indexFormat == DrawPacket::Index16)
+		{
+			const uint16_t* indices = reinterpret_cast<const uint16_t*>(indexBuffer.data.data()) + packet.startIndex;
+			m_rasterizer.DrawIndexed(vertices, baseVertexCount, indices, indexCount);
+		}
+		else
+		{
+			const uint32_t* indices = reinterpret_cast<const uint32_t*>(indexBuffer.data.data()) + packet.startIndex;
+			m_rasterizer.DrawIndexed(vertices, baseVertexCount, indices, indexCount);
+		}
+	}
+}
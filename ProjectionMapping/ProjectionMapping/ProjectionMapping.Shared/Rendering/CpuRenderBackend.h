@@ -0,0 +1,76 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderBackend.h"
+#include "SoftwareRasterizer.h"
+#include "UploadRing.h"
+
+namespace ProjectionMapping
+{
+	// SoftwareRasterizer で描画するバックエンド。GPU のない環境での実行や、描画結果の回帰テストに使用します。
+	// 頂点シェーダーは SampleVertexShader と同じく、オブジェクトの定数 (スロット 1) の先頭に HLSL 用に転置した modelViewProjection が
+	// あるものとして扱います。頂点の間隔は位置と色の 24 バイトだけに対応します。
+	// インスタンス化した描画は InstancedVertexShader と同じく、フレームの定数 (スロット 0) の viewProjection とインスタンスの
+	// ワールド行列で変換し、インスタンスごとの描画で再現します。
+	// Submit の中で描画が完了するので、リング バッファーの領域は次の BeginFrame で再利用します。
+	class CpuRenderBackend : public RenderBackend
+	{
+	public:
+		CpuRenderBackend();
+
+		// 描画先の大きさを変更します。
+		void SetRenderTargetSize(uint32_t width, uint32_t height)	{ m_rasterizer.SetRenderTargetSize(width, height); }
+
+		// Submit の後の描画結果。
+		const SoftwareRasterizer& GetRasterizer() const				{ return m_rasterizer; }
+
+		virtual BufferHandle CreateBuffer(const BufferDescription& description);
+		virtual void DestroyBuffer(BufferHandle buffer);
+
+		virtual PipelineHandle CreatePipeline(const PipelineDescription& description);
+		virtual void DestroyPipeline(PipelineHandle pipeline);
+
+		virtual bool SupportsIndex32() const						{ return true; }
+		virtual bool SupportsInstancing() const						{ return true; }
+
+		virtual void BeginFrame();
+		virtual bool AllocateTransient(BufferDescription::Usage usage, uint32_t size, uint32_t alignment, TransientAllocation* allocation);
+
+		using RenderBackend::Submit;
+		virtual void Submit(const CommandList* const* lists, size_t count);
+
+	private:
+		struct Buffer
+		{
+			BufferDescription::Usage usage;
+			std::vector<uint8_t> data;
+			bool alive;
+		};
+
+		struct Pipeline
+		{
+			PipelineDescription::CullMode cullMode;
+			PipelineDescription::VertexLayout vertexLayout;
+			bool alive;
+		};
+
+		bool IsTransientBuffer(BufferHandle buffer) const;
+		const uint8_t* GetConstants(const ConstantRange& range) const;
+		void Draw(const DrawPacket& packet);
+
+		SoftwareRasterizer		m_rasterizer;
+		BoundState				m_boundState;		// 直前の描画の状態。パイプラインが変わらない間はカリングの設定を省きます。
+
+		// 番号 - 1 が添字です。破棄した番号は再利用します。
+		std::vector<Buffer>		m_buffers;
+		std::vector<uint32_t>	m_freeBuffers;
+		std::vector<Pipeline>	m_pipelines;
+		std::vector<uint32_t>	m_freePipelines;
+
+		// BufferDescription::Usage ごとのリング バッファー。最初の BeginFrame で作成します。
+		UploadRing				m_rings[3];
+		BufferHandle			m_ringBuffers[3];
+		bool					m_frameOpen;
+	};
+}
@@ -0,0 +1,655 @@
+﻿#include "pch.h"
+#include "D3D11RenderBackend.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "..\Common\DirectXHelper.h"
+#include "InstanceTransforms.h"
+
+using namespace ProjectionMapping;
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+	// 定数バッファーの範囲を指定するときの単位 (バイト)。シェーダー定数 16 個分です。
+	const uint32_t ConstantBufferAlignment = 256;
+	const uint32_t MaxConstantBufferBytes = D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT * 16;
+
+	// DrawPacket の frameConstants と objectConstants を置く頂点シェーダーのスロット。
+	const UINT FrameConstantSlot = 0;
+	const UINT ObjectConstantSlot = 1;
+}
+
+D3D11RenderBackend::D3D11RenderBackend(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources),
+	m_mapConstantRing(false),
+	m_millisecondsPerTick(0.0),
+	m_frameCount(0),
+	m_frameOpen(false)
+{
+	for (uint32_t i = 0; i < FramesInFlight; i++)
+	{
+		m_fencePending[i] = false;
+	}
+
+	LARGE_INTEGER frequency;
+	if (QueryPerformanceFrequency(&frequency))
+	{
+		m_millisecondsPerTick = 1000.0 / static_cast<double>(frequency.QuadPart);
+	}
+
+	CreateDeviceDependentResources();
+}
+
+void D3D11RenderBackend::CreateDeviceDependentResources()
+{
+	auto device = m_deviceResources->GetD3DDevice();
+
+	// 動的な定数バッファーを NO_OVERWRITE でマップし、オフセットを指定してバインドできる場合だけ、定数のリングを GPU に置きます。
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	m_mapConstantRing =
+		SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+		options.ConstantBufferOffsetting &&
+		options.MapNoOverwriteOnDynamicConstantBuffer;
+
+	static const uint32_t capacities[3] =
+	{
+		TransientVertexCapacity,
+		TransientIndexCapacity,
+		TransientConstantCapacity
+	};
+
+	static const UINT bindFlags[] =
+	{
+		D3D11_BIND_VERTEX_BUFFER,
+		D3D11_BIND_INDEX_BUFFER,
+		D3D11_BIND_CONSTANT_BUFFER
+	};
+
+	for (int i = 0; i < 3; i++)
+	{
+		Ring& ring = m_rings[i];
+		ring.ring.Reset(capacities[i]);
+		ring.mapped = nullptr;
+		ring.discard = true;
+
+		ComPtr<ID3D11Buffer> buffer;
+		if (i == BufferDescription::Constant && !m_mapConstantRing)
+		{
+			// 描画ごとに定数をコピーする、定数バッファーの最大の大きさのバッファーをスロットごとに作成し、リングの番号に割り当てます。
+			ring.shadow.assign(capacities[i], 0);
+
+			CD3D11_BUFFER_DESC scratchDesc(MaxConstantBufferBytes, D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+			for (int slot = 0; slot < 2; slot++)
+			{
+				DX::ThrowIfFailed(
+					device->CreateBuffer(
+						&scratchDesc,
+						nullptr,
+						&m_constantScratch[slot]
+						)
+					);
+			}
+			buffer = m_constantScratch[0];
+		}
+		else
+		{
+			ring.shadow.clear();
+
+			CD3D11_BUFFER_DESC ringDesc(capacities[i], bindFlags[i], D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+			DX::ThrowIfFailed(
+				device->CreateBuffer(
+					&ringDesc,
+					nullptr,
+					&buffer
+					)
+				);
+		}
+		ring.buffer = AddBuffer(buffer);
+	}
+
+	CD3D11_QUERY_DESC fenceDesc(D3D11_QUERY_EVENT);
+	for (uint32_t i = 0; i < FramesInFlight; i++)
+	{
+		DX::ThrowIfFailed(
+			device->CreateQuery(
+				&fenceDesc,
+				&m_fences[i]
+				)
+			);
+		m_fencePending[i] = false;
+	}
+}
+
+void D3D11RenderBackend::ReleaseDeviceDependentResources()
+{
+	m_buffers.clear();
+	m_freeBuffers.clear();
+	m_pipelines.clear();
+	m_freePipelines.clear();
+
+	for (int i = 0; i < 3; i++)
+	{
+		m_rings[i].ring.Reset(0);
+		m_rings[i].buffer = InvalidHandle;
+		m_rings[i].mapped = nullptr;
+		m_rings[i].shadow.clear();
+	}
+	m_constantScratch[0].Reset();
+	m_constantScratch[1].Reset();
+	m_renderTarget.Reset();
+	m_depthStencil.Reset();
+
+	for (uint32_t i = 0; i < FramesInFlight; i++)
+	{
+		m_fences[i].Reset();
+		m_fencePending[i] = false;
+	}
+	m_frameOpen = false;
+}
+
+BufferHandle D3D11RenderBackend::CreateBuffer(const BufferDescription& description)
+{
+	static const UINT bindFlags[] =
+	{
+		D3D11_BIND_VERTEX_BUFFER,
+		D3D11_BIND_INDEX_BUFFER,
+		D3D11_BIND_CONSTANT_BUFFER
+	};
+
+	CD3D11_BUFFER_DESC bufferDesc(description.size, bindFlags[description.usage]);
+
+	D3D11_SUBRESOURCE_DATA bufferData = {0};
+	bufferData.pSysMem = description.initialData;
+
+	ComPtr<ID3D11Buffer> buffer;
+	DX::ThrowIfFailed(
+		m_deviceResources->GetD3DDevice()->CreateBuffer(
+			&bufferDesc,
+			description.initialData ? &bufferData : nullptr,
+			&buffer
+			)
+		);
+
+	return AddBuffer(buffer);
+}
+
+BufferHandle D3D11RenderBackend::AddBuffer(const ComPtr<ID3D11Buffer>& buffer)
+{
+	uint32_t index;
+	if (!m_freeBuffers.empty())
+	{
+		index = m_freeBuffers.back();
+		m_freeBuffers.pop_back();
+		m_buffers[index] = buffer;
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_buffers.size());
+		m_buffers.push_back(buffer);
+	}
+	return index + 1;
+}
+
+void D3D11RenderBackend::DestroyBuffer(BufferHandle buffer)
+{
+	if (GetBuffer(buffer) == nullptr || IsTransientBuffer(buffer))
+	{
+		return;
+	}
+
+	m_buffers[buffer - 1].Reset();
+	m_freeBuffers.push_back(buffer - 1);
+}
+
+PipelineHandle D3D11RenderBackend::CreatePipeline(const PipelineDescription& description)
+{
+	auto device = m_deviceResources->GetD3DDevice();
+	Pipeline pipeline;
+
+	DX::ThrowIfFailed(
+		device->CreateVertexShader(
+			description.vertexShader,
+			description.vertexShaderSize,
+			nullptr,
+			&pipeline.vertexShader
+			)
+		);
+
+	static const D3D11_INPUT_ELEMENT_DESC vertexDesc [] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	// InstanceData のワールド行列の 3 つの列と色を、インスタンスごとに 1 回進めます。
+	static const D3D11_INPUT_ELEMENT_DESC instancedVertexDesc [] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "COLOR", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
+
+	pipeline.instanced = (description.vertexLayout == PipelineDescription::PositionColorInstance);
+
+	DX::ThrowIfFailed(
+		device->CreateInputLayout(
+			pipeline.instanced ? instancedVertexDesc : vertexDesc,
+			pipeline.instanced ? ARRAYSIZE(instancedVertexDesc) : ARRAYSIZE(vertexDesc),
+			description.vertexShader,
+			description.vertexShaderSize,
+			&pipeline.inputLayout
+			)
+		);
+
+	DX::ThrowIfFailed(
+		device->CreatePixelShader(
+			description.pixelShader,
+			description.pixelShaderSize,
+			nullptr,
+			&pipeline.pixelShader
+			)
+		);
+
+	static const D3D11_CULL_MODE cullModes[] =
+	{
+		D3D11_CULL_NONE,
+		D3D11_CULL_FRONT,
+		D3D11_CULL_BACK
+	};
+
+	CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+	rasterizerDesc.CullMode = cullModes[description.cullMode];
+	DX::ThrowIfFailed(
+		device->CreateRasterizerState(
+			&rasterizerDesc,
+			&pipeline.rasterizerState
+			)
+		);
+
+	uint32_t index;
+	if (!m_freePipelines.empty())
+	{
+		index = m_freePipelines.back();
+		m_freePipelines.pop_back();
+		m_pipelines[index] = pipeline;
+	}
+	else
+	{
+		index = static_cast<uint32_t>(m_pipelines.size());
+		m_pipelines.push_back(pipeline);
+	}
+	return index + 1;
+}
+
+void D3D11RenderBackend::DestroyPipeline(PipelineHandle pipeline)
+{
+	if (GetPipeline(pipeline) == nullptr)
+	{
+		return;
+	}
+
+	m_pipelines[pipeline - 1] = Pipeline();
+	m_freePipelines.push_back(pipeline - 1);
+}
+
+bool D3D11RenderBackend::IsTransientBuffer(BufferHandle buffer) const
+{
+	return buffer != InvalidHandle && (buffer == m_rings[0].buffer || buffer == m_rings[1].buffer || buffer == m_rings[2].buffer);
+}
+
+void D3D11RenderBackend::BeginFrame()
+{
+	if (m_frameOpen || m_rings[0].buffer == InvalidHandle)
+	{
+		return;
+	}
+
+	auto context = m_deviceResources->GetD3DDeviceContext();
+
+	// このスロットを前に使ったフレームの描画が終わるまで待ち、そのフレームで確保したリングの領域を解放します。
+	const uint32_t slot = static_cast<uint32_t>(m_frameCount % FramesInFlight);
+	if (m_fencePending[slot])
+	{
+		while (context->GetData(m_fences[slot].Get(), nullptr, 0, 0) == S_FALSE)
+		{
+			std::this_thread::yield();
+		}
+
+		for (int i = 0; i < 3; i++)
+		{
+			m_rings[i].ring.Release(m_fenceHeads[slot][i]);
+		}
+		m_fencePending[slot] = false;
+	}
+
+	MapRings(context);
+	m_frameOpen = true;
+}
+
+bool D3D11RenderBackend::AllocateTransient(BufferDescription::Usage usage, uint32_t size, uint32_t alignment, TransientAllocation* allocation)
+{
+	if (!m_frameOpen)
+	{
+		return false;
+	}
+
+	if (usage == BufferDescription::Constant)
+	{
+		alignment = std::max(alignment, ConstantBufferAlignment);
+	}
+
+	Ring& ring = m_rings[usage];
+	uint32_t offset;
+	if (!ring.ring.Allocate(size, alignment, &offset))
+	{
+		return false;
+	}
+
+	allocation->buffer = ring.buffer;
+	allocation->offset = offset;
+	allocation->data = ring.mapped + offset;
+	return true;
+}
+
+void D3D11RenderBackend::MapRings(ID3D11DeviceContext2* context)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		Ring& ring = m_rings[i];
+		if (!ring.shadow.empty())
+		{
+			ring.mapped = ring.shadow.data();
+			continue;
+		}
+
+		// 使用中の領域はフェンスで避けているので、GPU を待たずにマップできます。
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		DX::ThrowIfFailed(
+			context->Map(
+				GetBuffer(ring.buffer),
+				0,
+				ring.discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+				0,
+				&mapped
+				)
+			);
+		ring.mapped = static_cast<uint8_t*>(mapped.pData);
+		ring.discard = false;
+	}
+}
+
+void D3D11RenderBackend::UnmapRings(ID3D11DeviceContext2* context)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		Ring& ring = m_rings[i];
+		if (ring.shadow.empty() && ring.mapped != nullptr)
+		{
+			context->Unmap(GetBuffer(ring.buffer), 0);
+		}
+		ring.mapped = nullptr;
+	}
+}
+
+void D3D11RenderBackend::DrawIndexed(ID3D11DeviceContext2* context, const DrawPacket& packet, uint32_t indexCount, uint32_t startIndex, int32_t baseVertex)
+{
+	m_statistics.draws++;
+	if (packet.instanceBuffer != InvalidHandle)
+	{
+		context->DrawIndexedInstanced(indexCount, packet.instanceCount, startIndex, baseVertex, 0);
+	}
+	else
+	{
+		context->DrawIndexed(indexCount, startIndex, baseVertex);
+	}
+}
+
+bool D3D11RenderBackend::SupportsInstancing() const
+{
+	return m_deviceResources->GetDeviceFeatureLevel() >= D3D_FEATURE_LEVEL_9_3;
+}
+
+void D3D11RenderBackend::SetRenderTargets(ID3D11RenderTargetView* renderTarget, ID3D11DepthStencilView* depthStencil)
+{
+	m_renderTarget = renderTarget;
+	m_depthStencil = depthStencil;
+}
+
+bool D3D11RenderBackend::SupportsIndex32() const
+{
+	return m_deviceResources->GetDeviceFeatureLevel() > D3D_FEATURE_LEVEL_9_1;
+}
+
+ID3D11Buffer* D3D11RenderBackend::GetBuffer(BufferHandle buffer) const
+{
+	if (buffer == InvalidHandle || buffer > m_buffers.size())
+	{
+		return nullptr;
+	}
+	return m_buffers[buffer - 1].Get();
+}
+
+const D3D11RenderBackend::Pipeline* D3D11RenderBackend::GetPipeline(PipelineHandle pipeline) const
+{
+	if (pipeline == InvalidHandle || pipeline > m_pipelines.size() || m_pipelines[pipeline - 1].vertexShader == nullptr)
+	{
+		return nullptr;
+	}
+	return &m_pipelines[pipeline - 1];
+}
+
+void D3D11RenderBackend::Submit(const CommandList* const* lists, size_t count)
+{
+	auto context = m_deviceResources->GetD3DDeviceContext();
+
+	LARGE_INTEGER submitStart;
+	QueryPerformanceCounter(&submitStart);
+	m_statistics.draws = 0;
+	m_statistics.stateChanges = 0;
+	m_statistics.redundantStates = 0;
+
+	// 描画の前にリングへの書き込みを終えます。
+	if (m_frameOpen)
+	{
+		UnmapRings(context);
+	}
+
+	// レンダリング ターゲットを設定します。指定がない場合は画面です。
+	ID3D11RenderTargetView* renderTarget = m_renderTarget != nullptr ? m_renderTarget.Get() : m_deviceResources->GetBackBufferRenderTargetView();
+	ID3D11DepthStencilView* depthStencil = m_depthStencil != nullptr ? m_depthStencil.Get() : m_deviceResources->GetDepthStencilView();
+	ID3D11RenderTargetView *const targets[1] = { renderTarget };
+	context->OMSetRenderTargets(1, targets, depthStencil);
+
+	// 前の Submit の後にほかの描画が状態を変えているので、最初の描画ではすべて設定します。トポロジは常に三角形のリストです。
+	m_boundState.Reset();
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	for (size_t l = 0; l < count; l++)
+	{
+		const CommandList& list = *lists[l];
+
+		// リストごとにビューポートをリセットして全画面をターゲットとします。
+		const D3D11_VIEWPORT screenViewport = m_deviceResources->GetScreenViewport();
+		context->RSSetViewports(1, &screenViewport);
+
+		for (size_t c = 0; c < list.GetCommandCount(); c++)
+		{
+			const CommandList::Command& command = list.GetCommand(c);
+			switch (command.type)
+			{
+			case CommandList::Command::Clear:
+				context->ClearRenderTargetView(renderTarget, command.clear.color);
+				context->ClearDepthStencilView(depthStencil, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, command.clear.depth, 0);
+				break;
+
+			case CommandList::Command::Viewport:
+				{
+					const D3D11_VIEWPORT viewport = CD3D11_VIEWPORT(
+						command.viewport.x,
+						command.viewport.y,
+						command.viewport.width,
+						command.viewport.height
+						);
+					context->RSSetViewports(1, &viewport);
+				}
+				break;
+
+			case CommandList::Command::UpdateBuffer:
+				{
+					ID3D11Buffer* buffer = GetBuffer(command.update.buffer);
+					if (buffer != nullptr && !IsTransientBuffer(command.update.buffer))
+					{
+						context->UpdateSubresource(buffer, 0, NULL, list.GetData() + command.update.offset, 0, 0);
+					}
+				}
+				break;
+
+			case CommandList::Command::Draw:
+				if (BindPacket(context, command.draw))
+				{
+					DrawIndexed(context, command.draw, command.draw.indexCount, command.draw.startIndex, command.draw.baseVertex);
+				}
+				break;
+
+			case CommandList::Command::DrawBatch:
+				if (BindPacket(context, command.batch.packet))
+				{
+					const DrawRange* ranges = list.GetRanges(command);
+					for (uint32_t r = 0; r < command.batch.rangeCount; r++)
+					{
+						DrawIndexed(context, command.batch.packet, ranges[r].indexCount, ranges[r].startIndex, ranges[r].baseVertex);
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	// フレームの終わりを記録し、描画が終わったら BeginFrame でリングの領域を解放します。
+	if (m_frameOpen)
+	{
+		const uint32_t slot = static_cast<uint32_t>(m_frameCount % FramesInFlight);
+		for (int i = 0; i < 3; i++)
+		{
+			m_fenceHeads[slot][i] = m_rings[i].ring.GetHead();
+		}
+		context->End(m_fences[slot].Get());
+		m_fencePending[slot] = true;
+
+		m_frameCount++;
+		m_frameOpen = false;
+	}
+
+	LARGE_INTEGER submitEnd;
+	QueryPerformanceCounter(&submitEnd);
+	m_statistics.submitMilliseconds = (submitEnd.QuadPart - submitStart.QuadPart) * m_millisecondsPerTick;
+}
+
+bool D3D11RenderBackend::BindPacket(ID3D11DeviceContext2* context, const DrawPacket& packet)
+{
+	const Pipeline* pipeline = GetPipeline(packet.pipeline);
+	ID3D11Buffer* vertexBuffer = GetBuffer(packet.vertexBuffer);
+	ID3D11Buffer* indexBuffer = GetBuffer(packet.indexBuffer);
+	if (pipeline == nullptr || vertexBuffer == nullptr || indexBuffer == nullptr)
+	{
+		return false;
+	}
+
+	// 入力レイアウトとインスタンスのバッファーの有無が一致しない描画は行いません。
+	ID3D11Buffer* instanceBuffer = GetBuffer(packet.instanceBuffer);
+	if (pipeline->instanced != (instanceBuffer != nullptr))
+	{
+		return false;
+	}
+
+	// 直前の描画と異なる状態だけを設定します。
+	const uint32_t changed = m_boundState.Bind(packet, &m_statistics);
+
+	if (changed & BoundState::VertexBufferGroup)
+	{
+		ID3D11Buffer* vertexBuffers[2] = { vertexBuffer, instanceBuffer };
+		UINT strides[2] = { packet.vertexStride, sizeof(InstanceData) };
+		UINT offsets[2] = { 0, packet.instanceOffset };
+		context->IASetVertexBuffers(0, pipeline->instanced ? 2 : 1, vertexBuffers, strides, offsets);
+	}
+	if (changed & BoundState::IndexBufferGroup)
+	{
+		context->IASetIndexBuffer(indexBuffer, packet.indexFormat == DrawPacket::Index16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT, 0);
+	}
+	if (changed & BoundState::PipelineGroup)
+	{
+		context->IASetInputLayout(pipeline->inputLayout.Get());
+		context->RSSetState(pipeline->rasterizerState.Get());
+		context->VSSetShader(pipeline->vertexShader.Get(), nullptr, 0);
+		context->PSSetShader(pipeline->pixelShader.Get(), nullptr, 0);
+	}
+	if (changed & BoundState::FrameConstantGroup)
+	{
+		SetConstantBuffer(context, FrameConstantSlot, packet.frameConstants);
+	}
+	if (changed & BoundState::ObjectConstantGroup)
+	{
+		SetConstantBuffer(context, ObjectConstantSlot, packet.objectConstants);
+	}
+	return true;
+}
+
+void D3D11RenderBackend::SetConstantBuffer(ID3D11DeviceContext2* context, UINT slot, const ConstantRange& range)
+{
+	// シェーダーが使用しないスロットは設定しません。
+	ID3D11Buffer* constantBuffer = GetBuffer(range.buffer);
+	if (constantBuffer == nullptr)
+	{
+		return;
+	}
+
+	const Ring& constantRing = m_rings[BufferDescription::Constant];
+
+	// システム メモリのリングの定数は、描画ごとにスロットの作業用のバッファーへコピーします。
+	if (range.buffer == constantRing.buffer && !constantRing.shadow.empty())
+	{
+		const uint32_t capacity = constantRing.ring.GetCapacity();
+		if (range.offset >= capacity)
+		{
+			return;
+		}
+
+		uint32_t size = range.size ? range.size : MaxConstantBufferBytes;
+		size = std::min(size, std::min(MaxConstantBufferBytes, capacity - range.offset));
+
+		ID3D11Buffer* scratch = m_constantScratch[slot].Get();
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		DX::ThrowIfFailed(
+			context->Map(scratch, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)
+			);
+		memcpy(mapped.pData, constantRing.shadow.data() + range.offset, size);
+		context->Unmap(scratch, 0);
+
+		context->VSSetConstantBuffers(slot, 1, &scratch);
+		return;
+	}
+
+	if (range.offset == 0 && range.size == 0)
+	{
+		context->VSSetConstantBuffers(slot, 1, &constantBuffer);
+		return;
+	}
+
+	// 範囲はシェーダー定数の個数で、16 の倍数で指定します。
+	uint32_t size = range.size;
+	if (size == 0)
+	{
+		D3D11_BUFFER_DESC desc;
+		constantBuffer->GetDesc(&desc);
+		size = desc.ByteWidth > range.offset ? desc.ByteWidth - range.offset : 0;
+	}
+	UINT firstConstant = range.offset / 16;
+	UINT constantCount = std::min((size + ConstantBufferAlignment - 1) / ConstantBufferAlignment * 16, static_cast<uint32_t>(D3D11_REQ_CONSTANT_BUFFER_ELEMENT_COUNT));
+	context->VSSetConstantBuffers1(slot, 1, &constantBuffer, &firstConstant, &constantCount);
+}
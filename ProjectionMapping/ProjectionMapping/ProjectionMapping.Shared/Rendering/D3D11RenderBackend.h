@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <vector>
+#include "..\Common\DeviceResources.h"
+#include "RenderBackend.h"
+#include "UploadRing.h"
+
+namespace ProjectionMapping
+{
+	// Direct3D 11 のバックエンド。Submit でスワップ チェーンのバック バッファーと深度ステンシル、または SetRenderTargets のターゲットに描画します。
+	// リング バッファーは動的バッファーで、BeginFrame から Submit まで D3D11_MAP_WRITE_NO_OVERWRITE でマップしたままにします。
+	// Direct3D 11 には永続的なマップがないので、フレームの間だけマップし、上書きしないことはイベント クエリのフェンスで保証します。
+	// 定数バッファーのオフセット指定に対応しないデバイスでは、定数のリングはシステム メモリに置き、描画ごとにコピーします。
+	// Submit の中では直前の描画と同じ状態を設定しません。Submit の間にほかの描画がコンテキストの状態を変えるので、Submit ごとに設定し直します。
+	class D3D11RenderBackend : public RenderBackend
+	{
+	public:
+		D3D11RenderBackend(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+
+		// リング バッファーとフェンスを作成します。デバイスが復元されたときは、ほかのリソースより先に呼び出します。
+		void CreateDeviceDependentResources();
+
+		// デバイスが失われたときに、すべてのリソースを解放します。以前の番号は無効になります。
+		void ReleaseDeviceDependentResources();
+
+		virtual BufferHandle CreateBuffer(const BufferDescription& description);
+		virtual void DestroyBuffer(BufferHandle buffer);
+
+		virtual PipelineHandle CreatePipeline(const PipelineDescription& description);
+		virtual void DestroyPipeline(PipelineHandle pipeline);
+
+		virtual bool SupportsIndex32() const;
+		virtual bool SupportsInstancing() const;
+
+		virtual void BeginFrame();
+		virtual bool AllocateTransient(BufferDescription::Usage usage, uint32_t size, uint32_t alignment, TransientAllocation* allocation);
+
+		using RenderBackend::Submit;
+		virtual void Submit(const CommandList* const* lists, size_t count);
+
+		// 以降の Submit の描画先を設定します。nullptr の場合はバック バッファーと DeviceResources の深度ステンシルです。
+		// ターゲットはバック バッファーと同じ大きさにします。
+		void SetRenderTargets(ID3D11RenderTargetView* renderTarget, ID3D11DepthStencilView* depthStencil);
+
+	private:
+		struct Pipeline
+		{
+			Microsoft::WRL::ComPtr<ID3D11VertexShader>		vertexShader;
+			Microsoft::WRL::ComPtr<ID3D11PixelShader>		pixelShader;
+			Microsoft::WRL::ComPtr<ID3D11InputLayout>		inputLayout;
+			Microsoft::WRL::ComPtr<ID3D11RasterizerState>	rasterizerState;
+			bool											instanced;
+		};
+
+		struct Ring
+		{
+			UploadRing				ring;
+			BufferHandle			buffer;
+			uint8_t*				mapped;		// BeginFrame から Submit までの書き込み先。
+			std::vector<uint8_t>	shadow;		// GPU のバッファーをマップしない場合の書き込み先。
+			bool					discard;	// 作成後の最初のマップは D3D11_MAP_WRITE_DISCARD でなければなりません。
+		};
+
+		BufferHandle AddBuffer(const Microsoft::WRL::ComPtr<ID3D11Buffer>& buffer);
+		bool IsTransientBuffer(BufferHandle buffer) const;
+		void MapRings(ID3D11DeviceContext2* context);
+		void UnmapRings(ID3D11DeviceContext2* context);
+		void SetConstantBuffer(ID3D11DeviceContext2* context, UINT slot, const ConstantRange& range);
+		ID3D11Buffer* GetBuffer(BufferHandle buffer) const;
+		const Pipeline* GetPipeline(PipelineHandle pipeline) const;
+		bool BindPacket(ID3D11DeviceContext2* context, const DrawPacket& packet);
+		void DrawIndexed(ID3D11DeviceContext2* context, const DrawPacket& packet, uint32_t indexCount, uint32_t startIndex, int32_t baseVertex);
+
+		// デバイス リソースへのキャッシュされたポインター。
+		std::shared_ptr<DX::DeviceResources> m_deviceResources;
+
+		// 番号 - 1 が添字です。破棄した番号は再利用します。
+		std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>>	m_buffers;
+		std::vector<uint32_t>								m_freeBuffers;
+		std::vector<Pipeline>								m_pipelines;
+		std::vector<uint32_t>								m_freePipelines;
+
+		// BufferDescription::Usage ごとのリング バッファー。
+		Ring												m_rings[3];
+		bool												m_mapConstantRing;
+		Microsoft::WRL::ComPtr<ID3D11Buffer>				m_constantScratch[2];	// 定数のスロットごと。
+
+		// SetRenderTargets の描画先。
+		Microsoft::WRL::ComPtr<ID3D11RenderTargetView>		m_renderTarget;
+		Microsoft::WRL::ComPtr<ID3D11DepthStencilView>		m_depthStencil;
+
+		// Submit の中で最後に設定した状態と、Submit の時間の単位。
+		BoundState											m_boundState;
+		double												m_millisecondsPerTick;
+
+		// フレームの完了を知るためのフェンスと、そのフレームの終わりのリングの位置。
+		Microsoft::WRL::ComPtr<ID3D11Query>					m_fences[FramesInFlight];
+		uint64_t											m_fenceHeads[FramesInFlight][3];
+		bool												m_fencePending[FramesInFlight];
+		uint64_t											m_frameCount;
+		bool												m_frameOpen;
+	};
+}
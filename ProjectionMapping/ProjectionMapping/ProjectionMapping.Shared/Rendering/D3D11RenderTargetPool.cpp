@@ -0,0 +1,134 @@
+﻿#include "pch.h"
+#include "D3D11RenderTargetPool.h"
+
+#include "..\Common\DirectXHelper.h"
+
+using namespace ProjectionMapping;
+
+using namespace Microsoft::WRL;
+
+namespace
+{
+	// Color はスワップ チェーンのバック バッファー、DepthStencil は DeviceResources の深度ステンシルと同じ形式です。
+	const DXGI_FORMAT ColorFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
+	const DXGI_FORMAT DepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+}
+
+D3D11RenderTargetPool::D3D11RenderTargetPool(const std::shared_ptr<DX::DeviceResources>& deviceResources) :
+	m_deviceResources(deviceResources)
+{
+}
+
+void D3D11RenderTargetPool::Prepare(const RenderGraph& graph)
+{
+	const size_t count = graph.GetPhysicalCount();
+	m_targets.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const RenderTargetDescription& description = graph.GetPhysicalDescription(i);
+		Target& target = m_targets[i];
+		if (target.texture == nullptr || !(target.description == description))
+		{
+			CreateTarget(&target, description);
+		}
+	}
+}
+
+void D3D11RenderTargetPool::ReleaseDeviceDependentResources()
+{
+	m_targets.clear();
+}
+
+void D3D11RenderTargetPool::CreateTarget(Target* target, const RenderTargetDescription& description)
+{
+	auto device = m_deviceResources->GetD3DDevice();
+
+	target->description = description;
+	target->texture.Reset();
+	target->renderTargetView.Reset();
+	target->shaderResourceView.Reset();
+	target->depthStencilView.Reset();
+
+	const bool color = (description.format == RenderTargetDescription::Color);
+	CD3D11_TEXTURE2D_DESC textureDesc(
+		color ? ColorFormat : DepthStencilFormat,
+		description.width,
+		description.height,
+		1,
+		1,
+		color ? (D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE) : D3D11_BIND_DEPTH_STENCIL
+		);
+
+	DX::ThrowIfFailed(
+		device->CreateTexture2D(
+			&textureDesc,
+			nullptr,
+			&target->texture
+			)
+		);
+
+	if (color)
+	{
+		DX::ThrowIfFailed(
+			device->CreateRenderTargetView(
+				target->texture.Get(),
+				nullptr,
+				&target->renderTargetView
+				)
+			);
+
+		DX::ThrowIfFailed(
+			device->CreateShaderResourceView(
+				target->texture.Get(),
+				nullptr,
+				&target->shaderResourceView
+				)
+			);
+	}
+	else
+	{
+		CD3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc(D3D11_DSV_DIMENSION_TEXTURE2D);
+		DX::ThrowIfFailed(
+			device->CreateDepthStencilView(
+				target->texture.Get(),
+				&depthStencilViewDesc,
+				&target->depthStencilView
+				)
+			);
+	}
+}
+
+const D3D11RenderTargetPool::Target* D3D11RenderTargetPool::GetTarget(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const
+{
+	const uint32_t physical = graph.GetPhysicalIndex(resource);
+	if (physical == RenderGraph::NoPhysical || physical >= m_targets.size())
+	{
+		return nullptr;
+	}
+	return &m_targets[physical];
+}
+
+ID3D11Texture2D* D3D11RenderTargetPool::GetTexture(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const
+{
+	const Target* target = GetTarget(graph, resource);
+	return target != nullptr ? target->texture.Get() : nullptr;
+}
+
+ID3D11RenderTargetView* D3D11RenderTargetPool::GetRenderTargetView(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const
+{
+	const Target* target = GetTarget(graph, resource);
+	return target != nullptr ? target->renderTargetView.Get() : nullptr;
+}
+
+ID3D11ShaderResourceView* D3D11RenderTargetPool::GetShaderResourceView(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const
+{
+	const Target* target = GetTarget(graph, resource);
+	return target != nullptr ? target->shaderResourceView.Get() : nullptr;
+}
+
+ID3D11DepthStencilView* D3D11RenderTargetPool::GetDepthStencilView(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const
+{
+	const Target* target = GetTarget(graph, resource);
+	return target != nullptr ? target->depthStencilView.Get() : nullptr;
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <vector>
+#include "..\Common\DeviceResources.h"
+#include "RenderGraph.h"
+
+namespace ProjectionMapping
+{
+	// RenderGraph の一時的なターゲットの実体を Direct3D 11 のテクスチャで用意します。
+	// Direct3D 11 にはメモリを直接割り当てる手段がないので、グラフが同じ実体に割り当てたターゲットは同じテクスチャを共有します。
+	// テクスチャはフレームをまたいで保持し、実体の形式か大きさが変わったときだけ作り直します。
+	class D3D11RenderTargetPool
+	{
+	public:
+		D3D11RenderTargetPool(const std::shared_ptr<DX::DeviceResources>& deviceResources);
+
+		// Compile 済みの graph の実体をすべて用意します。使われなくなったテクスチャは解放します。
+		void Prepare(const RenderGraph& graph);
+
+		void ReleaseDeviceDependentResources();
+
+		// resource の実体。実体がない場合は nullptr です。Color はレンダリング ターゲットとシェーダー リソース、DepthStencil は深度ステンシルのビューを持ちます。
+		ID3D11Texture2D* GetTexture(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const;
+		ID3D11RenderTargetView* GetRenderTargetView(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const;
+		ID3D11ShaderResourceView* GetShaderResourceView(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const;
+		ID3D11DepthStencilView* GetDepthStencilView(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const;
+
+	private:
+		struct Target
+		{
+			RenderTargetDescription								description;
+			Microsoft::WRL::ComPtr<ID3D11Texture2D>				texture;
+			Microsoft::WRL::ComPtr<ID3D11RenderTargetView>		renderTargetView;
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>	shaderResourceView;
+			Microsoft::WRL::ComPtr<ID3D11DepthStencilView>		depthStencilView;
+		};
+
+		void CreateTarget(Target* target, const RenderTargetDescription& description);
+		const Target* GetTarget(const RenderGraph& graph, RenderGraph::ResourceHandle resource) const;
+
+		// デバイス リソースへのキャッシュされたポインター。
+		std::shared_ptr<DX::DeviceResources> m_deviceResources;
+
+		// グラフの実体の添字ごとのテクスチャ。
+		std::vector<Target> m_targets;
+	};
+}
@@ -0,0 +1,398 @@
+﻿#include "DynamicBvh.h"
+
+#include <algorithm>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 葉に入っていないオブジェクトと、根の親を表す番号。
+	const uint32_t NoNode = 0xFFFFFFFF;
+
+	// SAH のビンの数。
+	const uint32_t BinCount = 12;
+
+	// ノードをたどるコストと、オブジェクトを判定するコストの比。どちらも視錐台の判定 1 回です。
+	const float TraversalCost = 1.0f;
+	const float IntersectCost = 1.0f;
+
+	// refit で SAH のコストがこの倍率を超えたら作り直します。
+	const float DefaultRebuildThreshold = 1.5f;
+}
+
+DynamicBvh::DynamicBvh() :
+	m_structureChanged(false),
+	m_dirtyCount(0),
+	m_cost(0.0f),
+	m_builtCost(0.0f),
+	m_rebuildThreshold(DefaultRebuildThreshold),
+	m_rebuildCount(0)
+{
+}
+
+uint32_t DynamicBvh::CreateProxy(const Aabb& bounds, uint32_t userData)
+{
+	uint32_t proxy;
+	if (!m_freeProxies.empty())
+	{
+		proxy = m_freeProxies.back();
+		m_freeProxies.pop_back();
+		m_proxyBounds[proxy] = bounds;
+		m_proxyData[proxy] = userData;
+		m_proxyLeaf[proxy] = NoNode;
+		m_proxyAlive[proxy] = 1;
+	}
+	else
+	{
+		proxy = static_cast<uint32_t>(m_proxyBounds.size());
+		m_proxyBounds.push_back(bounds);
+		m_proxyData.push_back(userData);
+		m_proxyLeaf.push_back(NoNode);
+		m_proxyAlive.push_back(1);
+	}
+
+	m_structureChanged = true;
+	return proxy;
+}
+
+void DynamicBvh::DestroyProxy(uint32_t proxy)
+{
+	if (proxy >= m_proxyAlive.size() || !m_proxyAlive[proxy])
+	{
+		return;
+	}
+
+	m_proxyAlive[proxy] = 0;
+	m_proxyLeaf[proxy] = NoNode;
+	m_freeProxies.push_back(proxy);
+	m_structureChanged = true;
+}
+
+void DynamicBvh::MoveProxy(uint32_t proxy, const Aabb& bounds)
+{
+	if (proxy >= m_proxyAlive.size() || !m_proxyAlive[proxy])
+	{
+		return;
+	}
+
+	m_proxyBounds[proxy] = bounds;
+	if (m_structureChanged)
+	{
+		return;
+	}
+
+	// 葉から根までの境界を再計算の対象にします。既に対象になっているノードより上は、すでに対象です。
+	for (uint32_t node = m_proxyLeaf[proxy]; node != NoNode && !m_dirty[node]; node = m_nodes[node].parent)
+	{
+		m_dirty[node] = 1;
+		m_dirtyCount++;
+	}
+}
+
+void DynamicBvh::Update()
+{
+	if (m_structureChanged)
+	{
+		Rebuild();
+		return;
+	}
+
+	if (m_dirtyCount == 0)
+	{
+		return;
+	}
+
+	Refit();
+	if (m_cost > m_builtCost * m_rebuildThreshold)
+	{
+		Rebuild();
+	}
+}
+
+void DynamicBvh::Cull(const Frustum& frustum, std::vector<uint32_t>* visible) const
+{
+	visible->clear();
+	if (m_nodes.empty())
+	{
+		return;
+	}
+
+	// 内部ノードの深さは MaxDepth - 2 以下なので、スタックは MaxDepth を超えません。
+	uint32_t stack[MaxDepth + 1];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0)
+	{
+		const uint32_t index = stack[--top];
+		const Node& node = m_nodes[index];
+
+		const Frustum::Containment containment = frustum.Test(node.bounds);
+		if (containment == Frustum::Outside)
+		{
+			continue;
+		}
+
+		if (containment == Frustum::Inside)
+		{
+			AppendRange(node, visible);
+			continue;
+		}
+
+		if (node.right == 0)
+		{
+			// 平面をまたぐ葉は、オブジェクトごとに判定します。
+			for (uint32_t k = node.first; k < node.first + node.count; k++)
+			{
+				const uint32_t proxy = m_leafProxies[k];
+				if (frustum.Test(m_proxyBounds[proxy]) != Frustum::Outside)
+				{
+					visible->push_back(m_proxyData[proxy]);
+				}
+			}
+			continue;
+		}
+
+		stack[top++] = node.right;
+		stack[top++] = index + 1;
+	}
+}
+
+void DynamicBvh::AppendRange(const Node& node, std::vector<uint32_t>* visible) const
+{
+	for (uint32_t k = node.first; k < node.first + node.count; k++)
+	{
+		visible->push_back(m_proxyData[m_leafProxies[k]]);
+	}
+}
+
+float DynamicBvh::NodeCost(const Node& node)
+{
+	return node.bounds.HalfArea() * (node.right == 0 ? IntersectCost * node.count : TraversalCost);
+}
+
+// 子は親より後ろにあるので、後ろから順に再計算すると子の境界が先に決まります。
+// 再計算は対象のノードだけですが、SAH のコストはすべてのノードについて合計し直します。
+void DynamicBvh::Refit()
+{
+	float cost = 0.0f;
+	for (size_t i = m_nodes.size(); i-- > 0; )
+	{
+		Node& node = m_nodes[i];
+		if (m_dirty[i])
+		{
+			if (node.right == 0)
+			{
+				node.bounds = Aabb::Empty();
+				for (uint32_t k = node.first; k < node.first + node.count; k++)
+				{
+					node.bounds.Merge(m_proxyBounds[m_leafProxies[k]]);
+				}
+			}
+			else
+			{
+				node.bounds = m_nodes[i + 1].bounds;
+				node.bounds.Merge(m_nodes[node.right].bounds);
+			}
+			m_dirty[i] = 0;
+		}
+		cost += NodeCost(node);
+	}
+
+	const float rootArea = m_nodes[0].bounds.HalfArea();
+	m_cost = rootArea > 0.0f ? cost / rootArea : 0.0f;
+	m_dirtyCount = 0;
+}
+
+void DynamicBvh::Rebuild()
+{
+	const uint32_t proxyCapacity = static_cast<uint32_t>(m_proxyBounds.size());
+
+	m_leafProxies.clear();
+	m_centroids.resize(proxyCapacity * 3);
+	for (uint32_t proxy = 0; proxy < proxyCapacity; proxy++)
+	{
+		m_proxyLeaf[proxy] = NoNode;
+		if (!m_proxyAlive[proxy])
+		{
+			continue;
+		}
+
+		m_leafProxies.push_back(proxy);
+		const Aabb& bounds = m_proxyBounds[proxy];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			m_centroids[proxy * 3 + axis] = (bounds.min[axis] + bounds.max[axis]) * 0.5f;
+		}
+	}
+
+	// ノードの数は 2n - 1 以下なので、構築中に再確保されません。
+	const uint32_t count = static_cast<uint32_t>(m_leafProxies.size());
+	m_nodes.clear();
+	m_nodes.reserve(count * 2);
+	if (count > 0)
+	{
+		BuildNode(0, count, NoNode, 0);
+	}
+	m_dirty.assign(m_nodes.size(), 0);
+
+	float cost = 0.0f;
+	for (size_t i = 0; i < m_nodes.size(); i++)
+	{
+		cost += NodeCost(m_nodes[i]);
+	}
+	const float rootArea = m_nodes.empty() ? 0.0f : m_nodes[0].bounds.HalfArea();
+	m_cost = rootArea > 0.0f ? cost / rootArea : 0.0f;
+	m_builtCost = m_cost;
+
+	m_structureChanged = false;
+	m_dirtyCount = 0;
+	m_rebuildCount++;
+}
+
+// [begin, end) のオブジェクトのノードを作り、番号を返します。中心の広がりが最も大きい軸をビンに分け、SAH のコストが最小の位置で分割します。
+uint32_t DynamicBvh::BuildNode(uint32_t begin, uint32_t end, uint32_t parent, uint32_t depth)
+{
+	const uint32_t index = static_cast<uint32_t>(m_nodes.size());
+	m_nodes.push_back(Node());
+
+	Aabb bounds = Aabb::Empty();
+	Aabb centroidBounds = Aabb::Empty();
+	for (uint32_t k = begin; k < end; k++)
+	{
+		const uint32_t proxy = m_leafProxies[k];
+		bounds.Merge(m_proxyBounds[proxy]);
+
+		const float* centroid = &m_centroids[proxy * 3];
+		const Aabb point = { { centroid[0], centroid[1], centroid[2] }, { centroid[0], centroid[1], centroid[2] } };
+		centroidBounds.Merge(point);
+	}
+
+	Node node;
+	node.bounds = bounds;
+	node.parent = parent;
+	node.right = 0;
+	node.first = begin;
+	node.count = end - begin;
+
+	const uint32_t count = end - begin;
+	bool leaf = count <= 1 || depth + 1 >= MaxDepth;
+
+	int axis = 0;
+	for (int a = 1; a < 3; a++)
+	{
+		if (centroidBounds.max[a] - centroidBounds.min[a] > centroidBounds.max[axis] - centroidBounds.min[axis])
+		{
+			axis = a;
+		}
+	}
+	const float axisMin = centroidBounds.min[axis];
+	const float axisExtent = centroidBounds.max[axis] - axisMin;
+
+	uint32_t mid = begin;
+	if (!leaf && axisExtent > 0.0f)
+	{
+		uint32_t binCounts[BinCount] = {};
+		Aabb binBounds[BinCount];
+		for (uint32_t b = 0; b < BinCount; b++)
+		{
+			binBounds[b] = Aabb::Empty();
+		}
+
+		const float binScale = BinCount / axisExtent;
+		const float* centroids = m_centroids.data();
+		auto binOf = [=](uint32_t proxy) -> uint32_t
+		{
+			const uint32_t bin = static_cast<uint32_t>((centroids[proxy * 3 + axis] - axisMin) * binScale);
+			return bin < BinCount ? bin : BinCount - 1;
+		};
+
+		for (uint32_t k = begin; k < end; k++)
+		{
+			const uint32_t proxy = m_leafProxies[k];
+			const uint32_t bin = binOf(proxy);
+			binCounts[bin]++;
+			binBounds[bin].Merge(m_proxyBounds[proxy]);
+		}
+
+		// 右側の累積の面積と数を先に求め、左から分割位置を動かしながらコストを比べます。
+		float rightAreas[BinCount];
+		uint32_t rightCounts[BinCount];
+		Aabb accumulated = Aabb::Empty();
+		uint32_t accumulatedCount = 0;
+		for (uint32_t b = BinCount; b-- > 1; )
+		{
+			accumulated.Merge(binBounds[b]);
+			accumulatedCount += binCounts[b];
+			rightAreas[b] = accumulated.HalfArea();
+			rightCounts[b] = accumulatedCount;
+		}
+
+		float bestCost = 0.0f;
+		uint32_t bestSplit = 0;
+		accumulated = Aabb::Empty();
+		accumulatedCount = 0;
+		for (uint32_t b = 1; b < BinCount; b++)
+		{
+			accumulated.Merge(binBounds[b - 1]);
+			accumulatedCount += binCounts[b - 1];
+			if (accumulatedCount == 0 || rightCounts[b] == 0)
+			{
+				continue;
+			}
+
+			const float cost = accumulated.HalfArea() * accumulatedCount + rightAreas[b] * rightCounts[b];
+			if (bestSplit == 0 || cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = b;
+			}
+		}
+
+		const float area = bounds.HalfArea();
+		const float splitCost = TraversalCost + (area > 0.0f ? IntersectCost * bestCost / area : 0.0f);
+		const float leafCost = IntersectCost * count;
+		if (count <= MaxLeafProxies && (bestSplit == 0 || leafCost <= splitCost))
+		{
+			leaf = true;
+		}
+		else if (bestSplit != 0)
+		{
+			mid = static_cast<uint32_t>(std::partition(m_leafProxies.begin() + begin, m_leafProxies.begin() + end, [&](uint32_t proxy)
+			{
+				return binOf(proxy) < bestSplit;
+			}) - m_leafProxies.begin());
+		}
+	}
+	else if (!leaf && count <= MaxLeafProxies)
+	{
+		// 中心がすべて同じ位置にある場合は、分けても判定は減りません。
+		leaf = true;
+	}
+
+	if (leaf)
+	{
+		for (uint32_t k = begin; k < end; k++)
+		{
+			m_proxyLeaf[m_leafProxies[k]] = index;
+		}
+		m_nodes[index] = node;
+		return index;
+	}
+
+	// ビンで分けられない場合は、中心の中央値で半分に分けます。
+	if (mid == begin || mid == end)
+	{
+		mid = begin + count / 2;
+		const float* centroids = m_centroids.data();
+		std::nth_element(m_leafProxies.begin() + begin, m_leafProxies.begin() + mid, m_leafProxies.begin() + end, [=](uint32_t a, uint32_t b)
+		{
+			return centroids[a * 3 + axis] < centroids[b * 3 + axis];
+		});
+	}
+
+	BuildNode(begin, mid, index, depth + 1);
+	node.right = BuildNode(mid, end, index, depth + 1);
+	m_nodes[index] = node;
+	return index;
+}
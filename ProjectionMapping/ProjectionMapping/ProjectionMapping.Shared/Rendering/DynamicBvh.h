@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "../Math/Bounds.h"
+
+namespace ProjectionMapping
+{
+	// シーンのオブジェクトの境界ボックスを入れる動的な境界ボリューム階層 (BVH)。視錐台カリングに使用します。
+	// オブジェクトが動いたときは、動いた葉から根までの境界だけを Update で再計算 (refit) します。
+	// refit を繰り返して SAH のコストが構築時の一定倍を超えた場合や、オブジェクトを追加、削除した場合は、ビン分割の SAH で作り直します。
+	// ノードは深さ優先の順に並び、左の子は親の直後に置きます。各ノードは部分木のオブジェクトの連続した範囲を持ちます。
+	class DynamicBvh
+	{
+	public:
+		// 葉に入れるオブジェクトの最大数。
+		static const uint32_t MaxLeafProxies = 4;
+
+		// 木の最大の深さ。これより深い部分は 1 枚の葉にまとめ、Cull のスタックの大きさを固定します。
+		static const uint32_t MaxDepth = 48;
+
+		DynamicBvh();
+
+		// オブジェクトを追加し、番号を返します。Cull は見えるオブジェクトの userData を返します。
+		uint32_t CreateProxy(const Aabb& bounds, uint32_t userData);
+
+		void DestroyProxy(uint32_t proxy);
+
+		// オブジェクトの境界を更新します。木は次の Update で refit します。
+		void MoveProxy(uint32_t proxy, const Aabb& bounds);
+
+		// 移動を反映します。構造が変わったか、品質が落ちた場合は作り直します。
+		void Update();
+
+		// 視錐台と交差するか内側にあるオブジェクトの userData を visible に書き込みます。以前の内容は消去します。
+		// 部分木全体が内側にある場合は、その下のノードを判定せずにまとめて追加します。const なので、複数のビューから並列に呼び出せます。
+		void Cull(const Frustum& frustum, std::vector<uint32_t>* visible) const;
+
+		// refit で SAH のコストが構築時の何倍になったら作り直すか。
+		void SetRebuildThreshold(float ratio)	{ m_rebuildThreshold = ratio; }
+
+		uint32_t GetProxyCount() const			{ return static_cast<uint32_t>(m_proxyBounds.size() - m_freeProxies.size()); }
+		uint32_t GetNodeCount() const			{ return static_cast<uint32_t>(m_nodes.size()); }
+		uint32_t GetRebuildCount() const		{ return m_rebuildCount; }
+
+		// 構築時に対する現在の SAH のコストの比。
+		float GetCostRatio() const				{ return m_builtCost > 0.0f ? m_cost / m_builtCost : 1.0f; }
+
+	private:
+		struct Node
+		{
+			Aabb		bounds;
+			uint32_t	parent;
+			uint32_t	right;		// 右の子。0 の場合は葉です (根は子になりません)。左の子は次のノードです。
+			uint32_t	first;		// m_leafProxies の部分木の範囲。
+			uint32_t	count;
+		};
+
+		void Rebuild();
+		uint32_t BuildNode(uint32_t begin, uint32_t end, uint32_t parent, uint32_t depth);
+		void Refit();
+		void AppendRange(const Node& node, std::vector<uint32_t>* visible) const;
+
+		// ノードの SAH のコストへの寄与。
+		static float NodeCost(const Node& node);
+
+		// オブジェクトごとの配列。番号で参照します。
+		std::vector<Aabb>		m_proxyBounds;
+		std::vector<uint32_t>	m_proxyData;
+		std::vector<uint32_t>	m_proxyLeaf;		// オブジェクトが入っている葉。木に入っていない場合は無効な番号です。
+		std::vector<uint8_t>	m_proxyAlive;
+		std::vector<uint32_t>	m_freeProxies;
+
+		std::vector<Node>		m_nodes;
+		std::vector<uint8_t>	m_dirty;			// 境界の再計算が必要なノード。
+		std::vector<uint32_t>	m_leafProxies;		// 葉の順に並べたオブジェクトの番号。
+
+		// 構築で使用する作業用の配列。
+		std::vector<float>		m_centroids;
+
+		bool		m_structureChanged;
+		uint32_t	m_dirtyCount;
+		float		m_cost;
+		float		m_builtCost;
+		float		m_rebuildThreshold;
+		uint32_t	m_rebuildCount;
+	};
+}
@@ -0,0 +1,156 @@
+﻿#include "InstanceTransforms.h"
+
+#include "../Math/VectorMath.h"
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 4 個のインスタンスの 4 つの要素を転置して、インスタンスごとの 4 要素として書き込みます。
+	inline void StoreTransposed(float* p0, float* p1, float* p2, float* p3, const Vector& a, const Vector& b, const Vector& c, const Vector& d)
+	{
+		const Matrix transposed = Matrix(a, b, c, d).Transpose();
+		transposed.rows[0].Store(p0);
+		transposed.rows[1].Store(p1);
+		transposed.rows[2].Store(p2);
+		transposed.rows[3].Store(p3);
+	}
+
+	// 連続した 4 個のインスタンスの要素を読み込みます。
+	struct ContiguousLanes
+	{
+		size_t i;
+
+		Vector operator()(const std::vector<float>& values) const
+		{
+			return Vector::Load(&values[i]);
+		}
+	};
+
+	// 番号で指定した 4 個のインスタンスの要素を集めます。
+	struct GatheredLanes
+	{
+		const uint32_t* indices;
+
+		Vector operator()(const std::vector<float>& values) const
+		{
+			return Vector::Set(values[indices[0]], values[indices[1]], values[indices[2]], values[indices[3]]);
+		}
+	};
+
+	// lanes で読み込んだ 4 個のインスタンスを変換し、o[0] から o[3] に書き込みます。
+	template<typename Lanes>
+	void WriteFour(const InstanceTransforms& t, const Lanes& lanes, InstanceData* o)
+	{
+		const Vector x = lanes(t.rotationX);
+		const Vector y = lanes(t.rotationY);
+		const Vector z = lanes(t.rotationZ);
+		const Vector w = lanes(t.rotationW);
+		const Vector s = lanes(t.scale);
+		const Vector s2 = s * Vector::Splat(2.0f);
+
+		const Vector xx = x * x, yy = y * y, zz = z * z;
+		const Vector xy = x * y, xz = x * z, yz = y * z;
+		const Vector wx = w * x, wy = w * y, wz = w * z;
+
+		StoreTransposed(o[0].world[0], o[1].world[0], o[2].world[0], o[3].world[0],
+			s - s2 * (yy + zz),
+			s2 * (xy - wz),
+			s2 * (xz + wy),
+			lanes(t.positionX));
+
+		StoreTransposed(o[0].world[1], o[1].world[1], o[2].world[1], o[3].world[1],
+			s2 * (xy + wz),
+			s - s2 * (xx + zz),
+			s2 * (yz - wx),
+			lanes(t.positionY));
+
+		StoreTransposed(o[0].world[2], o[1].world[2], o[2].world[2], o[3].world[2],
+			s2 * (xz - wy),
+			s2 * (yz + wx),
+			s - s2 * (xx + yy),
+			lanes(t.positionZ));
+
+		StoreTransposed(o[0].color, o[1].color, o[2].color, o[3].color,
+			lanes(t.colorR),
+			lanes(t.colorG),
+			lanes(t.colorB),
+			lanes(t.colorA));
+	}
+
+	// 1 個のインスタンスを変換します。4 個に満たない端数に使用します。
+	void WriteInstance(const InstanceTransforms& t, size_t i, InstanceData* output)
+	{
+		const float x = t.rotationX[i], y = t.rotationY[i], z = t.rotationZ[i], w = t.rotationW[i];
+		const float s = t.scale[i];
+		const float s2 = s * 2.0f;
+
+		// 列ベクトル規約の回転行列の各行が、行ベクトル規約のワールド行列の各列になります。
+		// SIMD の経路と同じ順に計算して、同じ結果にします。
+		output->world[0][0] = s - s2 * (y * y + z * z);
+		output->world[0][1] = s2 * (x * y - w * z);
+		output->world[0][2] = s2 * (x * z + w * y);
+		output->world[0][3] = t.positionX[i];
+
+		output->world[1][0] = s2 * (x * y + w * z);
+		output->world[1][1] = s - s2 * (x * x + z * z);
+		output->world[1][2] = s2 * (y * z - w * x);
+		output->world[1][3] = t.positionY[i];
+
+		output->world[2][0] = s2 * (x * z - w * y);
+		output->world[2][1] = s2 * (y * z + w * x);
+		output->world[2][2] = s - s2 * (x * x + y * y);
+		output->world[2][3] = t.positionZ[i];
+
+		output->color[0] = t.colorR[i];
+		output->color[1] = t.colorG[i];
+		output->color[2] = t.colorB[i];
+		output->color[3] = t.colorA[i];
+	}
+}
+
+void InstanceTransforms::Resize(size_t count)
+{
+	positionX.resize(count, 0.0f);
+	positionY.resize(count, 0.0f);
+	positionZ.resize(count, 0.0f);
+	rotationX.resize(count, 0.0f);
+	rotationY.resize(count, 0.0f);
+	rotationZ.resize(count, 0.0f);
+	rotationW.resize(count, 1.0f);
+	scale.resize(count, 1.0f);
+	colorR.resize(count, 1.0f);
+	colorG.resize(count, 1.0f);
+	colorB.resize(count, 1.0f);
+	colorA.resize(count, 1.0f);
+}
+
+void InstanceTransforms::Write(size_t begin, size_t end, InstanceData* output) const
+{
+	size_t i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		const ContiguousLanes lanes = { i };
+		WriteFour(*this, lanes, output + (i - begin));
+	}
+
+	for (; i < end; i++)
+	{
+		WriteInstance(*this, i, output + (i - begin));
+	}
+}
+
+void InstanceTransforms::Gather(const uint32_t* indices, size_t count, InstanceData* output) const
+{
+	size_t k = 0;
+	for (; k + 4 <= count; k += 4)
+	{
+		const GatheredLanes lanes = { indices + k };
+		WriteFour(*this, lanes, output + k);
+	}
+
+	for (; k < count; k++)
+	{
+		WriteInstance(*this, indices[k], output + k);
+	}
+}
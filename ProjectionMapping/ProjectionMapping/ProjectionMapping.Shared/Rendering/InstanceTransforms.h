@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ProjectionMapping
+{
+	// InstancedVertexShader に渡すインスタンスごとのデータ。頂点バッファーのスロット 1 に置きます。
+	struct InstanceData
+	{
+		float world[3][4];	// ワールド行列 (行ベクトル規約) の 1 から 3 列目。位置は dot(float4(p, 1), world[i]) で変換します。
+		float color[4];		// 頂点の色に掛ける色 (RGBA)。
+	};
+
+	// インスタンスの変換と色を要素ごとの配列 (SoA) で保持します。
+	// 要素ごとに連続しているので、数千個のインスタンスの更新を配列ごとのループで行い、Write でまとめて InstanceData に変換します。
+	struct InstanceTransforms
+	{
+		std::vector<float> positionX;
+		std::vector<float> positionY;
+		std::vector<float> positionZ;
+
+		// 単位クォータニオン。
+		std::vector<float> rotationX;
+		std::vector<float> rotationY;
+		std::vector<float> rotationZ;
+		std::vector<float> rotationW;
+
+		std::vector<float> scale;
+
+		std::vector<float> colorR;
+		std::vector<float> colorG;
+		std::vector<float> colorB;
+		std::vector<float> colorA;
+
+		// 要素数を変更します。増えたインスタンスは原点、回転なし、大きさ 1、白です。
+		void Resize(size_t count);
+
+		size_t GetCount() const		{ return positionX.size(); }
+
+		// [begin, end) のインスタンスを output[0] から書き込みます。4 個ずつ SIMD で計算します。
+		void Write(size_t begin, size_t end, InstanceData* output) const;
+
+		// indices[0..count) のインスタンスを output[0] から詰めて書き込みます。カリングで残ったインスタンスだけを送るのに使用します。
+		void Gather(const uint32_t* indices, size_t count, InstanceData* output) const;
+	};
+}
@@ -0,0 +1,99 @@
+﻿#include "RadixSort.h"
+
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const int DigitBits = 8;
+	const int DigitCount = 64 / DigitBits;
+	const uint32_t BucketCount = 1 << DigitBits;
+
+	// これより少ない場合は挿入ソートの方が速くなります。
+	const size_t InsertionSortThreshold = 32;
+}
+
+void RadixSort::Sort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* keyScratch, uint32_t* valueScratch)
+{
+	if (count < 2)
+	{
+		return;
+	}
+
+	if (count < InsertionSortThreshold)
+	{
+		for (size_t i = 1; i < count; i++)
+		{
+			const uint64_t key = keys[i];
+			const uint32_t value = values[i];
+			size_t j = i;
+			for (; j > 0 && keys[j - 1] > key; j--)
+			{
+				keys[j] = keys[j - 1];
+				values[j] = values[j - 1];
+			}
+			keys[j] = key;
+			values[j] = value;
+		}
+		return;
+	}
+
+	// すべての桁の度数を 1 回の走査で数えます。
+	uint32_t histograms[DigitCount][BucketCount];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint64_t key = keys[i];
+		for (int digit = 0; digit < DigitCount; digit++)
+		{
+			histograms[digit][(key >> (digit * DigitBits)) & (BucketCount - 1)]++;
+		}
+	}
+
+	uint64_t* sourceKeys = keys;
+	uint32_t* sourceValues = values;
+	uint64_t* targetKeys = keyScratch;
+	uint32_t* targetValues = valueScratch;
+
+	for (int digit = 0; digit < DigitCount; digit++)
+	{
+		uint32_t* histogram = histograms[digit];
+		const int shift = digit * DigitBits;
+
+		// すべてのキーがこの桁で同じ値なら、並べ替えても順は変わりません。
+		if (histogram[(sourceKeys[0] >> shift) & (BucketCount - 1)] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < BucketCount; bucket++)
+		{
+			const uint32_t bucketCount = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint32_t position = histogram[(sourceKeys[i] >> shift) & (BucketCount - 1)]++;
+			targetKeys[position] = sourceKeys[i];
+			targetValues[position] = sourceValues[i];
+		}
+
+		uint64_t* swapKeys = sourceKeys;
+		sourceKeys = targetKeys;
+		targetKeys = swapKeys;
+		uint32_t* swapValues = sourceValues;
+		sourceValues = targetValues;
+		targetValues = swapValues;
+	}
+
+	// 奇数回並べ替えた場合は、結果が作業用の領域にあります。
+	if (sourceKeys != keys)
+	{
+		memcpy(keys, sourceKeys, sizeof(uint64_t) * count);
+		memcpy(values, sourceValues, sizeof(uint32_t) * count);
+	}
+}
@@ -0,0 +1,17 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ProjectionMapping
+{
+	// 64 ビットのキーと 32 ビットの値の組を、キーの昇順に並べ替えます。同じキーの組は元の順を保ちます (安定)。
+	// 下位から 8 ビットずつの LSD 基数ソートで、すべてのキーで同じ値の桁は飛ばします。
+	// 描画のキーは上位の桁 (パスとパイプライン) がほとんど同じなので、実際に並べ替える桁は少なくなります。
+	class RadixSort
+	{
+	public:
+		// keys と values を並べ替えます。keyScratch と valueScratch は count 個以上の作業用の領域です。
+		static void Sort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* keyScratch, uint32_t* valueScratch);
+	};
+}
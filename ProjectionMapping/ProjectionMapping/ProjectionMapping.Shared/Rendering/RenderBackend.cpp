@@ -0,0 +1,171 @@
+﻿#include "RenderBackend.h"
+#include "RadixSort.h"
+
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+void CommandList::Reset()
+{
+	m_commands.clear();
+	m_keys.clear();
+	m_data.clear();
+}
+
+void CommandList::AddCommand(const Command& command, uint64_t sortKey)
+{
+	m_commands.push_back(command);
+	m_keys.push_back(sortKey);
+}
+
+void CommandList::Clear(const float color[4], float depth)
+{
+	Command command;
+	command.type = Command::Clear;
+	memcpy(command.clear.color, color, sizeof(command.clear.color));
+	command.clear.depth = depth;
+	AddCommand(command, 0);
+}
+
+void CommandList::UpdateBuffer(BufferHandle buffer, const void* data, uint32_t size)
+{
+	const size_t offset = m_data.size();
+	m_data.resize(offset + size);
+	memcpy(m_data.data() + offset, data, size);
+
+	Command command;
+	command.type = Command::UpdateBuffer;
+	command.update.buffer = buffer;
+	command.update.offset = static_cast<uint32_t>(offset);
+	command.update.size = size;
+	AddCommand(command, 0);
+}
+
+void CommandList::SetViewport(float x, float y, float width, float height)
+{
+	Command command;
+	command.type = Command::Viewport;
+	command.viewport.x = x;
+	command.viewport.y = y;
+	command.viewport.width = width;
+	command.viewport.height = height;
+	AddCommand(command, 0);
+}
+
+void CommandList::Draw(const DrawPacket& packet, uint64_t sortKey)
+{
+	Command command;
+	command.type = Command::Draw;
+	command.draw = packet;
+	AddCommand(command, sortKey);
+}
+
+void CommandList::DrawBatch(const DrawPacket& packet, const DrawRange* ranges, uint32_t count, uint64_t sortKey)
+{
+	// DrawRange を読み出せるように、位置を 4 バイトに揃えます。
+	const size_t offset = (m_data.size() + 3) & ~static_cast<size_t>(3);
+	m_data.resize(offset + sizeof(DrawRange) * count);
+	memcpy(m_data.data() + offset, ranges, sizeof(DrawRange) * count);
+
+	Command command;
+	command.type = Command::DrawBatch;
+	command.batch.packet = packet;
+	command.batch.rangeOffset = static_cast<uint32_t>(offset);
+	command.batch.rangeCount = count;
+	AddCommand(command, sortKey);
+}
+
+void CommandList::Sort()
+{
+	const size_t commandCount = m_commands.size();
+	m_sortedCommands.resize(commandCount);
+	m_sortKeyScratch.resize(commandCount);
+	m_sortOrderScratch.resize(commandCount);
+
+	bool reordered = false;
+	size_t begin = 0;
+	while (begin < commandCount)
+	{
+		// 描画以外のコマンドはそのまま残します。
+		const Command::Type type = m_commands[begin].type;
+		if (type != Command::Draw && type != Command::DrawBatch)
+		{
+			m_sortedCommands[begin] = m_commands[begin];
+			begin++;
+			continue;
+		}
+
+		size_t end = begin + 1;
+		while (end < commandCount && (m_commands[end].type == Command::Draw || m_commands[end].type == Command::DrawBatch))
+		{
+			end++;
+		}
+
+		const size_t count = end - begin;
+		m_sortKeys.assign(m_keys.begin() + begin, m_keys.begin() + end);
+		m_sortOrder.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			m_sortOrder[i] = static_cast<uint32_t>(begin + i);
+		}
+
+		RadixSort::Sort(m_sortKeys.data(), m_sortOrder.data(), count, m_sortKeyScratch.data(), m_sortOrderScratch.data());
+
+		for (size_t i = 0; i < count; i++)
+		{
+			m_sortedCommands[begin + i] = m_commands[m_sortOrder[i]];
+			m_keys[begin + i] = m_sortKeys[i];
+			reordered |= (m_sortOrder[i] != begin + i);
+		}
+		begin = end;
+	}
+
+	if (reordered)
+	{
+		m_commands.swap(m_sortedCommands);
+	}
+}
+
+uint32_t BoundState::Bind(const DrawPacket& packet, SubmitStatistics* statistics)
+{
+	uint32_t changed = AllGroups;
+	if (m_valid)
+	{
+		changed = 0;
+		if (packet.pipeline != m_packet.pipeline)
+		{
+			changed |= PipelineGroup;
+		}
+		if (packet.vertexBuffer != m_packet.vertexBuffer || packet.vertexStride != m_packet.vertexStride ||
+			packet.instanceBuffer != m_packet.instanceBuffer || packet.instanceOffset != m_packet.instanceOffset)
+		{
+			changed |= VertexBufferGroup;
+		}
+		if (packet.indexBuffer != m_packet.indexBuffer || packet.indexFormat != m_packet.indexFormat)
+		{
+			changed |= IndexBufferGroup;
+		}
+		if (packet.frameConstants.buffer != m_packet.frameConstants.buffer || packet.frameConstants.offset != m_packet.frameConstants.offset ||
+			packet.frameConstants.size != m_packet.frameConstants.size)
+		{
+			changed |= FrameConstantGroup;
+		}
+		if (packet.objectConstants.buffer != m_packet.objectConstants.buffer || packet.objectConstants.offset != m_packet.objectConstants.offset ||
+			packet.objectConstants.size != m_packet.objectConstants.size)
+		{
+			changed |= ObjectConstantGroup;
+		}
+	}
+
+	m_packet = packet;
+	m_valid = true;
+
+	uint32_t changedCount = 0;
+	for (uint32_t group = 0; group < GroupCount; group++)
+	{
+		changedCount += (changed >> group) & 1;
+	}
+	statistics->stateChanges += changedCount;
+	statistics->redundantStates += GroupCount - changedCount;
+	return changed;
+}
@@ -0,0 +1,331 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace ProjectionMapping
+{
+	// バックエンドが作成したリソースの番号。0 は無効です。
+	typedef uint32_t BufferHandle;
+	typedef uint32_t PipelineHandle;
+	const uint32_t InvalidHandle = 0;
+
+	struct BufferDescription
+	{
+		enum Usage
+		{
+			Vertex,
+			Index,
+			Constant
+		};
+
+		Usage usage;
+		uint32_t size;				// バイト数。
+		const void* initialData;	// nullptr の場合は内容が不定です。
+	};
+
+	// 頂点の形式は位置と色 (VertexPositionColor) で、インスタンスごとのデータを加えることができます。
+	struct PipelineDescription
+	{
+		enum CullMode
+		{
+			CullNone,
+			CullFront,
+			CullBack
+		};
+
+		enum VertexLayout
+		{
+			PositionColor,			// SampleVertexShader。
+			PositionColorInstance	// InstancedVertexShader。スロット 1 にインスタンスごとの InstanceData を置きます。
+		};
+
+		// コンパイル済みのシェーダー (.cso の内容)。CPU のバックエンドは SampleVertexShader と同じ処理を行い、参照しません。
+		const void* vertexShader;
+		size_t vertexShaderSize;
+		const void* pixelShader;
+		size_t pixelShaderSize;
+		CullMode cullMode;
+		VertexLayout vertexLayout;
+	};
+
+	// 定数バッファーの中の範囲。
+	struct ConstantRange
+	{
+		BufferHandle buffer;
+		uint32_t offset;	// buffer の中の位置 (バイト)。RenderBackend::ConstantAlignment の倍数です。
+		uint32_t size;		// 0 の場合は buffer の全体です。
+	};
+
+	// 1 回の描画に必要なリソースの組。
+	// 定数は更新の頻度で分けます。ビューとプロジェクションはフレームごと (変更したときだけ) に、
+	// オブジェクトの行列は CPU で MVP まで掛け合わせてオブジェクトごとに設定します。
+	struct DrawPacket
+	{
+		enum IndexFormat
+		{
+			Index16,
+			Index32
+		};
+
+		PipelineHandle pipeline;
+		BufferHandle vertexBuffer;
+		BufferHandle indexBuffer;
+		ConstantRange frameConstants;	// 頂点シェーダーのスロット 0。転置した viewProjection。使用しない場合は InvalidHandle です。
+		ConstantRange objectConstants;	// 頂点シェーダーのスロット 1。転置した modelViewProjection。使用しない場合は InvalidHandle です。
+		uint32_t vertexStride;
+		IndexFormat indexFormat;
+		uint32_t indexCount;
+		uint32_t startIndex;
+		int32_t baseVertex;
+
+		// インスタンスごとの InstanceData の頂点バッファー。InvalidHandle の場合はインスタンス化しません。
+		BufferHandle instanceBuffer;
+		uint32_t instanceOffset;		// instanceBuffer の中の位置 (バイト)。
+		uint32_t instanceCount;
+	};
+
+	// CommandList::Sort で描画を並べ替える 64 ビットのキー。上位から、パス (4 ビット)、パイプライン (12 ビット)、
+	// マテリアル (16 ビット)、深度 (32 ビット) の順に比べます。
+	// 同じパイプラインとマテリアルの描画が続くので、Submit で省ける状態の設定が増えます。同じ状態の中では手前から描画します。
+	class DrawKey
+	{
+	public:
+		static const uint32_t MaxPass = 15;
+
+		// material は描画するリソースの組を表す任意の番号 (メッシュの頂点バッファーなど) で、下位 16 ビットを使用します。
+		// depth はビュー空間の奥行き (クリップ座標の w など) です。負の値と NaN は 0 として扱います。
+		static uint64_t Make(uint32_t pass, PipelineHandle pipeline, uint32_t material, float depth)
+		{
+			// 0 以上の float のビット列は、値と同じ順に並びます。
+			uint32_t depthBits = 0;
+			if (depth > 0.0f)
+			{
+				memcpy(&depthBits, &depth, sizeof(depthBits));
+			}
+
+			return (static_cast<uint64_t>(pass < MaxPass ? pass : MaxPass) << 60) |
+				(static_cast<uint64_t>(pipeline & 0xFFF) << 48) |
+				(static_cast<uint64_t>(material & 0xFFFF) << 32) |
+				depthBits;
+		}
+
+		static uint32_t GetPass(uint64_t key)				{ return static_cast<uint32_t>(key >> 60); }
+		static PipelineHandle GetPipeline(uint64_t key)		{ return static_cast<PipelineHandle>((key >> 48) & 0xFFF); }
+	};
+
+	// 同じリソースで続けて描画するインデックスの範囲。DrawPacket の indexCount, startIndex, baseVertex に相当します。
+	struct DrawRange
+	{
+		uint32_t indexCount;
+		uint32_t startIndex;
+		int32_t baseVertex;
+	};
+
+	// RenderBackend::AllocateTransient で確保した、現在のフレームだけ有効な領域。
+	struct TransientAllocation
+	{
+		BufferHandle buffer;
+		uint32_t offset;	// buffer の中の位置 (バイト)。
+		void* data;			// 書き込み先。Submit までに書き込みます。
+	};
+
+	// 描画コマンドを記録する線形のリスト。バックエンドの状態に触れないので、別々のリストをワーカー スレッドで同時に記録できます。
+	// 記録したリストは RenderBackend::Submit で順に実行します。
+	class CommandList
+	{
+	public:
+		struct Command
+		{
+			enum Type
+			{
+				Clear,
+				UpdateBuffer,
+				Viewport,
+				Draw,
+				DrawBatch
+			};
+
+			Type type;
+			union
+			{
+				struct
+				{
+					float color[4];
+					float depth;
+				} clear;
+
+				struct
+				{
+					BufferHandle buffer;
+					uint32_t offset;		// GetData の中の位置。
+					uint32_t size;
+				} update;
+
+				// 描画先の左上を原点とする画素単位の矩形。
+				struct
+				{
+					float x;
+					float y;
+					float width;
+					float height;
+				} viewport;
+
+				DrawPacket draw;
+
+				// packet のリソースを 1 回だけ設定して、各範囲を描画します。packet の範囲の値は使用しません。
+				struct
+				{
+					DrawPacket packet;
+					uint32_t rangeOffset;	// GetData の中の DrawRange の配列の位置。
+					uint32_t rangeCount;
+				} batch;
+			};
+		};
+
+		// 記録をすべて消します。確保したメモリは次のフレームで再利用します。
+		void Reset();
+
+		// 描画先の色 (RGBA) と深度をクリアします。ビューポートによらず全体をクリアします。
+		void Clear(const float color[4], float depth);
+
+		// 以降の描画のビューポートを設定します。各リストの先頭では描画先の全体です。
+		void SetViewport(float x, float y, float width, float height);
+
+		// バッファーの内容を置き換えます。data はリストにコピーされるので、呼び出しの後に変更してかまいません。
+		void UpdateBuffer(BufferHandle buffer, const void* data, uint32_t size);
+
+		// sortKey は Sort で使用する DrawKey です。
+		void Draw(const DrawPacket& packet, uint64_t sortKey = 0);
+
+		// 同じリソースで複数の範囲を描画します。ranges はリストにコピーされます。
+		void DrawBatch(const DrawPacket& packet, const DrawRange* ranges, uint32_t count, uint64_t sortKey = 0);
+
+		// Clear、UpdateBuffer、SetViewport の間に記録した描画を、それぞれ sortKey の昇順に並べ替えます。
+		// これらのコマンドは記録した位置に残るので、バッファーの更新やビューポートと描画の前後関係は変わりません。同じキーの描画は記録した順です。
+		void Sort();
+
+		size_t GetCommandCount() const					{ return m_commands.size(); }
+		const Command& GetCommand(size_t index) const	{ return m_commands[index]; }
+		uint64_t GetSortKey(size_t index) const			{ return m_keys[index]; }
+		const uint8_t* GetData() const					{ return m_data.data(); }
+
+		const DrawRange* GetRanges(const Command& command) const
+		{
+			return reinterpret_cast<const DrawRange*>(m_data.data() + command.batch.rangeOffset);
+		}
+
+	private:
+		void AddCommand(const Command& command, uint64_t sortKey);
+
+		std::vector<Command>	m_commands;
+		std::vector<uint64_t>	m_keys;		// コマンドごとの並べ替えキー。描画以外は 0 です。
+		std::vector<uint8_t>	m_data;
+
+		// Sort の作業用の領域。
+		std::vector<uint64_t>	m_sortKeys;
+		std::vector<uint32_t>	m_sortOrder;
+		std::vector<uint64_t>	m_sortKeyScratch;
+		std::vector<uint32_t>	m_sortOrderScratch;
+		std::vector<Command>	m_sortedCommands;
+	};
+
+	// 直前の Submit の統計。
+	struct SubmitStatistics
+	{
+		uint32_t	draws;				// 描画の呼び出しの数。DrawBatch は範囲ごとに数えます。
+		uint32_t	stateChanges;		// 実際に設定した状態の数。状態は BoundState::Group の単位で数えます。
+		uint32_t	redundantStates;	// 直前の描画と同じため、設定を省いた状態の数。
+		double		submitMilliseconds;	// Submit の CPU 時間。
+	};
+
+	// 直前の描画で設定した状態。Submit で、前の描画と同じ状態の設定を省くために使用します。
+	class BoundState
+	{
+	public:
+		enum Group
+		{
+			PipelineGroup = 1,			// 入力レイアウト、シェーダー、ラスタライザーの状態。
+			VertexBufferGroup = 2,		// 頂点バッファーとインスタンスのバッファー。
+			IndexBufferGroup = 4,
+			FrameConstantGroup = 8,		// 定数バッファーのスロット 0。
+			ObjectConstantGroup = 16,	// 定数バッファーのスロット 1。
+			AllGroups = 31
+		};
+
+		static const uint32_t GroupCount = 5;
+
+		BoundState() : m_valid(false) {}
+
+		// 以前の状態を無効にします。次の Bind はすべての状態を設定します。
+		void Reset()	{ m_valid = false; }
+
+		// packet を設定したものとして記録し、直前と異なる状態の Group の組み合わせを返します。statistics の数を更新します。
+		uint32_t Bind(const DrawPacket& packet, SubmitStatistics* statistics);
+
+	private:
+		DrawPacket	m_packet;
+		bool		m_valid;
+	};
+
+	// Direct3D 11 と CPU のラスタライザーに共通の描画インターフェイス。
+	// リソースの作成、BeginFrame と Submit は描画スレッドから呼び出します。
+	// フレームごとに変わるジオメトリや定数は、CreateBuffer ではなく AllocateTransient で確保したリング バッファーの領域に書き込みます。
+	// リングの領域は FramesInFlight フレーム前の描画の完了を待ってから再利用するので、再確保や GPU との競合がありません。
+	class RenderBackend
+	{
+	public:
+		// 同時に処理中にできるフレーム数。
+		static const uint32_t FramesInFlight = 3;
+
+		// リング バッファーの容量 (バイト)。FramesInFlight フレーム分の領域を含みます。
+		static const uint32_t TransientVertexCapacity = 48 * 1024 * 1024;
+		static const uint32_t TransientIndexCapacity = 24 * 1024 * 1024;
+		static const uint32_t TransientConstantCapacity = 1024 * 1024;
+
+		// 定数バッファーの範囲の位置の単位 (バイト)。AllocateTransient は定数をこの倍数に揃えます。
+		static const uint32_t ConstantAlignment = 256;
+
+		RenderBackend() : m_statistics() {}
+		virtual ~RenderBackend() {}
+
+		virtual BufferHandle CreateBuffer(const BufferDescription& description) = 0;
+		virtual void DestroyBuffer(BufferHandle buffer) = 0;
+
+		virtual PipelineHandle CreatePipeline(const PipelineDescription& description) = 0;
+		virtual void DestroyPipeline(PipelineHandle pipeline) = 0;
+
+		// 32 ビットのインデックスで描画できるかどうか。Direct3D の機能レベル 9_1 は 16 ビットだけに対応します。
+		virtual bool SupportsIndex32() const = 0;
+
+		// インスタンス化した描画ができるかどうか。Direct3D の機能レベル 9_1 と 9_2 は対応しません。
+		virtual bool SupportsInstancing() const = 0;
+
+		// フレームを開始します。FramesInFlight フレーム前の描画の完了を待ち、そのリングの領域を再利用できるようにします。
+		virtual void BeginFrame() = 0;
+
+		// BeginFrame から Submit までの間だけ有効な領域をリング バッファーに確保します。ワーカー スレッドから呼び出せます。
+		// 頂点は alignment に頂点の大きさを指定すると、offset / vertexStride を DrawPacket::baseVertex に使用できます。
+		// インデックスは offset / インデックスの大きさを DrawPacket::startIndex に加えます。定数は ConstantAlignment の倍数に揃えます。
+		// リングに空きがない場合は false を返します。
+		virtual bool AllocateTransient(BufferDescription::Usage usage, uint32_t size, uint32_t alignment, TransientAllocation* allocation) = 0;
+
+		// 記録したリストを順に実行して、フレームの描画先に描画し、フレームを終了します。
+		// リング バッファーは UpdateBuffer では更新できません。
+		virtual void Submit(const CommandList* const* lists, size_t count) = 0;
+
+		void Submit(const CommandList& list)
+		{
+			const CommandList* lists[1] = { &list };
+			Submit(lists, 1);
+		}
+
+		// 直前の Submit の描画の数、状態の設定の数と時間。
+		const SubmitStatistics& GetStatistics() const	{ return m_statistics; }
+
+	protected:
+		SubmitStatistics m_statistics;
+	};
+}
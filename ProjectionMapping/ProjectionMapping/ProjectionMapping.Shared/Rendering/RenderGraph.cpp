@@ -0,0 +1,400 @@
+﻿#include "RenderGraph.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 書き込んだパスがない版、前の版がない版、実行の順に入らないリソースを表す番号。
+	const uint32_t NoPass = 0xFFFFFFFF;
+	const uint32_t NoVersion = 0xFFFFFFFF;
+	const uint32_t NoPosition = 0xFFFFFFFF;
+}
+
+RenderGraph::RenderGraph() :
+	m_valid(true)
+{
+}
+
+void RenderGraph::Reset()
+{
+	m_resources.clear();
+	m_versions.clear();
+	m_passes.clear();
+	m_accesses.clear();
+	m_order.clear();
+	m_positions.clear();
+	m_physicals.clear();
+	m_valid = true;
+}
+
+RenderGraph::ResourceHandle RenderGraph::CreateTransient(const char* name, const RenderTargetDescription& description)
+{
+	Resource resource = { name, description, false, NoPosition, NoPosition, NoPhysical };
+	m_resources.push_back(resource);
+
+	Version version = { static_cast<uint32_t>(m_resources.size() - 1), NoPass, NoVersion, false, false };
+	m_versions.push_back(version);
+	return static_cast<ResourceHandle>(m_versions.size());
+}
+
+RenderGraph::ResourceHandle RenderGraph::Import(const char* name)
+{
+	const RenderTargetDescription description = { 0, 0, RenderTargetDescription::Color };
+	const ResourceHandle handle = CreateTransient(name, description);
+	m_resources.back().imported = true;
+	return handle;
+}
+
+RenderGraph::PassHandle RenderGraph::AddPass(const char* name, const ExecuteFunction& execute)
+{
+	Pass pass = { name, execute, false };
+	m_passes.push_back(pass);
+	return static_cast<PassHandle>(m_passes.size());
+}
+
+void RenderGraph::Read(PassHandle pass, ResourceHandle resource)
+{
+	if (pass == InvalidHandle || pass > m_passes.size() || resource == InvalidHandle || resource > m_versions.size())
+	{
+		m_valid = false;
+		return;
+	}
+
+	Access access = { pass - 1, resource - 1, false };
+	m_accesses.push_back(access);
+}
+
+RenderGraph::ResourceHandle RenderGraph::Write(PassHandle pass, ResourceHandle resource)
+{
+	if (pass == InvalidHandle || pass > m_passes.size() || resource == InvalidHandle || resource > m_versions.size())
+	{
+		m_valid = false;
+		return InvalidHandle;
+	}
+
+	// 1 つの版に 2 つのパスが書き込むと、どちらの結果を後のパスが読むか決まりません。
+	Version& previous = m_versions[resource - 1];
+	if (previous.superseded)
+	{
+		m_valid = false;
+	}
+	previous.superseded = true;
+
+	Version version = { previous.resource, pass - 1, resource - 1, false, false };
+	m_versions.push_back(version);
+
+	Access access = { pass - 1, static_cast<uint32_t>(m_versions.size() - 1), true };
+	m_accesses.push_back(access);
+	return static_cast<ResourceHandle>(m_versions.size());
+}
+
+void RenderGraph::MarkOutput(ResourceHandle resource)
+{
+	if (resource == InvalidHandle || resource > m_versions.size())
+	{
+		m_valid = false;
+		return;
+	}
+	m_versions[resource - 1].output = true;
+}
+
+bool RenderGraph::Compile()
+{
+	m_order.clear();
+	m_positions.assign(m_passes.size(), NoPosition);
+	m_physicals.clear();
+	for (Resource& resource : m_resources)
+	{
+		resource.firstUse = NoPosition;
+		resource.lastUse = NoPosition;
+		resource.physical = NoPhysical;
+	}
+
+	if (!m_valid)
+	{
+		return false;
+	}
+
+	// 書き込まれていない一時的なターゲットは内容が不定なので、読むことはできません。
+	for (const Access& access : m_accesses)
+	{
+		const Version& version = m_versions[access.version];
+		if (!access.write && version.producer == NoPass && !m_resources[version.resource].imported)
+		{
+			return false;
+		}
+	}
+
+	CullPasses();
+	if (!SortPasses())
+	{
+		m_order.clear();
+		m_positions.assign(m_passes.size(), NoPosition);
+		return false;
+	}
+	AssignPhysicals();
+	return true;
+}
+
+// 出力の版を書き込んだパスから、読む版を書き込んだパスへ逆にたどり、たどれたパスだけを残します。
+void RenderGraph::CullPasses()
+{
+	const uint32_t versionCount = static_cast<uint32_t>(m_versions.size());
+
+	// 版ごとに、その版を読むパスを並べます。
+	m_readerOffsets.assign(versionCount + 1, 0);
+	for (const Access& access : m_accesses)
+	{
+		if (!access.write)
+		{
+			m_readerOffsets[access.version + 1]++;
+		}
+	}
+	for (uint32_t v = 0; v < versionCount; v++)
+	{
+		m_readerOffsets[v + 1] += m_readerOffsets[v];
+	}
+	m_readers.resize(m_readerOffsets[versionCount]);
+	m_stack.assign(m_readerOffsets.begin(), m_readerOffsets.end() - 1);
+	for (const Access& access : m_accesses)
+	{
+		if (!access.write)
+		{
+			m_readers[m_stack[access.version]++] = access.pass;
+		}
+	}
+
+	for (Pass& pass : m_passes)
+	{
+		pass.active = false;
+	}
+
+	m_stack.clear();
+	for (const Version& version : m_versions)
+	{
+		if (version.output && version.producer != NoPass && !m_passes[version.producer].active)
+		{
+			m_passes[version.producer].active = true;
+			m_stack.push_back(version.producer);
+		}
+	}
+
+	while (!m_stack.empty())
+	{
+		const uint32_t pass = m_stack.back();
+		m_stack.pop_back();
+
+		for (const Access& access : m_accesses)
+		{
+			if (access.pass != pass || access.write)
+			{
+				continue;
+			}
+
+			const uint32_t producer = m_versions[access.version].producer;
+			if (producer != NoPass && !m_passes[producer].active)
+			{
+				m_passes[producer].active = true;
+				m_stack.push_back(producer);
+			}
+		}
+	}
+}
+
+// 残したパスを依存関係の順に並べます。実行できるパスが複数ある場合は、先に宣言したパスを選びます。
+bool RenderGraph::SortPasses()
+{
+	const uint32_t passCount = static_cast<uint32_t>(m_passes.size());
+
+	// 読む版を書き込んだパス、上書きする版を書き込んだパスと読んだパスを先に実行します。
+	m_edges.clear();
+	for (const Access& access : m_accesses)
+	{
+		if (!m_passes[access.pass].active)
+		{
+			continue;
+		}
+
+		const Version& version = m_versions[access.version];
+		if (!access.write)
+		{
+			if (version.producer != NoPass && version.producer != access.pass)
+			{
+				m_edges.push_back(version.producer);
+				m_edges.push_back(access.pass);
+			}
+			continue;
+		}
+
+		if (version.previous == NoVersion)
+		{
+			continue;
+		}
+
+		const uint32_t previousProducer = m_versions[version.previous].producer;
+		if (previousProducer != NoPass && previousProducer != access.pass && m_passes[previousProducer].active)
+		{
+			m_edges.push_back(previousProducer);
+			m_edges.push_back(access.pass);
+		}
+		for (uint32_t r = m_readerOffsets[version.previous]; r < m_readerOffsets[version.previous + 1]; r++)
+		{
+			const uint32_t reader = m_readers[r];
+			if (reader != access.pass && m_passes[reader].active)
+			{
+				m_edges.push_back(reader);
+				m_edges.push_back(access.pass);
+			}
+		}
+	}
+
+	// パスごとに後に実行するパスを並べ、先に実行するパスの数を数えます。
+	m_successorOffsets.assign(passCount + 1, 0);
+	m_pendingCounts.assign(passCount, 0);
+	for (size_t e = 0; e < m_edges.size(); e += 2)
+	{
+		m_successorOffsets[m_edges[e] + 1]++;
+		m_pendingCounts[m_edges[e + 1]]++;
+	}
+	for (uint32_t p = 0; p < passCount; p++)
+	{
+		m_successorOffsets[p + 1] += m_successorOffsets[p];
+	}
+	m_successors.resize(m_edges.size() / 2);
+	m_stack.assign(m_successorOffsets.begin(), m_successorOffsets.end() - 1);
+	for (size_t e = 0; e < m_edges.size(); e += 2)
+	{
+		m_successors[m_stack[m_edges[e]]++] = m_edges[e + 1];
+	}
+
+	// 実行できるパスを添字の小さい順に取り出します (最小ヒープ)。
+	uint32_t activeCount = 0;
+	m_stack.clear();
+	for (uint32_t p = 0; p < passCount; p++)
+	{
+		if (m_passes[p].active)
+		{
+			activeCount++;
+			if (m_pendingCounts[p] == 0)
+			{
+				m_stack.push_back(p);
+			}
+		}
+	}
+	std::make_heap(m_stack.begin(), m_stack.end(), std::greater<uint32_t>());
+
+	while (!m_stack.empty())
+	{
+		std::pop_heap(m_stack.begin(), m_stack.end(), std::greater<uint32_t>());
+		const uint32_t pass = m_stack.back();
+		m_stack.pop_back();
+
+		m_positions[pass] = static_cast<uint32_t>(m_order.size());
+		m_order.push_back(pass);
+
+		for (uint32_t s = m_successorOffsets[pass]; s < m_successorOffsets[pass + 1]; s++)
+		{
+			const uint32_t successor = m_successors[s];
+			if (--m_pendingCounts[successor] == 0)
+			{
+				m_stack.push_back(successor);
+				std::push_heap(m_stack.begin(), m_stack.end(), std::greater<uint32_t>());
+			}
+		}
+	}
+
+	// 残ったパスは循環の中にあります。
+	return m_order.size() == activeCount;
+}
+
+// 一時的なターゲットを最初に使用する順に調べ、寿命が終わった同じ形式の実体があれば再利用します。
+void RenderGraph::AssignPhysicals()
+{
+	for (const Access& access : m_accesses)
+	{
+		const uint32_t position = m_positions[access.pass];
+		if (position == NoPosition)
+		{
+			continue;
+		}
+
+		Resource& resource = m_resources[m_versions[access.version].resource];
+		if (resource.firstUse == NoPosition || position < resource.firstUse)
+		{
+			resource.firstUse = position;
+		}
+		if (resource.lastUse == NoPosition || position > resource.lastUse)
+		{
+			resource.lastUse = position;
+		}
+	}
+
+	m_resourceOrder.clear();
+	for (uint32_t r = 0; r < m_resources.size(); r++)
+	{
+		if (!m_resources[r].imported && m_resources[r].firstUse != NoPosition)
+		{
+			m_resourceOrder.push_back(r);
+		}
+	}
+
+	const std::vector<Resource>& resources = m_resources;
+	std::stable_sort(m_resourceOrder.begin(), m_resourceOrder.end(), [&resources](uint32_t a, uint32_t b)
+	{
+		return resources[a].firstUse < resources[b].firstUse;
+	});
+
+	for (uint32_t r : m_resourceOrder)
+	{
+		Resource& resource = m_resources[r];
+
+		// 同じパスの中で使用する 2 つのターゲットは、実体を共有できません。
+		uint32_t physical = NoPhysical;
+		for (uint32_t p = 0; p < m_physicals.size(); p++)
+		{
+			if (m_physicals[p].description == resource.description && m_physicals[p].lastUse < resource.firstUse)
+			{
+				physical = p;
+				break;
+			}
+		}
+
+		if (physical == NoPhysical)
+		{
+			Physical created = { resource.description, resource.lastUse };
+			m_physicals.push_back(created);
+			physical = static_cast<uint32_t>(m_physicals.size() - 1);
+		}
+		m_physicals[physical].lastUse = resource.lastUse;
+		resource.physical = physical;
+	}
+}
+
+void RenderGraph::Execute() const
+{
+	for (uint32_t pass : m_order)
+	{
+		const ExecuteFunction& execute = m_passes[pass].execute;
+		if (execute)
+		{
+			execute(*this);
+		}
+	}
+}
+
+bool RenderGraph::IsPassActive(PassHandle pass) const
+{
+	return pass != InvalidHandle && pass <= m_passes.size() && m_positions.size() == m_passes.size() && m_positions[pass - 1] != NoPosition;
+}
+
+uint32_t RenderGraph::GetPhysicalIndex(ResourceHandle resource) const
+{
+	if (resource == InvalidHandle || resource > m_versions.size())
+	{
+		return NoPhysical;
+	}
+	return m_resources[m_versions[resource - 1].resource].physical;
+}
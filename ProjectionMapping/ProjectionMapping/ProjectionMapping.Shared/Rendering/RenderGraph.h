@@ -0,0 +1,152 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "RenderBackend.h"
+
+namespace ProjectionMapping
+{
+	// レンダー グラフが管理するレンダリング ターゲットの形式と大きさ。
+	struct RenderTargetDescription
+	{
+		enum Format
+		{
+			Color,			// 出力 (バック バッファー) と同じ形式の色。
+			DepthStencil
+		};
+
+		uint32_t width;
+		uint32_t height;
+		Format format;
+
+		bool operator==(const RenderTargetDescription& other) const
+		{
+			return width == other.width && height == other.height && format == other.format;
+		}
+	};
+
+	// フレームのパスと、パスが読み書きするレンダリング ターゲットを宣言し、依存関係から実行の順を決めます。
+	// 毎フレーム Reset から宣言し直し、Compile で次のことを行います。
+	// ・出力に必要なパスだけを残し、結果を使われないパスを取り除きます (カリング)。
+	// ・読み書きの依存関係から実行の順を決めます。依存関係のないパスは宣言した順です。
+	// ・一時的なターゲットの寿命 (最初と最後に使用するパス) を求め、寿命が重ならない同じ形式のターゲットに同じ実体を割り当てます (エイリアシング)。
+	// 実体の作成はグラフの利用者が行います。GetPhysicalCount と GetPhysicalDescription の実体を用意し、GetPhysicalIndex で引きます。
+	// 書き込みはリソースの新しい版を返します。後のパスはその版を読むので、同じリソースへの書き込みの順序も依存関係で決まります。
+	class RenderGraph
+	{
+	public:
+		// リソースの版とパスの番号。0 は無効です。
+		typedef uint32_t ResourceHandle;
+		typedef uint32_t PassHandle;
+
+		// パスの処理。Execute で実行の順に呼び出します。
+		typedef std::function<void(const RenderGraph& graph)> ExecuteFunction;
+
+		RenderGraph();
+
+		// 前のフレームの宣言を消去します。作業用の領域は再利用します。
+		void Reset();
+
+		// フレームの中だけで使用するターゲットを宣言します。最初に書き込むまで内容は不定です。
+		ResourceHandle CreateTransient(const char* name, const RenderTargetDescription& description);
+
+		// グラフの外で作成したリソース (バック バッファーなど) を宣言します。実体は割り当てません。
+		ResourceHandle Import(const char* name);
+
+		PassHandle AddPass(const char* name, const ExecuteFunction& execute);
+
+		// pass が resource の版を読むことを宣言します。
+		void Read(PassHandle pass, ResourceHandle resource);
+
+		// pass が resource に書き込むことを宣言し、書き込み後の版を返します。前の内容を使う場合は Read も宣言します。
+		ResourceHandle Write(PassHandle pass, ResourceHandle resource);
+
+		// フレームの結果として残す版を指定します。この版を作るのに必要なパスだけを実行します。
+		void MarkOutput(ResourceHandle resource);
+
+		// カリング、順序付け、実体の割り当てを行います。依存関係が循環している場合や、書き込まれていない一時的なターゲットを読む場合は false を返します。
+		bool Compile();
+
+		// Compile で残したパスを順に実行します。
+		void Execute() const;
+
+		// Compile の結果。
+		bool IsPassActive(PassHandle pass) const;
+		size_t GetPassCount() const						{ return m_passes.size(); }
+		size_t GetActivePassCount() const				{ return m_order.size(); }
+		const char* GetPassName(PassHandle pass) const	{ return m_passes[pass - 1].name; }
+
+		// 一時的なターゲットの実体。同じ実体を複数のターゲットが共有します。
+		size_t GetPhysicalCount() const											{ return m_physicals.size(); }
+		const RenderTargetDescription& GetPhysicalDescription(size_t index) const	{ return m_physicals[index].description; }
+
+		// resource の版が使用する実体の添字を返します。インポートしたリソースと、カリングで使われなくなったターゲットは NoPhysical です。
+		uint32_t GetPhysicalIndex(ResourceHandle resource) const;
+
+		static const uint32_t NoPhysical = 0xFFFFFFFF;
+
+	private:
+		struct Resource
+		{
+			const char*					name;
+			RenderTargetDescription		description;
+			bool						imported;
+			uint32_t					firstUse;	// 実行の順の位置。使われない場合は NoPosition です。
+			uint32_t					lastUse;
+			uint32_t					physical;
+		};
+
+		struct Version
+		{
+			uint32_t	resource;
+			uint32_t	producer;	// 書き込んだパス。最初の版は NoPass です。
+			uint32_t	previous;	// 同じリソースの前の版。最初の版は NoVersion です。
+			bool		output;
+			bool		superseded;	// この版に書き込んだ次の版があります。
+		};
+
+		struct Pass
+		{
+			const char*			name;
+			ExecuteFunction		execute;
+			bool				active;
+		};
+
+		struct Access
+		{
+			uint32_t	pass;
+			uint32_t	version;
+			bool		write;
+		};
+
+		struct Physical
+		{
+			RenderTargetDescription		description;
+			uint32_t					lastUse;
+		};
+
+		void CullPasses();
+		bool SortPasses();
+		void AssignPhysicals();
+
+		std::vector<Resource>	m_resources;
+		std::vector<Version>	m_versions;
+		std::vector<Pass>		m_passes;
+		std::vector<Access>		m_accesses;
+		bool					m_valid;	// 宣言に誤りがない場合は true です。
+
+		// Compile の作業用の領域と結果。
+		std::vector<uint32_t>	m_readerOffsets;		// 版ごとの m_readers の範囲。
+		std::vector<uint32_t>	m_readers;				// 版を読むパス。
+		std::vector<uint32_t>	m_edges;				// 先に実行するパスと後に実行するパスの組。
+		std::vector<uint32_t>	m_successorOffsets;		// パスごとの m_successors の範囲。
+		std::vector<uint32_t>	m_successors;
+		std::vector<uint32_t>	m_pendingCounts;		// まだ実行の順に入っていない、先に実行するパスの数。
+		std::vector<uint32_t>	m_stack;
+		std::vector<uint32_t>	m_order;				// 実行するパスの添字。
+		std::vector<uint32_t>	m_positions;			// パスごとの実行の順の位置。
+		std::vector<uint32_t>	m_resourceOrder;
+		std::vector<Physical>	m_physicals;
+	};
+}
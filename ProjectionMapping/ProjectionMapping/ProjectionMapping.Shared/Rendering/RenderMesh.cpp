@@ -0,0 +1,269 @@
+﻿#include "RenderMesh.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 機能レベル 9_1 で 1 回の描画に使用できる三角形の数。
+	const uint32_t MaxTrianglesWithoutIndex32 = 65535;
+
+	const uint32_t NoMeshlet = 0xFFFFFFFF;
+
+	// インスタンスの変換を並列化する単位。
+	const size_t InstanceChunkSize = 1024;
+}
+
+RenderMesh::RenderMesh() :
+	m_vertexBuffer(InvalidHandle),
+	m_indexBuffer(InvalidHandle),
+	m_indexFormat(DrawPacket::Index16),
+	m_vertexBytes(0),
+	m_indexBytes(0)
+{
+}
+
+void RenderMesh::Create(RenderBackend* backend, const TriangleMesh& mesh, IndexMode mode)
+{
+	Release(backend);
+
+	const uint32_t vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+	if (vertexCount == 0 || triangleCount == 0)
+	{
+		return;
+	}
+
+	const bool index32 = backend->SupportsIndex32();
+	const uint32_t maxTriangles = index32 ? std::numeric_limits<uint32_t>::max() : MaxTrianglesWithoutIndex32;
+
+	std::vector<MeshVertex> meshletVertices;
+	std::vector<uint16_t> indices16;
+	const MeshVertex* vertices = mesh.vertices.data();
+	const void* indices;
+	uint32_t indexSize;
+
+	if (vertexCount <= MaxIndex16Vertices && triangleCount <= maxTriangles)
+	{
+		indices16.assign(mesh.indices.begin(), mesh.indices.begin() + triangleCount * 3);
+
+		DrawRange range = { triangleCount * 3, 0, 0 };
+		m_ranges.push_back(range);
+		m_indexFormat = DrawPacket::Index16;
+		indices = indices16.data();
+		indexSize = sizeof(uint16_t);
+	}
+	else if (index32 && mode == AutoIndex)
+	{
+		DrawRange range = { triangleCount * 3, 0, 0 };
+		m_ranges.push_back(range);
+		m_indexFormat = DrawPacket::Index32;
+		indices = mesh.indices.data();
+		indexSize = sizeof(uint32_t);
+	}
+	else
+	{
+		BuildMeshlets(mesh, MaxIndex16Vertices, maxTriangles, &meshletVertices, &indices16, &m_ranges);
+		m_indexFormat = DrawPacket::Index16;
+		vertices = meshletVertices.data();
+		indices = indices16.data();
+		indexSize = sizeof(uint16_t);
+	}
+
+	const uint32_t bufferVertexCount = meshletVertices.empty() ? vertexCount : static_cast<uint32_t>(meshletVertices.size());
+	m_vertexBytes = bufferVertexCount * sizeof(MeshVertex);
+	m_indexBytes = triangleCount * 3 * indexSize;
+
+	BufferDescription vertexBufferDesc;
+	vertexBufferDesc.usage = BufferDescription::Vertex;
+	vertexBufferDesc.size = m_vertexBytes;
+	vertexBufferDesc.initialData = vertices;
+	m_vertexBuffer = backend->CreateBuffer(vertexBufferDesc);
+
+	BufferDescription indexBufferDesc;
+	indexBufferDesc.usage = BufferDescription::Index;
+	indexBufferDesc.size = m_indexBytes;
+	indexBufferDesc.initialData = indices;
+	m_indexBuffer = backend->CreateBuffer(indexBufferDesc);
+}
+
+void RenderMesh::Release(RenderBackend* backend)
+{
+	if (m_vertexBuffer != InvalidHandle)
+	{
+		backend->DestroyBuffer(m_vertexBuffer);
+		backend->DestroyBuffer(m_indexBuffer);
+	}
+	Reset();
+}
+
+void RenderMesh::Reset()
+{
+	m_vertexBuffer = InvalidHandle;
+	m_indexBuffer = InvalidHandle;
+	m_ranges.clear();
+	m_vertexBytes = 0;
+	m_indexBytes = 0;
+}
+
+void RenderMesh::Record(CommandList* commands, const DrawPacket& material, uint64_t sortKey) const
+{
+	if (!IsValid())
+	{
+		return;
+	}
+
+	DrawPacket packet = material;
+	packet.vertexBuffer = m_vertexBuffer;
+	packet.indexBuffer = m_indexBuffer;
+	packet.vertexStride = sizeof(MeshVertex);
+	packet.indexFormat = m_indexFormat;
+
+	if (m_ranges.size() == 1)
+	{
+		packet.indexCount = m_ranges[0].indexCount;
+		packet.startIndex = m_ranges[0].startIndex;
+		packet.baseVertex = m_ranges[0].baseVertex;
+		commands->Draw(packet, sortKey);
+	}
+	else
+	{
+		commands->DrawBatch(packet, m_ranges.data(), static_cast<uint32_t>(m_ranges.size()), sortKey);
+	}
+}
+
+bool RenderMesh::RecordInstances(RenderBackend* backend, CommandList* commands, const DrawPacket& material, const InstanceTransforms& instances) const
+{
+	return RecordInstances(backend, commands, material, instances, nullptr, instances.GetCount());
+}
+
+bool RenderMesh::RecordInstances(RenderBackend* backend, CommandList* commands, const DrawPacket& material, const InstanceTransforms& instances, const uint32_t* indices, size_t count, uint64_t sortKey) const
+{
+	const size_t instanceCount = count;
+	if (!IsValid() || instanceCount == 0)
+	{
+		return true;
+	}
+
+	if (!backend->SupportsInstancing())
+	{
+		return false;
+	}
+
+	TransientAllocation allocation;
+	if (!backend->AllocateTransient(BufferDescription::Vertex, static_cast<uint32_t>(instanceCount * sizeof(InstanceData)), sizeof(InstanceData), &allocation))
+	{
+		return false;
+	}
+
+	// リングへの書き込みはこのフレームで 1 回だけです。大きな配列はスレッドに分けます。
+	InstanceData* output = static_cast<InstanceData*>(allocation.data);
+	const size_t chunks = (instanceCount + InstanceChunkSize - 1) / InstanceChunkSize;
+	DX::ParallelFor(0, chunks, [&](size_t chunk)
+	{
+		const size_t begin = chunk * InstanceChunkSize;
+		const size_t end = std::min(begin + InstanceChunkSize, instanceCount);
+		if (indices != nullptr)
+		{
+			instances.Gather(indices + begin, end - begin, output + begin);
+		}
+		else
+		{
+			instances.Write(begin, end, output + begin);
+		}
+	});
+
+	DrawPacket packet = material;
+	packet.instanceBuffer = allocation.buffer;
+	packet.instanceOffset = allocation.offset;
+	packet.instanceCount = static_cast<uint32_t>(instanceCount);
+	Record(commands, packet, sortKey);
+	return true;
+}
+
+void RenderMesh::BuildMeshlets(
+	const TriangleMesh& mesh,
+	uint32_t maxVertices,
+	uint32_t maxTriangles,
+	std::vector<MeshVertex>* vertices,
+	std::vector<uint16_t>* indices,
+	std::vector<DrawRange>* ranges
+	)
+{
+	vertices->clear();
+	indices->clear();
+	ranges->clear();
+
+	const size_t triangleCount = mesh.indices.size() / 3;
+	if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0)
+	{
+		return;
+	}
+
+	if (maxVertices > MaxIndex16Vertices)
+	{
+		maxVertices = MaxIndex16Vertices;
+	}
+
+	vertices->reserve(mesh.vertices.size() + mesh.vertices.size() / 16);
+	indices->reserve(triangleCount * 3);
+
+	// 頂点がどのメッシュレットで何番目に置かれたか。メッシュレットが変わると番号が一致しなくなるので、クリアは不要です。
+	std::vector<uint32_t> owner(mesh.vertices.size(), NoMeshlet);
+	std::vector<uint16_t> local(mesh.vertices.size());
+
+	uint32_t meshlet = 0;
+	uint32_t baseVertex = 0;
+	uint32_t startIndex = 0;
+	uint32_t meshletVertexCount = 0;
+	uint32_t meshletTriangleCount = 0;
+
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* triangle = &mesh.indices[t * 3];
+
+		// 三角形が新しく加える頂点の数。同じ頂点を繰り返す縮退した三角形は 1 回だけ数えます。
+		uint32_t newVertices = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t index = triangle[k];
+			if (owner[index] != meshlet && (k < 1 || index != triangle[0]) && (k < 2 || index != triangle[1]))
+			{
+				newVertices++;
+			}
+		}
+
+		// 入りきらない場合は、ここまでをメッシュレットとして閉じます。
+		if (meshletVertexCount + newVertices > maxVertices || meshletTriangleCount == maxTriangles)
+		{
+			DrawRange range = { meshletTriangleCount * 3, startIndex, static_cast<int32_t>(baseVertex) };
+			ranges->push_back(range);
+
+			meshlet++;
+			baseVertex += meshletVertexCount;
+			startIndex += meshletTriangleCount * 3;
+			meshletVertexCount = 0;
+			meshletTriangleCount = 0;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t index = triangle[k];
+			if (owner[index] != meshlet)
+			{
+				owner[index] = meshlet;
+				local[index] = static_cast<uint16_t>(meshletVertexCount++);
+				vertices->push_back(mesh.vertices[index]);
+			}
+			indices->push_back(local[index]);
+		}
+		meshletTriangleCount++;
+	}
+
+	DrawRange range = { meshletTriangleCount * 3, startIndex, static_cast<int32_t>(baseVertex) };
+	ranges->push_back(range);
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "InstanceTransforms.h"
+#include "RenderBackend.h"
+#include "../Reconstruction/TriangleMesh.h"
+
+namespace ProjectionMapping
+{
+	// TriangleMesh の頂点とインデックスをバックエンドのバッファーに置き、描画を記録します。
+	// 65536 頂点以下のメッシュは 16 ビットのインデックスで 1 回で描画します。それより大きいメッシュは 32 ビットのインデックスで描画するか、
+	// 65536 頂点以下の 16 ビットのメッシュレットに分割して、同じリソースのまとまった描画 (CommandList::DrawBatch) で描画します。
+	// メッシュレットはインデックスの帯域が半分になる代わりに、境界の頂点が重複します。
+	class RenderMesh
+	{
+	public:
+		// 16 ビットのインデックスで参照できる頂点数。
+		static const uint32_t MaxIndex16Vertices = 65536;
+
+		enum IndexMode
+		{
+			AutoIndex,		// 32 ビットのインデックスに対応しない場合だけメッシュレットに分割します。
+			MeshletIndex	// 16 ビットで参照できない場合は常にメッシュレットに分割します。
+		};
+
+		RenderMesh();
+
+		// mesh のバッファーを作成します。以前のバッファーは破棄します。
+		void Create(RenderBackend* backend, const TriangleMesh& mesh, IndexMode mode);
+
+		// バッファーを破棄します。
+		void Release(RenderBackend* backend);
+
+		// デバイスが失われたときに、破棄せずに番号を無効にします。
+		void Reset();
+
+		// material のパイプラインと定数バッファーで描画を記録します。sortKey は CommandList::Sort の順序です (DrawKey)。
+		void Record(CommandList* commands, const DrawPacket& material, uint64_t sortKey = 0) const;
+
+		// instances をこのフレームのリング バッファーに書き込み、すべてのインスタンスを 1 回の描画で記録します。
+		// material のパイプラインは PositionColorInstance の頂点レイアウトで作成します。
+		// バックエンドがインスタンス化に対応しない場合や、リングに空きがない場合は false を返します。
+		bool RecordInstances(RenderBackend* backend, CommandList* commands, const DrawPacket& material, const InstanceTransforms& instances) const;
+
+		// instances のうち indices[0..count) のインスタンスだけを詰めて書き込み、1 回の描画で記録します。indices が nullptr の場合は先頭の count 個です。
+		bool RecordInstances(RenderBackend* backend, CommandList* commands, const DrawPacket& material, const InstanceTransforms& instances, const uint32_t* indices, size_t count, uint64_t sortKey = 0) const;
+
+		bool IsValid() const							{ return m_vertexBuffer != InvalidHandle; }
+		BufferHandle GetVertexBuffer() const			{ return m_vertexBuffer; }
+		DrawPacket::IndexFormat GetIndexFormat() const	{ return m_indexFormat; }
+		uint32_t GetDrawCount() const					{ return static_cast<uint32_t>(m_ranges.size()); }
+		uint32_t GetVertexBytes() const					{ return m_vertexBytes; }
+		uint32_t GetIndexBytes() const					{ return m_indexBytes; }
+
+		// 頂点数が maxVertices 以下、三角形数が maxTriangles 以下になるように三角形を順に分け、メッシュレットごとに頂点を並べ直します。
+		// ranges の baseVertex を加えると、16 ビットのインデックスが vertices の位置になります。
+		static void BuildMeshlets(
+			const TriangleMesh& mesh,
+			uint32_t maxVertices,
+			uint32_t maxTriangles,
+			std::vector<MeshVertex>* vertices,
+			std::vector<uint16_t>* indices,
+			std::vector<DrawRange>* ranges
+			);
+
+	private:
+		BufferHandle			m_vertexBuffer;
+		BufferHandle			m_indexBuffer;
+		DrawPacket::IndexFormat	m_indexFormat;
+		std::vector<DrawRange>	m_ranges;
+		uint32_t				m_vertexBytes;
+		uint32_t				m_indexBytes;
+	};
+}
@@ -0,0 +1,747 @@
+﻿#include "SoftwareRasterizer.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PROJECTIONMAPPING_RASTER_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PROJECTIONMAPPING_RASTER_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 画面座標の小数部のビット数。Direct3D のラスタライザーと同じ 8 ビットです。
+	const int32_t SubpixelBits = 8;
+	const int32_t SubpixelScale = 1 << SubpixelBits;
+	const int32_t SubpixelHalf = SubpixelScale / 2;
+
+	// 画面の外に広げるガード バンド (正規化デバイス座標)。これを超える三角形だけをクリップします。
+	// 描画先が 4096 画素でも、サブピクセル座標が float で正確に表せる 2^24 に収まります。
+	const float GuardBand = 8.0f;
+
+	// 1 つのビンにまとめる三角形の数。
+	const uint32_t TrianglesPerBin = 4096;
+
+	// 頂点変換を並列化する単位。
+	const uint32_t VertexChunkSize = 4096;
+
+	// クリップ平面 (近、遠、ガード バンドの左右上下) で切り取った多角形の最大の頂点数。
+	const int ClipPlaneCount = 6;
+	const int MaxClipVertices = 3 + ClipPlaneCount;
+
+	inline int32_t FloorDivide(int64_t value, int32_t divisor)
+	{
+		int64_t quotient = value / divisor;
+		if (value % divisor != 0 && value < 0)
+		{
+			quotient--;
+		}
+		return static_cast<int32_t>(quotient);
+	}
+
+	// 平面の内側で正になる距離。
+	inline float ClipDistance(const float* p, int plane)
+	{
+		switch (plane)
+		{
+		case 0:		return p[2];
+		case 1:		return p[3] - p[2];
+		case 2:		return GuardBand * p[3] + p[0];
+		case 3:		return GuardBand * p[3] - p[0];
+		case 4:		return GuardBand * p[3] + p[1];
+		default:	return GuardBand * p[3] - p[1];
+		}
+	}
+
+	inline uint32_t ToChannel(float value)
+	{
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		return static_cast<uint32_t>(value * 255.0f + 0.5f);
+	}
+
+	// 4 画素分の float とマスクの演算。ISA ごとの違いをここに閉じ込めて、ラスタライズの本体を 1 つにします。
+#if defined(PROJECTIONMAPPING_RASTER_SSE2)
+	typedef __m128 Float4;
+	typedef __m128 Mask4;
+
+	inline Float4 Splat(float value)						{ return _mm_set1_ps(value); }
+	inline Float4 Lanes(float a, float b, float c, float d)	{ return _mm_setr_ps(a, b, c, d); }
+	inline Float4 Load(const float* p)						{ return _mm_loadu_ps(p); }
+	inline Float4 Add(Float4 a, Float4 b)					{ return _mm_add_ps(a, b); }
+	inline Float4 Multiply(Float4 a, Float4 b)				{ return _mm_mul_ps(a, b); }
+	inline Float4 Reciprocal(Float4 a)						{ return _mm_div_ps(_mm_set1_ps(1.0f), a); }
+	inline Mask4 Greater(Float4 a, Float4 b)				{ return _mm_cmpgt_ps(a, b); }
+	inline Mask4 GreaterEqual(Float4 a, Float4 b)			{ return _mm_cmpge_ps(a, b); }
+	inline Mask4 Less(Float4 a, Float4 b)					{ return _mm_cmplt_ps(a, b); }
+	inline Mask4 And(Mask4 a, Mask4 b)						{ return _mm_and_ps(a, b); }
+	inline bool Any(Mask4 mask)								{ return _mm_movemask_ps(mask) != 0; }
+
+	inline void StoreMasked(float* p, Float4 value, Mask4 mask)
+	{
+		_mm_storeu_ps(p, _mm_or_ps(_mm_and_ps(mask, value), _mm_andnot_ps(mask, _mm_loadu_ps(p))));
+	}
+
+	// 0..1 の色を BGRA8 にして、マスクの画素だけを書き込みます。
+	inline void StoreColor(uint32_t* p, Float4 r, Float4 g, Float4 b, Mask4 mask)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 scale = _mm_set1_ps(255.0f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		__m128i ri = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(r, zero), one), scale), half));
+		__m128i gi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(g, zero), one), scale), half));
+		__m128i bi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(b, zero), one), scale), half));
+		__m128i pixels = _mm_or_si128(_mm_or_si128(bi, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(ri, 16), _mm_set1_epi32(static_cast<int>(0xFF000000))));
+
+		__m128i* destination = reinterpret_cast<__m128i*>(p);
+		__m128i m = _mm_castps_si128(mask);
+		_mm_storeu_si128(destination, _mm_or_si128(_mm_and_si128(m, pixels), _mm_andnot_si128(m, _mm_loadu_si128(destination))));
+	}
+#elif defined(PROJECTIONMAPPING_RASTER_NEON)
+	typedef float32x4_t Float4;
+	typedef uint32x4_t Mask4;
+
+	inline Float4 Splat(float value)						{ return vdupq_n_f32(value); }
+	inline Float4 Lanes(float a, float b, float c, float d)	{ const float lanes[4] = { a, b, c, d }; return vld1q_f32(lanes); }
+	inline Float4 Load(const float* p)						{ return vld1q_f32(p); }
+	inline Float4 Add(Float4 a, Float4 b)					{ return vaddq_f32(a, b); }
+	inline Float4 Multiply(Float4 a, Float4 b)				{ return vmulq_f32(a, b); }
+	inline Mask4 Greater(Float4 a, Float4 b)				{ return vcgtq_f32(a, b); }
+	inline Mask4 GreaterEqual(Float4 a, Float4 b)			{ return vcgeq_f32(a, b); }
+	inline Mask4 Less(Float4 a, Float4 b)					{ return vcltq_f32(a, b); }
+	inline Mask4 And(Mask4 a, Mask4 b)						{ return vandq_u32(a, b); }
+
+	// ARMv7 には除算がないので、逆数の近似を Newton 法で 2 回改善します。
+	inline Float4 Reciprocal(Float4 a)
+	{
+		float32x4_t estimate = vrecpeq_f32(a);
+		estimate = vmulq_f32(vrecpsq_f32(a, estimate), estimate);
+		return vmulq_f32(vrecpsq_f32(a, estimate), estimate);
+	}
+
+	inline bool Any(Mask4 mask)
+	{
+		uint32x2_t folded = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+		return (vget_lane_u32(folded, 0) | vget_lane_u32(folded, 1)) != 0;
+	}
+
+	inline void StoreMasked(float* p, Float4 value, Mask4 mask)
+	{
+		vst1q_f32(p, vbslq_f32(mask, value, vld1q_f32(p)));
+	}
+
+	inline void StoreColor(uint32_t* p, Float4 r, Float4 g, Float4 b, Mask4 mask)
+	{
+		const float32x4_t zero = vdupq_n_f32(0.0f);
+		const float32x4_t one = vdupq_n_f32(1.0f);
+		const float32x4_t scale = vdupq_n_f32(255.0f);
+		const float32x4_t half = vdupq_n_f32(0.5f);
+		uint32x4_t ri = vcvtq_u32_f32(vmlaq_f32(half, vminq_f32(vmaxq_f32(r, zero), one), scale));
+		uint32x4_t gi = vcvtq_u32_f32(vmlaq_f32(half, vminq_f32(vmaxq_f32(g, zero), one), scale));
+		uint32x4_t bi = vcvtq_u32_f32(vmlaq_f32(half, vminq_f32(vmaxq_f32(b, zero), one), scale));
+		uint32x4_t pixels = vorrq_u32(vorrq_u32(bi, vshlq_n_u32(gi, 8)), vorrq_u32(vshlq_n_u32(ri, 16), vdupq_n_u32(0xFF000000)));
+		vst1q_u32(p, vbslq_u32(mask, pixels, vld1q_u32(p)));
+	}
+#else
+	struct Float4
+	{
+		float v[4];
+	};
+
+	struct Mask4
+	{
+		bool v[4];
+	};
+
+	inline Float4 Splat(float value)						{ Float4 r = { { value, value, value, value } }; return r; }
+	inline Float4 Lanes(float a, float b, float c, float d)	{ Float4 r = { { a, b, c, d } }; return r; }
+	inline Float4 Load(const float* p)						{ Float4 r = { { p[0], p[1], p[2], p[3] } }; return r; }
+
+	inline Float4 Add(Float4 a, Float4 b)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			a.v[i] += b.v[i];
+		}
+		return a;
+	}
+
+	inline Float4 Multiply(Float4 a, Float4 b)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			a.v[i] *= b.v[i];
+		}
+		return a;
+	}
+
+	inline Float4 Reciprocal(Float4 a)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			a.v[i] = 1.0f / a.v[i];
+		}
+		return a;
+	}
+
+	inline Mask4 Greater(Float4 a, Float4 b)
+	{
+		Mask4 m;
+		for (int i = 0; i < 4; i++)
+		{
+			m.v[i] = a.v[i] > b.v[i];
+		}
+		return m;
+	}
+
+	inline Mask4 GreaterEqual(Float4 a, Float4 b)
+	{
+		Mask4 m;
+		for (int i = 0; i < 4; i++)
+		{
+			m.v[i] = a.v[i] >= b.v[i];
+		}
+		return m;
+	}
+
+	inline Mask4 Less(Float4 a, Float4 b)
+	{
+		Mask4 m;
+		for (int i = 0; i < 4; i++)
+		{
+			m.v[i] = a.v[i] < b.v[i];
+		}
+		return m;
+	}
+
+	inline Mask4 And(Mask4 a, Mask4 b)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			a.v[i] = a.v[i] && b.v[i];
+		}
+		return a;
+	}
+
+	inline bool Any(Mask4 mask)								{ return mask.v[0] || mask.v[1] || mask.v[2] || mask.v[3]; }
+
+	inline void StoreMasked(float* p, Float4 value, Mask4 mask)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			if (mask.v[i])
+			{
+				p[i] = value.v[i];
+			}
+		}
+	}
+
+	inline void StoreColor(uint32_t* p, Float4 r, Float4 g, Float4 b, Mask4 mask)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			if (mask.v[i])
+			{
+				p[i] = ToChannel(b.v[i]) | (ToChannel(g.v[i]) << 8) | (ToChannel(r.v[i]) << 16) | 0xFF000000;
+			}
+		}
+	}
+#endif
+
+	inline Float4 Interpolate(Float4 l0, Float4 l1, Float4 l2, float a0, float a1, float a2)
+	{
+		return Add(Add(Multiply(l0, Splat(a0)), Multiply(l1, Splat(a1))), Multiply(l2, Splat(a2)));
+	}
+}
+
+SoftwareRasterizer::SoftwareRasterizer() :
+	m_width(0),
+	m_height(0),
+	m_stride(0),
+	m_tilesX(0),
+	m_tilesY(0),
+	m_cullMode(CullBack),
+	m_binCount(0)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		m_colorScale[k] = 1.0f;
+	}
+
+	m_transform = Matrix::Identity().ToFloat4x4();
+	SetViewport(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
+void SoftwareRasterizer::SetRenderTargetSize(uint32_t width, uint32_t height)
+{
+	m_binCount = 0;
+	m_width = std::min(width, 4096u);
+	m_height = std::min(height, 4096u);
+	m_tilesX = (m_width + TileSize - 1) / TileSize;
+	m_tilesY = (m_height + TileSize - 1) / TileSize;
+	SetViewport(0.0f, 0.0f, static_cast<float>(m_width), static_cast<float>(m_height));
+
+	// 4 画素単位の読み書きがタイルの外にはみ出さないように、タイルの大きさに切り上げて確保します。
+	m_stride = m_tilesX * TileSize;
+	const size_t pixelCount = static_cast<size_t>(m_stride) * m_tilesY * TileSize;
+	m_color.resize(pixelCount);
+	m_depth.resize(pixelCount);
+}
+
+void SoftwareRasterizer::SetViewport(float x, float y, float width, float height)
+{
+	m_viewport[0] = x;
+	m_viewport[1] = y;
+	m_viewport[2] = width;
+	m_viewport[3] = height;
+}
+
+void SoftwareRasterizer::SetColorScale(const float scale[3])
+{
+	for (int k = 0; k < 3; k++)
+	{
+		m_colorScale[k] = scale[k];
+	}
+}
+
+void SoftwareRasterizer::Clear(const float color[4], float depth)
+{
+	Flush();
+
+	const uint32_t pixel = ToChannel(color[2]) | (ToChannel(color[1]) << 8) | (ToChannel(color[0]) << 16) | (ToChannel(color[3]) << 24);
+	const uint32_t rows = m_tilesY * TileSize;
+	const uint32_t stride = m_stride;
+
+	DX::ParallelFor(0, m_tilesY, [&](size_t tileY)
+	{
+		const size_t begin = tileY * TileSize * static_cast<size_t>(stride);
+		const size_t end = std::min(static_cast<size_t>(rows), (tileY + 1) * TileSize) * stride;
+		std::fill(m_color.begin() + begin, m_color.begin() + end, pixel);
+		std::fill(m_depth.begin() + begin, m_depth.begin() + end, depth);
+	});
+}
+
+void SoftwareRasterizer::DrawIndexed(const MeshVertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount)
+{
+	Record(vertices, vertexCount, indices, indexCount);
+}
+
+void SoftwareRasterizer::DrawIndexed(const MeshVertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+	Record(vertices, vertexCount, indices, indexCount);
+}
+
+template<typename TIndex>
+void SoftwareRasterizer::Record(const MeshVertex* vertices, uint32_t vertexCount, const TIndex* indices, uint32_t indexCount)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	if (m_width == 0 || m_height == 0 || triangleCount == 0 || vertexCount == 0)
+	{
+		return;
+	}
+
+	// 1. 頂点をクリップ座標に変換します。
+	m_clipVertices.resize(vertexCount);
+	const Matrix m = Matrix::Load(m_transform);
+	const float* colorScale = m_colorScale;
+	const uint32_t vertexChunks = (vertexCount + VertexChunkSize - 1) / VertexChunkSize;
+	DX::ParallelFor(0, vertexChunks, [&](size_t chunk)
+	{
+		const uint32_t begin = static_cast<uint32_t>(chunk) * VertexChunkSize;
+		const uint32_t end = std::min(begin + VertexChunkSize, vertexCount);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const float* p = vertices[i].position;
+			ClipVertex& v = m_clipVertices[i];
+			m.TransformPoint(Vector::Load3(p, 1.0f)).Store(v.position);
+			v.color[0] = vertices[i].color[0] * colorScale[0];
+			v.color[1] = vertices[i].color[1] * colorScale[1];
+			v.color[2] = vertices[i].color[2] * colorScale[2];
+		}
+	});
+
+	// 2. 三角形をビンごとに準備して、タイルに振り分けます。ビンの順が描画の順になります。
+	const uint32_t binCount = (triangleCount + TrianglesPerBin - 1) / TrianglesPerBin;
+	if (m_bins.size() < m_binCount + binCount)
+	{
+		m_bins.resize(m_binCount + binCount);
+	}
+
+	DX::ParallelFor(0, binCount, [&](size_t b)
+	{
+		Bin& bin = m_bins[m_binCount + b];
+		bin.triangles.clear();
+
+		const uint32_t begin = static_cast<uint32_t>(b) * TrianglesPerBin;
+		const uint32_t end = std::min(begin + TrianglesPerBin, triangleCount);
+		for (uint32_t t = begin; t < end; t++)
+		{
+			const uint32_t i0 = indices[t * 3];
+			const uint32_t i1 = indices[t * 3 + 1];
+			const uint32_t i2 = indices[t * 3 + 2];
+			if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount)
+			{
+				continue;
+			}
+			SetupTriangle(m_clipVertices[i0], m_clipVertices[i1], m_clipVertices[i2], &bin.triangles);
+		}
+
+		BinTriangles(&bin);
+	});
+
+	m_binCount += binCount;
+}
+
+// 近と遠のクリップ面とガード バンドで三角形を切り取ります。ほとんどの三角形はそのまま通ります。
+void SoftwareRasterizer::SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, std::vector<Triangle>* triangles) const
+{
+	const ClipVertex* input[3] = { &a, &b, &c };
+	uint32_t outside[3] = { 0, 0, 0 };
+	for (int v = 0; v < 3; v++)
+	{
+		for (int plane = 0; plane < ClipPlaneCount; plane++)
+		{
+			if (ClipDistance(input[v]->position, plane) < 0.0f)
+			{
+				outside[v] |= 1u << plane;
+			}
+		}
+	}
+
+	if ((outside[0] & outside[1] & outside[2]) != 0)
+	{
+		return;
+	}
+
+	if ((outside[0] | outside[1] | outside[2]) == 0)
+	{
+		const ClipVertex v[3] = { a, b, c };
+		AddTriangle(v, triangles);
+		return;
+	}
+
+	// Sutherland-Hodgman 法で多角形を切り取り、扇形に三角形分割します。
+	ClipVertex polygon[2][MaxClipVertices];
+	polygon[0][0] = a;
+	polygon[0][1] = b;
+	polygon[0][2] = c;
+	int count = 3;
+	int current = 0;
+
+	const uint32_t planes = outside[0] | outside[1] | outside[2];
+	for (int plane = 0; plane < ClipPlaneCount && count >= 3; plane++)
+	{
+		if (!(planes & (1u << plane)))
+		{
+			continue;
+		}
+
+		const ClipVertex* source = polygon[current];
+		ClipVertex* destination = polygon[current ^ 1];
+		int clipped = 0;
+		for (int i = 0; i < count; i++)
+		{
+			const ClipVertex& p = source[i];
+			const ClipVertex& q = source[(i + 1) % count];
+			const float dp = ClipDistance(p.position, plane);
+			const float dq = ClipDistance(q.position, plane);
+
+			if (dp >= 0.0f)
+			{
+				destination[clipped++] = p;
+			}
+
+			if ((dp >= 0.0f) != (dq >= 0.0f))
+			{
+				const float t = dp / (dp - dq);
+				ClipVertex& r = destination[clipped++];
+				for (int k = 0; k < 4; k++)
+				{
+					r.position[k] = p.position[k] + t * (q.position[k] - p.position[k]);
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					r.color[k] = p.color[k] + t * (q.color[k] - p.color[k]);
+				}
+			}
+		}
+		count = clipped;
+		current ^= 1;
+	}
+
+	for (int i = 1; i + 1 < count; i++)
+	{
+		const ClipVertex v[3] = { polygon[current][0], polygon[current][i], polygon[current][i + 1] };
+		AddTriangle(v, triangles);
+	}
+}
+
+void SoftwareRasterizer::AddTriangle(const ClipVertex* v, std::vector<Triangle>* triangles) const
+{
+	Triangle triangle;
+	const float originX = m_viewport[0] * SubpixelScale;
+	const float originY = m_viewport[1] * SubpixelScale;
+	const float halfWidth = 0.5f * m_viewport[2] * SubpixelScale;
+	const float halfHeight = 0.5f * m_viewport[3] * SubpixelScale;
+
+	for (int i = 0; i < 3; i++)
+	{
+		const float inverseW = 1.0f / v[i].position[3];
+		triangle.x[i] = static_cast<int32_t>(std::floor(originX + (v[i].position[0] * inverseW + 1.0f) * halfWidth + 0.5f));
+		triangle.y[i] = static_cast<int32_t>(std::floor(originY + (1.0f - v[i].position[1] * inverseW) * halfHeight + 0.5f));
+		triangle.z[i] = v[i].position[2] * inverseW;
+		triangle.inverseW[i] = inverseW;
+		for (int k = 0; k < 3; k++)
+		{
+			triangle.color[i][k] = v[i].color[k] * inverseW;
+		}
+	}
+
+	// 画面は y が下向きなので、時計回りの三角形で面積が正になります。
+	int64_t area =
+		static_cast<int64_t>(triangle.y[2] - triangle.y[0]) * (triangle.x[1] - triangle.x[0]) -
+		static_cast<int64_t>(triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+	if (area == 0)
+	{
+		return;
+	}
+
+	const bool front = area > 0;
+	if ((m_cullMode == CullBack && !front) || (m_cullMode == CullFront && front))
+	{
+		return;
+	}
+
+	// 裏向きの三角形は頂点を入れ替えて、常に時計回りで扱います。
+	if (!front)
+	{
+		std::swap(triangle.x[1], triangle.x[2]);
+		std::swap(triangle.y[1], triangle.y[2]);
+		std::swap(triangle.z[1], triangle.z[2]);
+		std::swap(triangle.inverseW[1], triangle.inverseW[2]);
+		for (int k = 0; k < 3; k++)
+		{
+			std::swap(triangle.color[1][k], triangle.color[2][k]);
+		}
+		area = -area;
+	}
+
+	// 画素の中心がビューポートの中にある画素の範囲。
+	const int32_t viewportMinX = std::max(0, static_cast<int32_t>(std::ceil(m_viewport[0] - 0.5f)));
+	const int32_t viewportMinY = std::max(0, static_cast<int32_t>(std::ceil(m_viewport[1] - 0.5f)));
+	const int32_t viewportMaxX = std::min(static_cast<int32_t>(m_width), static_cast<int32_t>(std::ceil(m_viewport[0] + m_viewport[2] - 0.5f))) - 1;
+	const int32_t viewportMaxY = std::min(static_cast<int32_t>(m_height), static_cast<int32_t>(std::ceil(m_viewport[1] + m_viewport[3] - 0.5f))) - 1;
+
+	// 画素の中心が三角形の範囲にある画素の範囲。
+	const int32_t minX = std::min(std::min(triangle.x[0], triangle.x[1]), triangle.x[2]);
+	const int32_t minY = std::min(std::min(triangle.y[0], triangle.y[1]), triangle.y[2]);
+	const int32_t maxX = std::max(std::max(triangle.x[0], triangle.x[1]), triangle.x[2]);
+	const int32_t maxY = std::max(std::max(triangle.y[0], triangle.y[1]), triangle.y[2]);
+	const int32_t pixelMinX = std::max(viewportMinX, FloorDivide(static_cast<int64_t>(minX) - SubpixelHalf + SubpixelScale - 1, SubpixelScale));
+	const int32_t pixelMinY = std::max(viewportMinY, FloorDivide(static_cast<int64_t>(minY) - SubpixelHalf + SubpixelScale - 1, SubpixelScale));
+	const int32_t pixelMaxX = std::min(viewportMaxX, FloorDivide(static_cast<int64_t>(maxX) - SubpixelHalf, SubpixelScale));
+	const int32_t pixelMaxY = std::min(viewportMaxY, FloorDivide(static_cast<int64_t>(maxY) - SubpixelHalf, SubpixelScale));
+	if (pixelMinX > pixelMaxX || pixelMinY > pixelMaxY)
+	{
+		return;
+	}
+
+	triangle.minX = static_cast<uint16_t>(pixelMinX);
+	triangle.minY = static_cast<uint16_t>(pixelMinY);
+	triangle.maxX = static_cast<uint16_t>(pixelMaxX);
+	triangle.maxY = static_cast<uint16_t>(pixelMaxY);
+	triangle.inverseArea = static_cast<float>(1.0 / static_cast<double>(area));
+
+	// トップレフト規則。時計回りでは、上の辺は右向きの水平な辺、左の辺は上向きの辺です。
+	triangle.topLeft = 0;
+	for (int e = 0; e < 3; e++)
+	{
+		const int32_t dx = triangle.x[(e + 1) % 3] - triangle.x[e];
+		const int32_t dy = triangle.y[(e + 1) % 3] - triangle.y[e];
+		if ((dy == 0 && dx > 0) || dy < 0)
+		{
+			triangle.topLeft |= 1u << e;
+		}
+	}
+
+	triangles->push_back(triangle);
+}
+
+// ビンの三角形を、範囲が重なるタイルごとに数え上げソートで並べます。
+void SoftwareRasterizer::BinTriangles(Bin* bin) const
+{
+	const uint32_t tileCount = m_tilesX * m_tilesY;
+	bin->tileOffsets.assign(tileCount + 1, 0);
+
+	const size_t count = bin->triangles.size();
+	for (size_t t = 0; t < count; t++)
+	{
+		const Triangle& triangle = bin->triangles[t];
+		for (uint32_t tileY = triangle.minY / TileSize; tileY <= triangle.maxY / TileSize; tileY++)
+		{
+			for (uint32_t tileX = triangle.minX / TileSize; tileX <= triangle.maxX / TileSize; tileX++)
+			{
+				bin->tileOffsets[tileY * m_tilesX + tileX + 1]++;
+			}
+		}
+	}
+
+	for (uint32_t tile = 0; tile < tileCount; tile++)
+	{
+		bin->tileOffsets[tile + 1] += bin->tileOffsets[tile];
+	}
+
+	bin->tileTriangles.resize(bin->tileOffsets[tileCount]);
+	std::vector<uint32_t> cursor(bin->tileOffsets.begin(), bin->tileOffsets.end() - 1);
+	for (size_t t = 0; t < count; t++)
+	{
+		const Triangle& triangle = bin->triangles[t];
+		for (uint32_t tileY = triangle.minY / TileSize; tileY <= triangle.maxY / TileSize; tileY++)
+		{
+			for (uint32_t tileX = triangle.minX / TileSize; tileX <= triangle.maxX / TileSize; tileX++)
+			{
+				bin->tileTriangles[cursor[tileY * m_tilesX + tileX]++] = static_cast<uint32_t>(t);
+			}
+		}
+	}
+}
+
+void SoftwareRasterizer::Flush()
+{
+	if (m_binCount == 0)
+	{
+		return;
+	}
+
+	// タイルは互いに重ならないので、タイル単位で並列に描画できます。タイル内は記録した順に描画します。
+	DX::ParallelFor(0, m_tilesX * m_tilesY, [&](size_t tile)
+	{
+		RasterizeTile(static_cast<uint32_t>(tile) % m_tilesX, static_cast<uint32_t>(tile) / m_tilesX);
+	});
+
+	m_binCount = 0;
+}
+
+void SoftwareRasterizer::RasterizeTile(uint32_t tileX, uint32_t tileY)
+{
+	const uint32_t tile = tileY * m_tilesX + tileX;
+	for (size_t b = 0; b < m_binCount; b++)
+	{
+		const Bin& bin = m_bins[b];
+		const uint32_t begin = bin.tileOffsets[tile];
+		const uint32_t end = bin.tileOffsets[tile + 1];
+		for (uint32_t i = begin; i < end; i++)
+		{
+			RasterizeTriangle(bin.triangles[bin.tileTriangles[i]], tileX, tileY);
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const Triangle& triangle, uint32_t tileX, uint32_t tileY)
+{
+	const uint32_t originX = tileX * TileSize;
+	const uint32_t originY = tileY * TileSize;
+	const uint32_t x0 = std::max<uint32_t>(triangle.minX, originX);
+	const uint32_t y0 = std::max<uint32_t>(triangle.minY, originY);
+	const uint32_t x1 = std::min<uint32_t>(triangle.maxX, originX + TileSize - 1);
+	const uint32_t y1 = std::min<uint32_t>(triangle.maxY, originY + TileSize - 1);
+	if (x0 > x1 || y0 > y1)
+	{
+		return;
+	}
+
+	// エッジ関数はタイルの原点の画素中心で int64 で求めてから float に丸め、そこからの差分を float で足します。
+	// 丸めるので値そのものは正確ではありませんが、float への丸めも加算も符号について対称なので、逆向きの辺では
+	// 原点の値も差分も各画素の値も符号が反転するだけです。そのため辺を共有する三角形の判定は必ず相補的になります。
+	const int64_t sampleX = static_cast<int64_t>(originX) * SubpixelScale + SubpixelHalf;
+	const int64_t sampleY = static_cast<int64_t>(originY) * SubpixelScale + SubpixelHalf;
+
+	float edgeOrigin[3];
+	float stepX[3];
+	float stepY[3];
+	for (int e = 0; e < 3; e++)
+	{
+		const int32_t ax = triangle.x[e];
+		const int32_t ay = triangle.y[e];
+		const int32_t bx = triangle.x[(e + 1) % 3];
+		const int32_t by = triangle.y[(e + 1) % 3];
+		edgeOrigin[e] = static_cast<float>((sampleY - ay) * (bx - ax) - (sampleX - ax) * (by - ay));
+		stepX[e] = static_cast<float>(ay - by) * SubpixelScale;
+		stepY[e] = static_cast<float>(bx - ax) * SubpixelScale;
+
+		// 範囲の角のうちエッジ関数が最大になる点でも外側なら、このタイルには画素がありません。
+		const float dx = static_cast<float>(stepX[e] > 0.0f ? x1 - originX : x0 - originX);
+		const float dy = static_cast<float>(stepY[e] > 0.0f ? y1 - originY : y0 - originY);
+		if (edgeOrigin[e] + stepY[e] * dy + stepX[e] * dx < 0.0f)
+		{
+			return;
+		}
+	}
+
+	const bool topLeft0 = (triangle.topLeft & 1) != 0;
+	const bool topLeft1 = (triangle.topLeft & 2) != 0;
+	const bool topLeft2 = (triangle.topLeft & 4) != 0;
+	const float inverseArea = triangle.inverseArea;
+	const Float4 zero = Splat(0.0f);
+	const Float4 stepX0 = Splat(stepX[0]);
+	const Float4 stepX1 = Splat(stepX[1]);
+	const Float4 stepX2 = Splat(stepX[2]);
+
+	// 4 画素の組はタイルの中で 4 の倍数の位置から始めます。範囲外の画素はエッジ関数で除外されます。
+	const uint32_t groupBegin = x0 & ~3u;
+	for (uint32_t y = y0; y <= y1; y++)
+	{
+		const float dy = static_cast<float>(y - originY);
+		const float row0 = edgeOrigin[0] + stepY[0] * dy;
+		const float row1 = edgeOrigin[1] + stepY[1] * dy;
+		const float row2 = edgeOrigin[2] + stepY[2] * dy;
+		const size_t rowOffset = static_cast<size_t>(y) * m_stride;
+
+		for (uint32_t x = groupBegin; x <= x1; x += 4)
+		{
+			const float dx = static_cast<float>(x - originX);
+			const Float4 offset = Lanes(dx, dx + 1.0f, dx + 2.0f, dx + 3.0f);
+			const Float4 e0 = Add(Splat(row0), Multiply(stepX0, offset));
+			const Float4 e1 = Add(Splat(row1), Multiply(stepX1, offset));
+			const Float4 e2 = Add(Splat(row2), Multiply(stepX2, offset));
+
+			Mask4 mask = And(
+				And(topLeft0 ? GreaterEqual(e0, zero) : Greater(e0, zero), topLeft1 ? GreaterEqual(e1, zero) : Greater(e1, zero)),
+				topLeft2 ? GreaterEqual(e2, zero) : Greater(e2, zero));
+			if (!Any(mask))
+			{
+				continue;
+			}
+
+			// 辺 e の向かいの頂点の重みは、辺 e のエッジ関数を面積で割ったものです。
+			const Float4 area = Splat(inverseArea);
+			const Float4 l0 = Multiply(e1, area);
+			const Float4 l1 = Multiply(e2, area);
+			const Float4 l2 = Multiply(e0, area);
+
+			// 深度は画面上で線形に補間します。
+			float* depth = &m_depth[rowOffset + x];
+			const Float4 z = Interpolate(l0, l1, l2, triangle.z[0], triangle.z[1], triangle.z[2]);
+			mask = And(mask, Less(z, Load(depth)));
+			if (!Any(mask))
+			{
+				continue;
+			}
+			StoreMasked(depth, z, mask);
+
+			// 色は 1/w で遠近補正します。
+			const Float4 inverseW = Reciprocal(Interpolate(l0, l1, l2, triangle.inverseW[0], triangle.inverseW[1], triangle.inverseW[2]));
+			const Float4 r = Multiply(Interpolate(l0, l1, l2, triangle.color[0][0], triangle.color[1][0], triangle.color[2][0]), inverseW);
+			const Float4 g = Multiply(Interpolate(l0, l1, l2, triangle.color[0][1], triangle.color[1][1], triangle.color[2][1]), inverseW);
+			const Float4 b = Multiply(Interpolate(l0, l1, l2, triangle.color[0][2], triangle.color[1][2], triangle.color[2][2]), inverseW);
+			StoreColor(&m_color[rowOffset + x], r, g, b, mask);
+		}
+	}
+}
@@ -0,0 +1,120 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../Math/VectorMath.h"
+#include "../Reconstruction/TriangleMesh.h"
+
+namespace ProjectionMapping
+{
+	// Sample3DSceneRenderer と同じパイプライン (MVP による頂点変換、色の補間、深度テスト) を CPU で実行するラスタライザー。
+	// 描画はタイルごとのビンに振り分けておき、Flush でタイルをスレッドに分配して、
+	// 4 画素ずつ SIMD でエッジ関数、深度テスト、色を評価します。
+	// 既定のラスタライザー ステートと同じく、時計回りの三角形を表として裏面を除外し、深度は Less で比較して書き込みます。
+	// 結果はスレッド数によらず同じで、辺を共有する三角形の間に隙間や重なりはできません。
+	class SoftwareRasterizer
+	{
+	public:
+		// タイルの 1 辺 (画素)。
+		static const uint32_t TileSize = 64;
+
+		enum CullMode
+		{
+			CullNone,
+			CullFront,
+			CullBack
+		};
+
+		SoftwareRasterizer();
+
+		// 描画先の大きさを変更します。内容は不定になるので Clear してください。ビューポートは全体に戻ります。
+		void SetRenderTargetSize(uint32_t width, uint32_t height);
+
+		// 以降に記録する描画の、正規化デバイス座標を割り当てる画素単位の矩形。矩形の外の画素には描画しません。
+		void SetViewport(float x, float y, float width, float height);
+
+		void SetCullMode(CullMode mode)						{ m_cullMode = mode; }
+
+		// 頂点シェーダーの定数バッファーと同じく、model, view, projection を掛け合わせた行ベクトル規約の行列です。
+		// v * modelViewProjection で変換します。
+		void SetTransform(const Float4x4& modelViewProjection)	{ m_transform = modelViewProjection; }
+
+		// 頂点の色に掛ける色 (RGB)。インスタンスごとの色に使用します。既定は白です。
+		void SetColorScale(const float scale[3]);
+
+		// 色 (RGBA、0..1) と深度をクリアします。記録済みの描画は先に実行します。
+		void Clear(const float color[4], float depth);
+
+		// 三角形リストを記録します。頂点とインデックスは呼び出しの間だけ参照します。
+		void DrawIndexed(const MeshVertex* vertices, uint32_t vertexCount, const uint16_t* indices, uint32_t indexCount);
+		void DrawIndexed(const MeshVertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+		// 記録した描画をラスタライズします。
+		void Flush();
+
+		uint32_t GetWidth() const							{ return m_width; }
+		uint32_t GetHeight() const							{ return m_height; }
+
+		// BGRA8 の色と深度 (0..1)。行の間隔は GetStride 画素で、Flush の後に参照してください。
+		const uint32_t* GetColorBuffer() const				{ return m_color.data(); }
+		const float* GetDepthBuffer() const					{ return m_depth.data(); }
+		uint32_t GetStride() const							{ return m_stride; }
+
+	private:
+		// 画面座標に変換し、ラスタライズの準備をした三角形。
+		struct Triangle
+		{
+			int32_t x[3], y[3];			// サブピクセル単位の画面座標。
+			float z[3];					// 深度 (z/w)。
+			float inverseW[3];
+			float color[3][3];			// 色/w。
+			float inverseArea;
+			uint16_t minX, minY;		// 画素単位の範囲 (両端を含む)。
+			uint16_t maxX, maxY;
+			uint32_t topLeft;			// 辺ごとのトップレフト規則のフラグ。
+		};
+
+		// 連続する三角形の一群。タイルごとの三角形の番号を数え上げソートで並べます。
+		struct Bin
+		{
+			std::vector<Triangle> triangles;
+			std::vector<uint32_t> tileOffsets;		// タイル数 + 1。
+			std::vector<uint32_t> tileTriangles;
+		};
+
+		// クリップ座標に変換した頂点。
+		struct ClipVertex
+		{
+			float position[4];
+			float color[3];
+		};
+
+		template<typename TIndex>
+		void Record(const MeshVertex* vertices, uint32_t vertexCount, const TIndex* indices, uint32_t indexCount);
+
+		void SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, std::vector<Triangle>* triangles) const;
+		void AddTriangle(const ClipVertex* v, std::vector<Triangle>* triangles) const;
+		void BinTriangles(Bin* bin) const;
+		void RasterizeTile(uint32_t tileX, uint32_t tileY);
+		void RasterizeTriangle(const Triangle& triangle, uint32_t tileX, uint32_t tileY);
+
+		uint32_t				m_width;
+		uint32_t				m_height;
+		uint32_t				m_stride;
+		uint32_t				m_tilesX;
+		uint32_t				m_tilesY;
+		CullMode				m_cullMode;
+		Float4x4				m_transform;
+		float					m_viewport[4];		// x, y, 幅, 高さ。
+		float					m_colorScale[3];
+
+		std::vector<uint32_t>	m_color;
+		std::vector<float>		m_depth;
+
+		// 記録済みの描画。m_binCount までが有効で、後ろはメモリを再利用するために残しておきます。
+		std::vector<Bin>		m_bins;
+		size_t					m_binCount;
+		std::vector<ClipVertex>	m_clipVertices;
+	};
+}
@@ -0,0 +1,65 @@
+﻿#include "UploadRing.h"
+
+using namespace ProjectionMapping;
+
+UploadRing::UploadRing() :
+	m_capacity(0),
+	m_head(0),
+	m_tail(0)
+{
+}
+
+void UploadRing::Reset(uint32_t capacity)
+{
+	m_capacity = capacity;
+	m_head.store(0, std::memory_order_release);
+	m_tail = 0;
+}
+
+bool UploadRing::Allocate(uint32_t size, uint32_t alignment, uint32_t* offset)
+{
+	if (m_capacity == 0 || size > m_capacity)
+	{
+		return false;
+	}
+
+	if (alignment == 0)
+	{
+		alignment = 1;
+	}
+
+	uint64_t head = m_head.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		const uint64_t position = head % m_capacity;
+		uint64_t aligned = (position + alignment - 1) / alignment * alignment;
+		uint64_t start = head + (aligned - position);
+
+		// 末尾をまたぐ場合は、残りを飛ばして先頭から確保します。先頭はどの alignment の倍数でもあります。
+		if (aligned + size > m_capacity)
+		{
+			start = head + (m_capacity - position);
+			aligned = 0;
+		}
+
+		const uint64_t end = start + size;
+		if (end - m_tail > m_capacity)
+		{
+			return false;
+		}
+
+		if (m_head.compare_exchange_weak(head, end, std::memory_order_acq_rel, std::memory_order_relaxed))
+		{
+			*offset = static_cast<uint32_t>(aligned);
+			return true;
+		}
+	}
+}
+
+void UploadRing::Release(uint64_t head)
+{
+	if (head > m_tail)
+	{
+		m_tail = head;
+	}
+}
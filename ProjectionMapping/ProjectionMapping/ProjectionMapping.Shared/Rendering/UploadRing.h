@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace ProjectionMapping
+{
+	// 固定容量のリング バッファーの確保位置を管理します。メモリそのものは持たず、バイト単位の位置だけを返します。
+	// フレームごとに確保した領域は、そのフレームの描画が完了したことをフェンスで確かめてから Release で再利用します。
+	// 位置は単調に増える 64 ビットの値で、容量で割った余りがバッファー内の位置です。
+	class UploadRing
+	{
+	public:
+		UploadRing();
+
+		// 容量を設定し、すべての領域を空きにします。
+		void Reset(uint32_t capacity);
+
+		uint32_t GetCapacity() const	{ return m_capacity; }
+
+		// size バイトを alignment の倍数の位置に確保します。領域がバッファーの末尾をまたぐ場合は先頭から確保します。
+		// 使用中の領域と重なる場合は false を返します。複数のスレッドから同時に呼び出せますが、Release とは同時に呼び出せません。
+		bool Allocate(uint32_t size, uint32_t alignment, uint32_t* offset);
+
+		// これまでに確保した領域の終わり。フレームの終わりに記録して、完了後に Release に渡します。
+		uint64_t GetHead() const		{ return m_head.load(std::memory_order_acquire); }
+
+		// head (GetHead の値) までに確保した領域を再利用できるようにします。
+		void Release(uint64_t head);
+
+		// 使用中のバイト数。末尾をまたいだために飛ばした部分も含みます。
+		uint32_t GetUsedBytes() const	{ return static_cast<uint32_t>(GetHead() - m_tail); }
+
+	private:
+		uint32_t				m_capacity;
+		std::atomic<uint64_t>	m_head;
+		uint64_t				m_tail;
+	};
+}
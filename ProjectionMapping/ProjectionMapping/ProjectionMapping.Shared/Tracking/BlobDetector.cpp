@@ -0,0 +1,319 @@
+﻿#include "BlobDetector.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const uint32_t NoComponent = 0xFFFFFFFF;
+
+	// 1 ストリップの最小の行数。小さすぎると境界のマージが増えます。
+	const uint32_t MinStripRows = 16;
+
+	// 根を探します。経路を書き換えないので、複数のスレッドから同時に呼び出せます。
+	inline uint32_t FindRoot(const uint32_t* parent, uint32_t index)
+	{
+		while (parent[index] != index)
+		{
+			index = parent[index];
+		}
+		return index;
+	}
+
+	// 根を探しながら経路を半分に縮めます。
+	inline uint32_t FindRootCompress(uint32_t* parent, uint32_t index)
+	{
+		while (parent[index] != index)
+		{
+			parent[index] = parent[parent[index]];
+			index = parent[index];
+		}
+		return index;
+	}
+
+	// 番号の小さい方を根にします。ラスター順で最初の画素が常に根になります。
+	inline void Union(uint32_t* parent, uint32_t a, uint32_t b)
+	{
+		a = FindRootCompress(parent, a);
+		b = FindRootCompress(parent, b);
+		if (a < b)
+		{
+			parent[b] = a;
+		}
+		else if (b < a)
+		{
+			parent[a] = b;
+		}
+	}
+}
+
+BlobDetector::BlobDetector() :
+	m_width(0),
+	m_height(0),
+	m_backgroundFrames(0),
+	m_minHeight(40),
+	m_maxHeight(2000),
+	m_minArea(200),
+	m_stripCount(0)
+{
+}
+
+void BlobDetector::SetHeightRange(uint16_t minHeight, uint16_t maxHeight)
+{
+	m_minHeight = minHeight;
+	m_maxHeight = maxHeight;
+}
+
+void BlobDetector::ResetBackground()
+{
+	m_background.clear();
+	m_width = 0;
+	m_height = 0;
+	m_backgroundFrames = 0;
+}
+
+void BlobDetector::AccumulateBackground(const uint16_t* depth, uint32_t width, uint32_t height)
+{
+	if (!depth || width == 0 || height == 0)
+	{
+		return;
+	}
+
+	if (width != m_width || height != m_height)
+	{
+		m_width = width;
+		m_height = height;
+		m_background.assign(static_cast<size_t>(width) * height, 0);
+		m_backgroundFrames = 0;
+	}
+
+	// 深度のノイズで背景が手前に見えないように、最も遠い値を採用します。0 は測定できなかった画素です。
+	const size_t count = m_background.size();
+	for (size_t i = 0; i < count; i++)
+	{
+		m_background[i] = std::max(m_background[i], depth[i]);
+	}
+
+	m_backgroundFrames++;
+}
+
+void BlobDetector::LabelStrip(const uint16_t* depth, uint32_t y0, uint32_t y1)
+{
+	const uint32_t width = m_width;
+	const uint16_t minHeight = m_minHeight;
+	const uint16_t maxHeight = m_maxHeight;
+	uint8_t* mask = m_mask.data();
+	uint32_t* parent = m_parent.data();
+
+	for (uint32_t y = y0; y < y1; y++)
+	{
+		const uint32_t row = y * width;
+
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint32_t i = row + x;
+			const uint16_t d = depth[i];
+			const uint16_t b = m_background[i];
+
+			// 深度と背景の両方が有効で、背景から一定の範囲で手前にある画素が前景です。
+			uint8_t foreground = (d != 0 && b > d && static_cast<uint16_t>(b - d) >= minHeight && static_cast<uint16_t>(b - d) <= maxHeight) ? 1 : 0;
+			mask[i] = foreground;
+			parent[i] = i;
+
+			if (!foreground)
+			{
+				continue;
+			}
+
+			// 4 近傍で左と上 (同じストリップ内のみ) とつなぎます。
+			if (x > 0 && mask[i - 1])
+			{
+				Union(parent, i, i - 1);
+			}
+			if (y > y0 && mask[i - width])
+			{
+				Union(parent, i, i - width);
+			}
+		}
+	}
+}
+
+void BlobDetector::AccumulateStrip(const uint16_t* depth, uint32_t y0, uint32_t y1, Accumulator* accumulators) const
+{
+	const uint32_t width = m_width;
+
+	for (uint32_t y = y0; y < y1; y++)
+	{
+		const uint32_t row = y * width;
+
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint32_t i = row + x;
+			if (!m_mask[i])
+			{
+				continue;
+			}
+
+			Accumulator& a = accumulators[m_component[i]];
+			a.area++;
+			a.sumX += x;
+			a.sumY += y;
+			a.sumDepth += depth[i];
+			a.sumHeight += m_background[i] - depth[i];
+			a.minX = std::min(a.minX, static_cast<uint16_t>(x));
+			a.minY = std::min(a.minY, static_cast<uint16_t>(y));
+			a.maxX = std::max(a.maxX, static_cast<uint16_t>(x));
+			a.maxY = std::max(a.maxY, static_cast<uint16_t>(y));
+		}
+	}
+}
+
+bool BlobDetector::Detect(const uint16_t* depth, uint32_t width, uint32_t height, std::vector<Blob>* blobs)
+{
+	blobs->clear();
+
+	if (!depth || m_backgroundFrames == 0 || width != m_width || height != m_height)
+	{
+		return false;
+	}
+
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	m_mask.resize(pixelCount);
+	m_parent.resize(pixelCount);
+	m_component.resize(pixelCount);
+
+	// ワーカーあたり 2 ストリップにして、負荷の偏りを吸収します。
+	uint32_t stripCount = m_stripCount != 0 ? std::min(m_stripCount, height) : std::max(1u, std::min(DX::GetWorkerCount() * 2, height / MinStripRows));
+	uint32_t stripRows = (height + stripCount - 1) / stripCount;
+	stripCount = (height + stripRows - 1) / stripRows;
+
+	// 1. ストリップごとに前景の抽出とラベリングを行います。ストリップ内の画素しか書き換えません。
+	DX::ParallelFor(0, stripCount, [&](size_t strip)
+	{
+		uint32_t y0 = static_cast<uint32_t>(strip) * stripRows;
+		LabelStrip(depth, y0, std::min(y0 + stripRows, height));
+	});
+
+	// 2. ストリップの境界をまたぐ連結をまとめます。境界 1 行分なので逐次で行います。
+	uint32_t* parent = m_parent.data();
+	for (uint32_t strip = 1; strip < stripCount; strip++)
+	{
+		const uint32_t row = strip * stripRows * width;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			if (m_mask[row + x] && m_mask[row + x - width])
+			{
+				Union(parent, row + x, row + x - width);
+			}
+		}
+	}
+
+	// 3. 根に連番を付けます。ストリップごとに根を数えてから、開始番号を割り当てます。
+	std::vector<uint32_t> stripComponents(stripCount + 1, 0);
+	DX::ParallelFor(0, stripCount, [&](size_t strip)
+	{
+		uint32_t begin = static_cast<uint32_t>(strip) * stripRows * width;
+		uint32_t end = std::min(begin + stripRows * width, static_cast<uint32_t>(pixelCount));
+		uint32_t roots = 0;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			if (m_mask[i] && parent[i] == i)
+			{
+				roots++;
+			}
+		}
+		stripComponents[strip + 1] = roots;
+	});
+
+	for (uint32_t strip = 0; strip < stripCount; strip++)
+	{
+		stripComponents[strip + 1] += stripComponents[strip];
+	}
+
+	const uint32_t componentCount = stripComponents[stripCount];
+	if (componentCount == 0)
+	{
+		return true;
+	}
+
+	DX::ParallelFor(0, stripCount, [&](size_t strip)
+	{
+		uint32_t begin = static_cast<uint32_t>(strip) * stripRows * width;
+		uint32_t end = std::min(begin + stripRows * width, static_cast<uint32_t>(pixelCount));
+		uint32_t next = stripComponents[strip];
+		for (uint32_t i = begin; i < end; i++)
+		{
+			m_component[i] = (m_mask[i] && parent[i] == i) ? next++ : NoComponent;
+		}
+	});
+
+	// 根以外の画素は根の番号を引き継ぎます。根の番号はすべて確定しているので、読み取りだけで済みます。
+	DX::ParallelFor(0, stripCount, [&](size_t strip)
+	{
+		uint32_t begin = static_cast<uint32_t>(strip) * stripRows * width;
+		uint32_t end = std::min(begin + stripRows * width, static_cast<uint32_t>(pixelCount));
+		for (uint32_t i = begin; i < end; i++)
+		{
+			if (m_mask[i] && parent[i] != i)
+			{
+				m_component[i] = m_component[FindRoot(parent, i)];
+			}
+		}
+	});
+
+	// 4. ストリップごとに統計を集計してから合算します。
+	Accumulator empty = { 0, 0, 0, 0, 0, 0xFFFF, 0xFFFF, 0, 0 };
+	m_accumulators.assign(static_cast<size_t>(componentCount) * stripCount, empty);
+
+	DX::ParallelFor(0, stripCount, [&](size_t strip)
+	{
+		uint32_t y0 = static_cast<uint32_t>(strip) * stripRows;
+		AccumulateStrip(depth, y0, std::min(y0 + stripRows, height), &m_accumulators[strip * componentCount]);
+	});
+
+	for (uint32_t component = 0; component < componentCount; component++)
+	{
+		Accumulator total = empty;
+		for (uint32_t strip = 0; strip < stripCount; strip++)
+		{
+			const Accumulator& a = m_accumulators[static_cast<size_t>(strip) * componentCount + component];
+			if (a.area == 0)
+			{
+				continue;
+			}
+
+			total.area += a.area;
+			total.sumX += a.sumX;
+			total.sumY += a.sumY;
+			total.sumDepth += a.sumDepth;
+			total.sumHeight += a.sumHeight;
+			total.minX = std::min(total.minX, a.minX);
+			total.minY = std::min(total.minY, a.minY);
+			total.maxX = std::max(total.maxX, a.maxX);
+			total.maxY = std::max(total.maxY, a.maxY);
+		}
+
+		if (total.area < m_minArea)
+		{
+			continue;
+		}
+
+		Blob blob;
+		blob.area = total.area;
+		blob.centroidX = static_cast<float>(static_cast<double>(total.sumX) / total.area);
+		blob.centroidY = static_cast<float>(static_cast<double>(total.sumY) / total.area);
+		blob.meanDepth = static_cast<float>(static_cast<double>(total.sumDepth) / total.area);
+		blob.meanHeight = static_cast<float>(static_cast<double>(total.sumHeight) / total.area);
+		blob.minX = total.minX;
+		blob.minY = total.minY;
+		blob.maxX = total.maxX;
+		blob.maxY = total.maxY;
+		blobs->push_back(blob);
+	}
+
+	std::sort(blobs->begin(), blobs->end(), [](const Blob& a, const Blob& b) { return a.area > b.area; });
+	return true;
+}
@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ProjectionMapping
+{
+	// 背景より手前にある物体 (手や体) の連結領域。
+	struct Blob
+	{
+		uint32_t area;				// 画素数。
+		float centroidX;			// 重心 (深度画素)。
+		float centroidY;
+		float meanDepth;			// 平均深度 (ミリメートル)。
+		float meanHeight;			// 背景からの平均の高さ (ミリメートル)。
+		uint16_t minX, minY;		// 外接矩形 (両端を含む)。
+		uint16_t maxX, maxY;
+	};
+
+	// 深度フレームから背景差分で前景を抽出し、連結成分ごとの統計を求めます。
+	// ラベリングは行方向のストリップごとに並列に Union-Find を行い、ストリップの境界を最後にまとめます。
+	class BlobDetector
+	{
+	public:
+		BlobDetector();
+
+		// 背景からの高さがこの範囲 (ミリメートル) にある画素を前景とします。
+		void SetHeightRange(uint16_t minHeight, uint16_t maxHeight);
+
+		// これより小さい連結成分はノイズとして捨てます。
+		void SetMinimumArea(uint32_t minArea)				{ m_minArea = minArea; }
+
+		// ラベリングを分けるストリップの数。0 (既定) はワーカーの数から決めます。1 はフレーム全体を 1 回でラベリングします。
+		void SetStripCount(uint32_t stripCount)				{ m_stripCount = stripCount; }
+
+		// 背景を学習し直します。
+		void ResetBackground();
+
+		// 物体のないフレームを背景として取り込みます。画素ごとに最も遠い有効な深度を保持します。
+		void AccumulateBackground(const uint16_t* depth, uint32_t width, uint32_t height);
+		uint32_t GetBackgroundFrameCount() const			{ return m_backgroundFrames; }
+
+		// 前景を抽出してラベリングし、面積の大きい順に blobs に格納します。
+		// 背景の学習前や大きさが背景と異なる場合は false を返します。
+		bool Detect(const uint16_t* depth, uint32_t width, uint32_t height, std::vector<Blob>* blobs);
+
+		// 直近の Detect の前景マスク (前景は 1)。
+		const uint8_t* GetForegroundMask() const			{ return m_mask.data(); }
+
+	private:
+		struct Accumulator
+		{
+			uint32_t area;
+			uint64_t sumX;
+			uint64_t sumY;
+			uint64_t sumDepth;
+			uint64_t sumHeight;
+			uint16_t minX, minY;
+			uint16_t maxX, maxY;
+		};
+
+		void LabelStrip(const uint16_t* depth, uint32_t y0, uint32_t y1);
+		void AccumulateStrip(const uint16_t* depth, uint32_t y0, uint32_t y1, Accumulator* accumulators) const;
+
+		std::vector<uint16_t>	m_background;
+		uint32_t				m_width;
+		uint32_t				m_height;
+		uint32_t				m_backgroundFrames;
+		uint16_t				m_minHeight;
+		uint16_t				m_maxHeight;
+		uint32_t				m_minArea;
+		uint32_t				m_stripCount;
+
+		// ラベリングの作業領域。フレーム間で再利用します。
+		std::vector<uint8_t>		m_mask;
+		std::vector<uint32_t>		m_parent;
+		std::vector<uint32_t>		m_component;
+		std::vector<Accumulator>	m_accumulators;
+	};
+}
@@ -0,0 +1,91 @@
+﻿#include "LatencyEstimator.h"
+
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 測定値の指数移動平均の重み。数十フレームで収束し、1 フレームの外れ値には強くなります。
+	const double SmoothingFactor = 0.1;
+
+	// 妥当なリフレッシュ周期の範囲 (秒)。
+	const double MinRefreshPeriod = 1.0 / 240.0;
+	const double MaxRefreshPeriod = 1.0 / 24.0;
+}
+
+LatencyEstimator::LatencyEstimator() :
+	m_refreshPeriod(1.0 / 60.0),
+	m_frameLatency(2.0 / 60.0),
+	m_lastSyncTime(0.0),
+	m_lastSyncRefreshCount(0),
+	m_lastPresentCount(0),
+	m_hasSync(false),
+	m_measured(false)
+{
+	memset(m_pending, 0, sizeof(m_pending));
+}
+
+void LatencyEstimator::SetDefaultRefreshPeriod(double seconds)
+{
+	if (!m_measured && seconds >= MinRefreshPeriod && seconds <= MaxRefreshPeriod)
+	{
+		// 測定するまでは、Present(1, 0) とキューの 1 フレーム分の 2 周期を遅延と見なします。
+		m_refreshPeriod = seconds;
+		m_frameLatency = seconds * 2.0;
+	}
+}
+
+void LatencyEstimator::BeginFrame(uint32_t presentCount, double time)
+{
+	PendingFrame& frame = m_pending[presentCount % PendingFrameCount];
+	frame.presentCount = presentCount;
+	frame.time = time;
+}
+
+void LatencyEstimator::FrameDisplayed(uint32_t presentCount, uint32_t presentRefreshCount, uint32_t syncRefreshCount, double syncTime)
+{
+	// リフレッシュ周期は、垂直同期の回数と時刻の差から求めます。
+	if (m_hasSync && syncRefreshCount != m_lastSyncRefreshCount)
+	{
+		double period = (syncTime - m_lastSyncTime) / static_cast<double>(syncRefreshCount - m_lastSyncRefreshCount);
+		if (period >= MinRefreshPeriod && period <= MaxRefreshPeriod)
+		{
+			m_refreshPeriod += (period - m_refreshPeriod) * SmoothingFactor;
+		}
+	}
+	m_lastSyncTime = syncTime;
+	m_lastSyncRefreshCount = syncRefreshCount;
+	m_hasSync = true;
+
+	// 同じフレームの統計は一度だけ使用します。
+	if (presentCount == m_lastPresentCount)
+	{
+		return;
+	}
+	m_lastPresentCount = presentCount;
+
+	const PendingFrame& frame = m_pending[presentCount % PendingFrameCount];
+	if (frame.presentCount != presentCount)
+	{
+		return;
+	}
+
+	// フレームが表示された垂直同期の時刻は、統計を取った垂直同期からさかのぼって求めます。
+	double displayTime = syncTime - static_cast<double>(syncRefreshCount - presentRefreshCount) * m_refreshPeriod;
+	double latency = displayTime - frame.time;
+	if (latency <= 0.0 || latency > MaxRefreshPeriod * PendingFrameCount)
+	{
+		return;
+	}
+
+	if (m_measured)
+	{
+		m_frameLatency += (latency - m_frameLatency) * SmoothingFactor;
+	}
+	else
+	{
+		m_frameLatency = latency;
+		m_measured = true;
+	}
+}
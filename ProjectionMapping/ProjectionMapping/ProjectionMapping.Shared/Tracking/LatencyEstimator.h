@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <cstdint>
+
+namespace ProjectionMapping
+{
+	// 描画の開始から投影された光が出るまでの時間を、表示の統計から測定します。
+	// 時刻はすべて同じ時計 (QueryPerformanceCounter など) の秒で指定します。
+	class LatencyEstimator
+	{
+	public:
+		LatencyEstimator();
+
+		// time に描画を開始したフレームを記録します。
+		// presentCount は、このフレームを Present した後に IDXGISwapChain::GetLastPresentCount が返す値です。
+		void BeginFrame(uint32_t presentCount, double time);
+
+		// 表示の統計 (DXGI_FRAME_STATISTICS) を取り込みます。
+		// presentCount のフレームが presentRefreshCount 回目の垂直同期で表示され、syncRefreshCount 回目の垂直同期が syncTime にあったことを示します。
+		void FrameDisplayed(uint32_t presentCount, uint32_t presentRefreshCount, uint32_t syncRefreshCount, double syncTime);
+
+		// 統計を取得できない環境で使用する、リフレッシュ周期の既定値を設定します。
+		void SetDefaultRefreshPeriod(double seconds);
+
+		double GetRefreshPeriod() const				{ return m_refreshPeriod; }
+
+		// 描画の開始から、そのフレームが表示される垂直同期までの時間 (秒)。
+		double GetFrameLatency() const				{ return m_frameLatency; }
+		bool IsMeasured() const						{ return m_measured; }
+
+		// frameStartTime に描画を開始したフレームの光が出る時刻。走査が画面の中央に達する時刻とします。
+		double PredictPhotonTime(double frameStartTime) const
+		{
+			return frameStartTime + m_frameLatency + m_refreshPeriod * 0.5;
+		}
+
+	private:
+		static const uint32_t PendingFrameCount = 16;
+
+		struct PendingFrame
+		{
+			uint32_t presentCount;
+			double time;
+		};
+
+		PendingFrame	m_pending[PendingFrameCount];
+		double			m_refreshPeriod;
+		double			m_frameLatency;
+		double			m_lastSyncTime;
+		uint32_t		m_lastSyncRefreshCount;
+		uint32_t		m_lastPresentCount;
+		bool			m_hasSync;
+		bool			m_measured;
+	};
+}
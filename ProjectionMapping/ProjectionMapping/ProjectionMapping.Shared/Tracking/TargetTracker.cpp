@@ -0,0 +1,294 @@
+﻿#include "TargetTracker.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 目標を確定するまでに必要な連続した対応付けの回数。
+	const uint32_t ConfirmHits = 3;
+
+	// 確定した目標を、対応付けがないまま保持するフレーム数。
+	const uint32_t MaxMisses = 5;
+
+	// 新しい目標の速度と加速度の初期の標準偏差 (位置の単位/秒、/秒^2)。
+	const double InitialVelocitySigma = 500.0;
+	const double InitialAccelerationSigma = 5000.0;
+
+	struct Candidate
+	{
+		double distance;
+		size_t track;
+		size_t blob;
+	};
+}
+
+TargetTracker::TargetTracker() :
+	m_model(ConstantAcceleration),
+	m_lastTime(0.0),
+	m_hasTime(false),
+	m_nextId(1),
+	m_positionSigma(2.0f),
+	m_depthSigma(15.0f),
+	m_positionNoise(1.0e7f),
+	m_depthNoise(1.0e8f),
+	m_gate(16.0f),
+	m_maxHorizon(0.25f)
+{
+}
+
+void TargetTracker::SetMeasurementNoise(float positionSigma, float depthSigma)
+{
+	m_positionSigma = positionSigma;
+	m_depthSigma = depthSigma;
+}
+
+void TargetTracker::SetProcessNoise(float positionNoise, float depthNoise)
+{
+	m_positionNoise = positionNoise;
+	m_depthNoise = depthNoise;
+}
+
+void TargetTracker::Reset()
+{
+	m_tracks.clear();
+	m_hasTime = false;
+}
+
+void TargetTracker::InitializeAxis(Axis* axis, double position, double variance) const
+{
+	memset(axis, 0, sizeof(Axis));
+	axis->state[0] = position;
+	axis->covariance[0][0] = variance;
+	axis->covariance[1][1] = InitialVelocitySigma * InitialVelocitySigma;
+	axis->covariance[2][2] = (m_model == ConstantAcceleration) ? InitialAccelerationSigma * InitialAccelerationSigma : 0.0;
+}
+
+// x' = F x、P' = F P F^T + Q。
+// Q は等速度モデルでは白色加速度、等加速度モデルでは白色躍度 (jerk) の連続時間モデルを離散化したものです。
+void TargetTracker::PredictAxis(Axis* axis, double dt, double processNoise) const
+{
+	double f[3][3] = {};
+	double q[3][3] = {};
+	const double dt2 = dt * dt;
+	const double dt3 = dt2 * dt;
+
+	f[0][0] = 1.0;
+	f[0][1] = dt;
+	f[1][1] = 1.0;
+
+	if (m_model == ConstantAcceleration)
+	{
+		const double dt4 = dt3 * dt;
+		const double dt5 = dt4 * dt;
+
+		f[0][2] = dt2 * 0.5;
+		f[1][2] = dt;
+		f[2][2] = 1.0;
+
+		q[0][0] = dt5 / 20.0;	q[0][1] = dt4 / 8.0;	q[0][2] = dt3 / 6.0;
+		q[1][0] = dt4 / 8.0;	q[1][1] = dt3 / 3.0;	q[1][2] = dt2 / 2.0;
+		q[2][0] = dt3 / 6.0;	q[2][1] = dt2 / 2.0;	q[2][2] = dt;
+	}
+	else
+	{
+		q[0][0] = dt3 / 3.0;	q[0][1] = dt2 / 2.0;
+		q[1][0] = dt2 / 2.0;	q[1][1] = dt;
+	}
+
+	double state[3];
+	for (int i = 0; i < 3; i++)
+	{
+		state[i] = f[i][0] * axis->state[0] + f[i][1] * axis->state[1] + f[i][2] * axis->state[2];
+	}
+
+	double fp[3][3];
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			fp[i][j] = f[i][0] * axis->covariance[0][j] + f[i][1] * axis->covariance[1][j] + f[i][2] * axis->covariance[2][j];
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		axis->state[i] = state[i];
+		for (int j = 0; j < 3; j++)
+		{
+			axis->covariance[i][j] = fp[i][0] * f[j][0] + fp[i][1] * f[j][1] + fp[i][2] * f[j][2] + q[i][j] * processNoise;
+		}
+	}
+}
+
+// 位置だけを観測するので、カルマン ゲインは共分散の 1 列目をイノベーションの分散で割ったものです。
+void TargetTracker::CorrectAxis(Axis* axis, double measurement, double variance) const
+{
+	const double innovation = measurement - axis->state[0];
+	const double s = axis->covariance[0][0] + variance;
+
+	double gain[3];
+	for (int i = 0; i < 3; i++)
+	{
+		gain[i] = axis->covariance[i][0] / s;
+		axis->state[i] += gain[i] * innovation;
+	}
+
+	// P = (I - K H) P
+	double row[3] = { axis->covariance[0][0], axis->covariance[0][1], axis->covariance[0][2] };
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			axis->covariance[i][j] -= gain[i] * row[j];
+		}
+	}
+}
+
+double TargetTracker::Extrapolate(const Axis& axis, double dt) const
+{
+	double position = axis.state[0] + axis.state[1] * dt;
+	if (m_model == ConstantAcceleration)
+	{
+		position += 0.5 * axis.state[2] * dt * dt;
+	}
+	return position;
+}
+
+void TargetTracker::Update(const std::vector<Blob>& blobs, double time)
+{
+	const double dt = m_hasTime ? time - m_lastTime : 0.0;
+	if (m_hasTime && dt < 0.0)
+	{
+		// 時刻が戻った場合はセンサーが再起動したものとして、追跡をやり直します。
+		m_tracks.clear();
+	}
+	else if (dt > 0.0)
+	{
+		for (size_t t = 0; t < m_tracks.size(); t++)
+		{
+			PredictAxis(&m_tracks[t].axes[0], dt, m_positionNoise);
+			PredictAxis(&m_tracks[t].axes[1], dt, m_positionNoise);
+			PredictAxis(&m_tracks[t].axes[2], dt, m_depthNoise);
+		}
+	}
+	m_lastTime = time;
+	m_hasTime = true;
+
+	const double positionVariance = static_cast<double>(m_positionSigma) * m_positionSigma;
+	const double depthVariance = static_cast<double>(m_depthSigma) * m_depthSigma;
+
+	// ゲート内のすべての組を距離の近い順に並べ、貪欲に対応付けます。
+	std::vector<Candidate> candidates;
+	for (size_t t = 0; t < m_tracks.size(); t++)
+	{
+		const Track& track = m_tracks[t];
+		for (size_t b = 0; b < blobs.size(); b++)
+		{
+			double dx = blobs[b].centroidX - track.axes[0].state[0];
+			double dy = blobs[b].centroidY - track.axes[1].state[0];
+			double distance =
+				dx * dx / (track.axes[0].covariance[0][0] + positionVariance) +
+				dy * dy / (track.axes[1].covariance[0][0] + positionVariance);
+
+			if (distance < m_gate)
+			{
+				Candidate candidate = { distance, t, b };
+				candidates.push_back(candidate);
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+
+	std::vector<bool> trackAssigned(m_tracks.size(), false);
+	std::vector<bool> blobAssigned(blobs.size(), false);
+
+	for (size_t c = 0; c < candidates.size(); c++)
+	{
+		const Candidate& candidate = candidates[c];
+		if (trackAssigned[candidate.track] || blobAssigned[candidate.blob])
+		{
+			continue;
+		}
+
+		trackAssigned[candidate.track] = true;
+		blobAssigned[candidate.blob] = true;
+
+		Track& track = m_tracks[candidate.track];
+		const Blob& blob = blobs[candidate.blob];
+		CorrectAxis(&track.axes[0], blob.centroidX, positionVariance);
+		CorrectAxis(&track.axes[1], blob.centroidY, positionVariance);
+		CorrectAxis(&track.axes[2], blob.meanDepth, depthVariance);
+		track.area = static_cast<float>(blob.area);
+		track.hits++;
+		track.misses = 0;
+	}
+
+	// 対応付けのない目標を数え、確定前のものやしばらく見えないものを削除します。
+	size_t kept = 0;
+	for (size_t t = 0; t < m_tracks.size(); t++)
+	{
+		Track& track = m_tracks[t];
+		if (!trackAssigned[t])
+		{
+			track.misses++;
+			if (track.hits < ConfirmHits || track.misses > MaxMisses)
+			{
+				continue;
+			}
+		}
+		m_tracks[kept++] = track;
+	}
+	m_tracks.resize(kept);
+
+	// 対応付けのないブロブから新しい目標を作ります。
+	for (size_t b = 0; b < blobs.size(); b++)
+	{
+		if (blobAssigned[b])
+		{
+			continue;
+		}
+
+		Track track;
+		track.id = m_nextId++;
+		InitializeAxis(&track.axes[0], blobs[b].centroidX, positionVariance);
+		InitializeAxis(&track.axes[1], blobs[b].centroidY, positionVariance);
+		InitializeAxis(&track.axes[2], blobs[b].meanDepth, depthVariance);
+		track.area = static_cast<float>(blobs[b].area);
+		track.hits = 1;
+		track.misses = 0;
+		m_tracks.push_back(track);
+	}
+}
+
+void TargetTracker::Predict(double time, std::vector<TrackedTarget>* targets) const
+{
+	targets->clear();
+
+	double dt = m_hasTime ? time - m_lastTime : 0.0;
+	dt = std::max(0.0, std::min(dt, static_cast<double>(m_maxHorizon)));
+
+	// 目標は作成順に並んでいるので、古い目標が先になります。
+	for (size_t t = 0; t < m_tracks.size(); t++)
+	{
+		const Track& track = m_tracks[t];
+		if (track.hits < ConfirmHits)
+		{
+			continue;
+		}
+
+		TrackedTarget target;
+		target.id = track.id;
+		target.x = static_cast<float>(Extrapolate(track.axes[0], dt));
+		target.y = static_cast<float>(Extrapolate(track.axes[1], dt));
+		target.depth = static_cast<float>(Extrapolate(track.axes[2], dt));
+		target.velocityX = static_cast<float>(track.axes[0].state[1] + track.axes[0].state[2] * dt);
+		target.velocityY = static_cast<float>(track.axes[1].state[1] + track.axes[1].state[2] * dt);
+		target.area = track.area;
+		target.age = track.hits;
+		targets->push_back(target);
+	}
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "BlobDetector.h"
+
+namespace ProjectionMapping
+{
+	// 追跡中の目標の、ある時刻での推定位置。
+	struct TrackedTarget
+	{
+		uint32_t id;				// 目標が消えるまで変わらない番号。
+		float x, y;					// 位置 (深度画素)。
+		float depth;				// 深度 (ミリメートル)。
+		float velocityX, velocityY;	// 速度 (深度画素/秒)。
+		float area;					// 直近に対応付けたブロブの面積。
+		uint32_t age;				// 対応付けたフレーム数。
+	};
+
+	// ブロブの重心を Kalman フィルターで追跡する複数目標トラッカー。
+	// 各軸を等速度または等加速度モデルで独立に推定し、ゲート付きの最近傍法でブロブを対応付けます。
+	// 観測時刻と表示時刻から、画面に光が出る時刻の位置を外挿して遅延を隠します。
+	class TargetTracker
+	{
+	public:
+		enum MotionModel
+		{
+			ConstantVelocity,
+			ConstantAcceleration
+		};
+
+		TargetTracker();
+
+		void SetMotionModel(MotionModel model)				{ m_model = model; }
+
+		// 観測ノイズの標準偏差 (深度画素、ミリメートル)。
+		void SetMeasurementNoise(float positionSigma, float depthSigma);
+
+		// 運動モデルを駆動するノイズのスペクトル密度。等加速度モデルでは躍度、等速度モデルでは加速度の密度です。
+		// 既定値は等加速度モデルで手の動きに合わせたものです。
+		void SetProcessNoise(float positionNoise, float depthNoise);
+
+		// 対応付けのゲート (正規化イノベーションの 2 乗、x と y の 2 自由度)。
+		void SetGate(float gate)							{ m_gate = gate; }
+
+		// 外挿する時間の上限 (秒)。大きな遅延で予測が発散しないようにします。
+		void SetMaxPredictionHorizon(float seconds)			{ m_maxHorizon = seconds; }
+
+		void Reset();
+
+		// time (秒) に観測したブロブで目標を更新します。時刻は単調増加である必要があります。
+		void Update(const std::vector<Blob>& blobs, double time);
+
+		// 確定した目標の time での位置を予測して、古い目標から順に格納します。フィルターの状態は変えません。
+		void Predict(double time, std::vector<TrackedTarget>* targets) const;
+
+		// 直近の観測時刻。
+		double GetLastUpdateTime() const					{ return m_lastTime; }
+
+	private:
+		// 1 軸分の状態 (位置、速度、加速度) と共分散。
+		struct Axis
+		{
+			double state[3];
+			double covariance[3][3];
+		};
+
+		struct Track
+		{
+			uint32_t id;
+			Axis axes[3];			// x, y, 深度。
+			float area;
+			uint32_t hits;
+			uint32_t misses;
+		};
+
+		void InitializeAxis(Axis* axis, double position, double variance) const;
+		void PredictAxis(Axis* axis, double dt, double processNoise) const;
+		void CorrectAxis(Axis* axis, double measurement, double variance) const;
+		double Extrapolate(const Axis& axis, double dt) const;
+
+		std::vector<Track>	m_tracks;
+		MotionModel			m_model;
+		double				m_lastTime;
+		bool				m_hasTime;
+		uint32_t			m_nextId;
+		float				m_positionSigma;
+		float				m_depthSigma;
+		float				m_positionNoise;
+		float				m_depthNoise;
+		float				m_gate;
+		float				m_maxHorizon;
+	};
+}
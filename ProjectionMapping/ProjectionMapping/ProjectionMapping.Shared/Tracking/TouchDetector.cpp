@@ -0,0 +1,476 @@
+﻿#include "TouchDetector.h"
+
+#include "../Common/ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define PROJECTIONMAPPING_TOUCH_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PROJECTIONMAPPING_TOUCH_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 高さの下限を、面のノイズの標準偏差の何倍まで引き上げるか。
+	const float NoiseSigmaScale = 3.0f;
+
+	// Down と Up を通知するまでに必要な連続したフレーム数。1 フレームのちらつきを無視します。
+	const uint32_t DownFrames = 2;
+	const uint32_t UpFrames = 2;
+
+	// 1 ストリップの行数。
+	const uint32_t StripRows = 32;
+
+	inline uint32_t FindRoot(uint32_t* parent, uint32_t index)
+	{
+		while (parent[index] != index)
+		{
+			parent[index] = parent[parent[index]];
+			index = parent[index];
+		}
+		return index;
+	}
+
+	inline void Union(uint32_t* parent, uint32_t a, uint32_t b)
+	{
+		a = FindRoot(parent, a);
+		b = FindRoot(parent, b);
+		if (a < b)
+		{
+			parent[b] = a;
+		}
+		else if (b < a)
+		{
+			parent[a] = b;
+		}
+	}
+
+	struct Candidate
+	{
+		float distance;
+		size_t touch;
+		size_t fingertip;
+	};
+}
+
+TouchDetector::TouchDetector() :
+	m_width(0),
+	m_height(0),
+	m_surfaceFrames(0),
+	m_surfaceReady(false),
+	m_minHeight(4),
+	m_maxHeight(20),
+	m_minArea(6),
+	m_maxArea(400),
+	m_matchRadius(12.0f),
+	m_nextId(1)
+{
+}
+
+void TouchDetector::SetHeightBand(uint16_t minHeight, uint16_t maxHeight)
+{
+	m_minHeight = minHeight;
+	m_maxHeight = maxHeight;
+
+	if (m_surfaceFrames > 0)
+	{
+		FinalizeSurface();
+	}
+}
+
+void TouchDetector::SetFingerArea(uint32_t minArea, uint32_t maxArea)
+{
+	m_minArea = minArea;
+	m_maxArea = maxArea;
+}
+
+void TouchDetector::ResetSurface()
+{
+	m_width = 0;
+	m_height = 0;
+	m_surfaceFrames = 0;
+	m_surfaceReady = false;
+	m_touches.clear();
+}
+
+void TouchDetector::AccumulateSurface(const uint16_t* depth, uint32_t width, uint32_t height)
+{
+	if (!depth || width == 0 || height == 0)
+	{
+		return;
+	}
+
+	if (width != m_width || height != m_height)
+	{
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		m_width = width;
+		m_height = height;
+		m_sum.assign(pixelCount, 0);
+		m_sumSquares.assign(pixelCount, 0);
+		m_count.assign(pixelCount, 0);
+		m_surfaceFrames = 0;
+		m_touches.clear();
+	}
+
+	const size_t pixelCount = m_sum.size();
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		const uint32_t d = depth[i];
+		if (d != 0)
+		{
+			m_sum[i] += d;
+			m_sumSquares[i] += d * d;
+			m_count[i]++;
+		}
+	}
+
+	m_surfaceFrames++;
+	FinalizeSurface();
+}
+
+// 学習したフレームから、画素ごとの面の深度と高さの下限を求めます。
+void TouchDetector::FinalizeSurface()
+{
+	const size_t pixelCount = m_sum.size();
+	m_surface.resize(pixelCount);
+	m_lowerBound.resize(pixelCount);
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		const uint32_t count = m_count[i];
+
+		// 半分以上のフレームで測定できなかった画素は使用しません。
+		if (count == 0 || count * 2 < m_surfaceFrames)
+		{
+			m_surface[i] = 0;
+			m_lowerBound[i] = 0xFFFF;
+			continue;
+		}
+
+		double mean = static_cast<double>(m_sum[i]) / count;
+		double variance = std::max(0.0, static_cast<double>(m_sumSquares[i]) / count - mean * mean);
+		float bound = std::max(static_cast<float>(m_minHeight), ceilf(NoiseSigmaScale * static_cast<float>(sqrt(variance))));
+
+		// ノイズが帯より大きい画素では、指と面を区別できません。
+		if (bound > m_maxHeight)
+		{
+			m_surface[i] = 0;
+			m_lowerBound[i] = 0xFFFF;
+			continue;
+		}
+
+		m_surface[i] = static_cast<uint16_t>(mean + 0.5);
+		m_lowerBound[i] = static_cast<uint16_t>(bound);
+	}
+
+	m_surfaceReady = true;
+}
+
+// 面から帯の範囲にある画素を 0xFF、それ以外を 0 にします。
+// 深度と面の両方が有効で、lowerBound <= surface - depth <= maxHeight の画素が候補です。
+void TouchDetector::ClassifyRows(const uint16_t* depth, uint32_t y0, uint32_t y1)
+{
+	const size_t begin = static_cast<size_t>(y0) * m_width;
+	const size_t end = static_cast<size_t>(y1) * m_width;
+	const uint16_t* surface = m_surface.data();
+	const uint16_t* lowerBound = m_lowerBound.data();
+	uint8_t* mask = m_mask.data();
+	size_t i = begin;
+
+#if defined(PROJECTIONMAPPING_TOUCH_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i upper = _mm_set1_epi16(static_cast<short>(m_maxHeight));
+
+	for (; i + 16 <= end; i += 16)
+	{
+		__m128i halves[2];
+		for (int half = 0; half < 2; half++)
+		{
+			const size_t offset = i + half * 8;
+			__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth + offset));
+			__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(surface + offset));
+			__m128i lower = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowerBound + offset));
+
+			// SSE2 には符号なしの比較がないので、飽和減算が 0 になるかどうかで比較します。
+			__m128i heightAbove = _mm_subs_epu16(s, d);
+			__m128i aboveLower = _mm_cmpeq_epi16(_mm_subs_epu16(lower, heightAbove), zero);
+			__m128i belowUpper = _mm_cmpeq_epi16(_mm_subs_epu16(heightAbove, upper), zero);
+			__m128i invalid = _mm_or_si128(_mm_cmpeq_epi16(d, zero), _mm_cmpeq_epi16(s, zero));
+
+			halves[half] = _mm_andnot_si128(invalid, _mm_and_si128(aboveLower, belowUpper));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), _mm_packs_epi16(halves[0], halves[1]));
+	}
+#elif defined(PROJECTIONMAPPING_TOUCH_NEON)
+	const uint16x8_t zero = vdupq_n_u16(0);
+	const uint16x8_t upper = vdupq_n_u16(m_maxHeight);
+
+	for (; i + 8 <= end; i += 8)
+	{
+		uint16x8_t d = vld1q_u16(depth + i);
+		uint16x8_t s = vld1q_u16(surface + i);
+		uint16x8_t lower = vld1q_u16(lowerBound + i);
+
+		uint16x8_t heightAbove = vqsubq_u16(s, d);
+		uint16x8_t inBand = vandq_u16(vcgeq_u16(heightAbove, lower), vcleq_u16(heightAbove, upper));
+		uint16x8_t valid = vandq_u16(vmvnq_u16(vceqq_u16(d, zero)), vmvnq_u16(vceqq_u16(s, zero)));
+
+		vst1_u8(mask + i, vmovn_u16(vandq_u16(inBand, valid)));
+	}
+#endif
+
+	for (; i < end; i++)
+	{
+		const uint16_t d = depth[i];
+		const uint16_t s = surface[i];
+		const uint16_t heightAbove = s > d ? static_cast<uint16_t>(s - d) : 0;
+		mask[i] = (d != 0 && s != 0 && heightAbove >= lowerBound[i] && heightAbove <= m_maxHeight) ? 0xFF : 0;
+	}
+}
+
+// 候補の画素を 8 近傍でつなぎ、面積が指先らしいものを残します。候補は疎なので逐次で処理します。
+void TouchDetector::FindFingertips(const uint16_t* depth)
+{
+	const uint32_t width = m_width;
+	const uint32_t height = m_height;
+	const uint8_t* mask = m_mask.data();
+	uint32_t* parent = m_parent.data();
+
+	m_fingertips.clear();
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint32_t row = y * width;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint32_t i = row + x;
+
+			// 候補のない 8 画素はまとめて読み飛ばします。
+			if ((x & 7) == 0 && x + 8 <= width)
+			{
+				uint64_t block;
+				memcpy(&block, mask + i, sizeof(block));
+				if (block == 0)
+				{
+					x += 7;
+					continue;
+				}
+			}
+
+			if (!mask[i])
+			{
+				continue;
+			}
+
+			parent[i] = i;
+			if (x > 0 && mask[i - 1])
+			{
+				Union(parent, i, i - 1);
+			}
+			if (y > 0)
+			{
+				if (mask[i - width])
+				{
+					Union(parent, i, i - width);
+				}
+				if (x > 0 && mask[i - width - 1])
+				{
+					Union(parent, i, i - width - 1);
+				}
+				if (x + 1 < width && mask[i - width + 1])
+				{
+					Union(parent, i, i - width + 1);
+				}
+			}
+		}
+	}
+
+	// 根ごとに統計を集計します。
+	struct Accumulator
+	{
+		uint32_t area;
+		uint64_t sumX;
+		uint64_t sumY;
+		uint64_t sumHeight;
+	};
+	std::vector<Accumulator> accumulators;
+
+	for (uint32_t y = 0; y < height; y++)
+	{
+		const uint32_t row = y * width;
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const uint32_t i = row + x;
+			if (!mask[i])
+			{
+				continue;
+			}
+
+			const uint32_t root = FindRoot(parent, i);
+			if (root == i)
+			{
+				m_label[i] = static_cast<uint32_t>(accumulators.size());
+				Accumulator empty = { 0, 0, 0, 0 };
+				accumulators.push_back(empty);
+			}
+
+			Accumulator& a = accumulators[m_label[root]];
+			a.area++;
+			a.sumX += x;
+			a.sumY += y;
+			a.sumHeight += m_surface[i] - depth[i];
+		}
+	}
+
+	for (size_t c = 0; c < accumulators.size(); c++)
+	{
+		const Accumulator& a = accumulators[c];
+		if (a.area < m_minArea || a.area > m_maxArea)
+		{
+			continue;
+		}
+
+		Fingertip fingertip;
+		fingertip.x = static_cast<float>(static_cast<double>(a.sumX) / a.area);
+		fingertip.y = static_cast<float>(static_cast<double>(a.sumY) / a.area);
+		fingertip.height = static_cast<float>(static_cast<double>(a.sumHeight) / a.area);
+		fingertip.area = a.area;
+		m_fingertips.push_back(fingertip);
+	}
+}
+
+// 指先を前のフレームのタッチに近い順で対応付け、状態の変化をイベントにします。
+void TouchDetector::TrackTouches(std::vector<TouchEvent>* events)
+{
+	const float radiusSquared = m_matchRadius * m_matchRadius;
+
+	std::vector<Candidate> candidates;
+	for (size_t t = 0; t < m_touches.size(); t++)
+	{
+		for (size_t f = 0; f < m_fingertips.size(); f++)
+		{
+			float dx = m_fingertips[f].x - m_touches[t].x;
+			float dy = m_fingertips[f].y - m_touches[t].y;
+			float distance = dx * dx + dy * dy;
+			if (distance <= radiusSquared)
+			{
+				Candidate candidate = { distance, t, f };
+				candidates.push_back(candidate);
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+
+	std::vector<bool> touchMatched(m_touches.size(), false);
+	std::vector<bool> fingertipMatched(m_fingertips.size(), false);
+
+	for (size_t c = 0; c < candidates.size(); c++)
+	{
+		const Candidate& candidate = candidates[c];
+		if (touchMatched[candidate.touch] || fingertipMatched[candidate.fingertip])
+		{
+			continue;
+		}
+
+		touchMatched[candidate.touch] = true;
+		fingertipMatched[candidate.fingertip] = true;
+
+		Touch& touch = m_touches[candidate.touch];
+		const Fingertip& fingertip = m_fingertips[candidate.fingertip];
+		touch.x = fingertip.x;
+		touch.y = fingertip.y;
+		touch.height = fingertip.height;
+		touch.hits++;
+		touch.misses = 0;
+
+		TouchEvent event = { TouchEvent::Move, touch.id, touch.x, touch.y, touch.height };
+		if (!touch.down)
+		{
+			if (touch.hits < DownFrames)
+			{
+				continue;
+			}
+			touch.down = true;
+			event.type = TouchEvent::Down;
+		}
+		events->push_back(event);
+	}
+
+	// 見つからなかったタッチを離します。
+	size_t kept = 0;
+	for (size_t t = 0; t < m_touches.size(); t++)
+	{
+		Touch& touch = m_touches[t];
+		if (!touchMatched[t])
+		{
+			touch.misses++;
+			if (!touch.down || touch.misses >= UpFrames)
+			{
+				if (touch.down)
+				{
+					TouchEvent event = { TouchEvent::Up, touch.id, touch.x, touch.y, touch.height };
+					events->push_back(event);
+				}
+				continue;
+			}
+		}
+		m_touches[kept++] = touch;
+	}
+	m_touches.resize(kept);
+
+	// 新しい指先はまだ Down を通知しません。Down は上の照合で DownFrames 回目に見つかったときに通知します。
+	static_assert(DownFrames > 1, "新しい指先は 1 フレーム目に Down を通知しません。");
+	for (size_t f = 0; f < m_fingertips.size(); f++)
+	{
+		if (fingertipMatched[f])
+		{
+			continue;
+		}
+
+		Touch touch;
+		touch.id = m_nextId++;
+		touch.x = m_fingertips[f].x;
+		touch.y = m_fingertips[f].y;
+		touch.height = m_fingertips[f].height;
+		touch.hits = 1;
+		touch.misses = 0;
+		touch.down = false;
+		m_touches.push_back(touch);
+	}
+}
+
+bool TouchDetector::Detect(const uint16_t* depth, uint32_t width, uint32_t height, std::vector<TouchEvent>* events)
+{
+	events->clear();
+
+	if (!depth || !m_surfaceReady || width != m_width || height != m_height)
+	{
+		return false;
+	}
+
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	m_mask.resize(pixelCount);
+	m_parent.resize(pixelCount);
+	m_label.resize(pixelCount);
+
+	// 分類は画素ごとに独立なので、行のストリップに分けて並列に行います。
+	const uint32_t stripCount = (height + StripRows - 1) / StripRows;
+	DX::ParallelFor(0, stripCount, [&](size_t strip)
+	{
+		uint32_t y0 = static_cast<uint32_t>(strip) * StripRows;
+		ClassifyRows(depth, y0, std::min(y0 + StripRows, height));
+	});
+
+	FindFingertips(depth);
+	TrackTouches(events);
+	return true;
+}
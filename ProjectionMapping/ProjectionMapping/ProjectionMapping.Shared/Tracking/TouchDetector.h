@@ -0,0 +1,105 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ProjectionMapping
+{
+	// タッチの状態の変化。
+	struct TouchEvent
+	{
+		enum Type
+		{
+			Down,
+			Move,
+			Up
+		};
+
+		Type type;
+		uint32_t id;			// 指が離れるまで変わらない番号。
+		float x, y;				// 指先の位置 (深度画素)。
+		float height;			// 面からの平均の高さ (ミリメートル)。
+	};
+
+	// 机や壁などの面に触れている指先を深度から検出し、マルチタッチのイベントにします。
+	// 画素ごとに面の深度とノイズを学習し、面から薄い高さの範囲にある画素を SIMD で抽出してから、指先ごとにまとめます。
+	class TouchDetector
+	{
+	public:
+		TouchDetector();
+
+		// 面からの高さがこの範囲 (ミリメートル) にある画素を、触れている指の候補とします。
+		// 下限は画素ごとのノイズに応じて引き上げられます。
+		void SetHeightBand(uint16_t minHeight, uint16_t maxHeight);
+
+		// 指先とみなす画素数の範囲。
+		void SetFingerArea(uint32_t minArea, uint32_t maxArea);
+
+		// 前のフレームの指と同じとみなす距離 (深度画素)。
+		void SetMatchRadius(float radius)					{ m_matchRadius = radius; }
+
+		// 面を学習し直します。進行中のタッチはすべて離されます。
+		void ResetSurface();
+
+		// 何も触れていないフレームを面として取り込みます。
+		void AccumulateSurface(const uint16_t* depth, uint32_t width, uint32_t height);
+		uint32_t GetSurfaceFrameCount() const				{ return m_surfaceFrames; }
+
+		// 1 フレーム分の指先を検出し、前のフレームからの変化を events に格納します。
+		// 面の学習前や大きさが面と異なる場合は false を返します。
+		bool Detect(const uint16_t* depth, uint32_t width, uint32_t height, std::vector<TouchEvent>* events);
+
+		// 直近の Detect のタッチ マスク (候補の画素は 0xFF)。
+		const uint8_t* GetTouchMask() const					{ return m_mask.data(); }
+
+	private:
+		struct Fingertip
+		{
+			float x, y;
+			float height;
+			uint32_t area;
+		};
+
+		struct Touch
+		{
+			uint32_t id;
+			float x, y;
+			float height;
+			uint32_t hits;			// 連続して見つかったフレーム数。
+			uint32_t misses;		// 連続して見つからなかったフレーム数。
+			bool down;				// Down を通知済みかどうか。
+		};
+
+		void FinalizeSurface();
+		void ClassifyRows(const uint16_t* depth, uint32_t y0, uint32_t y1);
+		void FindFingertips(const uint16_t* depth);
+		void TrackTouches(std::vector<TouchEvent>* events);
+
+		uint32_t				m_width;
+		uint32_t				m_height;
+		uint32_t				m_surfaceFrames;
+		bool					m_surfaceReady;
+		uint16_t				m_minHeight;
+		uint16_t				m_maxHeight;
+		uint32_t				m_minArea;
+		uint32_t				m_maxArea;
+		float					m_matchRadius;
+		uint32_t				m_nextId;
+
+		// 面の学習。画素ごとの和と 2 乗和、有効なフレーム数。
+		std::vector<uint32_t>	m_sum;
+		std::vector<uint64_t>	m_sumSquares;
+		std::vector<uint16_t>	m_count;
+
+		// 学習した面の深度と、画素ごとの高さの下限。無効な画素は面が 0 です。
+		std::vector<uint16_t>	m_surface;
+		std::vector<uint16_t>	m_lowerBound;
+
+		// フレームごとの作業領域。
+		std::vector<uint8_t>	m_mask;
+		std::vector<uint32_t>	m_parent;
+		std::vector<uint32_t>	m_label;
+		std::vector<Fingertip>	m_fingertips;
+		std::vector<Touch>		m_touches;
+	};
+}
@@ -0,0 +1,328 @@
+﻿#include "Tracking/BlobDetector.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const uint32_t Width = 512;
+	const uint32_t Height = 424;
+	const uint16_t BackgroundDepth = 2500;
+
+	// 比べるストリップの数。1 行ずつのストリップでは、上とのつながりがすべて境界のマージになります。
+	const uint32_t StripCounts[] = { 2, 3, 7, 16, 26, 53, 141, Height };
+
+	// 前景の画素の深度。背景から 100..109 ミリメートル手前です。
+	uint16_t ForegroundDepth(std::mt19937* random)
+	{
+		return static_cast<uint16_t>(BackgroundDepth - 100 - (*random)() % 10);
+	}
+
+	// BlobDetector とは別に、前景を 1 回の幅優先探索で 4 近傍の連結成分に分けます。面積が minArea 以上の成分を返します。
+	std::vector<Blob> ReferenceBlobs(const std::vector<uint16_t>& depth, const std::vector<uint16_t>& background, uint16_t minHeight, uint16_t maxHeight, uint32_t minArea)
+	{
+		std::vector<uint8_t> foreground(depth.size());
+		for (size_t i = 0; i < depth.size(); i++)
+		{
+			foreground[i] = depth[i] != 0 && background[i] > depth[i] && background[i] - depth[i] >= minHeight && background[i] - depth[i] <= maxHeight;
+		}
+
+		std::vector<Blob> blobs;
+		std::vector<uint32_t> queue;
+		for (uint32_t start = 0; start < depth.size(); start++)
+		{
+			if (!foreground[start])
+			{
+				continue;
+			}
+
+			double sumX = 0.0, sumY = 0.0, sumDepth = 0.0, sumHeight = 0.0;
+			Blob blob = { 0, 0.0f, 0.0f, 0.0f, 0.0f, 0xFFFF, 0xFFFF, 0, 0 };
+			foreground[start] = 0;
+			queue.assign(1, start);
+			for (size_t head = 0; head < queue.size(); head++)
+			{
+				const uint32_t i = queue[head];
+				const uint32_t x = i % Width, y = i / Width;
+				blob.area++;
+				sumX += x;
+				sumY += y;
+				sumDepth += depth[i];
+				sumHeight += background[i] - depth[i];
+				blob.minX = std::min(blob.minX, static_cast<uint16_t>(x));
+				blob.minY = std::min(blob.minY, static_cast<uint16_t>(y));
+				blob.maxX = std::max(blob.maxX, static_cast<uint16_t>(x));
+				blob.maxY = std::max(blob.maxY, static_cast<uint16_t>(y));
+
+				const uint32_t neighbors[4] = { x > 0 ? i - 1 : i, x + 1 < Width ? i + 1 : i, y > 0 ? i - Width : i, y + 1 < Height ? i + Width : i };
+				for (int n = 0; n < 4; n++)
+				{
+					if (foreground[neighbors[n]])
+					{
+						foreground[neighbors[n]] = 0;
+						queue.push_back(neighbors[n]);
+					}
+				}
+			}
+
+			if (blob.area >= minArea)
+			{
+				blob.centroidX = static_cast<float>(sumX / blob.area);
+				blob.centroidY = static_cast<float>(sumY / blob.area);
+				blob.meanDepth = static_cast<float>(sumDepth / blob.area);
+				blob.meanHeight = static_cast<float>(sumHeight / blob.area);
+				blobs.push_back(blob);
+			}
+		}
+		return blobs;
+	}
+
+	// 面積の同じ成分の順番は決まっていないので、面積、外接矩形の順に並べて比べます。
+	bool IsBefore(const Blob& a, const Blob& b)
+	{
+		if (a.area != b.area) return a.area > b.area;
+		if (a.minY != b.minY) return a.minY < b.minY;
+		if (a.minX != b.minX) return a.minX < b.minX;
+		if (a.maxY != b.maxY) return a.maxY < b.maxY;
+		return a.maxX < b.maxX;
+	}
+
+	bool IsSameBlob(const Blob& a, const Blob& b, float tolerance)
+	{
+		return a.area == b.area && a.minX == b.minX && a.minY == b.minY && a.maxX == b.maxX && a.maxY == b.maxY &&
+			std::fabs(a.centroidX - b.centroidX) <= tolerance && std::fabs(a.centroidY - b.centroidY) <= tolerance &&
+			std::fabs(a.meanDepth - b.meanDepth) <= tolerance && std::fabs(a.meanHeight - b.meanHeight) <= tolerance;
+	}
+
+	// 違う成分の数を返します。成分の数が違う場合は -1 です。
+	int CountDifferences(std::vector<Blob> a, std::vector<Blob> b, float tolerance)
+	{
+		if (a.size() != b.size())
+		{
+			return -1;
+		}
+		std::sort(a.begin(), a.end(), IsBefore);
+		std::sort(b.begin(), b.end(), IsBefore);
+
+		int differences = 0;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			differences += IsSameBlob(a[i], b[i], tolerance) ? 0 : 1;
+		}
+		return differences;
+	}
+
+	// 1 ストリップ (1 回のラベリング) の結果が参照と一致し、どのストリップ数でもそれと同じ成分が同じ順番で求まることを調べます。
+	// 成分の番号はラスター順の最初の画素で決まるので、ストリップの分け方によらず並べ替えの結果も同じになります。
+	void CheckStripCounts(const std::vector<uint16_t>& depth, const std::vector<uint16_t>& background, uint32_t minArea, size_t expectedCount)
+	{
+		BlobDetector detector;
+		detector.SetMinimumArea(minArea);
+		detector.AccumulateBackground(background.data(), Width, Height);
+
+		std::vector<Blob> single;
+		detector.SetStripCount(1);
+		CHECK(detector.Detect(depth.data(), Width, Height, &single));
+		CHECK(single.size() == expectedCount);
+		CHECK(CountDifferences(single, ReferenceBlobs(depth, background, 40, 2000, minArea), 1.0e-3f) == 0);
+		const std::vector<uint8_t> singleMask(detector.GetForegroundMask(), detector.GetForegroundMask() + depth.size());
+
+		for (size_t s = 0; s <= sizeof(StripCounts) / sizeof(StripCounts[0]); s++)
+		{
+			// 最後は既定の、ワーカーの数から決めるストリップ数です。
+			detector.SetStripCount(s < sizeof(StripCounts) / sizeof(StripCounts[0]) ? StripCounts[s] : 0);
+			std::vector<Blob> strips;
+			CHECK(detector.Detect(depth.data(), Width, Height, &strips));
+			CHECK(strips.size() == single.size());
+			int differences = 0;
+			for (size_t i = 0; i < std::min(strips.size(), single.size()); i++)
+			{
+				differences += IsSameBlob(strips[i], single[i], 0.0f) ? 0 : 1;
+			}
+			CHECK(differences == 0);
+			CHECK(std::equal(singleMask.begin(), singleMask.end(), detector.GetForegroundMask()));
+		}
+	}
+
+	// ストリップの内側ではつながらず、どこかのストリップの境界の向こう側だけでつながる形です。
+	// 上から下まで往復する蛇行、下の行だけでつながる櫛、上の行だけでつながる逆さの櫛、2 本の腕が一番下でつながる U 字を置きます。
+	// 斜めにだけ接する市松模様の画素は、それぞれ別の成分です。
+	void TestShapesAcrossStripBoundaries()
+	{
+		std::mt19937 random(1);
+		const std::vector<uint16_t> background(Width * Height, BackgroundDepth);
+		std::vector<uint16_t> depth(background);
+		auto set = [&](uint32_t x, uint32_t y) { depth[y * Width + x] = ForegroundDepth(&random); };
+
+		// 蛇行: 左端の列から幅 1 の縦線を 4 列おきに引き、交互に一番上と一番下の行でつなぎます。
+		for (uint32_t column = 0; column < 10; column++)
+		{
+			const uint32_t x = column * 4;
+			for (uint32_t y = 0; y < Height; y++)
+			{
+				set(x, y);
+			}
+			if (column + 1 < 10)
+			{
+				const uint32_t y = column % 2 == 0 ? Height - 1 : 0;
+				for (uint32_t dx = 1; dx < 4; dx++)
+				{
+					set(x + dx, y);
+				}
+			}
+		}
+
+		// 櫛と逆さの櫛: 歯は 1 行目から最後の 1 つ前の行までで、根元の行だけでつながります。
+		for (uint32_t x = 60; x < 140; x++)
+		{
+			set(x, Height - 1);
+			set(x + 100, 0);
+		}
+		for (uint32_t x = 60; x < 140; x += 3)
+		{
+			for (uint32_t y = 1; y < Height - 1; y++)
+			{
+				set(x, y);
+				set(x + 100, y);
+			}
+		}
+
+		// U 字: 太さや高さの異なる腕が、一番下の行だけでつながります。
+		for (uint32_t u = 0; u < 6; u++)
+		{
+			const uint32_t left = 260 + u * 20;
+			const uint32_t top = u * 37;
+			const uint32_t bottom = Height - 1 - u * 11;
+			for (uint32_t y = top; y <= bottom; y++)
+			{
+				for (uint32_t dx = 0; dx <= u % 3; dx++)
+				{
+					set(left + dx, y);
+					set(left + 12 - dx, y);
+				}
+			}
+			for (uint32_t x = left; x <= left + 12; x++)
+			{
+				set(x, bottom);
+			}
+		}
+
+		// 市松模様: 4 近傍では 1 画素ずつの成分です。
+		for (uint32_t y = 0; y < Height; y++)
+		{
+			for (uint32_t x = 400; x < 420; x++)
+			{
+				if ((x + y) % 2 == 0)
+				{
+					set(x, y);
+				}
+			}
+		}
+
+		// 蛇行、櫛 2 つ、U 字 6 つと、市松模様の 20 * 424 / 2 画素です。
+		CheckStripCounts(depth, background, 1, 1 + 2 + 6 + 20 * Height / 2);
+		CheckStripCounts(depth, background, 2, 1 + 2 + 6);
+	}
+
+	// 乱数で置いた円と、測定できなかった (深度 0 の) 画素の穴がある場面です。背景にも深度 0 の画素があります。
+	void TestRandomScenes()
+	{
+		std::mt19937 random(2);
+		for (int scene = 0; scene < 4; scene++)
+		{
+			std::vector<uint16_t> background(Width * Height, BackgroundDepth);
+			std::vector<uint16_t> depth(background);
+			for (int disc = 0; disc < 60; disc++)
+			{
+				const int cx = random() % Width, cy = random() % Height, radius = 2 + random() % 30;
+				for (int y = std::max(0, cy - radius); y <= std::min(static_cast<int>(Height) - 1, cy + radius); y++)
+				{
+					for (int x = std::max(0, cx - radius); x <= std::min(static_cast<int>(Width) - 1, cx + radius); x++)
+					{
+						if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius)
+						{
+							depth[y * Width + x] = ForegroundDepth(&random);
+						}
+					}
+				}
+			}
+			for (int hole = 0; hole < 3000; hole++)
+			{
+				depth[random() % depth.size()] = 0;
+				background[random() % depth.size()] = 0;
+			}
+
+			const std::vector<Blob> reference = ReferenceBlobs(depth, background, 40, 2000, 1);
+			CHECK(reference.size() > 20);
+			CheckStripCounts(depth, background, 1, reference.size());
+		}
+	}
+
+	// 背景からの高さの範囲は両端を含みます。背景か深度が 0 の画素、背景より奥の画素は前景ではありません。
+	// 最小の面積より小さい成分は捨て、残りは面積の大きい順に並びます。
+	void TestForegroundRule()
+	{
+		const std::vector<uint16_t> background(Width * Height, BackgroundDepth);
+		std::vector<uint16_t> depth(background);
+		const uint16_t heights[] = { 39, 40, 41, 300, 1999, 2000, 2001 };
+		for (uint32_t h = 0; h < sizeof(heights) / sizeof(heights[0]); h++)
+		{
+			for (uint32_t y = 10; y < 20 + h; y++)
+			{
+				for (uint32_t x = 10 + h * 30; x < 30 + h * 30; x++)
+				{
+					depth[y * Width + x] = static_cast<uint16_t>(BackgroundDepth - heights[h]);
+				}
+			}
+		}
+		for (uint32_t x = 300; x < 320; x++)
+		{
+			depth[100 * Width + x] = BackgroundDepth + 100;
+			depth[101 * Width + x] = 0;
+		}
+
+		BlobDetector detector;
+		std::vector<Blob> blobs;
+		CHECK(!detector.Detect(depth.data(), Width, Height, &blobs));
+		detector.AccumulateBackground(background.data(), Width, Height);
+		CHECK(detector.GetBackgroundFrameCount() == 1);
+		CHECK(!detector.Detect(depth.data(), Width, Height - 1, &blobs));
+
+		detector.SetMinimumArea(200);
+		CHECK(detector.Detect(depth.data(), Width, Height, &blobs));
+		CHECK(blobs.size() == 5);
+		const uint32_t expectedAreas[] = { 20 * 15, 20 * 14, 20 * 13, 20 * 12, 20 * 11 };
+		const float expectedHeights[] = { 2000.0f, 1999.0f, 300.0f, 41.0f, 40.0f };
+		for (size_t i = 0; i < std::min(blobs.size(), static_cast<size_t>(5)); i++)
+		{
+			CHECK(blobs[i].area == expectedAreas[i]);
+			CHECK(blobs[i].meanHeight == expectedHeights[i]);
+			CHECK(blobs[i].minY == 10 && blobs[i].maxY == 10 + expectedAreas[i] / 20 - 1);
+		}
+
+		// 面積が最小の面積と同じ成分は残ります。範囲を狭めると、外れた高さの成分は消えます。
+		detector.SetMinimumArea(220);
+		CHECK(detector.Detect(depth.data(), Width, Height, &blobs) && blobs.size() == 5);
+		detector.SetMinimumArea(221);
+		CHECK(detector.Detect(depth.data(), Width, Height, &blobs) && blobs.size() == 4);
+		detector.SetHeightRange(301, 1999);
+		CHECK(detector.Detect(depth.data(), Width, Height, &blobs));
+		CHECK(blobs.size() == 1 && blobs[0].meanHeight == 1999.0f);
+
+		detector.ResetBackground();
+		CHECK(!detector.Detect(depth.data(), Width, Height, &blobs) && blobs.empty());
+	}
+}
+
+int main()
+{
+	TestShapesAcrossStripBoundaries();
+	TestRandomScenes();
+	TestForegroundRule();
+	return TestCheck::TestResult();
+}
@@ -0,0 +1,290 @@
+﻿#include "Rendering/CpuRenderBackend.h"
+#include "Rendering/InstanceTransforms.h"
+#include "TestCheck.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const uint32_t Width = 160;
+	const uint32_t Height = 96;
+
+	// 参照画像との比較の許容値。SIMD の有無やコンパイラーによる丸めの違いで、チャネルが少しずれたり、
+	// 辺の上の画素の判定が変わったりすることは許します。
+	const int MaxChannelDifference = 2;
+	const uint32_t MaxMismatchedPixels = Width * Height / 200;
+
+	// Sample3DSceneRenderer と同じ立方体。
+	const MeshVertex CubeVertices[] =
+	{
+		{ { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 0.0f } },
+		{ { -0.5f, -0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } },
+		{ { -0.5f,  0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f } },
+		{ { -0.5f,  0.5f,  0.5f }, { 0.0f, 1.0f, 1.0f } },
+		{ {  0.5f, -0.5f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+		{ {  0.5f, -0.5f,  0.5f }, { 1.0f, 0.0f, 1.0f } },
+		{ {  0.5f,  0.5f, -0.5f }, { 1.0f, 1.0f, 0.0f } },
+		{ {  0.5f,  0.5f,  0.5f }, { 1.0f, 1.0f, 1.0f } },
+	};
+
+	const uint16_t CubeIndices[] =
+	{
+		0, 2, 1, 1, 2, 3,
+		4, 5, 6, 5, 7, 6,
+		0, 1, 5, 0, 5, 4,
+		2, 6, 7, 2, 7, 3,
+		0, 4, 6, 0, 6, 2,
+		1, 3, 7, 1, 7, 5,
+	};
+
+	const uint32_t CubeIndexCount = sizeof(CubeIndices) / sizeof(CubeIndices[0]);
+
+	// 頂点シェーダーと同じく、転置した行列を定数バッファーの先頭に置きます。
+	void WriteConstants(const Matrix& matrix, void* destination)
+	{
+		const Float4x4 transposed = matrix.Transpose().ToFloat4x4();
+		memcpy(destination, &transposed, sizeof(transposed));
+	}
+
+	// 固定のバッファー、リング バッファーの定数、まとめた描画、ビューポート、インスタンス化した描画を
+	// CommandList に記録して描画します。
+	void RenderScene(CpuRenderBackend* backend)
+	{
+		const Matrix view = Matrix::LookAtRH(Vector::Set(0.0f, 0.7f, 2.5f, 0.0f), Vector::Zero(), Vector::Set(0.0f, 1.0f, 0.0f, 0.0f));
+		const Matrix projection = Matrix::PerspectiveFovRH(1.0f, static_cast<float>(Width) / Height, 0.1f, 100.0f);
+		const Matrix viewProjection = view * projection;
+
+		BufferDescription description;
+		description.usage = BufferDescription::Vertex;
+		description.size = sizeof(CubeVertices);
+		description.initialData = CubeVertices;
+		const BufferHandle vertexBuffer = backend->CreateBuffer(description);
+
+		description.usage = BufferDescription::Index;
+		description.size = sizeof(CubeIndices);
+		description.initialData = CubeIndices;
+		const BufferHandle indexBuffer = backend->CreateBuffer(description);
+
+		// 固定の定数バッファーに 2 つのオブジェクトの行列を置きます。
+		std::vector<uint8_t> constants(RenderBackend::ConstantAlignment * 2);
+		WriteConstants(Matrix::RotationY(0.6f) * Matrix::Translation(-1.1f, 0.2f, 0.0f) * viewProjection, &constants[0]);
+		WriteConstants(Matrix::Scaling(0.8f, 0.8f, 0.8f) * Matrix::RotationY(-0.4f) * Matrix::Translation(1.1f, 0.2f, -0.5f) * viewProjection, &constants[RenderBackend::ConstantAlignment]);
+		description.usage = BufferDescription::Constant;
+		description.size = static_cast<uint32_t>(constants.size());
+		description.initialData = constants.data();
+		const BufferHandle constantBuffer = backend->CreateBuffer(description);
+
+		std::vector<uint8_t> frameConstants(RenderBackend::ConstantAlignment);
+		WriteConstants(viewProjection, frameConstants.data());
+		description.size = static_cast<uint32_t>(frameConstants.size());
+		description.initialData = frameConstants.data();
+		const BufferHandle frameConstantBuffer = backend->CreateBuffer(description);
+
+		PipelineDescription pipelineDescription = {};
+		pipelineDescription.cullMode = PipelineDescription::CullBack;
+		pipelineDescription.vertexLayout = PipelineDescription::PositionColor;
+		const PipelineHandle pipeline = backend->CreatePipeline(pipelineDescription);
+		pipelineDescription.vertexLayout = PipelineDescription::PositionColorInstance;
+		const PipelineHandle instancedPipeline = backend->CreatePipeline(pipelineDescription);
+
+		backend->BeginFrame();
+
+		CommandList commands;
+		const float background[4] = { 0.39f, 0.58f, 0.93f, 1.0f };
+		commands.Clear(background, 1.0f);
+
+		DrawPacket packet = {};
+		packet.pipeline = pipeline;
+		packet.vertexBuffer = vertexBuffer;
+		packet.indexBuffer = indexBuffer;
+		packet.objectConstants.buffer = constantBuffer;
+		packet.objectConstants.size = RenderBackend::ConstantAlignment;
+		packet.vertexStride = sizeof(MeshVertex);
+		packet.indexFormat = DrawPacket::Index16;
+		packet.indexCount = CubeIndexCount;
+
+		// 左の立方体は 1 回で描画します。
+		commands.Draw(packet);
+
+		// 右の立方体は 2 つの範囲に分けて、まとめた描画にします。
+		packet.objectConstants.offset = RenderBackend::ConstantAlignment;
+		const DrawRange ranges[2] = { { 18, 0, 0 }, { 18, 18, 0 } };
+		commands.DrawBatch(packet, ranges, 2);
+
+		// 中央の立方体の行列はリング バッファーに書き込みます。
+		TransientAllocation transient;
+		CHECK(backend->AllocateTransient(BufferDescription::Constant, RenderBackend::ConstantAlignment, RenderBackend::ConstantAlignment, &transient));
+		WriteConstants(Matrix::Scaling(0.6f, 0.6f, 0.6f) * Matrix::RotationY(1.2f) * Matrix::Translation(0.0f, 0.1f, 0.3f) * viewProjection, transient.data);
+		packet.objectConstants.buffer = transient.buffer;
+		packet.objectConstants.offset = transient.offset;
+		commands.Draw(packet);
+
+		// 下の帯のビューポートに、色の違う小さな立方体を 1 回のインスタンス化した描画で並べます。
+		InstanceTransforms instances;
+		instances.Resize(4);
+		for (size_t i = 0; i < instances.GetCount(); i++)
+		{
+			// y 軸まわりに 0.3 * i ラジアン回転します。
+			const float shade = 0.25f * (i + 1);
+			instances.positionX[i] = -1.5f + i;
+			instances.positionY[i] = 0.0f;
+			instances.positionZ[i] = 0.0f;
+			instances.rotationY[i] = std::sin(0.15f * i);
+			instances.rotationW[i] = std::cos(0.15f * i);
+			instances.scale[i] = 0.5f;
+			instances.colorR[i] = shade;
+			instances.colorG[i] = 1.0f - shade;
+			instances.colorB[i] = 0.5f;
+		}
+
+		TransientAllocation instanceData;
+		CHECK(backend->AllocateTransient(BufferDescription::Vertex, static_cast<uint32_t>(instances.GetCount() * sizeof(InstanceData)), sizeof(InstanceData), &instanceData));
+		instances.Write(0, instances.GetCount(), static_cast<InstanceData*>(instanceData.data));
+
+		commands.SetViewport(0.0f, Height * 0.5f, static_cast<float>(Width), Height * 0.5f);
+		DrawPacket instancedPacket = packet;
+		instancedPacket.pipeline = instancedPipeline;
+		instancedPacket.frameConstants.buffer = frameConstantBuffer;
+		instancedPacket.frameConstants.offset = 0;
+		instancedPacket.frameConstants.size = 0;
+		instancedPacket.objectConstants.buffer = InvalidHandle;
+		instancedPacket.instanceBuffer = instanceData.buffer;
+		instancedPacket.instanceOffset = instanceData.offset;
+		instancedPacket.instanceCount = static_cast<uint32_t>(instances.GetCount());
+		commands.Draw(instancedPacket);
+
+		backend->Submit(commands);
+
+		const SubmitStatistics& statistics = backend->GetStatistics();
+		CHECK(statistics.draws == 5);
+
+		backend->DestroyPipeline(instancedPipeline);
+		backend->DestroyPipeline(pipeline);
+		backend->DestroyBuffer(frameConstantBuffer);
+		backend->DestroyBuffer(constantBuffer);
+		backend->DestroyBuffer(indexBuffer);
+		backend->DestroyBuffer(vertexBuffer);
+	}
+
+	// BGRA8 の画像を RGB の PPM (P6) として書き込みます。
+	bool WritePpm(const std::string& path, const std::vector<uint32_t>& pixels, uint32_t width, uint32_t height)
+	{
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
+
+		fprintf(file, "P6\n%u %u\n255\n", width, height);
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			const uint8_t rgb[3] =
+			{
+				static_cast<uint8_t>(pixels[i] >> 16),
+				static_cast<uint8_t>(pixels[i] >> 8),
+				static_cast<uint8_t>(pixels[i])
+			};
+			fwrite(rgb, 1, sizeof(rgb), file);
+		}
+		return fclose(file) == 0;
+	}
+
+	// WritePpm で書き込んだ画像を BGRA8 として読み込みます。
+	bool ReadPpm(const std::string& path, std::vector<uint32_t>* pixels, uint32_t* width, uint32_t* height)
+	{
+		FILE* file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+
+		unsigned int maxValue = 0;
+		bool ok = fscanf(file, "P6 %u %u %u", width, height, &maxValue) == 3 && maxValue == 255 && fgetc(file) != EOF;
+		if (ok)
+		{
+			pixels->resize(static_cast<size_t>(*width) * *height);
+			for (size_t i = 0; ok && i < pixels->size(); i++)
+			{
+				uint8_t rgb[3];
+				ok = fread(rgb, 1, sizeof(rgb), file) == sizeof(rgb);
+				(*pixels)[i] = 0xFF000000u | (static_cast<uint32_t>(rgb[0]) << 16) | (static_cast<uint32_t>(rgb[1]) << 8) | rgb[2];
+			}
+		}
+		fclose(file);
+		return ok;
+	}
+
+	int ChannelDifference(uint32_t a, uint32_t b, int shift)
+	{
+		return abs(static_cast<int>((a >> shift) & 0xFF) - static_cast<int>((b >> shift) & 0xFF));
+	}
+}
+
+// 引数に --write-reference を指定すると、参照画像を描画結果で置き換えます。描画を意図して変えた場合に使用します。
+int main(int argc, char** argv)
+{
+	const std::string referencePath = std::string(TEST_DATA_DIR) + "/CpuRenderBackendTest.ppm";
+
+	CpuRenderBackend backend;
+	backend.SetRenderTargetSize(Width, Height);
+	RenderScene(&backend);
+
+	const SoftwareRasterizer& rasterizer = backend.GetRasterizer();
+	std::vector<uint32_t> image(Width * Height);
+	for (uint32_t y = 0; y < Height; y++)
+	{
+		for (uint32_t x = 0; x < Width; x++)
+		{
+			image[y * Width + x] = rasterizer.GetColorBuffer()[y * rasterizer.GetStride() + x] | 0xFF000000u;
+		}
+	}
+
+	if (argc > 1 && strcmp(argv[1], "--write-reference") == 0)
+	{
+		CHECK(WritePpm(referencePath, image, Width, Height));
+		return TestCheck::TestResult();
+	}
+
+	std::vector<uint32_t> reference;
+	uint32_t referenceWidth = 0;
+	uint32_t referenceHeight = 0;
+	CHECK(ReadPpm(referencePath, &reference, &referenceWidth, &referenceHeight));
+	CHECK(referenceWidth == Width && referenceHeight == Height);
+
+	if (reference.size() == image.size())
+	{
+		uint32_t mismatched = 0;
+		for (size_t i = 0; i < image.size(); i++)
+		{
+			for (int shift = 0; shift < 24; shift += 8)
+			{
+				if (ChannelDifference(image[i], reference[i], shift) > MaxChannelDifference)
+				{
+					mismatched++;
+					break;
+				}
+			}
+		}
+
+		if (mismatched > MaxMismatchedPixels)
+		{
+			fprintf(stderr, "%u pixels differ from %s\n", mismatched, referencePath.c_str());
+		}
+		CHECK(mismatched <= MaxMismatchedPixels);
+	}
+
+	// 失敗した場合は比較できるように描画結果を残します。
+	if (TestCheck::GetFailureCount() != 0)
+	{
+		WritePpm("CpuRenderBackendTest.actual.ppm", image, Width, Height);
+	}
+
+	return TestCheck::TestResult();
+}
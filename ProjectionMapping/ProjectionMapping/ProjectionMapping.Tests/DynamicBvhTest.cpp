@@ -0,0 +1,208 @@
+﻿#include "Rendering/DynamicBvh.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const int ProxyCount = 5000;
+
+	// (0, 3, 12) から (2, 0, 0) を見る視錐台。箱は -10..10 の範囲に散らばるので、一部だけが見えます。
+	Frustum MakeFrustum()
+	{
+		const Matrix view = Matrix::LookAtRH(Vector::Set(0.0f, 3.0f, 12.0f, 0.0f), Vector::Set(2.0f, 0.0f, 0.0f, 0.0f), Vector::Set(0.0f, 1.0f, 0.0f, 0.0f));
+		const Matrix projection = Matrix::PerspectiveFovRH(1.0f, 1.5f, 0.1f, 30.0f);
+		return Frustum::FromViewProjection((view * projection).ToFloat4x4());
+	}
+
+	// Cull の結果が、生きている箱をそれぞれ Frustum::Test で判定した結果と同じかどうか。同じ userData が 2 回入る場合も違いとします。
+	bool CullsLikeFrustumTest(const DynamicBvh& bvh, const Frustum& frustum, const std::vector<Aabb>& boxes, const std::vector<uint8_t>& alive)
+	{
+		std::vector<uint32_t> visible;
+		bvh.Cull(frustum, &visible);
+		std::sort(visible.begin(), visible.end());
+
+		std::vector<uint32_t> expected;
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (alive[i] && frustum.Test(boxes[i]) != Frustum::Outside)
+			{
+				expected.push_back(static_cast<uint32_t>(i));
+			}
+		}
+		return visible == expected;
+	}
+
+	void Translate(Aabb* box, float dx, float dy, float dz)
+	{
+		const float offset[3] = { dx, dy, dz };
+		for (int a = 0; a < 3; a++)
+		{
+			box->min[a] += offset[a];
+			box->max[a] += offset[a];
+		}
+	}
+
+	// userData に箱の番号を入れた木。
+	void CreateRandomBoxes(std::mt19937* random, DynamicBvh* bvh, std::vector<Aabb>* boxes, std::vector<uint32_t>* proxies)
+	{
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> extent(0.01f, 0.3f);
+		boxes->resize(ProxyCount);
+		proxies->resize(ProxyCount);
+		for (int i = 0; i < ProxyCount; i++)
+		{
+			(*boxes)[i] = Aabb::FromCenterExtent(position(*random), position(*random) * 0.2f, position(*random), extent(*random), extent(*random), extent(*random));
+			(*proxies)[i] = bvh->CreateProxy((*boxes)[i], static_cast<uint32_t>(i));
+		}
+	}
+
+	// 毎フレーム少しずつ動く場合は refit だけで、結果は箱ごとの判定と同じです。
+	void TestRefitMatchesFrustumTest()
+	{
+		std::mt19937 random(1);
+		DynamicBvh bvh;
+		std::vector<Aabb> boxes;
+		std::vector<uint32_t> proxies;
+		CreateRandomBoxes(&random, &bvh, &boxes, &proxies);
+		bvh.Update();
+		CHECK(bvh.GetProxyCount() == ProxyCount);
+		CHECK(bvh.GetRebuildCount() == 1);
+
+		const Frustum frustum = MakeFrustum();
+		const std::vector<uint8_t> alive(ProxyCount, 1);
+		CHECK(CullsLikeFrustumTest(bvh, frustum, boxes, alive));
+
+		int mismatches = 0;
+		for (int frame = 0; frame < 20; frame++)
+		{
+			for (int i = 0; i < ProxyCount; i++)
+			{
+				const float d = 0.05f * std::sin(frame * 0.3f + i);
+				Translate(&boxes[i], d, d, d);
+				bvh.MoveProxy(proxies[i], boxes[i]);
+			}
+			bvh.Update();
+			mismatches += CullsLikeFrustumTest(bvh, frustum, boxes, alive) ? 0 : 1;
+		}
+		CHECK(mismatches == 0);
+		CHECK(bvh.GetRebuildCount() == 1);
+		CHECK(bvh.GetCostRatio() > 1.0f);
+	}
+
+	// 大きく散らばると SAH のコストが上がって作り直します。作り直した後も結果は同じです。
+	void TestRebuildMatchesFrustumTest()
+	{
+		std::mt19937 random(2);
+		DynamicBvh bvh;
+		std::vector<Aabb> boxes;
+		std::vector<uint32_t> proxies;
+		CreateRandomBoxes(&random, &bvh, &boxes, &proxies);
+		bvh.Update();
+
+		const Frustum frustum = MakeFrustum();
+		const std::vector<uint8_t> alive(ProxyCount, 1);
+		std::uniform_real_distribution<float> scatter(-5.0f, 5.0f);
+		int mismatches = 0;
+		for (int frame = 0; frame < 6; frame++)
+		{
+			for (int i = 0; i < ProxyCount; i++)
+			{
+				Translate(&boxes[i], scatter(random), 0.0f, scatter(random));
+				bvh.MoveProxy(proxies[i], boxes[i]);
+			}
+			bvh.Update();
+			CHECK(bvh.GetCostRatio() <= 1.5f);
+			mismatches += CullsLikeFrustumTest(bvh, frustum, boxes, alive) ? 0 : 1;
+		}
+		CHECK(mismatches == 0);
+		CHECK(bvh.GetRebuildCount() > 1);
+
+		// しきい値を 1 にすると、コストが少しでも上がれば作り直します。
+		// 1 つの箱を全体の境界の内側で反対側へ動かし、その葉から根までの境界を広げます。
+		bvh.SetRebuildThreshold(1.0f);
+		const uint32_t rebuilds = bvh.GetRebuildCount();
+		const float centerX = boxes[0].min[0] + boxes[0].max[0];
+		const float centerZ = boxes[0].min[2] + boxes[0].max[2];
+		Translate(&boxes[0], -centerX, 0.0f, -centerZ);
+		bvh.MoveProxy(proxies[0], boxes[0]);
+		bvh.Update();
+		CHECK(bvh.GetRebuildCount() == rebuilds + 1);
+		CHECK(CullsLikeFrustumTest(bvh, frustum, boxes, alive));
+	}
+
+	// 削除したオブジェクトは返さず、番号は再利用します。
+	void TestDestroyAndReuse()
+	{
+		std::mt19937 random(3);
+		DynamicBvh bvh;
+		std::vector<Aabb> boxes;
+		std::vector<uint32_t> proxies;
+		CreateRandomBoxes(&random, &bvh, &boxes, &proxies);
+		bvh.Update();
+
+		const Frustum frustum = MakeFrustum();
+		std::vector<uint8_t> alive(ProxyCount, 1);
+		for (int i = 0; i < ProxyCount; i += 2)
+		{
+			bvh.DestroyProxy(proxies[i]);
+			alive[i] = 0;
+		}
+		// 同じオブジェクトを 2 回削除しても何も起きません。
+		bvh.DestroyProxy(proxies[0]);
+		bvh.Update();
+		CHECK(bvh.GetProxyCount() == ProxyCount / 2);
+		CHECK(CullsLikeFrustumTest(bvh, frustum, boxes, alive));
+
+		// 新しいオブジェクトは削除した番号を使い、次の Update で木に入ります。
+		const uint32_t proxy = bvh.CreateProxy(boxes[0], 0);
+		CHECK(proxy < ProxyCount && proxy % 2 == 0);
+		alive[0] = 1;
+		bvh.Update();
+		CHECK(bvh.GetProxyCount() == ProxyCount / 2 + 1);
+		CHECK(CullsLikeFrustumTest(bvh, frustum, boxes, alive));
+	}
+
+	// 中心がすべて同じ場合は分割できないので、深さの上限で 1 枚の葉にまとめます。空の木は何も返しません。
+	void TestDegenerateTrees()
+	{
+		DynamicBvh equal;
+		const int equalCount = 100;
+		for (int i = 0; i < equalCount; i++)
+		{
+			equal.CreateProxy(Aabb::FromCenterExtent(0.0f, 0.0f, -5.0f, 1.0f, 1.0f, 1.0f), static_cast<uint32_t>(i));
+		}
+		equal.Update();
+
+		std::vector<uint32_t> visible;
+		equal.Cull(Frustum(), &visible);
+		std::sort(visible.begin(), visible.end());
+		CHECK(visible.size() == equalCount);
+		for (int i = 0; i < equalCount && i < static_cast<int>(visible.size()); i++)
+		{
+			CHECK(visible[i] == static_cast<uint32_t>(i));
+		}
+		CHECK(equal.GetNodeCount() < 2 * DynamicBvh::MaxDepth);
+
+		DynamicBvh empty;
+		empty.Update();
+		visible.push_back(1);
+		empty.Cull(MakeFrustum(), &visible);
+		CHECK(visible.empty());
+		CHECK(empty.GetNodeCount() == 0);
+	}
+}
+
+int main()
+{
+	TestRefitMatchesFrustumTest();
+	TestRebuildMatchesFrustumTest();
+	TestDestroyAndReuse();
+	TestDegenerateTrees();
+	return TestCheck::TestResult();
+}
@@ -0,0 +1,176 @@
+﻿#include "Reconstruction/IcpTracker.h"
+#include "SyntheticDepth.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 参照のカメラ座標で、床 (y = 0.8)、左の壁 (x = -1.2)、奥の壁 (z = 3) の角の前に球がある場面を、
+	// pose (カメラ座標から参照のカメラ座標への変換) のカメラから見た深度。3 つの平面で 6 自由度がすべて決まります。
+	void RenderRoom(const RigidTransform& pose, std::vector<uint16_t>* depth)
+	{
+		const DepthCameraIntrinsics intrinsics = SyntheticDepth::GetIntrinsics();
+		const float* origin = pose.translation;
+		const float center[3] = { 0.3f, 0.2f, 2.0f };
+		const float radius = 0.4f;
+
+		depth->assign(SyntheticDepth::Width * SyntheticDepth::Height, 0);
+		for (uint32_t y = 0; y < SyntheticDepth::Height; y++)
+		{
+			for (uint32_t x = 0; x < SyntheticDepth::Width; x++)
+			{
+				// カメラ座標の方向 (rx, ry, 1) の光線。交点までの t は、そのままカメラ座標の z です。
+				const float ray[3] = { (x - intrinsics.cx) / intrinsics.fx, (y - intrinsics.cy) / intrinsics.fy, 1.0f };
+				float direction[3];
+				pose.ApplyRotation(ray, direction);
+
+				float nearest = 8.0f;
+				const int axes[3] = { 2, 1, 0 };
+				const float planes[3] = { 3.0f, 0.8f, -1.2f };
+				for (int i = 0; i < 3; i++)
+				{
+					if (std::fabs(direction[axes[i]]) > 1.0e-6f)
+					{
+						const float t = (planes[i] - origin[axes[i]]) / direction[axes[i]];
+						nearest = t > 0.0f ? std::min(nearest, t) : nearest;
+					}
+				}
+
+				float oc[3], a = 0.0f, b = 0.0f, c = -radius * radius;
+				for (int i = 0; i < 3; i++)
+				{
+					oc[i] = origin[i] - center[i];
+					a += direction[i] * direction[i];
+					b += 2.0f * oc[i] * direction[i];
+					c += oc[i] * oc[i];
+				}
+				const float discriminant = b * b - 4.0f * a * c;
+				if (discriminant >= 0.0f)
+				{
+					const float t = (-b - std::sqrt(discriminant)) / (2.0f * a);
+					nearest = t > 0.0f ? std::min(nearest, t) : nearest;
+				}
+
+				(*depth)[y * SyntheticDepth::Width + x] = nearest < 8.0f ? static_cast<uint16_t>(nearest * 1000.0f + 0.5f) : 0;
+			}
+		}
+	}
+
+	// y 軸まわりに yaw、x 軸まわりに pitch (ラジアン) 回転して、translation だけ動いたカメラ。
+	RigidTransform MakePose(float yaw, float pitch, float tx, float ty, float tz)
+	{
+		RigidTransform rotationY = RigidTransform::Identity();
+		rotationY.rotation[0][0] = std::cos(yaw);
+		rotationY.rotation[0][2] = std::sin(yaw);
+		rotationY.rotation[2][0] = -std::sin(yaw);
+		rotationY.rotation[2][2] = std::cos(yaw);
+
+		RigidTransform rotationX = RigidTransform::Identity();
+		rotationX.rotation[1][1] = std::cos(pitch);
+		rotationX.rotation[1][2] = -std::sin(pitch);
+		rotationX.rotation[2][1] = std::sin(pitch);
+		rotationX.rotation[2][2] = std::cos(pitch);
+
+		RigidTransform pose = rotationY * rotationX;
+		pose.translation[0] = tx;
+		pose.translation[1] = ty;
+		pose.translation[2] = tz;
+		return pose;
+	}
+
+	// 回転行列の要素の差の最大値と、並進の差の最大値 (メートル)。
+	void PoseError(const RigidTransform& a, const RigidTransform& b, float* rotationError, float* translationError)
+	{
+		*rotationError = 0.0f;
+		*translationError = 0.0f;
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				*rotationError = std::max(*rotationError, std::fabs(a.rotation[i][j] - b.rotation[i][j]));
+			}
+			*translationError = std::max(*translationError, std::fabs(a.translation[i] - b.translation[i]));
+		}
+	}
+
+	const float Degree = 3.14159265f / 180.0f;
+
+	// 3 度と 2 度の回転と数センチメートルの並進を、単位行列の初期値から推定します。
+	void TestRecoversKnownPose()
+	{
+		std::vector<uint16_t> reference, current;
+		RenderRoom(RigidTransform::Identity(), &reference);
+
+		IcpTracker tracker;
+		CHECK(tracker.SetReference(reference.data(), SyntheticDepth::GetIntrinsics()));
+
+		const RigidTransform expected = MakePose(3.0f * Degree, 2.0f * Degree, 0.04f, -0.02f, 0.03f);
+		RenderRoom(expected, &current);
+
+		IcpResult result;
+		CHECK(tracker.Track(current.data(), SyntheticDepth::GetIntrinsics(), RigidTransform::Identity(), &result));
+
+		float rotationError, translationError;
+		PoseError(result.pose, expected, &rotationError, &translationError);
+		CHECK(rotationError < 0.002f);
+		CHECK(translationError < 0.002f);
+		CHECK(result.rmsError < 0.002f);
+		CHECK(result.inlierCount > SyntheticDepth::Width * SyntheticDepth::Height / 4);
+
+		// 前のフレームの結果を初期値にすると、少ない反復で同じ姿勢になります。
+		IcpResult refined;
+		CHECK(tracker.Track(current.data(), SyntheticDepth::GetIntrinsics(), result.pose, &refined));
+		PoseError(refined.pose, expected, &rotationError, &translationError);
+		CHECK(rotationError < 0.002f && translationError < 0.002f);
+		CHECK(refined.iterations <= result.iterations);
+	}
+
+	// 参照と同じフレームは単位行列のままです。
+	void TestIdentity()
+	{
+		std::vector<uint16_t> reference;
+		RenderRoom(RigidTransform::Identity(), &reference);
+
+		IcpTracker tracker;
+		CHECK(tracker.SetReference(reference.data(), SyntheticDepth::GetIntrinsics()));
+
+		IcpResult result;
+		CHECK(tracker.Track(reference.data(), SyntheticDepth::GetIntrinsics(), RigidTransform::Identity(), &result));
+
+		float rotationError, translationError;
+		PoseError(result.pose, RigidTransform::Identity(), &rotationError, &translationError);
+		CHECK(rotationError < 1.0e-4f);
+		CHECK(translationError < 1.0e-4f);
+		CHECK(result.rmsError < 0.001f);
+	}
+
+	// 参照がない場合や、有効な深度がない場合は失敗します。
+	void TestFailures()
+	{
+		std::vector<uint16_t> depth;
+		RenderRoom(RigidTransform::Identity(), &depth);
+
+		IcpTracker tracker;
+		IcpResult result;
+		CHECK(!tracker.HasReference());
+		CHECK(!tracker.Track(depth.data(), SyntheticDepth::GetIntrinsics(), RigidTransform::Identity(), &result));
+
+		CHECK(tracker.SetReference(depth.data(), SyntheticDepth::GetIntrinsics()));
+		CHECK(tracker.HasReference());
+		const std::vector<uint16_t> empty(depth.size(), 0);
+		CHECK(!tracker.Track(empty.data(), SyntheticDepth::GetIntrinsics(), RigidTransform::Identity(), &result));
+	}
+}
+
+int main()
+{
+	TestRecoversKnownPose();
+	TestIdentity();
+	TestFailures();
+	return TestCheck::TestResult();
+}
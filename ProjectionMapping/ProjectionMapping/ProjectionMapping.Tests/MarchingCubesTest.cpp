@@ -0,0 +1,206 @@
+﻿#include "Reconstruction/MarchingCubes.h"
+#include "SyntheticDepth.h"
+#include "TestCheck.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// depth の (x0, y0) から (x1, y1) の手前の画素だけを残し、ほかは 0 (無効) にします。
+	// 残した画素の光線が通るブロックだけが統合されるので、ボリュームの一部だけが変わります。
+	void KeepWindow(uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1, std::vector<uint16_t>* depth)
+	{
+		for (uint32_t y = 0; y < SyntheticDepth::Height; y++)
+		{
+			for (uint32_t x = 0; x < SyntheticDepth::Width; x++)
+			{
+				if (x < x0 || x >= x1 || y < y0 || y >= y1)
+				{
+					(*depth)[y * SyntheticDepth::Width + x] = 0;
+				}
+			}
+		}
+	}
+
+	bool IsSameBlockMesh(const BlockMesh& a, const BlockMesh& b)
+	{
+		return a.coordinate.x == b.coordinate.x && a.coordinate.y == b.coordinate.y && a.coordinate.z == b.coordinate.z &&
+			a.indices == b.indices && a.vertices.size() == b.vertices.size() &&
+			(a.vertices.empty() || memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(MeshVertex)) == 0);
+	}
+
+	// incremental のメッシュが、同じ設定で volume 全体から抽出し直したメッシュと同じかどうか。違うブロックの数を返します。
+	int CountDifferences(const TsdfVolume& volume, const MarchingCubes& incremental, float simplifyRatio)
+	{
+		MarchingCubes full;
+		full.SetSimplification(simplifyRatio, 1.0e-5f);
+		std::vector<uint32_t> updated;
+		full.Update(volume, &updated);
+		if (full.GetMeshCount() != incremental.GetMeshCount())
+		{
+			return -1;
+		}
+
+		int differences = 0;
+		for (uint32_t i = 0; i < full.GetMeshCount(); i++)
+		{
+			differences += IsSameBlockMesh(full.GetMesh(i), incremental.GetMesh(i)) ? 0 : 1;
+		}
+		return differences;
+	}
+
+	// 壁の前の球を統合して抽出した後、一部の画素だけの 3 つのフレームを統合します。
+	// 変わったブロックとその -x、-y、-z 側の隣だけを作り直したメッシュが、すべてを抽出し直したメッシュと一致します。
+	void RunPartialUpdates(float simplifyRatio)
+	{
+		const DepthCameraIntrinsics intrinsics = SyntheticDepth::GetIntrinsics();
+		std::vector<uint16_t> depth;
+		const float center[3] = { 0.0f, 0.0f, 2.0f };
+		SyntheticDepth::RenderSphere(center, 0.5f, 2.5f, &depth);
+
+		TsdfVolume volume;
+		for (int frame = 0; frame < 3; frame++)
+		{
+			volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		}
+
+		MarchingCubes incremental;
+		incremental.SetSimplification(simplifyRatio, 1.0e-5f);
+		std::vector<uint32_t> updated;
+		CHECK(incremental.Update(volume, &updated) == volume.GetBlockCount());
+		CHECK(CountDifferences(volume, incremental, simplifyRatio) == 0);
+
+		// 変更がなければ何も作り直しません。
+		CHECK(incremental.Update(volume, &updated) == 0 && updated.empty());
+
+		// 球が 5 センチメートル右に動いたフレームの、右下の画素だけを統合します。窓の左の辺では、
+		// 統合したブロックの最初の列のボクセルが変わり、統合していない -x 側の隣のブロックのセルが表面をまたぎます。
+		const float movedCenter[3] = { 0.05f, 0.0f, 2.0f };
+		SyntheticDepth::RenderSphere(movedCenter, 0.5f, 2.5f, &depth);
+		KeepWindow(312, 150, 420, 260, &depth);
+		const uint32_t integrated = volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		const uint32_t rebuilt = incremental.Update(volume, &updated);
+		CHECK(rebuilt > integrated);
+		CHECK(rebuilt < volume.GetBlockCount() / 2);
+		CHECK(CountDifferences(volume, incremental, simplifyRatio) == 0);
+
+		// 球が下に動いたフレームの、下半分の画素だけを統合します。窓の上の辺では -y 側の隣のブロックが同じようになります。
+		const float lowerCenter[3] = { 0.0f, 0.05f, 2.0f };
+		SyntheticDepth::RenderSphere(lowerCenter, 0.5f, 2.5f, &depth);
+		KeepWindow(150, 212, 360, 380, &depth);
+		volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		CHECK(incremental.Update(volume, &updated) < volume.GetBlockCount() / 2);
+		CHECK(CountDifferences(volume, incremental, simplifyRatio) == 0);
+
+		// 左上に z = 1.2 の板が現れ、既存のブロックの隣に新しいブロックが割り当てられます。
+		const float point[3] = { 0.0f, 0.0f, 1.2f };
+		const float normal[3] = { 0.0f, 0.0f, -1.0f };
+		SyntheticDepth::RenderPlane(point, normal, &depth);
+		KeepWindow(60, 40, 180, 140, &depth);
+		const uint32_t blockCount = volume.GetBlockCount();
+		volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		CHECK(volume.GetBlockCount() > blockCount);
+		CHECK(incremental.Update(volume, &updated) < volume.GetBlockCount() / 2);
+		CHECK(CountDifferences(volume, incremental, simplifyRatio) == 0);
+	}
+
+	// ブロックの手前の面 (z = 19 * 8 ボクセル) のすぐ奥にある平面が、打ち切り距離より奥に下がります。
+	// 新しい平面の光線は手前のブロックを通らないので統合しませんが、その奥の面のセルは表面でなくなります。
+	void TestRecedingSurfaceRebuildsNearBlocks()
+	{
+		const DepthCameraIntrinsics intrinsics = SyntheticDepth::GetIntrinsics();
+		const float blockFace = 19 * TsdfVolume::BlockSize * 0.01f;
+		const float normal[3] = { 0.0f, 0.0f, -1.0f };
+		std::vector<uint16_t> depth;
+		const float point[3] = { 0.0f, 0.0f, blockFace + 0.003f };
+		SyntheticDepth::RenderPlane(point, normal, &depth);
+
+		TsdfVolume volume(0.01f, 0.04f);
+		for (int frame = 0; frame < 3; frame++)
+		{
+			volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		}
+		MarchingCubes incremental;
+		std::vector<uint32_t> updated;
+		incremental.Update(volume, &updated);
+
+		const float recededPoint[3] = { 0.0f, 0.0f, blockFace + 0.053f };
+		SyntheticDepth::RenderPlane(recededPoint, normal, &depth);
+		const uint32_t integrated = volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		CHECK(incremental.Update(volume, &updated) > integrated);
+		CHECK(CountDifferences(volume, incremental, 1.0f) == 0);
+	}
+
+	void TestPartialUpdateMatchesFullExtraction()
+	{
+		RunPartialUpdates(1.0f);
+	}
+
+	// 減らしたメッシュも、ブロックの内容だけで決まるので同じです。
+	void TestSimplifiedPartialUpdateMatchesFullExtraction()
+	{
+		RunPartialUpdates(0.5f);
+	}
+
+	// 1 回に作り直すブロック数を制限しても、残りは次の Update で作り直し、最後は同じメッシュになります。
+	// ボリュームを Reset すると、すべてを作り直します。
+	void TestBudgetAndReset()
+	{
+		const DepthCameraIntrinsics intrinsics = SyntheticDepth::GetIntrinsics();
+		std::vector<uint16_t> depth;
+		const float center[3] = { 0.0f, 0.0f, 2.0f };
+		SyntheticDepth::RenderSphere(center, 0.5f, 2.5f, &depth);
+
+		TsdfVolume volume;
+		volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+
+		const uint32_t budget = 50;
+		MarchingCubes incremental;
+		incremental.SetMaxBlocksPerUpdate(budget);
+		std::vector<uint32_t> updated;
+		uint32_t total = 0;
+		int updates = 0;
+		do
+		{
+			const uint32_t rebuilt = incremental.Update(volume, &updated);
+			CHECK(rebuilt <= budget);
+			total += rebuilt;
+			updates++;
+		} while (incremental.GetPendingBlockCount() > 0 && updates < 1000);
+		CHECK(total == volume.GetBlockCount());
+		CHECK(updates > 1);
+		CHECK(CountDifferences(volume, incremental, 1.0f) == 0);
+
+		// 予算の途中でブロックが変わっても、作り直し待ちの印は 1 つだけです。
+		volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		incremental.Update(volume, &updated);
+		volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		incremental.Update(volume, &updated);
+		CHECK(incremental.GetPendingBlockCount() <= volume.GetBlockCount());
+		while (incremental.GetPendingBlockCount() > 0)
+		{
+			incremental.Update(volume, &updated);
+		}
+		CHECK(CountDifferences(volume, incremental, 1.0f) == 0);
+
+		volume.Reset();
+		const float movedCenter[3] = { 0.1f, 0.0f, 1.8f };
+		SyntheticDepth::RenderSphere(movedCenter, 0.5f, 2.5f, &depth);
+		volume.Integrate(depth.data(), intrinsics, RigidTransform::Identity());
+		incremental.SetMaxBlocksPerUpdate(0xFFFFFFFF);
+		CHECK(incremental.Update(volume, &updated) == volume.GetBlockCount());
+		CHECK(CountDifferences(volume, incremental, 1.0f) == 0);
+	}
+}
+
+int main()
+{
+	TestPartialUpdateMatchesFullExtraction();
+	TestSimplifiedPartialUpdateMatchesFullExtraction();
+	TestRecedingSurfaceRebuildsNearBlocks();
+	TestBudgetAndReset();
+	return TestCheck::TestResult();
+}
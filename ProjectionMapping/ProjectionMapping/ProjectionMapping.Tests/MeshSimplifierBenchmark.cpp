@@ -0,0 +1,94 @@
+﻿#include "Reconstruction/MarchingCubes.h"
+#include "Reconstruction/MeshSimplifier.h"
+#include "Reconstruction/TsdfVolume.h"
+#include "SyntheticDepth.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+// センサーの解像度での MeshSimplifier のフレームあたりの時間。
+// 1. 深度画像の画素を頂点にしたメッシュ全体を半分に減らす時間 (フレームごとには間に合わない)。
+// 2. 実際の使い方どおり、MarchingCubes が作り直したブロックだけを SetMaxBlocksPerUpdate の予算内で減らす時間。
+namespace
+{
+	const float SphereRadius = 0.5f;
+	const float WallDepth = 3.0f;
+	const uint32_t NoBudget = 0xFFFFFFFF;
+
+	uint32_t CountTriangles(const MarchingCubes& marchingCubes)
+	{
+		uint32_t triangles = 0;
+		for (uint32_t i = 0; i < marchingCubes.GetMeshCount(); i++)
+		{
+			triangles += static_cast<uint32_t>(marchingCubes.GetMesh(i).indices.size() / 3);
+		}
+		return triangles;
+	}
+
+	void BenchmarkWholeMesh(const std::vector<uint16_t>& depth)
+	{
+		TriangleMesh mesh;
+		SyntheticDepth::BuildDepthMesh(depth, &mesh);
+		const uint32_t triangles = static_cast<uint32_t>(mesh.indices.size() / 3);
+
+		MeshSimplifier simplifier;
+		const SyntheticDepth::Stopwatch stopwatch;
+		const uint32_t remaining = simplifier.Simplify(&mesh, triangles / 2);
+		printf("whole depth mesh: %u -> %u triangles in %.1f ms\n", triangles, remaining, stopwatch.GetMilliseconds());
+	}
+
+	// 球が少しずつ動く場面を 1 フレームずつ統合し、Update ごとの時間を測ります。
+	void BenchmarkDirtyBlocks(float ratio, uint32_t maxBlocksPerUpdate)
+	{
+		const DepthCameraIntrinsics intrinsics = SyntheticDepth::GetIntrinsics();
+		const RigidTransform pose = RigidTransform::Identity();
+		std::vector<uint16_t> depth;
+
+		TsdfVolume volume;
+		MarchingCubes marchingCubes;
+		marchingCubes.SetSimplification(ratio, 1.0e-5f);
+		marchingCubes.SetMaxBlocksPerUpdate(maxBlocksPerUpdate);
+
+		const int FrameCount = 30;
+		std::vector<uint32_t> updated;
+		double total = 0.0;
+		double worst = 0.0;
+		uint32_t rebuilt = 0;
+		for (int frame = 0; frame < FrameCount; frame++)
+		{
+			const float center[3] = { 0.002f * frame, 0.0f, 2.0f };
+			SyntheticDepth::RenderSphere(center, SphereRadius, WallDepth, &depth);
+			volume.Integrate(depth.data(), intrinsics, pose);
+
+			const SyntheticDepth::Stopwatch stopwatch;
+			rebuilt += marchingCubes.Update(volume, &updated);
+			const double milliseconds = stopwatch.GetMilliseconds();
+			total += milliseconds;
+			worst = std::max(worst, milliseconds);
+		}
+
+		printf("ratio %.2f, budget %-9s: %6u blocks rebuilt over %d frames (%.3f ms each), update mean %.1f ms, worst %.1f ms, %u pending, %u triangles\n",
+			ratio, maxBlocksPerUpdate == NoBudget ? "none" : std::to_string(maxBlocksPerUpdate).c_str(), rebuilt, FrameCount, total / rebuilt,
+			total / FrameCount, worst, marchingCubes.GetPendingBlockCount(), CountTriangles(marchingCubes));
+	}
+}
+
+int main()
+{
+	std::vector<uint16_t> depth;
+	const float center[3] = { 0.0f, 0.0f, 2.0f };
+	SyntheticDepth::RenderSphere(center, SphereRadius, WallDepth, &depth);
+
+	printf("%ux%u depth frames\n", SyntheticDepth::Width, SyntheticDepth::Height);
+	BenchmarkWholeMesh(depth);
+
+	// 減らさない場合、予算なしで減らす場合、予算内で減らす場合。
+	BenchmarkDirtyBlocks(1.0f, NoBudget);
+	BenchmarkDirtyBlocks(0.5f, NoBudget);
+	BenchmarkDirtyBlocks(0.5f, 256);
+	return 0;
+}
@@ -0,0 +1,134 @@
+﻿#include "Common/ParallelFor.h"
+#include "TestCheck.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#if !defined(_MSC_VER)
+using namespace DX::Detail;
+
+namespace
+{
+	// 呼び出し元と合わせて 4 つのスレッドで実行するプール。
+	const unsigned int WorkerThreads = 3;
+
+	// すべてのインデックスを 1 回ずつ実行します。
+	void TestCoversRange()
+	{
+		WorkerPool pool(WorkerThreads);
+		CHECK(pool.GetWorkerCount() == WorkerThreads + 1);
+
+		std::vector<std::atomic<int>> counts(1000);
+		for (auto& count : counts)
+		{
+			count.store(0);
+		}
+
+		pool.Run(10, counts.size(), [&counts](size_t index) { counts[index]++; });
+
+		for (size_t i = 0; i < counts.size(); i++)
+		{
+			CHECK(counts[i].load() == (i < 10 ? 0 : 1));
+		}
+	}
+
+	// body の中の Run は、外側の body を実行しているスレッドで直列に実行します。呼び出し元のスレッドも含みます。
+	void TestNestedRun()
+	{
+		WorkerPool pool(WorkerThreads);
+
+		for (int iteration = 0; iteration < 200; iteration++)
+		{
+			std::atomic<int> innerCount(0);
+			std::atomic<int> foreignThreads(0);
+
+			pool.Run(0, 64, [&](size_t)
+			{
+				const std::thread::id outer = std::this_thread::get_id();
+				pool.Run(0, 4, [&](size_t)
+				{
+					if (std::this_thread::get_id() != outer)
+					{
+						foreignThreads++;
+					}
+					innerCount++;
+				});
+			});
+
+			CHECK(innerCount.load() == 64 * 4);
+			CHECK(foreignThreads.load() == 0);
+		}
+	}
+
+	// 入れ子の呼び出しの後も、呼び出し元のスレッドからの Run はワーカーに分配します。
+	void TestCallerRestored()
+	{
+		WorkerPool pool(WorkerThreads);
+		pool.Run(0, 2, [&pool](size_t) { pool.Run(0, 2, [](size_t) {}); });
+
+		// 2 つ目のスレッドが入ってくるまで各 body を待たせます。直列に実行された場合は時間切れになります。
+		std::atomic<int> entered(0);
+		std::atomic<bool> overlapped(false);
+		pool.Run(0, 2, [&](size_t)
+		{
+			entered++;
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+			while (entered.load() < 2 && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::yield();
+			}
+			if (entered.load() >= 2)
+			{
+				overlapped = true;
+			}
+		});
+		CHECK(overlapped.load());
+	}
+
+	// プールの外の 2 つのスレッドから同時に呼び出しても、それぞれの範囲を実行します。
+	void TestConcurrentCallers()
+	{
+		WorkerPool pool(WorkerThreads);
+		std::atomic<int> total(0);
+
+		auto caller = [&pool, &total]()
+		{
+			for (int iteration = 0; iteration < 100; iteration++)
+			{
+				pool.Run(0, 16, [&pool, &total](size_t)
+				{
+					pool.Run(0, 2, [&total](size_t) { total++; });
+				});
+			}
+		};
+
+		std::thread other(caller);
+		caller();
+		other.join();
+
+		CHECK(total.load() == 2 * 100 * 16 * 2);
+	}
+}
+#endif
+
+int main()
+{
+#if !defined(_MSC_VER)
+	TestCoversRange();
+	TestNestedRun();
+	TestCallerRestored();
+	TestConcurrentCallers();
+#endif
+
+	// 共有のプールを使用する入れ子の ParallelFor。
+	std::atomic<int> count(0);
+	DX::ParallelFor(0, 64, [&count](size_t)
+	{
+		DX::ParallelFor(0, 4, [&count](size_t) { count++; });
+	});
+	CHECK(count.load() == 64 * 4);
+
+	return TestCheck::TestResult();
+}
@@ -0,0 +1,155 @@
+﻿#include "Reconstruction/PointGrid.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	float SquaredDistance(const float* a, const float* b)
+	{
+		const float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// ランダムな点群。z = 0 の無効な点も混ぜます。
+	std::vector<float> MakePoints(uint32_t count, std::mt19937* random)
+	{
+		std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+		std::vector<float> points(count * 3);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			points[i * 3 + 0] = coordinate(*random);
+			points[i * 3 + 1] = coordinate(*random);
+			points[i * 3 + 2] = (i % 17 == 0) ? 0.0f : 1.0f + coordinate(*random);
+		}
+		return points;
+	}
+
+	// 半径内の点は総当たりと同じ集合になります。
+	void TestInRadiusMatchesBruteForce()
+	{
+		std::mt19937 random(1);
+		const uint32_t pointCount = 4000;
+		const std::vector<float> points = MakePoints(pointCount, &random);
+		const float radius = 0.15f;
+
+		PointGrid grid;
+		grid.Build(points.data(), pointCount, radius);
+
+		const uint32_t queryCount = 300;
+		const uint32_t maxResults = 4096;
+		const std::vector<float> queries = MakePoints(queryCount, &random);
+		std::vector<uint32_t> indices(queryCount * maxResults);
+		std::vector<uint32_t> counts(queryCount);
+		grid.FindInRadius(queries.data(), queryCount, radius, maxResults, indices.data(), counts.data());
+
+		int mismatches = 0;
+		for (uint32_t q = 0; q < queryCount; q++)
+		{
+			std::vector<uint32_t> expected;
+			for (uint32_t p = 0; p < pointCount; p++)
+			{
+				if (points[p * 3 + 2] != 0.0f && SquaredDistance(&queries[q * 3], &points[p * 3]) <= radius * radius)
+				{
+					expected.push_back(p);
+				}
+			}
+
+			std::vector<uint32_t> actual(indices.begin() + q * maxResults, indices.begin() + q * maxResults + counts[q]);
+			std::sort(actual.begin(), actual.end());
+			if (actual != expected || (counts[q] < maxResults && indices[q * maxResults + counts[q]] != PointGrid::InvalidIndex))
+			{
+				mismatches++;
+			}
+		}
+		CHECK(mismatches == 0);
+	}
+
+	// maxResults で打ち切り、結果の領域の外には書き込みません。0 の場合は何も書きません。
+	void TestInRadiusLimit()
+	{
+		std::mt19937 random(2);
+		const uint32_t pointCount = 2000;
+		const std::vector<float> points = MakePoints(pointCount, &random);
+
+		PointGrid grid;
+		grid.Build(points.data(), pointCount, 0.5f);
+
+		const float query[3] = { 0.0f, 0.0f, 1.0f };
+		const uint32_t Guard = 0xDEADBEEF;
+		std::vector<uint32_t> indices(8, Guard);
+		CHECK(grid.FindInRadius(query, 10.0f, 0, indices.data()) == 0);
+		CHECK(indices[0] == Guard);
+
+		CHECK(grid.FindInRadius(query, 10.0f, 3, indices.data()) == 3);
+		CHECK(indices[3] == Guard);
+
+		// まとめた問い合わせでも、問い合わせごとの領域を越えません。
+		const float queries[6] = { 0.0f, 0.0f, 1.0f, 0.5f, 0.5f, 1.5f };
+		std::fill(indices.begin(), indices.end(), Guard);
+		uint32_t counts[2] = { Guard, Guard };
+		grid.FindInRadius(queries, 2, 10.0f, 0, indices.data(), counts);
+		CHECK(counts[0] == 0 && counts[1] == 0);
+		CHECK(indices[0] == Guard);
+
+		std::fill(indices.begin(), indices.end(), Guard);
+		grid.FindInRadius(queries, 2, 10.0f, 2, indices.data(), counts);
+		CHECK(counts[0] == 2 && counts[1] == 2);
+		CHECK(indices[4] == Guard);
+	}
+
+	// k 近傍は総当たりの近い順と同じ距離になります。
+	void TestNearestMatchesBruteForce()
+	{
+		std::mt19937 random(3);
+		const uint32_t pointCount = 3000;
+		const std::vector<float> points = MakePoints(pointCount, &random);
+
+		PointGrid grid;
+		grid.Build(points.data(), pointCount, 0.1f);
+
+		const uint32_t k = 8;
+		const float maxRadius = 0.3f;
+		const uint32_t queryCount = 200;
+		const std::vector<float> queries = MakePoints(queryCount, &random);
+		std::vector<uint32_t> indices(queryCount * k);
+		std::vector<float> distances(queryCount * k);
+		std::vector<uint32_t> counts(queryCount);
+		grid.FindNearest(queries.data(), queryCount, k, maxRadius, indices.data(), distances.data(), counts.data());
+
+		int mismatches = 0;
+		for (uint32_t q = 0; q < queryCount; q++)
+		{
+			std::vector<float> expected;
+			for (uint32_t p = 0; p < pointCount; p++)
+			{
+				const float distance = SquaredDistance(&queries[q * 3], &points[p * 3]);
+				if (points[p * 3 + 2] != 0.0f && distance <= maxRadius * maxRadius)
+				{
+					expected.push_back(distance);
+				}
+			}
+			std::sort(expected.begin(), expected.end());
+			expected.resize(std::min<size_t>(expected.size(), k));
+
+			const std::vector<float> actual(distances.begin() + q * k, distances.begin() + q * k + counts[q]);
+			if (actual != expected)
+			{
+				mismatches++;
+			}
+		}
+		CHECK(mismatches == 0);
+	}
+}
+
+int main()
+{
+	TestInRadiusMatchesBruteForce();
+	TestInRadiusLimit();
+	TestNearestMatchesBruteForce();
+	return TestCheck::TestResult();
+}
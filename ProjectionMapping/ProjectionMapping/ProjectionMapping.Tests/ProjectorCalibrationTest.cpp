@@ -0,0 +1,257 @@
+﻿#include "Calibration/ProjectorCalibration.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const uint32_t ProjectorWidth = 1920;
+	const uint32_t ProjectorHeight = 1080;
+
+	// 深度カメラの右上から、y 軸まわりに 0.3、x 軸まわりに -0.2 ラジアン回して向けたプロジェクター。
+	// 多くのプロジェクターと同じく、レンズ シフトで主点が画像の中心からずれています。
+	ProjectorCalibration MakeTruth()
+	{
+		const ProjectorIntrinsics intrinsics = { 1400.0, 1380.0, 940.0, 620.0, 0.0, ProjectorWidth, ProjectorHeight };
+
+		const double a = 0.3, b = -0.2;
+		const double rotationY[3][3] = { { std::cos(a), 0.0, std::sin(a) }, { 0.0, 1.0, 0.0 }, { -std::sin(a), 0.0, std::cos(a) } };
+		const double rotationX[3][3] = { { 1.0, 0.0, 0.0 }, { 0.0, std::cos(b), -std::sin(b) }, { 0.0, std::sin(b), std::cos(b) } };
+
+		ProjectorExtrinsics extrinsics;
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				extrinsics.rotation[i][j] = 0.0;
+				for (int k = 0; k < 3; k++)
+				{
+					extrinsics.rotation[i][j] += rotationY[i][k] * rotationX[k][j];
+				}
+			}
+		}
+		extrinsics.translation[0] = 0.2;
+		extrinsics.translation[1] = -0.1;
+		extrinsics.translation[2] = 0.3;
+
+		ProjectorCalibration truth;
+		truth.Set(intrinsics, extrinsics);
+		return truth;
+	}
+
+	// 深度カメラの前の 1 x 1 x 1 メートルの範囲の点を投影し、画素に -noise..noise の一様な誤差を加えます。
+	std::vector<CalibrationCorrespondence> MakeCorrespondences(const ProjectorCalibration& truth, size_t count, double noise, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<double> lateral(-0.5, 0.5);
+		std::uniform_real_distribution<double> depth(1.5, 2.5);
+		std::uniform_real_distribution<double> error(-noise, noise);
+
+		std::vector<CalibrationCorrespondence> correspondences;
+		while (correspondences.size() < count)
+		{
+			CalibrationCorrespondence c;
+			c.x = lateral(random);
+			c.y = lateral(random);
+			c.z = depth(random);
+			if (truth.Project(c.x, c.y, c.z, &c.u, &c.v))
+			{
+				c.u += error(random);
+				c.v += error(random);
+				correspondences.push_back(c);
+			}
+		}
+		return correspondences;
+	}
+
+	// 対応点の再投影誤差の RMS (画素)。
+	double ReprojectionError(const ProjectorCalibration& calibration, const std::vector<CalibrationCorrespondence>& correspondences)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < correspondences.size(); i++)
+		{
+			const CalibrationCorrespondence& c = correspondences[i];
+			double u, v;
+			if (!calibration.Project(c.x, c.y, c.z, &u, &v))
+			{
+				return HUGE_VAL;
+			}
+			sum += (u - c.u) * (u - c.u) + (v - c.v) * (v - c.v);
+		}
+		return std::sqrt(sum / correspondences.size());
+	}
+
+	// 内部パラメーターの差の最大値 (画素)、回転行列の要素の差の最大値、並進の差の最大値 (メートル)。
+	void CompareCalibration(const ProjectorCalibration& a, const ProjectorCalibration& b, double* intrinsicsError, double* rotationError, double* translationError)
+	{
+		const ProjectorIntrinsics& ka = a.GetIntrinsics();
+		const ProjectorIntrinsics& kb = b.GetIntrinsics();
+		*intrinsicsError = std::max(std::max(std::fabs(ka.fx - kb.fx), std::fabs(ka.fy - kb.fy)),
+			std::max(std::max(std::fabs(ka.cx - kb.cx), std::fabs(ka.cy - kb.cy)), std::fabs(ka.skew - kb.skew)));
+
+		*rotationError = 0.0;
+		*translationError = 0.0;
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				*rotationError = std::max(*rotationError, std::fabs(a.GetExtrinsics().rotation[i][j] - b.GetExtrinsics().rotation[i][j]));
+			}
+			*translationError = std::max(*translationError, std::fabs(a.GetExtrinsics().translation[i] - b.GetExtrinsics().translation[i]));
+		}
+	}
+
+	// 誤差のない対応点からは、内部パラメーターと外部パラメーターがそのまま求まります。
+	void TestRecoversExactCalibration()
+	{
+		const ProjectorCalibration truth = MakeTruth();
+		ProjectorCalibration solved;
+		CHECK(solved.Solve(MakeCorrespondences(truth, 40, 0.0, 1), ProjectorWidth, ProjectorHeight));
+		CHECK(solved.IsValid());
+		CHECK(solved.GetIntrinsics().width == ProjectorWidth && solved.GetIntrinsics().height == ProjectorHeight);
+
+		double intrinsicsError, rotationError, translationError;
+		CompareCalibration(solved, truth, &intrinsicsError, &rotationError, &translationError);
+		CHECK(intrinsicsError < 0.01);
+		CHECK(rotationError < 1.0e-5);
+		CHECK(translationError < 1.0e-5);
+		CHECK(solved.GetReprojectionError() < 1.0e-3);
+	}
+
+	// 画素に 0.5 画素幅の誤差がある場合も、真の値の近くに求まります。Levenberg-Marquardt 法は再投影誤差を最小化するので、
+	// 対応点への当てはまりは真のキャリブレーションと同じかそれより良くなります。DLT の解だけではそうなりません。
+	void TestRecoversNoisyCalibration()
+	{
+		const ProjectorCalibration truth = MakeTruth();
+		const std::vector<CalibrationCorrespondence> correspondences = MakeCorrespondences(truth, 60, 0.25, 2);
+		ProjectorCalibration solved;
+		CHECK(solved.Solve(correspondences, ProjectorWidth, ProjectorHeight));
+
+		double intrinsicsError, rotationError, translationError;
+		CompareCalibration(solved, truth, &intrinsicsError, &rotationError, &translationError);
+		CHECK(intrinsicsError < 5.0);
+		CHECK(rotationError < 2.0e-3);
+		CHECK(translationError < 5.0e-3);
+
+		// 再投影誤差は点ごとの (u, v) の誤差の長さの RMS で、加えた一様な誤差では 0.25 * sqrt(2 / 3) = 0.20 画素です。
+		const double error = ReprojectionError(solved, correspondences);
+		CHECK(std::fabs(solved.GetReprojectionError() - error) < 1.0e-6);
+		CHECK(error <= ReprojectionError(truth, correspondences));
+		CHECK(error < 0.21);
+	}
+
+	// ビュー行列とプロジェクション行列で変換した点が、Project と同じ画素に来ます。
+	void TestMatricesMatchProject()
+	{
+		const ProjectorCalibration truth = MakeTruth();
+		const Float4x4 view = truth.GetViewMatrix();
+		const Float4x4 projection = truth.GetProjectionMatrix(0.01f, 100.0f);
+		const std::vector<CalibrationCorrespondence> points = MakeCorrespondences(truth, 20, 0.0, 3);
+
+		double worst = 0.0;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			const float position[4] = { static_cast<float>(points[i].x), static_cast<float>(points[i].y), static_cast<float>(points[i].z), 1.0f };
+			float viewPosition[4] = {}, clip[4] = {};
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					viewPosition[column] += position[row] * view.m[row][column];
+				}
+			}
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					clip[column] += viewPosition[row] * projection.m[row][column];
+				}
+			}
+
+			// クリップ空間の y は上向きで、画素の v は下向きです。深度は 0..1 に収まります。
+			const double u = (clip[0] / clip[3] + 1.0) * 0.5 * ProjectorWidth;
+			const double v = (1.0 - clip[1] / clip[3]) * 0.5 * ProjectorHeight;
+			worst = std::max(worst, std::max(std::fabs(u - points[i].u), std::fabs(v - points[i].v)));
+			CHECK(clip[2] / clip[3] > 0.0f && clip[2] / clip[3] < 1.0f);
+		}
+		CHECK(worst < 0.05);
+	}
+
+	// 対応表で変換した画素は Project と同じです。表はキャリブレーションか光線が変わったときだけ作り直します。
+	void TestDepthToProjectorMap()
+	{
+		const float fx = 365.0f, fy = 365.0f, cx = 256.0f, cy = 212.0f;
+		const uint32_t width = 512, height = 424;
+		ProjectorCalibration calibration = MakeTruth();
+
+		DepthToProjectorMap map;
+		CHECK(!map.IsReady());
+		map.SetDepthIntrinsics(fx, fy, cx, cy, width, height);
+		CHECK(map.Update(calibration));
+		CHECK(map.IsReady());
+		CHECK(!map.Update(calibration));
+
+		std::vector<uint16_t> depth(width * height);
+		for (uint32_t i = 0; i < width * height; i++)
+		{
+			depth[i] = static_cast<uint16_t>(1500 + i % 1000);
+		}
+		depth[0] = 0;
+		std::vector<float> uv(width * height * 2);
+		map.MapDepthFrame(depth.data(), uv.data());
+		CHECK(uv[0] == -1.0f && uv[1] == -1.0f);
+
+		double worst = 0.0;
+		for (uint32_t y = 0; y < height; y += 7)
+		{
+			for (uint32_t x = 1; x < width; x += 5)
+			{
+				// 深度カメラの空間は y が上向きです。
+				const double z = depth[y * width + x] * 0.001;
+				double u, v;
+				CHECK(calibration.Project((x - cx) / fx * z, (cy - y) / fy * z, z, &u, &v));
+				const size_t i = (static_cast<size_t>(y) * width + x) * 2;
+				worst = std::max(worst, std::max(std::fabs(uv[i] - u), std::fabs(uv[i + 1] - v)));
+			}
+		}
+		CHECK(worst < 0.05);
+
+		// キャリブレーションを解き直すと表を作り直します。
+		CHECK(calibration.Solve(MakeCorrespondences(calibration, 40, 0.0, 4), ProjectorWidth, ProjectorHeight));
+		CHECK(map.Update(calibration));
+		CHECK(!map.Update(calibration));
+	}
+
+	// 対応点が 6 点より少ない場合や、すべて同じ点の場合は失敗し、以前のキャリブレーションは変わりません。
+	void TestRejectsDegenerateInput()
+	{
+		const ProjectorCalibration truth = MakeTruth();
+		ProjectorCalibration calibration = truth;
+		const uint32_t generation = calibration.GetGeneration();
+
+		std::vector<CalibrationCorrespondence> correspondences = MakeCorrespondences(truth, 5, 0.0, 5);
+		CHECK(!calibration.Solve(correspondences, ProjectorWidth, ProjectorHeight));
+
+		correspondences.assign(10, correspondences[0]);
+		CHECK(!calibration.Solve(correspondences, ProjectorWidth, ProjectorHeight));
+
+		CHECK(calibration.IsValid());
+		CHECK(calibration.GetGeneration() == generation);
+		CHECK(calibration.GetIntrinsics().fx == truth.GetIntrinsics().fx);
+	}
+}
+
+int main()
+{
+	TestRecoversExactCalibration();
+	TestRecoversNoisyCalibration();
+	TestMatricesMatchProject();
+	TestDepthToProjectorMap();
+	TestRejectsDegenerateInput();
+	return TestCheck::TestResult();
+}
@@ -0,0 +1,202 @@
+﻿#include "Reconstruction/QuadtreeMesher.h"
+#include "SyntheticDepth.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const float Tolerance = 5.0f;
+
+	// 傾いた床に、ガウス形のこぶが (bumpX, bumpY) の画素にある場面。こぶの高さは 150 ミリメートルです。
+	void RenderBump(float bumpX, float bumpY, std::vector<uint16_t>* depth)
+	{
+		const DepthCameraIntrinsics intrinsics = SyntheticDepth::GetIntrinsics();
+		depth->resize(SyntheticDepth::Width * SyntheticDepth::Height);
+		for (uint32_t y = 0; y < SyntheticDepth::Height; y++)
+		{
+			for (uint32_t x = 0; x < SyntheticDepth::Width; x++)
+			{
+				const float ry = (y - intrinsics.cy) / intrinsics.fy;
+				const float dx = x - bumpX, dy = y - bumpY;
+				const float z = 2.0f / (1.0f - 0.5f * ry) - 0.15f * std::exp(-(dx * dx + dy * dy) / (2.0f * 30.0f * 30.0f));
+				(*depth)[y * SyntheticDepth::Width + x] = static_cast<uint16_t>(z * 1000.0f + 0.5f);
+			}
+		}
+	}
+
+	// 三角形の内側の画素で、逆深度を線形補間した深度と depth の差の最大値 (ミリメートル)。
+	float MaxError(const TriangleMesh& mesh, const std::vector<uint16_t>& depth)
+	{
+		const DepthCameraIntrinsics intrinsics = SyntheticDepth::GetIntrinsics();
+		float worst = 0.0f;
+		for (size_t i = 0; i < mesh.indices.size(); i += 3)
+		{
+			float u[3], v[3], w[3];
+			for (int k = 0; k < 3; k++)
+			{
+				const float* p = mesh.vertices[mesh.indices[i + k]].position;
+				u[k] = p[0] / p[2] * intrinsics.fx + intrinsics.cx;
+				v[k] = p[1] / p[2] * intrinsics.fy + intrinsics.cy;
+				w[k] = 1.0f / (p[2] * 1000.0f);
+			}
+
+			const int x0 = static_cast<int>(std::floor(std::min(u[0], std::min(u[1], u[2]))));
+			const int x1 = static_cast<int>(std::ceil(std::max(u[0], std::max(u[1], u[2]))));
+			const int y0 = static_cast<int>(std::floor(std::min(v[0], std::min(v[1], v[2]))));
+			const int y1 = static_cast<int>(std::ceil(std::max(v[0], std::max(v[1], v[2]))));
+			const float area = (u[1] - u[0]) * (v[2] - v[0]) - (u[2] - u[0]) * (v[1] - v[0]);
+			for (int y = std::max(y0, 0); y <= std::min(y1, static_cast<int>(SyntheticDepth::Height) - 1); y++)
+			{
+				for (int x = std::max(x0, 0); x <= std::min(x1, static_cast<int>(SyntheticDepth::Width) - 1); x++)
+				{
+					const float b0 = ((u[1] - x) * (v[2] - y) - (u[2] - x) * (v[1] - y)) / area;
+					const float b1 = ((u[2] - x) * (v[0] - y) - (u[0] - x) * (v[2] - y)) / area;
+					const float b2 = 1.0f - b0 - b1;
+					if (b0 < -1.0e-4f || b1 < -1.0e-4f || b2 < -1.0e-4f)
+					{
+						continue;
+					}
+
+					const float z = 1.0f / (b0 * w[0] + b1 * w[1] + b2 * w[2]);
+					worst = std::max(worst, std::fabs(z - depth[y * SyntheticDepth::Width + x]));
+				}
+			}
+		}
+		return worst;
+	}
+
+	bool IsSameMesh(const TriangleMesh& a, const TriangleMesh& b)
+	{
+		if (a.vertices.size() != b.vertices.size() || a.indices != b.indices)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.vertices.size(); i++)
+		{
+			if (!std::equal(a.vertices[i].position, a.vertices[i].position + 3, b.vertices[i].position))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// すべてを分割した場合、平らな所は大きな三角形になり、誤差は許容誤差以内です。
+	void TestFullUpdate()
+	{
+		std::vector<uint16_t> depth;
+		RenderBump(200.0f, 200.0f, &depth);
+
+		QuadtreeMesher mesher;
+		mesher.SetTolerance(Tolerance);
+		TriangleMesh mesh;
+		const uint32_t tiles = mesher.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &mesh);
+		CHECK(tiles == 8 * 7);
+		CHECK(mesh.indices.size() / 3 < depth.size() / 8);
+		CHECK(MaxError(mesh, depth) <= Tolerance);
+
+		// 同じフレームでは分割し直しません。
+		CHECK(mesher.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &mesh) == 0);
+	}
+
+	// こぶがタイルの境界をまたいで 10 フレーム動く間、変わったタイルだけを分割し直したメッシュの誤差の最大値。
+	// 各フレームで、すべてを分割し直したメッシュと同じかどうかも数えます。
+	float RunIncremental(uint16_t changeThreshold, uint32_t changePixelCount, int* mismatches, uint32_t* subdivided)
+	{
+		std::vector<uint16_t> depth;
+		RenderBump(180.0f, 180.0f, &depth);
+
+		QuadtreeMesher incremental;
+		incremental.SetTolerance(Tolerance);
+		incremental.SetChangeThreshold(changeThreshold, changePixelCount);
+		TriangleMesh mesh;
+		incremental.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &mesh);
+
+		float worst = 0.0f;
+		*mismatches = 0;
+		*subdivided = 0;
+		for (int frame = 1; frame <= 10; frame++)
+		{
+			RenderBump(180.0f + 5.0f * frame, 180.0f + 3.0f * frame, &depth);
+			*subdivided += incremental.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &mesh);
+			worst = std::max(worst, MaxError(mesh, depth));
+
+			QuadtreeMesher full;
+			full.SetTolerance(Tolerance);
+			TriangleMesh expected;
+			full.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &expected);
+			if (!IsSameMesh(mesh, expected))
+			{
+				(*mismatches)++;
+			}
+		}
+		return worst;
+	}
+
+	// どの画素の変化でもタイルを変わったとみなす場合、葉の右と下の辺で隣のタイルの画素を参照する
+	// 左、上、左上のタイルも分割し直すので、すべてを分割し直した場合と同じメッシュになります。
+	void TestIncrementalMatchesFull()
+	{
+		int mismatches;
+		uint32_t subdivided;
+		const float worst = RunIncremental(0, 0, &mismatches, &subdivided);
+		CHECK(worst <= Tolerance);
+		CHECK(mismatches == 0);
+		CHECK(subdivided > 0 && subdivided < 10 * 8 * 7);
+	}
+
+	// 1 つのタイルの画素だけが奥に下がった場合。左、上、左上のタイルの画素は変わりませんが、
+	// それらの葉の右と下の辺はこのタイルの最初の列と行を参照するので、分割し直さないと段差をまたいで歪みます。
+	void TestNeighbourTilesResubdivided()
+	{
+		std::vector<uint16_t> depth;
+		RenderBump(-1000.0f, -1000.0f, &depth);
+
+		QuadtreeMesher incremental;
+		incremental.SetTolerance(Tolerance);
+		TriangleMesh mesh;
+		incremental.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &mesh);
+
+		const uint32_t x0 = 3 * QuadtreeMesher::TileSize;
+		const uint32_t y0 = 3 * QuadtreeMesher::TileSize;
+		for (uint32_t y = y0; y < y0 + QuadtreeMesher::TileSize; y++)
+		{
+			for (uint32_t x = x0; x < x0 + QuadtreeMesher::TileSize; x++)
+			{
+				depth[y * SyntheticDepth::Width + x] += 100;
+			}
+		}
+		CHECK(incremental.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &mesh) == 4);
+
+		QuadtreeMesher full;
+		full.SetTolerance(Tolerance);
+		TriangleMesh expected;
+		full.Update(depth.data(), SyntheticDepth::GetIntrinsics(), &expected);
+		CHECK(IsSameMesh(mesh, expected));
+	}
+
+	// 既定のしきい値では、しきい値以下の変化を無視したタイルが古い深度のままなので、
+	// 誤差は許容誤差と変化のしきい値の和までに収まります。
+	void TestIncrementalWithinChangeThreshold()
+	{
+		const uint16_t changeThreshold = 10;
+		int mismatches;
+		uint32_t subdivided;
+		const float worst = RunIncremental(changeThreshold, 16, &mismatches, &subdivided);
+		CHECK(worst <= Tolerance + changeThreshold);
+	}
+}
+
+int main()
+{
+	TestFullUpdate();
+	TestIncrementalMatchesFull();
+	TestNeighbourTilesResubdivided();
+	TestIncrementalWithinChangeThreshold();
+	return TestCheck::TestResult();
+}
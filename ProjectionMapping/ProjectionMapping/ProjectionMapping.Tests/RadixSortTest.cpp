@@ -0,0 +1,180 @@
+﻿#include "Rendering/RadixSort.h"
+#include "Rendering/RenderBackend.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// keys を並べ替え、値に元の位置を入れておいて std::stable_sort と比べます。
+	bool SortsLikeStableSort(const std::vector<uint64_t>& input)
+	{
+		const size_t count = input.size();
+		std::vector<uint64_t> keys(input);
+		std::vector<uint32_t> values(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			values[i] = static_cast<uint32_t>(i);
+		}
+
+		// 作業用の領域は count 個ちょうどです。
+		std::vector<uint64_t> keyScratch(count);
+		std::vector<uint32_t> valueScratch(count);
+		RadixSort::Sort(keys.data(), values.data(), count, keyScratch.data(), valueScratch.data());
+
+		std::vector<std::pair<uint64_t, uint32_t>> expected(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			expected[i] = std::make_pair(input[i], static_cast<uint32_t>(i));
+		}
+		std::stable_sort(expected.begin(), expected.end(),
+			[](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+
+		for (size_t i = 0; i < count; i++)
+		{
+			if (keys[i] != expected[i].first || values[i] != expected[i].second)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// 挿入ソートと基数ソートの境界の前後の個数で、同じキーが多い場合も安定です。
+	void TestStableAroundInsertionCutoff()
+	{
+		std::mt19937_64 random(1);
+		const size_t counts[] = { 0, 1, 2, 3, 31, 32, 33, 100, 1000, 100000 };
+		for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+		{
+			std::vector<uint64_t> keys(counts[c]);
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				keys[i] = random();
+			}
+			CHECK(SortsLikeStableSort(keys));
+
+			// 8 種類のキーだけにして、同じキーの順を調べます。
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				keys[i] = (random() % 8) * 0x0101010101010101ull;
+			}
+			CHECK(SortsLikeStableSort(keys));
+		}
+	}
+
+	// すべてのキーで同じ値の桁は飛ばします。並べ替える桁の数が奇数の場合は、結果が作業用の領域から戻ります。
+	void TestSkippedDigits()
+	{
+		std::mt19937_64 random(2);
+		const size_t count = 500;
+		std::vector<uint64_t> keys(count);
+
+		// 最下位の桁だけが異なります (1 回)。
+		for (size_t i = 0; i < count; i++)
+		{
+			keys[i] = 0x1234560000000000ull | (random() & 0xFF);
+		}
+		CHECK(SortsLikeStableSort(keys));
+
+		// 最下位と最上位の桁が異なります (2 回)。
+		for (size_t i = 0; i < count; i++)
+		{
+			keys[i] = 0x0012345678000000ull | (random() & 0xFF00000000000000ull) | (random() & 0xFF);
+		}
+		CHECK(SortsLikeStableSort(keys));
+
+		// 描画のキーのように、上位のパスとパイプラインがほぼ同じで、奥行きの桁が異なります (3 回)。
+		for (size_t i = 0; i < count; i++)
+		{
+			keys[i] = DrawKey::Make(1, 3, static_cast<uint32_t>(random() % 4), static_cast<float>(random() % 1000) * 0.01f);
+		}
+		CHECK(SortsLikeStableSort(keys));
+
+		// すべてのキーが同じ場合は何も動きません。
+		std::fill(keys.begin(), keys.end(), 0xABCDEFull);
+		CHECK(SortsLikeStableSort(keys));
+	}
+
+	// 描画を区別するために、indexCount に記録した順の番号を入れます。
+	DrawPacket MakePacket(uint32_t id)
+	{
+		DrawPacket packet = {};
+		packet.indexCount = id;
+		return packet;
+	}
+
+	uint32_t GetDrawId(const CommandList& commands, size_t index)
+	{
+		const CommandList::Command& command = commands.GetCommand(index);
+		return command.type == CommandList::Command::DrawBatch ? command.batch.packet.indexCount : command.draw.indexCount;
+	}
+
+	// Clear、UpdateBuffer、SetViewport は記録した位置に残り、その間の描画だけがキーの順に並びます。
+	void TestCommandListSort()
+	{
+		CommandList commands;
+		const float color[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		const uint32_t data[4] = { 1, 2, 3, 4 };
+		const DrawRange ranges[2] = { { 3, 0, 0 }, { 6, 3, 10 } };
+
+		commands.Clear(color, 1.0f);											// 0
+		commands.Draw(MakePacket(1), 30);										// 1
+		commands.DrawBatch(MakePacket(2), ranges, 2, 10);						// 2
+		commands.Draw(MakePacket(3), 20);										// 3
+		commands.Draw(MakePacket(4), 10);										// 4
+		commands.UpdateBuffer(7, data, sizeof(data));							// 5
+		commands.Draw(MakePacket(5), 5);										// 6
+		commands.SetViewport(0.0f, 0.0f, 100.0f, 50.0f);						// 7
+
+		// 基数ソートを使う長さの区間。キーは 2 種類だけなので、同じキーの描画の順も調べます。
+		const uint32_t longSegment = 100;
+		for (uint32_t i = 0; i < longSegment; i++)
+		{
+			commands.Draw(MakePacket(100 + i), (i % 2) == 0 ? 0x2000000000000000ull : 0x1000000000000000ull);
+		}
+
+		commands.Sort();
+		CHECK(commands.GetCommandCount() == 8 + longSegment);
+
+		CHECK(commands.GetCommand(0).type == CommandList::Command::Clear);
+		CHECK(commands.GetCommand(5).type == CommandList::Command::UpdateBuffer && commands.GetCommand(5).update.buffer == 7);
+		CHECK(commands.GetCommand(7).type == CommandList::Command::Viewport && commands.GetCommand(7).viewport.width == 100.0f);
+
+		// 最初の区間は 2 (10)、4 (10)、3 (20)、1 (30) です。同じキーの 2 と 4 は記録した順です。
+		CHECK(GetDrawId(commands, 1) == 2 && GetDrawId(commands, 2) == 4 && GetDrawId(commands, 3) == 3 && GetDrawId(commands, 4) == 1);
+		CHECK(commands.GetSortKey(1) == 10 && commands.GetSortKey(2) == 10 && commands.GetSortKey(3) == 20 && commands.GetSortKey(4) == 30);
+		CHECK(GetDrawId(commands, 6) == 5);
+
+		// まとめた描画は移動しても同じ範囲を参照します。
+		const CommandList::Command& batch = commands.GetCommand(1);
+		CHECK(batch.type == CommandList::Command::DrawBatch && batch.batch.rangeCount == 2);
+		const DrawRange* sortedRanges = commands.GetRanges(batch);
+		CHECK(sortedRanges[1].indexCount == 6 && sortedRanges[1].startIndex == 3 && sortedRanges[1].baseVertex == 10);
+
+		// 長い区間は奇数番目 (キーが小さい) が先で、それぞれ記録した順です。
+		int mismatches = 0;
+		for (uint32_t i = 0; i < longSegment; i++)
+		{
+			const uint32_t expected = (i < longSegment / 2) ? 100 + 1 + i * 2 : 100 + (i - longSegment / 2) * 2;
+			if (GetDrawId(commands, 8 + i) != expected)
+			{
+				mismatches++;
+			}
+		}
+		CHECK(mismatches == 0);
+	}
+}
+
+int main()
+{
+	TestStableAroundInsertionCutoff();
+	TestSkippedDigits();
+	TestCommandListSort();
+	return TestCheck::TestResult();
+}
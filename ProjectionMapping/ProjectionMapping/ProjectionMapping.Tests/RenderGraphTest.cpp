@@ -0,0 +1,212 @@
+﻿#include "Rendering/RenderGraph.h"
+#include "TestCheck.h"
+
+#include <string>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const RenderTargetDescription ColorTarget = { 64, 64, RenderTargetDescription::Color };
+	const RenderTargetDescription DepthTarget = { 64, 64, RenderTargetDescription::DepthStencil };
+
+	// 実行したパスの名前を順に記録します。
+	RenderGraph::PassHandle AddRecordedPass(RenderGraph* graph, const char* name, std::vector<std::string>* executed)
+	{
+		return graph->AddPass(name, [name, executed](const RenderGraph&) { executed->push_back(name); });
+	}
+
+	// 出力に届かないパスは実行しません。出力のパスが読むパスは、宣言の順が後でも残ります。
+	void TestCullsUnusedPasses()
+	{
+		RenderGraph graph;
+		std::vector<std::string> executed;
+
+		RenderGraph::ResourceHandle backBuffer = graph.Import("BackBuffer");
+		RenderGraph::ResourceHandle debug = graph.CreateTransient("Debug", ColorTarget);
+		RenderGraph::ResourceHandle scene = graph.CreateTransient("Scene", ColorTarget);
+
+		const RenderGraph::PassHandle debugPass = AddRecordedPass(&graph, "Debug", &executed);
+		debug = graph.Write(debugPass, debug);
+
+		const RenderGraph::PassHandle scenePass = AddRecordedPass(&graph, "Scene", &executed);
+		scene = graph.Write(scenePass, scene);
+
+		const RenderGraph::PassHandle compositePass = AddRecordedPass(&graph, "Composite", &executed);
+		graph.Read(compositePass, scene);
+		backBuffer = graph.Write(compositePass, backBuffer);
+		graph.MarkOutput(backBuffer);
+
+		CHECK(graph.Compile());
+		CHECK(graph.GetPassCount() == 3);
+		CHECK(graph.GetActivePassCount() == 2);
+		CHECK(!graph.IsPassActive(debugPass));
+		CHECK(graph.IsPassActive(scenePass) && graph.IsPassActive(compositePass));
+		CHECK(graph.GetPhysicalIndex(debug) == RenderGraph::NoPhysical);
+		CHECK(graph.GetPhysicalIndex(backBuffer) == RenderGraph::NoPhysical);
+		CHECK(graph.GetPhysicalIndex(scene) != RenderGraph::NoPhysical);
+
+		graph.Execute();
+		CHECK(executed.size() == 2 && executed[0] == "Scene" && executed[1] == "Composite");
+	}
+
+	// 前の版を読むパスは、宣言の順が後でも、その版を上書きするパスより先に実行します。
+	void TestWriteAfterReadOrder()
+	{
+		RenderGraph graph;
+		std::vector<std::string> executed;
+
+		RenderGraph::ResourceHandle history = graph.Import("History");
+		RenderGraph::ResourceHandle backBuffer = graph.Import("BackBuffer");
+
+		// History を上書きするパスを先に宣言します。
+		const RenderGraph::PassHandle updatePass = AddRecordedPass(&graph, "UpdateHistory", &executed);
+		const RenderGraph::ResourceHandle updatedHistory = graph.Write(updatePass, history);
+
+		const RenderGraph::PassHandle blendPass = AddRecordedPass(&graph, "Blend", &executed);
+		graph.Read(blendPass, history);
+		backBuffer = graph.Write(blendPass, backBuffer);
+
+		graph.MarkOutput(updatedHistory);
+		graph.MarkOutput(backBuffer);
+
+		CHECK(graph.Compile());
+		graph.Execute();
+		CHECK(executed.size() == 2 && executed[0] == "Blend" && executed[1] == "UpdateHistory");
+
+		// 依存関係のないパスは宣言した順です。
+		graph.Reset();
+		executed.clear();
+		RenderGraph::ResourceHandle a = graph.Import("A");
+		RenderGraph::ResourceHandle b = graph.Import("B");
+		a = graph.Write(AddRecordedPass(&graph, "First", &executed), a);
+		b = graph.Write(AddRecordedPass(&graph, "Second", &executed), b);
+		graph.MarkOutput(a);
+		graph.MarkOutput(b);
+		CHECK(graph.Compile());
+		graph.Execute();
+		CHECK(executed.size() == 2 && executed[0] == "First" && executed[1] == "Second");
+	}
+
+	// 循環する依存関係、1 つの版への 2 つの書き込み、書き込まれていない一時的なターゲットの読み込みは Compile が失敗します。
+	void TestRejectsInvalidGraphs()
+	{
+		RenderGraph graph;
+		std::vector<std::string> executed;
+
+		// A は B が上書きした X を読み、B は A が書き込んだ Y を読みます。
+		RenderGraph::ResourceHandle x = graph.Import("X");
+		RenderGraph::ResourceHandle y = graph.Import("Y");
+		const RenderGraph::PassHandle passA = AddRecordedPass(&graph, "A", &executed);
+		const RenderGraph::PassHandle passB = AddRecordedPass(&graph, "B", &executed);
+		const RenderGraph::ResourceHandle y2 = graph.Write(passA, y);
+		const RenderGraph::ResourceHandle x2 = graph.Write(passB, x);
+		graph.Read(passB, y2);
+		graph.Read(passA, x2);
+		graph.MarkOutput(x2);
+		graph.MarkOutput(y2);
+
+		CHECK(!graph.Compile());
+		CHECK(graph.GetActivePassCount() == 0);
+		graph.Execute();
+		CHECK(executed.empty());
+
+		// 同じ版に 2 つのパスが書き込みます。
+		graph.Reset();
+		RenderGraph::ResourceHandle target = graph.Import("Target");
+		const RenderGraph::ResourceHandle first = graph.Write(AddRecordedPass(&graph, "First", &executed), target);
+		const RenderGraph::ResourceHandle second = graph.Write(AddRecordedPass(&graph, "Second", &executed), target);
+		graph.MarkOutput(first);
+		graph.MarkOutput(second);
+		CHECK(!graph.Compile());
+
+		// 版を順に書き込む場合は有効です。前の版を読まずに上書きすると、前の書き込みは使われないので取り除きます。
+		graph.Reset();
+		target = graph.Import("Target");
+		target = graph.Write(AddRecordedPass(&graph, "First", &executed), target);
+		const RenderGraph::PassHandle overwritePass = AddRecordedPass(&graph, "Second", &executed);
+		graph.MarkOutput(graph.Write(overwritePass, target));
+		CHECK(graph.Compile());
+		CHECK(graph.GetActivePassCount() == 1 && graph.IsPassActive(overwritePass));
+
+		graph.Reset();
+		target = graph.Import("Target");
+		target = graph.Write(AddRecordedPass(&graph, "First", &executed), target);
+		const RenderGraph::PassHandle blendPass = AddRecordedPass(&graph, "Second", &executed);
+		graph.Read(blendPass, target);
+		graph.MarkOutput(graph.Write(blendPass, target));
+		CHECK(graph.Compile());
+		CHECK(graph.GetActivePassCount() == 2);
+
+		// 書き込まれていない一時的なターゲットを読みます。
+		graph.Reset();
+		const RenderGraph::ResourceHandle transient = graph.CreateTransient("Transient", ColorTarget);
+		RenderGraph::ResourceHandle output = graph.Import("Output");
+		const RenderGraph::PassHandle readPass = AddRecordedPass(&graph, "Read", &executed);
+		graph.Read(readPass, transient);
+		output = graph.Write(readPass, output);
+		graph.MarkOutput(output);
+		CHECK(!graph.Compile());
+	}
+
+	// 寿命が重ならない同じ形式の一時的なターゲットは 1 つの実体を共有します。
+	// 同じパスで使用するターゲットや、形式の異なるターゲットは共有しません。
+	void TestAliasing()
+	{
+		RenderGraph graph;
+		RenderGraph::ResourceHandle backBuffer = graph.Import("BackBuffer");
+
+		// Blur が A を読んで B に書き、Composite が B を読んで C に書きます。Final が C を読みます。
+		RenderGraph::ResourceHandle a = graph.CreateTransient("A", ColorTarget);
+		RenderGraph::ResourceHandle b = graph.CreateTransient("B", ColorTarget);
+		RenderGraph::ResourceHandle c = graph.CreateTransient("C", ColorTarget);
+		RenderGraph::ResourceHandle depth = graph.CreateTransient("Depth", DepthTarget);
+
+		const RenderGraph::PassHandle scenePass = graph.AddPass("Scene", RenderGraph::ExecuteFunction());
+		a = graph.Write(scenePass, a);
+		depth = graph.Write(scenePass, depth);
+
+		const RenderGraph::PassHandle blurPass = graph.AddPass("Blur", RenderGraph::ExecuteFunction());
+		graph.Read(blurPass, a);
+		b = graph.Write(blurPass, b);
+
+		const RenderGraph::PassHandle compositePass = graph.AddPass("Composite", RenderGraph::ExecuteFunction());
+		graph.Read(compositePass, b);
+		graph.Read(compositePass, depth);
+		c = graph.Write(compositePass, c);
+
+		const RenderGraph::PassHandle finalPass = graph.AddPass("Final", RenderGraph::ExecuteFunction());
+		graph.Read(finalPass, c);
+		backBuffer = graph.Write(finalPass, backBuffer);
+		graph.MarkOutput(backBuffer);
+
+		CHECK(graph.Compile());
+
+		// A は Blur で寿命が終わるので、Composite で書き込む C が A の実体を使います。
+		const uint32_t physicalA = graph.GetPhysicalIndex(a);
+		const uint32_t physicalB = graph.GetPhysicalIndex(b);
+		const uint32_t physicalC = graph.GetPhysicalIndex(c);
+		const uint32_t physicalDepth = graph.GetPhysicalIndex(depth);
+		CHECK(physicalA == physicalC);
+
+		// A と B は Blur で、B と C は Composite で同時に使用します。
+		CHECK(physicalA != physicalB);
+		CHECK(physicalB != physicalC);
+
+		// 形式の異なる深度は別の実体です。
+		CHECK(physicalDepth != physicalA && physicalDepth != physicalB);
+		CHECK(graph.GetPhysicalCount() == 3);
+		CHECK(graph.GetPhysicalDescription(physicalDepth) == DepthTarget);
+		CHECK(graph.GetPhysicalDescription(physicalA) == ColorTarget);
+	}
+}
+
+int main()
+{
+	TestCullsUnusedPasses();
+	TestWriteAfterReadOrder();
+	TestRejectsInvalidGraphs();
+	TestAliasing();
+	return TestCheck::TestResult();
+}
@@ -0,0 +1,99 @@
+﻿#include "Rendering/CpuRenderBackend.h"
+#include "Rendering/RenderMesh.h"
+#include "SyntheticDepth.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+// センサーの解像度の深度メッシュ (約 22 万頂点、43 万三角形) を、32 ビットのインデックスの 1 回の描画と、
+// 16 ビットのメッシュレットのまとめた描画で比べます。CpuRenderBackend で描画するので、時間は CPU の
+// ラスタライズを含みます。GPU で得られるインデックスの帯域の差は、バッファーの大きさで比べてください。
+namespace
+{
+	const uint32_t RenderWidth = 1280;
+	const uint32_t RenderHeight = 720;
+	const int SubmitCount = 10;
+
+	// 機能レベル 9_1 のように 32 ビットのインデックスに対応しないバックエンド。
+	class Index16RenderBackend : public CpuRenderBackend
+	{
+	public:
+		virtual bool SupportsIndex32() const						{ return false; }
+	};
+
+	void Benchmark(const char* name, CpuRenderBackend* backend, const TriangleMesh& mesh, RenderMesh::IndexMode mode)
+	{
+		backend->SetRenderTargetSize(RenderWidth, RenderHeight);
+
+		// 深度カメラの座標 (y が下、z が奥) を、カメラの位置から見ます。
+		const Matrix view = Matrix::LookAtRH(Vector::Zero(), Vector::Set(0.0f, 0.0f, 1.0f, 0.0f), Vector::Set(0.0f, -1.0f, 0.0f, 0.0f));
+		const Matrix projection = Matrix::PerspectiveFovRH(1.0f, static_cast<float>(RenderWidth) / RenderHeight, 0.1f, 10.0f);
+		const Float4x4 constants = (view * projection).Transpose().ToFloat4x4();
+		std::vector<uint8_t> constantData(RenderBackend::ConstantAlignment);
+		memcpy(constantData.data(), &constants, sizeof(constants));
+
+		BufferDescription description;
+		description.usage = BufferDescription::Constant;
+		description.size = static_cast<uint32_t>(constantData.size());
+		description.initialData = constantData.data();
+
+		PipelineDescription pipelineDescription = {};
+		pipelineDescription.cullMode = PipelineDescription::CullNone;
+		pipelineDescription.vertexLayout = PipelineDescription::PositionColor;
+
+		DrawPacket material = {};
+		material.pipeline = backend->CreatePipeline(pipelineDescription);
+		material.objectConstants.buffer = backend->CreateBuffer(description);
+		material.objectConstants.size = RenderBackend::ConstantAlignment;
+
+		RenderMesh renderMesh;
+		const SyntheticDepth::Stopwatch createStopwatch;
+		renderMesh.Create(backend, mesh, mode);
+		const double createMilliseconds = createStopwatch.GetMilliseconds();
+
+		double best = 1.0e9;
+		for (int i = 0; i < SubmitCount; i++)
+		{
+			backend->BeginFrame();
+			CommandList commands;
+			const float background[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			commands.Clear(background, 1.0f);
+			renderMesh.Record(&commands, material);
+
+			const SyntheticDepth::Stopwatch submitStopwatch;
+			backend->Submit(commands);
+			best = std::min(best, submitStopwatch.GetMilliseconds());
+		}
+
+		printf("%-22s: %2u draws, %s indices, vertices %6.2f MB, indices %5.2f MB, create %5.1f ms, submit %6.1f ms\n",
+			name, renderMesh.GetDrawCount(), renderMesh.GetIndexFormat() == DrawPacket::Index16 ? "16-bit" : "32-bit",
+			renderMesh.GetVertexBytes() / 1048576.0, renderMesh.GetIndexBytes() / 1048576.0, createMilliseconds, best);
+
+		renderMesh.Release(backend);
+		backend->DestroyBuffer(material.objectConstants.buffer);
+		backend->DestroyPipeline(material.pipeline);
+	}
+}
+
+int main()
+{
+	std::vector<uint16_t> depth;
+	const float center[3] = { 0.0f, 0.0f, 2.0f };
+	SyntheticDepth::RenderSphere(center, 0.5f, 3.0f, &depth);
+	TriangleMesh mesh;
+	SyntheticDepth::BuildDepthMesh(depth, &mesh);
+
+	printf("%zu vertices, %zu triangles, drawn at %ux%u, best of %d submits\n", mesh.vertices.size(), mesh.indices.size() / 3, RenderWidth, RenderHeight, SubmitCount);
+
+	CpuRenderBackend index32Backend;
+	Benchmark("32-bit indices", &index32Backend, mesh, RenderMesh::AutoIndex);
+	Benchmark("16-bit meshlets", &index32Backend, mesh, RenderMesh::MeshletIndex);
+
+	Index16RenderBackend index16Backend;
+	Benchmark("16-bit meshlets (9_1)", &index16Backend, mesh, RenderMesh::AutoIndex);
+	return 0;
+}
@@ -0,0 +1,191 @@
+﻿#include "Rendering/CpuRenderBackend.h"
+#include "Rendering/RenderMesh.h"
+#include "SyntheticDepth.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	// 機能レベル 9_1 のように 32 ビットのインデックスに対応しないバックエンド。
+	class Index16RenderBackend : public CpuRenderBackend
+	{
+	public:
+		virtual bool SupportsIndex32() const						{ return false; }
+	};
+
+	void BuildSphereMesh(TriangleMesh* mesh)
+	{
+		std::vector<uint16_t> depth;
+		const float center[3] = { 0.0f, 0.0f, 2.0f };
+		SyntheticDepth::RenderSphere(center, 0.5f, 3.0f, &depth);
+		SyntheticDepth::BuildDepthMesh(depth, mesh);
+	}
+
+	// メッシュレットの範囲と baseVertex で、元の三角形が同じ順に同じ頂点で作り直せることを調べます。
+	void CheckMeshlets(const TriangleMesh& mesh, uint32_t maxVertices, uint32_t maxTriangles, uint32_t* rangeCount, uint32_t* largestTriangles)
+	{
+		std::vector<MeshVertex> vertices;
+		std::vector<uint16_t> indices;
+		std::vector<DrawRange> ranges;
+		RenderMesh::BuildMeshlets(mesh, maxVertices, maxTriangles, &vertices, &indices, &ranges);
+
+		*rangeCount = static_cast<uint32_t>(ranges.size());
+		*largestTriangles = 0;
+		CHECK(indices.size() == mesh.indices.size());
+
+		int mismatches = 0;
+		uint32_t startIndex = 0;
+		uint32_t baseVertex = 0;
+		for (size_t r = 0; r < ranges.size(); r++)
+		{
+			const DrawRange& range = ranges[r];
+			const uint32_t end = (r + 1 < ranges.size()) ? static_cast<uint32_t>(ranges[r + 1].baseVertex) : static_cast<uint32_t>(vertices.size());
+			const uint32_t vertexCount = end - static_cast<uint32_t>(range.baseVertex);
+
+			// 範囲は隙間なく続き、頂点数と三角形数は上限以内です。
+			CHECK(range.startIndex == startIndex && static_cast<uint32_t>(range.baseVertex) == baseVertex);
+			CHECK(range.indexCount % 3 == 0 && range.indexCount / 3 <= maxTriangles);
+			CHECK(vertexCount <= std::min(maxVertices, RenderMesh::MaxIndex16Vertices));
+			*largestTriangles = std::max(*largestTriangles, range.indexCount / 3);
+
+			for (uint32_t i = range.startIndex; i < range.startIndex + range.indexCount && i < mesh.indices.size(); i++)
+			{
+				const uint32_t local = indices[i];
+				if (local >= vertexCount || memcmp(&vertices[range.baseVertex + local], &mesh.vertices[mesh.indices[i]], sizeof(MeshVertex)) != 0)
+				{
+					mismatches++;
+				}
+			}
+
+			startIndex += range.indexCount;
+			baseVertex = end;
+		}
+		CHECK(startIndex == mesh.indices.size());
+		CHECK(mismatches == 0);
+	}
+
+	// センサーの解像度のメッシュ (約 22 万頂点) を 16 ビットのメッシュレットに分けます。
+	void TestMeshletsRebuildTriangles()
+	{
+		TriangleMesh mesh;
+		BuildSphereMesh(&mesh);
+		CHECK(mesh.vertices.size() > RenderMesh::MaxIndex16Vertices);
+
+		uint32_t rangeCount, largestTriangles;
+		CheckMeshlets(mesh, RenderMesh::MaxIndex16Vertices, std::numeric_limits<uint32_t>::max(), &rangeCount, &largestTriangles);
+		CHECK(rangeCount >= 4);
+		CHECK(largestTriangles > 65535);
+
+		// 機能レベル 9_1 では 1 回の描画が 65535 三角形までなので、頂点数より先に三角形数で分かれます。
+		CheckMeshlets(mesh, RenderMesh::MaxIndex16Vertices, 65535, &rangeCount, &largestTriangles);
+		CHECK(rangeCount >= 7);
+		CHECK(largestTriangles == 65535);
+	}
+
+	// 同じ頂点を繰り返す縮退した三角形は、新しい頂点を 1 回だけ数えます。
+	void TestDegenerateTriangles()
+	{
+		TriangleMesh mesh;
+		mesh.vertices.resize(6);
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			mesh.vertices[i].position[0] = static_cast<float>(i);
+		}
+		const uint32_t indices[] = { 0, 1, 2, 3, 3, 4, 4, 5, 5 };
+		mesh.indices.assign(indices, indices + sizeof(indices) / sizeof(indices[0]));
+
+		uint32_t rangeCount, largestTriangles;
+		CheckMeshlets(mesh, 3, std::numeric_limits<uint32_t>::max(), &rangeCount, &largestTriangles);
+		CHECK(rangeCount == 2);
+		CHECK(largestTriangles == 2);
+	}
+
+	// 32 ビットのインデックスの 1 回の描画と、16 ビットのメッシュレットのまとめた描画が同じ画像になります。
+	void TestIndex16MatchesIndex32()
+	{
+		const uint32_t width = 256;
+		const uint32_t height = 212;
+
+		TriangleMesh mesh;
+		BuildSphereMesh(&mesh);
+
+		// 深度カメラの座標 (y が下、z が奥) を、カメラの位置から見ます。
+		const Matrix view = Matrix::LookAtRH(Vector::Zero(), Vector::Set(0.0f, 0.0f, 1.0f, 0.0f), Vector::Set(0.0f, -1.0f, 0.0f, 0.0f));
+		const Matrix projection = Matrix::PerspectiveFovRH(1.0f, static_cast<float>(width) / height, 0.1f, 10.0f);
+		const Float4x4 constants = (view * projection).Transpose().ToFloat4x4();
+
+		Index16RenderBackend index16Backend;
+		CpuRenderBackend index32Backend;
+		RenderBackend* backends[2] = { &index16Backend, &index32Backend };
+		CpuRenderBackend* rasterizers[2] = { &index16Backend, &index32Backend };
+		RenderMesh meshes[2];
+
+		for (int b = 0; b < 2; b++)
+		{
+			rasterizers[b]->SetRenderTargetSize(width, height);
+
+			std::vector<uint8_t> constantData(RenderBackend::ConstantAlignment);
+			memcpy(constantData.data(), &constants, sizeof(constants));
+			BufferDescription description;
+			description.usage = BufferDescription::Constant;
+			description.size = static_cast<uint32_t>(constantData.size());
+			description.initialData = constantData.data();
+			const BufferHandle constantBuffer = backends[b]->CreateBuffer(description);
+
+			PipelineDescription pipelineDescription = {};
+			pipelineDescription.cullMode = PipelineDescription::CullNone;
+			pipelineDescription.vertexLayout = PipelineDescription::PositionColor;
+
+			DrawPacket material = {};
+			material.pipeline = backends[b]->CreatePipeline(pipelineDescription);
+			material.objectConstants.buffer = constantBuffer;
+			material.objectConstants.size = RenderBackend::ConstantAlignment;
+
+			meshes[b].Create(backends[b], mesh, RenderMesh::AutoIndex);
+
+			backends[b]->BeginFrame();
+			CommandList commands;
+			const float background[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			commands.Clear(background, 1.0f);
+			meshes[b].Record(&commands, material);
+			backends[b]->Submit(commands);
+		}
+
+		CHECK(meshes[0].GetIndexFormat() == DrawPacket::Index16);
+		CHECK(meshes[0].GetDrawCount() >= 7);
+		CHECK(meshes[0].GetIndexBytes() == mesh.indices.size() * sizeof(uint16_t));
+		CHECK(meshes[1].GetIndexFormat() == DrawPacket::Index32);
+		CHECK(meshes[1].GetDrawCount() == 1);
+		CHECK(index16Backend.GetStatistics().draws == meshes[0].GetDrawCount());
+
+		const SoftwareRasterizer& index16 = index16Backend.GetRasterizer();
+		const SoftwareRasterizer& index32 = index32Backend.GetRasterizer();
+		uint32_t covered = 0;
+		uint32_t differences = 0;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				const uint32_t color = index32.GetColorBuffer()[y * index32.GetStride() + x];
+				covered += (color & 0xFFFFFF) != 0 ? 1 : 0;
+				differences += color != index16.GetColorBuffer()[y * index16.GetStride() + x] ? 1 : 0;
+			}
+		}
+		CHECK(covered > width * height / 2);
+		CHECK(differences == 0);
+	}
+}
+
+int main()
+{
+	TestMeshletsRebuildTriangles();
+	TestDegenerateTriangles();
+	TestIndex16MatchesIndex32();
+	return TestCheck::TestResult();
+}
@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include "Reconstruction/DepthCamera.h"
+#include "Reconstruction/TriangleMesh.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// テストとベンチマークで使用する合成の深度画像。センサーと同じ 512x424 の Kinect v2 に近い内部パラメーターで、
+// 奥の壁の手前に球がある場面をレイ キャストして、ミリメートルの深度にします。
+namespace SyntheticDepth
+{
+	const uint32_t Width = 512;
+	const uint32_t Height = 424;
+
+	inline ProjectionMapping::DepthCameraIntrinsics GetIntrinsics()
+	{
+		const ProjectionMapping::DepthCameraIntrinsics intrinsics = { 365.0f, 365.0f, 256.0f, 212.0f, Width, Height };
+		return intrinsics;
+	}
+
+	// カメラ座標 (z が奥) で center、半径 radius の球と、z = wallDepth の壁。wallDepth が 0 の場合は壁がなく、球の外は 0 (無効) です。
+	inline void RenderSphere(const float* center, float radius, float wallDepth, std::vector<uint16_t>* depth)
+	{
+		const ProjectionMapping::DepthCameraIntrinsics intrinsics = GetIntrinsics();
+		depth->assign(Width * Height, 0);
+		for (uint32_t y = 0; y < Height; y++)
+		{
+			for (uint32_t x = 0; x < Width; x++)
+			{
+				// 方向 (rx, ry, 1) の光線と球の最初の交点の z。
+				const float rx = (x - intrinsics.cx) / intrinsics.fx;
+				const float ry = (y - intrinsics.cy) / intrinsics.fy;
+				const float a = rx * rx + ry * ry + 1.0f;
+				const float b = -2.0f * (rx * center[0] + ry * center[1] + center[2]);
+				const float c = center[0] * center[0] + center[1] * center[1] + center[2] * center[2] - radius * radius;
+				const float discriminant = b * b - 4.0f * a * c;
+
+				float z = wallDepth;
+				if (discriminant >= 0.0f)
+				{
+					z = (-b - std::sqrt(discriminant)) / (2.0f * a);
+				}
+				(*depth)[y * Width + x] = static_cast<uint16_t>(z * 1000.0f + 0.5f);
+			}
+		}
+	}
+
+	// カメラ座標で point を通り、法線が normal の平面。平面の裏側や光線と平行な画素は 0 です。
+	inline void RenderPlane(const float* point, const float* normal, std::vector<uint16_t>* depth)
+	{
+		const ProjectionMapping::DepthCameraIntrinsics intrinsics = GetIntrinsics();
+		depth->assign(Width * Height, 0);
+		const float d = point[0] * normal[0] + point[1] * normal[1] + point[2] * normal[2];
+		for (uint32_t y = 0; y < Height; y++)
+		{
+			for (uint32_t x = 0; x < Width; x++)
+			{
+				const float rx = (x - intrinsics.cx) / intrinsics.fx;
+				const float ry = (y - intrinsics.cy) / intrinsics.fy;
+				const float denominator = rx * normal[0] + ry * normal[1] + normal[2];
+				if (std::fabs(denominator) < 1.0e-4f)
+				{
+					continue;
+				}
+				const float z = d / denominator;
+				if (z > 0.0f && z < 8.0f)
+				{
+					(*depth)[y * Width + x] = static_cast<uint16_t>(z * 1000.0f + 0.5f);
+				}
+			}
+		}
+	}
+
+	// 画素を頂点にして、隣の画素との深度の差が 50 ミリメートル以上の所はつながないメッシュ。センサーの解像度で約 43 万三角形です。
+	inline void BuildDepthMesh(const std::vector<uint16_t>& depth, ProjectionMapping::TriangleMesh* mesh)
+	{
+		const ProjectionMapping::DepthCameraIntrinsics intrinsics = GetIntrinsics();
+		mesh->vertices.resize(depth.size());
+		mesh->indices.clear();
+		for (uint32_t i = 0; i < depth.size(); i++)
+		{
+			const float z = depth[i] * 0.001f;
+			ProjectionMapping::MeshVertex& vertex = mesh->vertices[i];
+			vertex.position[0] = ((i % Width) - intrinsics.cx) / intrinsics.fx * z;
+			vertex.position[1] = ((i / Width) - intrinsics.cy) / intrinsics.fy * z;
+			vertex.position[2] = z;
+			vertex.color[0] = vertex.color[1] = vertex.color[2] = 0.5f;
+		}
+
+		const auto connected = [&depth](uint32_t a, uint32_t b, uint32_t c)
+		{
+			const int za = depth[a], zb = depth[b], zc = depth[c];
+			return za != 0 && zb != 0 && zc != 0 && std::max(za, std::max(zb, zc)) - std::min(za, std::min(zb, zc)) < 50;
+		};
+		for (uint32_t y = 0; y + 1 < Height; y++)
+		{
+			for (uint32_t x = 0; x + 1 < Width; x++)
+			{
+				const uint32_t a = y * Width + x, b = a + 1, c = a + Width, d = c + 1;
+				if (connected(a, b, c))
+				{
+					mesh->indices.insert(mesh->indices.end(), { a, b, c });
+				}
+				if (connected(b, d, c))
+				{
+					mesh->indices.insert(mesh->indices.end(), { b, d, c });
+				}
+			}
+		}
+	}
+
+	// 経過時間の計測。
+	class Stopwatch
+	{
+	public:
+		Stopwatch() :
+			m_start(std::chrono::steady_clock::now())
+		{
+		}
+
+		double GetMilliseconds() const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+		}
+
+	private:
+		std::chrono::steady_clock::time_point m_start;
+	};
+}
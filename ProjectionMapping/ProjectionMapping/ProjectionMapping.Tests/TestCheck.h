@@ -0,0 +1,40 @@
+﻿#pragma once
+
+#include <cstdio>
+
+// 移植可能なコードの単体テストで使用する最小限の検査。
+// テストはそれぞれ CTest に登録した実行可能ファイルです。CHECK は失敗しても止まらずにすべての失敗を報告し、
+// main は TestResult の値を返して、失敗があれば 0 以外で終了します。
+namespace TestCheck
+{
+	inline int& GetFailureCount()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	inline void Fail(const char* file, int line, const char* expression)
+	{
+		fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+		GetFailureCount()++;
+	}
+
+	inline int TestResult()
+	{
+		if (GetFailureCount() != 0)
+		{
+			fprintf(stderr, "%d check(s) failed\n", GetFailureCount());
+			return 1;
+		}
+		return 0;
+	}
+}
+
+#define CHECK(expression) \
+	do \
+	{ \
+		if (!(expression)) \
+		{ \
+			TestCheck::Fail(__FILE__, __LINE__, #expression); \
+		} \
+	} while (0)
@@ -0,0 +1,323 @@
+﻿#include "Tracking/TouchDetector.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const uint32_t Width = 512;
+	const uint32_t Height = 424;
+	const uint16_t SurfaceDepth = 1000;
+
+	// 面から 10 ミリメートル浮いた、半径 3 画素 (29 画素) の指先。
+	struct Finger
+	{
+		int x, y;
+	};
+
+	// 指先を描いた深度フレーム。面にはノイズがありません。
+	std::vector<uint16_t> RenderFingers(const std::vector<Finger>& fingers, int radius = 3, uint16_t height = 10)
+	{
+		std::vector<uint16_t> depth(Width * Height, SurfaceDepth);
+		for (size_t f = 0; f < fingers.size(); f++)
+		{
+			for (int y = fingers[f].y - radius; y <= fingers[f].y + radius; y++)
+			{
+				for (int x = fingers[f].x - radius; x <= fingers[f].x + radius; x++)
+				{
+					if ((x - fingers[f].x) * (x - fingers[f].x) + (y - fingers[f].y) * (y - fingers[f].y) <= radius * radius)
+					{
+						depth[y * Width + x] = static_cast<uint16_t>(SurfaceDepth - height);
+					}
+				}
+			}
+		}
+		return depth;
+	}
+
+	// 平らな面を学習した検出器。
+	void LearnFlatSurface(TouchDetector* detector)
+	{
+		const std::vector<uint16_t> surface(Width * Height, SurfaceDepth);
+		for (int frame = 0; frame < 4; frame++)
+		{
+			detector->AccumulateSurface(surface.data(), Width, Height);
+		}
+	}
+
+	// 1 フレームを検出し、イベントを返します。
+	std::vector<TouchEvent> Step(TouchDetector* detector, const std::vector<Finger>& fingers)
+	{
+		const std::vector<uint16_t> depth = RenderFingers(fingers);
+		std::vector<TouchEvent> events;
+		CHECK(detector->Detect(depth.data(), Width, Height, &events));
+		return events;
+	}
+
+	// type と id が一致するイベントがちょうど 1 つあり、位置が (x, y) なら true です。
+	bool HasEvent(const std::vector<TouchEvent>& events, TouchEvent::Type type, uint32_t id, float x, float y)
+	{
+		int found = 0;
+		for (size_t i = 0; i < events.size(); i++)
+		{
+			if (events[i].type == type && events[i].id == id)
+			{
+				found += (events[i].x == x && events[i].y == y && events[i].height == 10.0f) ? 1 : 100;
+			}
+		}
+		return found == 1;
+	}
+
+	// 2 本の指が順に触れ、動き、1 フレームだけ見失い、離れるまでのイベントです。
+	// Down は 2 フレーム続けて見つかったとき、Up は 2 フレーム続けて見失ったときに通知し、番号は離れるまで変わりません。
+	void TestDownMoveUpSequence()
+	{
+		TouchDetector detector;
+		LearnFlatSurface(&detector);
+
+		// 1 本目は最初のフレームでは通知しません。
+		std::vector<TouchEvent> events = Step(&detector, { { 100, 100 } });
+		CHECK(events.empty());
+
+		events = Step(&detector, { { 103, 100 } });
+		CHECK(events.size() == 1 && HasEvent(events, TouchEvent::Down, 1, 103.0f, 100.0f));
+
+		// 2 本目が現れます。1 本目は Move だけです。
+		events = Step(&detector, { { 106, 101 }, { 300, 200 } });
+		CHECK(events.size() == 1 && HasEvent(events, TouchEvent::Move, 1, 106.0f, 101.0f));
+
+		events = Step(&detector, { { 109, 102 }, { 302, 200 } });
+		CHECK(events.size() == 2);
+		CHECK(HasEvent(events, TouchEvent::Move, 1, 109.0f, 102.0f));
+		CHECK(HasEvent(events, TouchEvent::Down, 2, 302.0f, 200.0f));
+
+		// 1 本目を 1 フレームだけ見失っても離さず、次に見つかると同じ番号で Move を続けます。
+		events = Step(&detector, { { 304, 201 } });
+		CHECK(events.size() == 1 && HasEvent(events, TouchEvent::Move, 2, 304.0f, 201.0f));
+
+		events = Step(&detector, { { 111, 102 }, { 306, 202 } });
+		CHECK(events.size() == 2);
+		CHECK(HasEvent(events, TouchEvent::Move, 1, 111.0f, 102.0f));
+		CHECK(HasEvent(events, TouchEvent::Move, 2, 306.0f, 202.0f));
+
+		// 両方を 2 フレーム見失うと、最後の位置で Up を通知します。
+		events = Step(&detector, {});
+		CHECK(events.empty());
+		events = Step(&detector, {});
+		CHECK(events.size() == 2);
+		CHECK(HasEvent(events, TouchEvent::Up, 1, 111.0f, 102.0f));
+		CHECK(HasEvent(events, TouchEvent::Up, 2, 306.0f, 202.0f));
+
+		events = Step(&detector, {});
+		CHECK(events.empty());
+
+		// 同じ場所にまた触れると新しい番号です。
+		Step(&detector, { { 111, 102 } });
+		events = Step(&detector, { { 111, 102 } });
+		CHECK(events.size() == 1 && HasEvent(events, TouchEvent::Down, 3, 111.0f, 102.0f));
+	}
+
+	// 1 フレームだけのちらつきはイベントになりません。照合の半径より大きく跳んだ指は、別の指として Down し、元の指は Up します。
+	void TestFlickerAndJump()
+	{
+		TouchDetector detector;
+		LearnFlatSurface(&detector);
+
+		CHECK(Step(&detector, { { 200, 200 } }).empty());
+		CHECK(Step(&detector, {}).empty());
+		CHECK(Step(&detector, {}).empty());
+
+		// ちらつきの分も番号は進み、使い回しません。
+		Step(&detector, { { 50, 50 } });
+		std::vector<TouchEvent> events = Step(&detector, { { 50, 50 } });
+		CHECK(events.size() == 1 && HasEvent(events, TouchEvent::Down, 2, 50.0f, 50.0f));
+
+		// 既定の照合の半径は 12 画素です。ちょうど 12 画素の移動は同じ指です。
+		events = Step(&detector, { { 62, 50 } });
+		CHECK(events.size() == 1 && HasEvent(events, TouchEvent::Move, 2, 62.0f, 50.0f));
+		events = Step(&detector, { { 50, 50 } });
+		CHECK(events.size() == 1 && HasEvent(events, TouchEvent::Move, 2, 50.0f, 50.0f));
+
+		events = Step(&detector, { { 80, 50 } });
+		CHECK(events.empty());
+		events = Step(&detector, { { 82, 50 } });
+		CHECK(events.size() == 2);
+		CHECK(HasEvent(events, TouchEvent::Down, 3, 82.0f, 50.0f));
+		CHECK(HasEvent(events, TouchEvent::Up, 2, 50.0f, 50.0f));
+	}
+
+	// 近くの 2 本の指が同じ向きに動いても、それぞれ最も近い前のタッチと対応付けられ、番号が入れ替わりません。
+	void TestNearbyFingersKeepIds()
+	{
+		TouchDetector detector;
+		LearnFlatSurface(&detector);
+
+		Step(&detector, { { 200, 200 }, { 216, 200 } });
+		std::vector<TouchEvent> events = Step(&detector, { { 200, 200 }, { 216, 200 } });
+		CHECK(events.size() == 2);
+		CHECK(HasEvent(events, TouchEvent::Down, 1, 200.0f, 200.0f));
+		CHECK(HasEvent(events, TouchEvent::Down, 2, 216.0f, 200.0f));
+
+		// 1 本目は自分の元の位置から 4 画素、2 本目の元の位置から照合の半径ちょうどの 12 画素です。
+		for (int step = 1; step <= 5; step++)
+		{
+			events = Step(&detector, { { 200 + step * 4, 200 }, { 216 + step * 4, 200 } });
+			CHECK(events.size() == 2);
+			CHECK(HasEvent(events, TouchEvent::Move, 1, 200.0f + step * 4, 200.0f));
+			CHECK(HasEvent(events, TouchEvent::Move, 2, 216.0f + step * 4, 200.0f));
+		}
+	}
+
+	// 4 画素ずつの 2 つの塊は、斜めにだけ接していても 1 つの指先 (6 画素以上) です。右上と左上の両方の向きを調べます。
+	void TestDiagonalPiecesFormOneFingertip()
+	{
+		TouchDetector detector;
+		LearnFlatSurface(&detector);
+
+		std::vector<uint16_t> depth(Width * Height, SurfaceDepth);
+		auto square = [&](uint32_t x, uint32_t y)
+		{
+			for (uint32_t dy = 0; dy < 2; dy++)
+			{
+				for (uint32_t dx = 0; dx < 2; dx++)
+				{
+					depth[(y + dy) * Width + x + dx] = SurfaceDepth - 10;
+				}
+			}
+		};
+		square(100, 100);
+		square(102, 98);
+		square(202, 100);
+		square(200, 98);
+
+		std::vector<TouchEvent> events;
+		CHECK(detector.Detect(depth.data(), Width, Height, &events) && events.empty());
+		CHECK(detector.Detect(depth.data(), Width, Height, &events));
+		CHECK(events.size() == 2);
+		CHECK(HasEvent(events, TouchEvent::Down, 1, 101.5f, 99.5f));
+		CHECK(HasEvent(events, TouchEvent::Down, 2, 201.5f, 99.5f));
+	}
+
+	// 帯より高いもの、指先より大きいものや小さいものはタッチになりません。面の学習前や大きさが違う場合は失敗します。
+	void TestRejectsNonFingers()
+	{
+		TouchDetector detector;
+		std::vector<TouchEvent> events;
+		std::vector<uint16_t> depth = RenderFingers({ { 100, 100 } });
+		CHECK(!detector.Detect(depth.data(), Width, Height, &events));
+
+		LearnFlatSurface(&detector);
+		CHECK(!detector.Detect(depth.data(), Width, Height - 1, &events));
+
+		// 浮いた指、手のひら (709 画素)、5 画素のノイズを、それぞれ 3 フレーム続けます。
+		const std::vector<Finger> fingers = { { 100, 100 } };
+		const std::vector<uint16_t> frames[3] = { RenderFingers(fingers, 3, 30), RenderFingers(fingers, 15), RenderFingers(fingers, 1) };
+		for (int kind = 0; kind < 3; kind++)
+		{
+			for (int frame = 0; frame < 3; frame++)
+			{
+				CHECK(detector.Detect(frames[kind].data(), Width, Height, &events) && events.empty());
+			}
+		}
+
+		detector.ResetSurface();
+		CHECK(!detector.Detect(depth.data(), Width, Height, &events));
+	}
+
+	// ノイズのある面で、SIMD と端数の画素のタッチ マスクが画素ごとの規則と一致します。
+	// 最後のストリップ (11 行) の画素数が 16 の倍数でないので、末尾の 15 画素はベクトルを使わずに分類します。
+	void TestTouchMaskMatchesRule()
+	{
+		const uint32_t width = 509, height = 43;
+		const uint32_t frames = 10;
+		std::mt19937 random(3);
+		std::vector<std::vector<uint16_t> > surfaceFrames(frames, std::vector<uint16_t>(width * height));
+
+		TouchDetector detector;
+		for (uint32_t frame = 0; frame < frames; frame++)
+		{
+			for (uint32_t i = 0; i < width * height; i++)
+			{
+				// 右に行くほどノイズが大きく、一部の画素はしばしば測定できません。
+				const uint32_t noise = 1 + i % width / 40;
+				surfaceFrames[frame][i] = (random() % (i % 7 == 0 ? 2 : 50) == 0) ? 0 : static_cast<uint16_t>(1500 + random() % noise);
+			}
+			detector.AccumulateSurface(surfaceFrames[frame].data(), width, height);
+		}
+
+		// 面の平均と、ノイズの 3 倍か 4 ミリメートルの大きい方を下限とする帯。面を使わない画素は surface が 0 です。
+		std::vector<int> surface(width * height, 0), lowerBound(width * height, 0);
+		for (uint32_t i = 0; i < width * height; i++)
+		{
+			double sum = 0.0, sumSquares = 0.0;
+			uint32_t count = 0;
+			for (uint32_t frame = 0; frame < frames; frame++)
+			{
+				const double d = surfaceFrames[frame][i];
+				sum += d;
+				sumSquares += d * d;
+				count += d != 0 ? 1 : 0;
+			}
+			if (count * 2 >= frames)
+			{
+				const double mean = sum / count;
+				const float bound = std::max(4.0f, std::ceil(3.0f * static_cast<float>(std::sqrt(std::max(0.0, sumSquares / count - mean * mean)))));
+				if (bound <= 20.0f)
+				{
+					surface[i] = static_cast<int>(mean + 0.5);
+					lowerBound[i] = static_cast<int>(bound);
+				}
+			}
+		}
+
+		// 多くの画素と末尾の画素はすべて、帯の両端かそのすぐ外に置きます。残りは面の前後に散らします。
+		std::vector<uint16_t> depth(width * height);
+		for (uint32_t i = 0; i < width * height; i++)
+		{
+			const int edges[4] = { lowerBound[i] - 1, lowerBound[i], 20, 21 };
+			const bool tail = i + 15 >= width * height;
+			const uint32_t r = random();
+			if (surface[i] != 0 && (tail || r % 3 != 0))
+			{
+				depth[i] = static_cast<uint16_t>(surface[i] - edges[i % 4]);
+			}
+			else
+			{
+				depth[i] = (r % 20 == 0) ? 0 : static_cast<uint16_t>(1470 + r / 3 % 40);
+			}
+		}
+		std::vector<TouchEvent> events;
+		CHECK(detector.Detect(depth.data(), width, height, &events));
+
+		int mismatches = 0;
+		int tailCandidates = 0;
+		int candidates = 0;
+		for (uint32_t i = 0; i < width * height; i++)
+		{
+			const int heightAbove = surface[i] - depth[i];
+			const uint8_t expected = (surface[i] != 0 && depth[i] != 0 && heightAbove >= lowerBound[i] && heightAbove <= 20) ? 0xFF : 0;
+			mismatches += detector.GetTouchMask()[i] != expected ? 1 : 0;
+			candidates += expected != 0 ? 1 : 0;
+			tailCandidates += expected != 0 && i + 15 >= width * height ? 1 : 0;
+		}
+		CHECK(candidates > 5000);
+		CHECK(tailCandidates > 3);
+		CHECK(mismatches == 0);
+	}
+}
+
+int main()
+{
+	TestDownMoveUpSequence();
+	TestFlickerAndJump();
+	TestNearbyFingersKeepIds();
+	TestDiagonalPiecesFormOneFingertip();
+	TestRejectsNonFingers();
+	TestTouchMaskMatchesRule();
+	return TestCheck::TestResult();
+}
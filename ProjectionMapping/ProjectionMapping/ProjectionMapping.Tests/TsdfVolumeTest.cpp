@@ -0,0 +1,195 @@
+﻿#include "Reconstruction/TsdfVolume.h"
+#include "SyntheticDepth.h"
+#include "TestCheck.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace ProjectionMapping;
+
+namespace
+{
+	const float VoxelSize = 0.01f;
+	const float Truncation = 0.04f;
+
+	// 量子化と整数の平均による丸めの許容誤差 (正規化した距離)。
+	const float DistanceTolerance = 1.0e-3f;
+
+	// ボクセルの中心のワールド座標。
+	void GetVoxelCenter(const TsdfVolume::Block& block, uint32_t index, float* center)
+	{
+		const int32_t local[3] =
+		{
+			static_cast<int32_t>(index % TsdfVolume::BlockSize),
+			static_cast<int32_t>(index / TsdfVolume::BlockSize % TsdfVolume::BlockSize),
+			static_cast<int32_t>(index / (TsdfVolume::BlockSize * TsdfVolume::BlockSize))
+		};
+		const int32_t coordinate[3] = { block.coordinate.x, block.coordinate.y, block.coordinate.z };
+		for (int i = 0; i < 3; i++)
+		{
+			center[i] = (coordinate[i] * static_cast<int32_t>(TsdfVolume::BlockSize) + local[i] + 0.5f) * VoxelSize;
+		}
+	}
+
+	// 正面を向いた平面では、光線に沿った距離は z の差と同じです。観測したボクセルの距離が
+	// min((planeZ - z) / truncation, 1) と一致し、重みが expectedWeight であることを調べます。
+	// 平面より奥の打ち切り距離を超えたボクセルは観測しません。観測したボクセルの数を返します。
+	uint32_t CheckFrontoParallelPlane(const TsdfVolume& volume, float planeZ, uint32_t expectedWeight, int* mismatches)
+	{
+		uint32_t observed = 0;
+		for (uint32_t b = 0; b < volume.GetBlockCount(); b++)
+		{
+			const TsdfVolume::Block& block = volume.GetBlock(b);
+			for (uint32_t i = 0; i < TsdfVolume::BlockVoxelCount; i++)
+			{
+				const TsdfVoxel& voxel = block.voxels[i];
+				float center[3];
+				GetVoxelCenter(block, i, center);
+
+				if (voxel.weight == 0)
+				{
+					continue;
+				}
+				observed++;
+
+				const float expected = std::min((planeZ - center[2]) / Truncation, 1.0f);
+				const float distance = voxel.distance / static_cast<float>(TsdfVolume::DistanceScale);
+				if (expected < -1.0f - DistanceTolerance || std::fabs(distance - expected) > DistanceTolerance || voxel.weight != expectedWeight)
+				{
+					(*mismatches)++;
+				}
+			}
+		}
+		return observed;
+	}
+
+	// z = 1.5 の平面を正面から 3 回統合します。距離は変わらず、重みは統合した回数になります。
+	void TestFrontoParallelPlane()
+	{
+		std::vector<uint16_t> depth;
+		const float point[3] = { 0.0f, 0.0f, 1.5f };
+		const float normal[3] = { 0.0f, 0.0f, -1.0f };
+		SyntheticDepth::RenderPlane(point, normal, &depth);
+
+		TsdfVolume volume(VoxelSize, Truncation);
+		for (uint32_t frame = 1; frame <= 3; frame++)
+		{
+			CHECK(volume.Integrate(depth.data(), SyntheticDepth::GetIntrinsics(), RigidTransform::Identity()) > 0);
+			int mismatches = 0;
+			CHECK(CheckFrontoParallelPlane(volume, 1.5f, frame, &mismatches) > 100000);
+			CHECK(mismatches == 0);
+		}
+		CHECK(volume.GetIntegrationCount() == 3);
+
+		// ブロックは平面の前後の打ち切り距離の範囲だけに割り当て、すべて最後のフレームで統合しています。
+		const int32_t blockDepth = static_cast<int32_t>(TsdfVolume::BlockSize);
+		const int32_t nearVoxel = static_cast<int32_t>(std::floor((1.5f - Truncation) / VoxelSize)) - 1;
+		const int32_t farVoxel = static_cast<int32_t>(std::ceil((1.5f + Truncation) / VoxelSize)) + 1;
+		int outside = 0;
+		for (uint32_t b = 0; b < volume.GetBlockCount(); b++)
+		{
+			const TsdfVolume::Block& block = volume.GetBlock(b);
+			if ((block.coordinate.z + 1) * blockDepth <= nearVoxel || block.coordinate.z * blockDepth >= farVoxel || block.modifiedStamp != 3)
+			{
+				outside++;
+			}
+			CHECK(volume.FindBlock(block.coordinate) == &block);
+		}
+		CHECK(outside == 0);
+	}
+
+	// 重みは上限で止まります。
+	void TestMaxWeight()
+	{
+		std::vector<uint16_t> depth;
+		const float point[3] = { 0.0f, 0.0f, 1.5f };
+		const float normal[3] = { 0.0f, 0.0f, -1.0f };
+		SyntheticDepth::RenderPlane(point, normal, &depth);
+
+		TsdfVolume volume(VoxelSize, Truncation);
+		volume.SetMaxWeight(2);
+		for (int frame = 0; frame < 4; frame++)
+		{
+			volume.Integrate(depth.data(), SyntheticDepth::GetIntrinsics(), RigidTransform::Identity());
+		}
+		int mismatches = 0;
+		CheckFrontoParallelPlane(volume, 1.5f, 2, &mismatches);
+		CHECK(mismatches == 0);
+	}
+
+	// カメラが奥に 0.5 メートル動いた姿勢では、カメラ座標の z = 1.5 の平面はワールド座標の z = 2 です。
+	void TestCameraPose()
+	{
+		std::vector<uint16_t> depth;
+		const float point[3] = { 0.0f, 0.0f, 1.5f };
+		const float normal[3] = { 0.0f, 0.0f, -1.0f };
+		SyntheticDepth::RenderPlane(point, normal, &depth);
+
+		RigidTransform cameraToWorld = RigidTransform::Identity();
+		cameraToWorld.translation[2] = 0.5f;
+
+		TsdfVolume volume(VoxelSize, Truncation);
+		volume.Integrate(depth.data(), SyntheticDepth::GetIntrinsics(), cameraToWorld);
+		int mismatches = 0;
+		CHECK(CheckFrontoParallelPlane(volume, 2.0f, 1, &mismatches) > 100000);
+		CHECK(mismatches == 0);
+	}
+
+	// 傾いた平面では、距離はボクセルを通る光線と平面の交点の z との差で、平面までの距離とは異なります。
+	// 符号は平面のどちら側かと一致します。丸めで符号が変わりうる、平面から 1.5 ボクセル以内のボクセルは除きます。
+	void TestTiltedPlane()
+	{
+		std::vector<uint16_t> depth;
+		const float point[3] = { 0.0f, 0.0f, 1.5f };
+		const float normal[3] = { 0.3f, 0.0f, -1.0f };
+		SyntheticDepth::RenderPlane(point, normal, &depth);
+
+		TsdfVolume volume(VoxelSize, Truncation);
+		volume.Integrate(depth.data(), SyntheticDepth::GetIntrinsics(), RigidTransform::Identity());
+
+		// カメラの側が正になる、平面までの符号付き距離。
+		const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		const float offset = point[0] * normal[0] + point[1] * normal[1] + point[2] * normal[2];
+
+		uint32_t checked = 0;
+		int wrongSign = 0;
+		int mismatches = 0;
+		for (uint32_t b = 0; b < volume.GetBlockCount(); b++)
+		{
+			const TsdfVolume::Block& block = volume.GetBlock(b);
+			for (uint32_t i = 0; i < TsdfVolume::BlockVoxelCount; i++)
+			{
+				const TsdfVoxel& voxel = block.voxels[i];
+				float center[3];
+				GetVoxelCenter(block, i, center);
+				const float signedDistance = (center[0] * normal[0] + center[1] * normal[1] + center[2] * normal[2] - offset) / length;
+				if (voxel.weight == 0 || std::fabs(signedDistance) < 1.5f * VoxelSize)
+				{
+					continue;
+				}
+				checked++;
+
+				const float distance = voxel.distance / static_cast<float>(TsdfVolume::DistanceScale);
+				wrongSign += (distance > 0.0f) != (signedDistance > 0.0f) ? 1 : 0;
+
+				// 画素への丸め (約 0.6 ミリメートル) と深度の量子化 (0.5 ミリメートル) の分だけずれます。
+				const float surfaceZ = offset / (center[0] / center[2] * normal[0] + center[1] / center[2] * normal[1] + normal[2]);
+				const float expected = std::min((surfaceZ - center[2]) / Truncation, 1.0f);
+				mismatches += std::fabs(distance - expected) > 0.04f ? 1 : 0;
+			}
+		}
+		CHECK(checked > 50000);
+		CHECK(wrongSign == 0);
+		CHECK(mismatches == 0);
+	}
+}
+
+int main()
+{
+	TestFrontoParallelPlane();
+	TestMaxWeight();
+	TestCameraPose();
+	TestTiltedPlane();
+	return TestCheck::TestResult();
+}
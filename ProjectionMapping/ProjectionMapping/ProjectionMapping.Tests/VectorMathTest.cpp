@@ -0,0 +1,372 @@
+﻿#include "Math/VectorMath.h"
+#include "TestCheck.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(VECTORMATHTEST_CAPTURE_DIRECTXMATH)
+#include <DirectXMath.h>
+#endif
+
+// VectorMath の結果を保存した参照値とビット単位で比べます。SIMD の経路どうしが一致することと、変更で丸めが変わらないことを確認します。
+// 参照値は DirectXMath の SSE2 の経路 (FMA なし) の演算を同じ順序で書き写して求めたもので、DirectXMath 自体の出力ではありません。
+// DirectXMath と一致することは、VECTORMATHTEST_CAPTURE_DIRECTXMATH を定義して DirectXMath と一緒にビルドし、出力した表を
+// ReferenceBits と比べるまで保証されません。このモードでは VectorMath の代わりに DirectXMath で計算して表を出力します。
+// CMake では SSE2 (ARM では NEON)、スカラー、AVX の経路をそれぞれ別の実行可能ファイルとしてビルドします。
+namespace
+{
+	using namespace ProjectionMapping;
+
+	// 入力。象限の境界をまたぐ角度と、[-π, π] に畳む必要がある大きな角度を含みます。
+	const float SinCosAngles[] = { 0.0f, 0.5f, -0.5f, 1.5707963f, -1.5707963f, 2.0f, -2.0f, 3.1415927f, -3.1415927f, 3.5f, -3.5f, 10.0f, -10.0f, 100.0f, 1000.5f };
+	const size_t SinCosAngleCount = sizeof(SinCosAngles) / sizeof(SinCosAngles[0]);
+
+	const float MatrixA[16] =
+	{
+		0.8f, -1.25f, 2.5f, 0.0f,
+		1.5f, 0.3f, -0.7f, 0.0f,
+		-2.2f, 0.9f, 1.1f, 0.0f,
+		3.75f, -4.5f, 0.125f, 1.0f,
+	};
+	const float MatrixB[16] =
+	{
+		1.1f, 0.2f, -0.4f, 0.05f,
+		-0.6f, 1.3f, 0.8f, -0.1f,
+		0.25f, -0.9f, 0.7f, 0.3f,
+		2.0f, 1.5f, -3.0f, 1.0f,
+	};
+	const float Point[3] = { 1.7f, -2.3f, 0.6f };
+
+	const float RotationAngles[3] = { 0.7f, -1.9f, 2.6f };
+	const float QuaternionAxisFirst[3] = { 1.0f, 2.0f, 3.0f };
+	const float QuaternionAngleFirst = 0.9f;
+	const float QuaternionAxisSecond[3] = { -2.0f, 0.5f, 1.0f };
+	const float QuaternionAngleSecond = -2.3f;
+	const float QuaternionUnnormalized[4] = { 0.3f, -1.2f, 0.8f, 2.1f };
+
+	const float FovAngleY = 0.8f;
+	const float AspectRatio = 16.0f / 9.0f;
+	const float NearZ = 0.05f;
+	const float FarZ = 50.0f;
+	const float Eye[3] = { 1.5f, 2.0f, 4.0f };
+	const float Focus[3] = { 0.0f, 0.5f, -1.0f };
+	const float Up[3] = { 0.0f, 1.0f, 0.0f };
+
+	// 比較する結果。すべて float なので、ビット列の配列として比較します。
+	struct Results
+	{
+		float sinCos[SinCosAngleCount][2];
+		float product[16];
+		float transformPoint[4];
+		float transformNormal[4];
+		float rotationX[16];
+		float rotationProduct[16];
+		float quaternionFirst[4];
+		float quaternionSecond[4];
+		float quaternionProduct[4];
+		float quaternionNormalized[4];
+		float rotationQuaternion[16];
+		float perspective[16];
+		float lookAt[16];
+	};
+
+	struct Section
+	{
+		const char* name;
+		size_t offset;
+		size_t count;
+	};
+
+#define VECTORMATHTEST_SECTION(member) { #member, offsetof(Results, member), sizeof(static_cast<Results*>(nullptr)->member) / sizeof(float) }
+	const Section Sections[] =
+	{
+		VECTORMATHTEST_SECTION(sinCos),
+		VECTORMATHTEST_SECTION(product),
+		VECTORMATHTEST_SECTION(transformPoint),
+		VECTORMATHTEST_SECTION(transformNormal),
+		VECTORMATHTEST_SECTION(rotationX),
+		VECTORMATHTEST_SECTION(rotationProduct),
+		VECTORMATHTEST_SECTION(quaternionFirst),
+		VECTORMATHTEST_SECTION(quaternionSecond),
+		VECTORMATHTEST_SECTION(quaternionProduct),
+		VECTORMATHTEST_SECTION(quaternionNormalized),
+		VECTORMATHTEST_SECTION(rotationQuaternion),
+		VECTORMATHTEST_SECTION(perspective),
+		VECTORMATHTEST_SECTION(lookAt),
+	};
+#undef VECTORMATHTEST_SECTION
+
+	uint32_t ToBits(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+#if defined(VECTORMATHTEST_CAPTURE_DIRECTXMATH)
+	using namespace DirectX;
+
+	XMMATRIX LoadMatrix(const float* m)
+	{
+		XMFLOAT4X4 stored;
+		memcpy(stored.m, m, sizeof(stored.m));
+		return XMLoadFloat4x4(&stored);
+	}
+
+	void StoreMatrix(const XMMATRIX& matrix, float* m)
+	{
+		XMFLOAT4X4 stored;
+		XMStoreFloat4x4(&stored, matrix);
+		memcpy(m, stored.m, sizeof(stored.m));
+	}
+
+	void StoreVector(const XMVECTOR& v, float* p)
+	{
+		XMFLOAT4 stored;
+		XMStoreFloat4(&stored, v);
+		p[0] = stored.x;
+		p[1] = stored.y;
+		p[2] = stored.z;
+		p[3] = stored.w;
+	}
+
+	XMVECTOR LoadVector3(const float* p)
+	{
+		const XMFLOAT3 stored(p[0], p[1], p[2]);
+		return XMLoadFloat3(&stored);
+	}
+
+	void Compute(Results* results)
+	{
+		for (size_t i = 0; i < SinCosAngleCount; i++)
+		{
+			XMScalarSinCos(&results->sinCos[i][0], &results->sinCos[i][1], SinCosAngles[i]);
+		}
+
+		const XMMATRIX a = LoadMatrix(MatrixA);
+		StoreMatrix(XMMatrixMultiply(a, LoadMatrix(MatrixB)), results->product);
+		StoreVector(XMVector3Transform(LoadVector3(Point), a), results->transformPoint);
+		StoreVector(XMVector3TransformNormal(LoadVector3(Point), a), results->transformNormal);
+
+		StoreMatrix(XMMatrixRotationX(RotationAngles[0]), results->rotationX);
+		const XMMATRIX rotation = XMMatrixMultiply(
+			XMMatrixMultiply(XMMatrixRotationX(RotationAngles[0]), XMMatrixRotationY(RotationAngles[1])),
+			XMMatrixRotationZ(RotationAngles[2]));
+		StoreMatrix(rotation, results->rotationProduct);
+
+		const XMVECTOR first = XMQuaternionRotationNormal(XMVector3Normalize(LoadVector3(QuaternionAxisFirst)), QuaternionAngleFirst);
+		const XMVECTOR second = XMQuaternionRotationNormal(XMVector3Normalize(LoadVector3(QuaternionAxisSecond)), QuaternionAngleSecond);
+		const XMVECTOR product = XMQuaternionMultiply(first, second);
+		const XMFLOAT4 unnormalized(QuaternionUnnormalized[0], QuaternionUnnormalized[1], QuaternionUnnormalized[2], QuaternionUnnormalized[3]);
+		StoreVector(first, results->quaternionFirst);
+		StoreVector(second, results->quaternionSecond);
+		StoreVector(product, results->quaternionProduct);
+		StoreVector(XMQuaternionNormalize(XMLoadFloat4(&unnormalized)), results->quaternionNormalized);
+		StoreMatrix(XMMatrixRotationQuaternion(product), results->rotationQuaternion);
+
+		StoreMatrix(XMMatrixPerspectiveFovRH(FovAngleY, AspectRatio, NearZ, FarZ), results->perspective);
+		StoreMatrix(XMMatrixLookAtRH(LoadVector3(Eye), LoadVector3(Focus), LoadVector3(Up)), results->lookAt);
+	}
+#else
+	// XMScalarSinCos、XMMatrixMultiply などの SSE2 の経路を書き写した演算で求めた値です。DirectXMath では未確認です。
+	// Windows で VECTORMATHTEST_CAPTURE_DIRECTXMATH を定義してビルドした出力と異なる場合は、その出力で置き換えてください。
+	const uint32_t ReferenceBits[] =
+	{
+		// sinCos
+		0x00000000, 0x3F800000, 0x3EF57744, 0x3F60A940,
+		0xBEF57744, 0x3F60A940, 0x3F800000, 0x33800000,
+		0xBF800000, 0x33800000, 0x3F68C7B9, 0xBED51130,
+		0xBF68C7B9, 0xBED51130, 0x00000000, 0xBF800000,
+		0x00000000, 0xBF800000, 0xBEB399DA, 0xBF6FBBA1,
+		0x3EB399DA, 0xBF6FBBA1, 0xBF0B44F4, 0xBF56CD66,
+		0x3F0B44F4, 0xBF56CD66, 0xBF01A156, 0x3F5CC0D6,
+		0x3F7ECA1E, 0x3DC6ED38,
+		// product
+		0x401051EC, 0xC06DC28F, 0x3EDC28F4, 0x3F6A3D71,
+		0x3FA5C290, 0x3FA8F5C3, 0xBF59999A, 0xBE28F5C3,
+		0xC02BD70A, 0xBE851EBC, 0x4017AE15, 0x3E051EB8,
+		0x410DB333, 0xC06D9999, 0xC1003334, 0x3FD66667,
+		// transformPoint
+		0x3EAE147C, 0xC0D8CCCD, 0x40D4A3D7, 0x3F800000,
+		// transformNormal
+		0xC05A3D70, 0xC011999A, 0x40D0A3D7, 0x00000000,
+		// rotationX
+		0x3F800000, 0x00000000, 0x00000000, 0x00000000,
+		0x00000000, 0x3F43CCB2, 0x3F24EB73, 0x00000000,
+		0x00000000, 0xBF24EB73, 0x3F43CCB2, 0x00000000,
+		0x00000000, 0x00000000, 0x00000000, 0x3F800000,
+		// rotationProduct
+		0x3E8DD5F8, 0xBE2AA7EC, 0x3F7240B9, 0x00000000,
+		0x3E032D28, 0xBF783ABC, 0xBE554469, 0x00000000,
+		0x3F73C8FE, 0x3E373654, 0xBE7D3324, 0x00000000,
+		0x00000000, 0x00000000, 0x00000000, 0x3F800000,
+		// quaternionFirst
+		0x3DEE142D, 0x3E6E142D, 0x3EB28F22, 0x3F6683B4,
+		// quaternionSecond
+		0x3F4BF636, 0xBE4BF636, 0xBECBF636, 0x3ED12544,
+		// quaternionProduct
+		0x3F49BDAD, 0xBED12CE4, 0xBC00A940, 0x3EEBBED2,
+		// quaternionNormalized
+		0x3DEF84A1, 0xBEEF84A1, 0x3E9FADC0, 0x3F51940B,
+		// rotationQuaternion
+		0x3F2A82C1, 0xBF26B128, 0x3EBA49DD, 0x00000000,
+		0xBF22FD4E, 0xBE77FB85, 0x3F3B6C01, 0x00000000,
+		0xBEC6F663, 0xBF3822FB, 0xBF136BF6, 0x00000000,
+		0x00000000, 0x00000000, 0x00000000, 0x3F800000,
+		// perspective
+		0x3FAA4BC8, 0x00000000, 0x00000000, 0x00000000,
+		0x00000000, 0x40175FCE, 0x00000000, 0x00000000,
+		0x00000000, 0x00000000, 0xBF8020CD, 0xBF800000,
+		0x00000000, 0x00000000, 0xBD4D0148, 0x00000000,
+		// lookAt
+		0x3F75341B, 0xBDA28635, 0x3E8D6677, 0x00000000,
+		0x00000000, 0x3F760B2F, 0x3E8D6677, 0x00000000,
+		0xBE931F43, 0xBE876FD8, 0x3F6BAAC7, 0x00000000,
+		0xBE931F44, 0xBF3EBD84, 0xC094C3CE, 0x3F800000,
+	};
+	static_assert(sizeof(ReferenceBits) == sizeof(Results), "ReferenceBits must cover every result");
+
+	void StoreMatrix(const Matrix& matrix, float* m)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			matrix.rows[row].Store(m + row * 4);
+		}
+	}
+
+	void Compute(Results* results)
+	{
+		for (size_t i = 0; i < SinCosAngleCount; i++)
+		{
+			Scalar::SinCos(SinCosAngles[i], &results->sinCos[i][0], &results->sinCos[i][1]);
+		}
+
+		const Matrix a = Matrix::Load(MatrixA);
+		StoreMatrix(a * Matrix::Load(MatrixB), results->product);
+		a.TransformPoint(Vector::Load3(Point, 1.0f)).Store(results->transformPoint);
+		a.TransformNormal(Vector::Load3(Point, 0.0f)).Store(results->transformNormal);
+
+		StoreMatrix(Matrix::RotationX(RotationAngles[0]), results->rotationX);
+		const Matrix rotation = Matrix::RotationX(RotationAngles[0]) * Matrix::RotationY(RotationAngles[1]) * Matrix::RotationZ(RotationAngles[2]);
+		StoreMatrix(rotation, results->rotationProduct);
+
+		const Vector first = Quaternion::RotationNormal(Vector::Normalize3(Vector::Load3(QuaternionAxisFirst, 0.0f)), QuaternionAngleFirst);
+		const Vector second = Quaternion::RotationNormal(Vector::Normalize3(Vector::Load3(QuaternionAxisSecond, 0.0f)), QuaternionAngleSecond);
+		const Vector product = Quaternion::Multiply(first, second);
+		first.Store(results->quaternionFirst);
+		second.Store(results->quaternionSecond);
+		product.Store(results->quaternionProduct);
+		Quaternion::Normalize(Vector::Load(QuaternionUnnormalized)).Store(results->quaternionNormalized);
+		StoreMatrix(Matrix::RotationQuaternion(product), results->rotationQuaternion);
+
+		StoreMatrix(Matrix::PerspectiveFovRH(FovAngleY, AspectRatio, NearZ, FarZ), results->perspective);
+		StoreMatrix(Matrix::LookAtRH(Vector::Load3(Eye, 0.0f), Vector::Load3(Focus, 0.0f), Vector::Load3(Up, 0.0f)), results->lookAt);
+	}
+
+	// MathBatch は 1 要素ずつの Matrix の演算と同じビット列になります。AVX の 2 要素ずつの経路と端数の両方を通します。
+	void TestMathBatch(const Results& results)
+	{
+		const float points[3 * 3] = { Point[0], Point[1], Point[2], -0.4f, 5.5f, 2.25f, Point[0], Point[1], Point[2] };
+		float transformed[3 * 3];
+		float normals[3 * 3];
+		MathBatch::TransformPoints(Matrix::Load(MatrixA), points, 3, transformed);
+		MathBatch::TransformNormals(Matrix::Load(MatrixA), points, 3, normals);
+
+		const Matrix a = Matrix::Load(MatrixA);
+		float expectedPoint[4];
+		float expectedNormal[4];
+		a.TransformPoint(Vector::Load3(points + 3, 1.0f)).Store(expectedPoint);
+		a.TransformNormal(Vector::Load3(points + 3, 0.0f)).Store(expectedNormal);
+		for (int i = 0; i < 3; i++)
+		{
+			CHECK(ToBits(transformed[i]) == ToBits(results.transformPoint[i]));
+			CHECK(ToBits(transformed[3 + i]) == ToBits(expectedPoint[i]));
+			CHECK(ToBits(transformed[6 + i]) == ToBits(results.transformPoint[i]));
+			CHECK(ToBits(normals[i]) == ToBits(results.transformNormal[i]));
+			CHECK(ToBits(normals[3 + i]) == ToBits(expectedNormal[i]));
+			CHECK(ToBits(normals[6 + i]) == ToBits(results.transformNormal[i]));
+		}
+
+		Float4x4 left[3];
+		memcpy(left[0].m, MatrixA, sizeof(MatrixA));
+		memcpy(left[1].m, results.rotationProduct, sizeof(results.rotationProduct));
+		memcpy(left[2].m, MatrixA, sizeof(MatrixA));
+		Float4x4 products[3];
+		MathBatch::Multiply(left, 3, Matrix::Load(MatrixB), products);
+
+		float expected[16];
+		StoreMatrix(Matrix::Load(results.rotationProduct) * Matrix::Load(MatrixB), expected);
+		for (int i = 0; i < 16; i++)
+		{
+			CHECK(ToBits((&products[0].m[0][0])[i]) == ToBits(results.product[i]));
+			CHECK(ToBits((&products[1].m[0][0])[i]) == ToBits(expected[i]));
+			CHECK(ToBits((&products[2].m[0][0])[i]) == ToBits(results.product[i]));
+		}
+
+		// 定数バッファー向けの転置も同じ積を並べ替えるだけです。
+		float transposed[2][16];
+		MathBatch::MultiplyTransposed(left, 2, Matrix::Load(MatrixB), transposed, sizeof(transposed[0]));
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				CHECK(ToBits(transposed[0][column * 4 + row]) == ToBits(results.product[row * 4 + column]));
+				CHECK(ToBits(transposed[1][column * 4 + row]) == ToBits(expected[row * 4 + column]));
+			}
+		}
+	}
+
+	const char* GetPathName()
+	{
+#if defined(PROJECTIONMAPPING_MATH_AVX)
+		return "AVX";
+#elif defined(PROJECTIONMAPPING_MATH_SSE2)
+		return "SSE2";
+#elif defined(PROJECTIONMAPPING_MATH_NEON)
+		return "NEON";
+#else
+		return "scalar";
+#endif
+	}
+#endif
+}
+
+int main()
+{
+	Results results;
+	Compute(&results);
+	const float* values = reinterpret_cast<const float*>(&results);
+
+#if defined(VECTORMATHTEST_CAPTURE_DIRECTXMATH)
+	// ReferenceBits の初期化子をそのまま出力します。
+	for (size_t s = 0; s < sizeof(Sections) / sizeof(Sections[0]); s++)
+	{
+		printf("\t\t// %s\n", Sections[s].name);
+		for (size_t i = 0; i < Sections[s].count; i++)
+		{
+			printf("%s0x%08X,%s", (i % 4 == 0) ? "\t\t" : " ", static_cast<unsigned int>(ToBits(values[Sections[s].offset / sizeof(float) + i])), (i % 4 == 3 || i + 1 == Sections[s].count) ? "\n" : "");
+		}
+	}
+	return 0;
+#else
+	printf("VectorMath path: %s\n", GetPathName());
+
+	for (size_t s = 0; s < sizeof(Sections) / sizeof(Sections[0]); s++)
+	{
+		for (size_t i = 0; i < Sections[s].count; i++)
+		{
+			const size_t index = Sections[s].offset / sizeof(float) + i;
+			const uint32_t bits = ToBits(values[index]);
+			if (bits != ReferenceBits[index])
+			{
+				fprintf(stderr, "%s[%u]: 0x%08X (%.9g), expected 0x%08X\n", Sections[s].name, static_cast<unsigned int>(i), static_cast<unsigned int>(bits), values[index], static_cast<unsigned int>(ReferenceBits[index]));
+				TestCheck::Fail(__FILE__, __LINE__, Sections[s].name);
+			}
+		}
+	}
+	TestMathBatch(results);
+
+	return TestCheck::TestResult();
+#endif
+}